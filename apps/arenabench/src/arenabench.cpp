@@ -0,0 +1,201 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+
+/**
+ * @file     arenabench.cpp
+ * @brief    Request scoped allocation: the thread arena against malloc/free
+ *
+ * A request allocates [objects] objects of 16 to 256 bytes (always the same sequence), writes
+ * each one, and at the end they all die. Two C tests:
+ * - MALLOC : malloc per object, free per object at the end of the request
+ * - ARENA  : pu_arena_alloc per object, one pu_arena_reset at the end
+ * .
+ * and the same with a std::list<uint32_t> of [objects] elements, with the default allocator and
+ * with pu::arena_allocator inside a pu::arena_scope. After the runs the arena must not have
+ * grown beyond what the first request needed.
+ *
+ * Usage: arenabench [requests] [objects]
+ * - requests : requests per run (default 20000)
+ * - objects  : objects per request (default 100)
+ * .
+ * The makefile targets the BBB cross compiler. For an x86 host run, override the tools:
+ * - make CC=gcc CPP=g++ STRIP=strip
+ * .
+ */
+
+/**** System includes, namespace, then local includes  ***********************/
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <list>
+#include <cstdlib>
+#include <cstring>
+#include "posutils.h"
+#include "puarena.hpp"
+
+// namespace
+using namespace std;
+
+/**** Local (anonymous) namespace *******************************************/
+
+/**** Definitions ************************************************************/
+#define DEF_REQUESTS    (20000)
+#define DEF_OBJECTS     (100)
+#define MIN_OBJECT      (16)
+#define MAX_OBJECT      (256)
+
+typedef list<uint32_t, pu::arena_allocator<uint32_t>> arena_list;
+
+/**** Macros ****************************************************************/
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static double run_malloc(void);
+static double run_arena(void);
+static double run_list_std(void);
+static double run_list_arena(void);
+
+/**** Static declarations ***************************************************/
+static uint32_t         uiRequests = DEF_REQUESTS;
+static uint32_t         uiObjects  = DEF_OBJECTS;
+static vector<size_t>   vSizes;
+static vector<void*>    vPtrs;
+static volatile uint8_t uiSink     = 0;
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+// ns per object
+static double run_malloc(void) {
+    auto tStart = chrono::steady_clock::now();
+    for (uint32_t r = 0; r < uiRequests; r++) {
+        for (uint32_t i = 0; i < uiObjects; i++) {
+            vPtrs[i] = malloc(vSizes[i]);
+            memset(vPtrs[i], (int)i, vSizes[i]);
+        }
+        for (uint32_t i = 0; i < uiObjects; i++) {
+            uiSink = uiSink + *(uint8_t*)vPtrs[i];
+            free(vPtrs[i]);
+        }
+    }
+    chrono::duration<double> tElapsed = chrono::steady_clock::now() - tStart;
+    return (tElapsed.count() * 1.0e9 / ((double)uiRequests * uiObjects));
+}
+
+static double run_arena(void) {
+    pu_arena_t* pArena = pu_thread_arena();
+
+    auto tStart = chrono::steady_clock::now();
+    for (uint32_t r = 0; r < uiRequests; r++) {
+        pu_arena_mark_t mark = pu_arena_mark(pArena);
+        for (uint32_t i = 0; i < uiObjects; i++) {
+            vPtrs[i] = pu_arena_alloc(pArena, vSizes[i]);
+            memset(vPtrs[i], (int)i, vSizes[i]);
+        }
+        for (uint32_t i = 0; i < uiObjects; i++) {
+            uiSink = uiSink + *(uint8_t*)vPtrs[i];
+        }
+        pu_arena_reset(pArena, &mark);
+    }
+    chrono::duration<double> tElapsed = chrono::steady_clock::now() - tStart;
+    return (tElapsed.count() * 1.0e9 / ((double)uiRequests * uiObjects));
+}
+
+static double run_list_std(void) {
+    auto tStart = chrono::steady_clock::now();
+    for (uint32_t r = 0; r < uiRequests; r++) {
+        list<uint32_t> lst;
+        for (uint32_t i = 0; i < uiObjects; i++) {
+            lst.push_back(i);
+        }
+        uiSink = uiSink + (uint8_t)lst.back();
+    }
+    chrono::duration<double> tElapsed = chrono::steady_clock::now() - tStart;
+    return (tElapsed.count() * 1.0e9 / ((double)uiRequests * uiObjects));
+}
+
+static double run_list_arena(void) {
+    auto tStart = chrono::steady_clock::now();
+    for (uint32_t r = 0; r < uiRequests; r++) {
+        pu::arena_scope scope;
+        arena_list      lst{pu::arena_allocator<uint32_t>(scope.arena())};
+        for (uint32_t i = 0; i < uiObjects; i++) {
+            lst.push_back(i);
+        }
+        uiSink = uiSink + (uint8_t)lst.back();
+    }
+    chrono::duration<double> tElapsed = chrono::steady_clock::now() - tStart;
+    return (tElapsed.count() * 1.0e9 / ((double)uiRequests * uiObjects));
+}
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * Main
+ * @param argc: argument count
+ * @param argv: [requests] [objects]
+ * @return 0, 2 if the arena kept growing
+ */
+int main( int argc, char *argv[] )
+{
+    uiRequests = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : DEF_REQUESTS;
+    uiObjects  = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 0) : DEF_OBJECTS;
+    if ((0 == uiRequests) || (0 == uiObjects)) {
+        cout << "Usage: arenabench [requests] [objects]" << endl;
+        return (1);
+    }
+
+    // Same sizes every request
+    srand(1);
+    for (uint32_t i = 0; i < uiObjects; i++) {
+        vSizes.push_back(MIN_OBJECT + (size_t)rand() % (MAX_OBJECT - MIN_OBJECT + 1));
+    }
+    vPtrs.resize(uiObjects);
+
+    int iRet = posutils_init();
+    ASSERT(0 == iRet);
+    int iResult = 0;
+    if (0 == iRet) {
+        pu_arena_t* pArena = pu_thread_arena();
+        cout << "Request: " << uiObjects << " objects of " << MIN_OBJECT << ".." << MAX_OBJECT << " bytes, "
+             << uiRequests << " requests, arena chunks of " << pArena->uiChunkSize << " bytes" << endl;
+        cout << "ns per object" << endl;
+        cout << left << setw(12) << "TEST" << right << setw(10) << "MALLOC" << setw(10) << "ARENA" << endl;
+        cout << left << setw(12) << "raw" << right << fixed << setprecision(1)
+             << setw(10) << run_malloc() << setw(10) << run_arena() << endl;
+        uint32_t uiChunks = pArena->uiChunks;
+        cout << left << setw(12) << "std::list" << right << fixed << setprecision(1)
+             << setw(10) << run_list_std() << setw(10) << run_list_arena() << endl;
+        cout << "Arena chunks: " << pArena->uiChunks << " (" << pArena->uiSpare << " spare)" << endl;
+        if (pArena->uiChunks > uiChunks + 1) {
+            cout << "ERROR: the arena kept growing" << endl;
+            iResult = 2;
+        }
+    }
+
+    // Clean up
+    posutils_exit();
+    return (iResult);
+}
+/* main */
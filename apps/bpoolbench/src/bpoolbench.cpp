@@ -0,0 +1,242 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+
+/**
+ * @file     bpoolbench.cpp
+ * @brief    Block pool against malloc/free, and a check that no block is handed out twice
+ *
+ * Every thread keeps a window of [window] live blocks: it frees the oldest, allocates a new one,
+ * stamps it with its own id and a sequence number and checks the stamp again when it frees it.
+ * A block handed to two threads at once shows up as a bad stamp. Three allocators:
+ * - MALLOC   : malloc/free
+ * - POOL     : pu_bpool, shared free list only
+ * - POOL_TLS : pu_bpool with per-thread caches
+ * .
+ * Usage: bpoolbench [ops] [window] [block size]
+ * - ops        : alloc/free pairs per thread (default 2000000)
+ * - window     : live blocks per thread (default 64)
+ * - block size : bytes (default 64)
+ * .
+ * The makefile targets the BBB cross compiler. For an x86 host run, override the tools:
+ * - make CC=gcc CPP=g++ STRIP=strip
+ * .
+ */
+
+/**** System includes, namespace, then local includes  ***********************/
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <cstdlib>
+#include <unistd.h>
+#include <pthread.h>
+#include "posutils.h"
+#include "pubpool.h"
+
+// namespace
+using namespace std;
+
+/**** Local (anonymous) namespace *******************************************/
+
+/**** Definitions ************************************************************/
+#define DEF_OPS         (2000000)
+#define DEF_WINDOW      (64)
+#define DEF_BLOCK_SIZE  (64)
+#define MAX_THREADS     (8)
+#define STACK_SIZE      (32*1024)
+#define BLOCKS_PER_SLAB (256)
+
+// The allocator under test
+typedef enum {
+    ALLOC_MALLOC = 0,
+    ALLOC_POOL,
+    ALLOC_POOL_TLS,
+    ALLOC_ENDDEF
+}   alloc_kind_t;
+
+// The stamp at the start of every block
+typedef struct {
+    uint32_t uiThread;
+    uint32_t uiSeq;
+}   stamp_t;
+
+/**** Macros ****************************************************************/
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static void*  block_alloc(void);
+static void   block_free(void* pBlock);
+static void*  worker_fct(void* pArg);
+static double run(alloc_kind_t enKind, uint32_t uiThreads);
+
+/**** Static declarations ***************************************************/
+static const char*  aszNames[ALLOC_ENDDEF] = { "MALLOC", "POOL", "POOL_TLS" };
+static alloc_kind_t enAlloc     = ALLOC_MALLOC;
+static pu_bpool_t*  pPool       = NULL;
+static uint64_t     uiOps       = DEF_OPS;
+static uint32_t     uiWindow    = DEF_WINDOW;
+static size_t       uiBlockSize = DEF_BLOCK_SIZE;
+static uint64_t     uiBadStamps = 0;
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+static void* block_alloc(void) {
+    return ((ALLOC_MALLOC == enAlloc) ? malloc(uiBlockSize) : pu_bpool_alloc(pPool));
+}
+
+static void block_free(void* pBlock) {
+    if (ALLOC_MALLOC == enAlloc) {
+        free(pBlock);
+    } else {
+        pu_bpool_free(pPool, pBlock);
+    }
+}
+
+// Sliding window of live blocks, checks each stamp before the free
+static void* worker_fct(void* pArg) {
+    uint32_t       uiThread = (uint32_t)(uintptr_t)pArg;
+    vector<void*>  vWindow(uiWindow, nullptr);
+    uint64_t       uiBad = 0;
+
+    for (uint64_t i = 0; i < uiOps + uiWindow; i++) {
+        void*& pSlot = vWindow[i % uiWindow];
+        if (pSlot) {
+            stamp_t* pStamp = (stamp_t*)pSlot;
+            uiBad += ((pStamp->uiThread == uiThread) && (pStamp->uiSeq == (uint32_t)(i - uiWindow))) ? 0u : 1u;
+            block_free(pSlot);
+            pSlot = nullptr;
+        }
+        if (i < uiOps) {
+            pSlot = block_alloc();
+            if (nullptr == pSlot) {
+                uiBad++;
+                continue;
+            }
+            stamp_t* pStamp = (stamp_t*)pSlot;
+            pStamp->uiThread = uiThread;
+            pStamp->uiSeq    = (uint32_t)i;
+        }
+    }
+    __atomic_fetch_add(&uiBadStamps, uiBad, __ATOMIC_RELAXED);
+    return (NULL);
+}
+
+// Millions of alloc/free pairs per second, all threads together
+static double run(alloc_kind_t enKind, uint32_t uiThreads) {
+    pu_thread_attr_t attr;
+    pthread_t        aPids[MAX_THREADS];
+    uint32_t         uiSlabs = (uiThreads * (uiWindow + PU_BPOOL_CACHE_SIZE)) / BLOCKS_PER_SLAB + 2;
+
+    enAlloc = enKind;
+    if (ALLOC_MALLOC != enKind) {
+        int iRet = pu_bpool_create(&pPool, uiBlockSize, 0, BLOCKS_PER_SLAB, uiSlabs, (ALLOC_POOL_TLS == enKind));
+        ASSERT(0 == iRet);
+        (void)iRet;
+    }
+    pu_thread_attr_init(&attr);
+    attr.uiStackSize = STACK_SIZE;
+
+    auto tStart = chrono::steady_clock::now();
+    for (uint32_t i = 0; i < uiThreads; i++) {
+        aPids[i] = pu_thread_create_attr(worker_fct, (void*)(uintptr_t)(i + 1), &attr, "worker");
+    }
+    for (uint32_t i = 0; i < uiThreads; i++) {
+        pu_thread_join(aPids[i], NULL);
+    }
+    chrono::duration<double> tElapsed = chrono::steady_clock::now() - tStart;
+
+    // The worker caches went back to the pool when the workers exited
+    if (ALLOC_MALLOC != enKind) {
+        pu_bpool_stats_t stats;
+        pu_bpool_get_stats(pPool, &stats);
+        if (0 != stats.uiInUse) {
+            cout << "ERROR: " << stats.uiInUse << " blocks still in use" << endl;
+            uiBadStamps++;
+        }
+        if (4 == uiThreads) {
+            cout << "    " << aszNames[enKind] << " x4: " << stats.uiSlabs << " slabs, " << stats.uiBlocks << " blocks ("
+                 << stats.uiStride << " bytes), peak " << stats.uiPeakInUse << ", " << stats.uiAllocs << " list pops, "
+                 << stats.uiCacheHits << " cache hits, " << stats.uiEmpty << " empty" << endl;
+        }
+        pu_bpool_destroy(pPool);
+        pPool = NULL;
+    }
+    return ((double)uiOps * uiThreads / tElapsed.count() / 1.0e6);
+}
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * Main
+ * @param argc: argument count
+ * @param argv: [ops] [window] [block size]
+ * @return 0, 2 if a block was handed out twice (or lost)
+ */
+int main( int argc, char *argv[] )
+{
+    uiOps       = (argc > 1) ? strtoull(argv[1], NULL, 0) : DEF_OPS;
+    uiWindow    = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 0) : DEF_WINDOW;
+    uiBlockSize = (argc > 3) ? (size_t)strtoul(argv[3], NULL, 0) : DEF_BLOCK_SIZE;
+    if ((0 == uiOps) || (0 == uiWindow) || (uiBlockSize < sizeof(stamp_t))) {
+        cout << "Usage: bpoolbench [ops] [window] [block size >= " << sizeof(stamp_t) << "]" << endl;
+        return (1);
+    }
+    cout << "Block pool: " << uiBlockSize << " byte blocks, window " << uiWindow << ", " << uiOps << " ops per thread" << endl;
+
+    int iRet = posutils_init();
+    ASSERT(0 == iRet);
+    if (0 == iRet) {
+        cout << "Throughput (M alloc+free/s)" << endl;
+        cout << left << setw(10) << "THREADS" << right;
+        for (int k = 0; k < ALLOC_ENDDEF; k++) {
+            cout << setw(10) << aszNames[k];
+        }
+        cout << endl;
+        for (uint32_t uiThreads = 1; uiThreads <= 4; uiThreads *= 2) {
+            double adRate[ALLOC_ENDDEF];
+            for (int k = 0; k < ALLOC_ENDDEF; k++) {
+                adRate[k] = run((alloc_kind_t)k, uiThreads);
+            }
+            cout << left << setw(10) << uiThreads << right << fixed << setprecision(2);
+            for (int k = 0; k < ALLOC_ENDDEF; k++) {
+                cout << setw(10) << adRate[k];
+            }
+            cout << endl;
+        }
+
+        // The thread contexts of all those workers came from the context pool
+        pu_thread_cache_stats_t cache;
+        pu_thread_cache_get_stats(&cache);
+        cout << "Thread contexts: " << cache.uiContextHits << " hits, " << cache.uiContextMisses << " misses, "
+             << cache.uiContextsCached << " free" << endl;
+        if (0 != uiBadStamps) {
+            cout << "ERROR: " << uiBadStamps << " bad stamps" << endl;
+        }
+    }
+
+    // Clean up
+    posutils_exit();
+    return ((0 == uiBadStamps) ? 0 : 2);
+}
+/* main */
@@ -0,0 +1,180 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+
+
+/**
+ * @file     dllbench.cpp
+ * @brief    Removal from anywhere in a list: SLL_ELEM_DEL against DLL_ELEM_DEL
+ *
+ * For each size n, n elements are put on a list and then removed in a shuffled order (the same
+ * order for both lists), the way objects leave a registry. SLL_ELEM_DEL searches for the
+ * predecessor, O(n) per removal. DLL_ELEM_DEL unlinks through the previous pointer, O(1).
+ * A DLL_FOR_EACH_SAFE pass that deletes every other element, and a walk back with
+ * DLL_FOR_EACH_REVERSE, check the links afterwards.
+ *
+ * Usage: dllbench [max elements]
+ * - max elements : largest n, the sizes are 1000, 10000, ... up to it (default 50000)
+ * .
+ * The makefile targets the BBB cross compiler. For an x86 host run, override the tools:
+ * - make CC=gcc CPP=g++ STRIP=strip
+ * .
+ */
+
+/**** System includes, namespace, then local includes  ***********************/
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+#include "sll.h"
+#include "dll.h"
+
+// namespace
+using namespace std;
+
+/**** Local (anonymous) namespace *******************************************/
+
+/**** Definitions ************************************************************/
+#define DEF_MAX_ELEMS   (50000)
+
+typedef struct elem_tag {
+    uint32_t uiSeq;
+    SLL_ENTRY(elem_tag);
+    DLL_ENTRY(elem_tag);
+}   elem_t;
+
+typedef DLL_HEAD(elem_tag) elem_list_t;
+
+/**** Macros ****************************************************************/
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static double remove_sll(size_t uiCount);
+static double remove_dll(size_t uiCount);
+static void   check_dll(size_t uiCount);
+
+/**** Static declarations ***************************************************/
+static vector<elem_t>   vElems;
+static vector<uint32_t> vOrder;
+static uint64_t         uiErrors = 0;
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+// ns per removal, the list is built outside the timed part
+static double remove_sll(size_t uiCount) {
+    elem_t* pList = NULL;
+
+    for (size_t i = 0; i < uiCount; i++) {
+        SLL_ELEM_ADD(pList, &vElems[i]);
+    }
+    auto tStart = chrono::steady_clock::now();
+    for (size_t i = 0; i < uiCount; i++) {
+        SLL_ELEM_DEL(elem_t, pList, &vElems[vOrder[i]]);
+    }
+    chrono::duration<double> tElapsed = chrono::steady_clock::now() - tStart;
+    uiErrors += (NULL == pList) ? 0u : 1u;
+    return (tElapsed.count() * 1.0e9 / (double)uiCount);
+}
+
+static double remove_dll(size_t uiCount) {
+    elem_list_t lst = DLL_INITIALIZER;
+
+    for (size_t i = 0; i < uiCount; i++) {
+        DLL_ELEM_ADD(lst, &vElems[i]);
+    }
+    auto tStart = chrono::steady_clock::now();
+    for (size_t i = 0; i < uiCount; i++) {
+        DLL_ELEM_DEL(lst, &vElems[vOrder[i]]);
+    }
+    chrono::duration<double> tElapsed = chrono::steady_clock::now() - tStart;
+    uiErrors += (DLL_IS_EMPTY(lst) && (NULL == DLL_LAST(lst))) ? 0u : 1u;
+    return (tElapsed.count() * 1.0e9 / (double)uiCount);
+}
+
+// Deletes the odd elements while iterating, then checks what is left in both directions
+static void check_dll(size_t uiCount) {
+    elem_list_t lst = DLL_INITIALIZER;
+    elem_t*     pElem;
+    elem_t*     pNext;
+
+    for (size_t i = 0; i < uiCount; i++) {
+        DLL_ELEM_ADD_TAIL(lst, &vElems[i]);
+    }
+    DLL_FOR_EACH_SAFE(lst, pElem, pNext) {
+        if (pElem->uiSeq & 1u) {
+            DLL_ELEM_DEL(lst, pElem);
+        }
+    }
+    uint32_t uiExpect = (uint32_t)((uiCount - 1) & ~(size_t)1);
+    DLL_FOR_EACH_REVERSE(lst, pElem) {
+        uiErrors += (pElem->uiSeq == uiExpect) ? 0u : 1u;
+        uiExpect -= 2;
+    }
+    uiErrors += (uiExpect == (uint32_t)-2) ? 0u : 1u;
+}
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * Main
+ * @param argc: argument count
+ * @param argv: [max elements]
+ * @return 0, 2 if a list was left inconsistent
+ */
+int main( int argc, char *argv[] )
+{
+    size_t uiMax = (argc > 1) ? (size_t)strtoul(argv[1], NULL, 0) : DEF_MAX_ELEMS;
+    if (uiMax < 1000) {
+        cout << "Usage: dllbench [max elements >= 1000]" << endl;
+        return (1);
+    }
+    vElems.resize(uiMax);
+    mt19937 rng(1);
+
+    cout << left << setw(10) << "ELEMENTS" << right << setw(14) << "SLL_ELEM_DEL" << setw(14) << "DLL_ELEM_DEL" << endl;
+    cout << left << setw(10) << "" << right << setw(14) << "(ns/elem)" << setw(14) << "(ns/elem)" << endl;
+    vector<size_t> vSizes;
+    for (size_t uiCount = 1000; uiCount < uiMax; uiCount *= 10) {
+        vSizes.push_back(uiCount);
+    }
+    vSizes.push_back(uiMax);
+    for (size_t uiCount : vSizes) {
+        vOrder.resize(uiCount);
+        for (size_t i = 0; i < uiCount; i++) {
+            vElems[i].uiSeq = (uint32_t)i;
+            vOrder[i] = (uint32_t)i;
+        }
+        shuffle(vOrder.begin(), vOrder.end(), rng);
+        cout << left << setw(10) << uiCount << right << fixed << setprecision(1)
+             << setw(14) << remove_sll(uiCount) << setw(14) << remove_dll(uiCount) << endl;
+        check_dll(uiCount);
+    }
+    if (0 != uiErrors) {
+        cout << "ERROR: " << uiErrors << " list errors" << endl;
+    }
+    return ((0 == uiErrors) ? 0 : 2);
+}
+/* main */
@@ -20,35 +20,121 @@
 
 /**
  * @file     gpio.cpp
- * @brief    Simple BeagleBone threaded GPIO
+ * @brief    Simple BeagleBone threaded GPIO: edge events from a sampling thread to a processing thread
+ *
+ * - The sampling thread owns the line. It waits for edges (gpiod_line_event_wait), reads them
+ *   and pushes them, with the line offset, into an SPSC ring. It never blocks on the consumer:
+ *   if the ring is full the event is counted as dropped.
+ * - The processing thread sleeps on the ring (pu_ring_pop_wait) and handles the events in
+ *   batches, here it just prints them with the time since the previous edge. The text of a
+ *   batch is built in the thread's arena and written in one go.
+ * .
+ * Usage: gpiocxx [chip] [line] [seconds]
+ * - chip    : GPIO chip number (default 1)
+ * - line    : line offset on that chip (default 28, i.e. GPIO1_28 on P9_12)
+ * - seconds : how long to run (default 10)
+ * .
  */
 
 /**** System includes, namespace, then local includes  ***********************/
 #include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
 #include <pthread.h>
 
 // Local includes
 #include "gpiod.h"
-#include "gpiod.hpp"
 #include "logging.h"
 #include "posutils.h"
+#include "puarena.hpp"
+#include "pufutex.h"
+#include "puring.h"
 
 // namespace
 using namespace std;
 
 //=== Local (anonymous) namespace =============================================
+namespace {
+
+// What goes through the ring
+typedef struct {
+    struct gpiod_line_event ev;
+    unsigned int            uiOffset;
+}   edge_t;
+
+// Batch text, lives in the processing thread's arena
+typedef basic_string<char, char_traits<char>, pu::arena_allocator<char>> arena_string;
+
+const unsigned int DEF_CHIP     = 1;
+const unsigned int DEF_LINE     = 28;
+const unsigned int DEF_SECONDS  = 10;
+const uint32_t     RING_SIZE    = 256;
+const uint32_t     BATCH        = 16;
+const uint32_t     POLL_MS      = 100;
+const size_t       LINE_CHARS   = 64;
+
+pu_ring_t          ringEdges;
+uint64_t           uiDropped = 0;
+
+}
 
 //=============================================================================
 // Local function definitions
 //=============================================================================
-void* thread_fct(void* pArg) {
-    struct gpiod_chip* pChip = (struct gpiod_chip*)pArg;
 
-    // Dump the basic information
-    cout << "Thread for " << gpiod_chip_name(pChip) << endl;
-    cout << "  label = " << gpiod_chip_label(pChip) << endl;
-    cout << "  lines = " << gpiod_chip_num_lines(pChip) << endl;
+// Producer: waits for edges, hands them over. Polls the stop token every POLL_MS
+void* sample_fct(void* pArg) {
+    struct gpiod_line* pLine = (struct gpiod_line*)pArg;
+    struct timespec    tsPoll = { 0, (long)POLL_MS * 1000000L };
+    edge_t             edge;
+
+    edge.uiOffset = gpiod_line_offset(pLine);
+    while (!pu_thread_stop_requested()) {
+        int iRet = gpiod_line_event_wait(pLine, &tsPoll);
+        if (iRet < 0) {
+            LOG_ERROR("event wait failed\n");
+            break;
+        }
+        if ((1 == iRet) && (0 == gpiod_line_event_read(pLine, &edge.ev))) {
+            if (0 == pu_ring_push(&ringEdges, &edge, 1)) {
+                uiDropped++;
+            }
+        }
+    }
+    return (NULL);
+}
 
+// Consumer: handles the edges in batches, one write per batch
+void* process_fct(void* pArg) {
+    edge_t aEdges[BATCH];
+    char   szLine[LINE_CHARS];
+    double dLast = 0.0;
+    (void)pArg;
+
+    while (!pu_thread_stop_requested()) {
+        uint32_t uiGot = pu_ring_pop_wait(&ringEdges, aEdges, BATCH, POLL_MS);
+        if (0 == uiGot) {
+            continue;
+        }
+        pu::arena_scope scope;
+        arena_string    sBatch{pu::arena_allocator<char>(scope.arena())};
+        sBatch.reserve(uiGot * LINE_CHARS);
+        for (uint32_t i = 0; i < uiGot; i++) {
+            double dNow = (double)aEdges[i].ev.ts.tv_sec + (double)aEdges[i].ev.ts.tv_nsec / 1.0e9;
+            snprintf(szLine, sizeof(szLine), "line %u %s at %.6f", aEdges[i].uiOffset,
+                     (GPIOD_LINE_EVENT_RISING_EDGE == aEdges[i].ev.event_type) ? "rising " : "falling", dNow);
+            sBatch += szLine;
+            if (dLast > 0.0) {
+                snprintf(szLine, sizeof(szLine), " (+%.3f ms)", (dNow - dLast) * 1000.0);
+                sBatch += szLine;
+            }
+            sBatch += '\n';
+            dLast = dNow;
+        }
+        cout << sBatch << flush;
+    }
     return (NULL);
 }
 
@@ -59,16 +145,16 @@ void* thread_fct(void* pArg) {
 
 /**
  * Main
- * @param argc: unused
- * @param argv: unused
- * @return 0
- * Create all the processes, resources, barriers, etc.
+ * @param argc: argument count
+ * @param argv: [chip] [line] [seconds]
+ * @return 0, 1 if the line could not be set up
+ * Open the line, create the ring and the two threads, run, stop.
  */
 int main( int argc, char *argv[] )
 {
-    pthread_t          pThreadList[4];
-    struct gpiod_chip* pChipList[4];
-    int                iChips = 0;
+    unsigned int uiChip    = (argc > 1) ? (unsigned int)strtoul(argv[1], NULL, 0) : DEF_CHIP;
+    unsigned int uiLine    = (argc > 2) ? (unsigned int)strtoul(argv[2], NULL, 0) : DEF_LINE;
+    unsigned int uiSeconds = (argc > 3) ? (unsigned int)strtoul(argv[3], NULL, 0) : DEF_SECONDS;
 
     // // Dump the library version
     cout << "LIBGPIOD version: " <<  gpiod_version_string() << endl;
@@ -77,32 +163,41 @@ int main( int argc, char *argv[] )
     int iRet = posutils_init();
     ASSERT(0 == iRet);
 
-    // For each chip, create a separate thread to manage it
-    for (unsigned int uiNum = 0; uiNum < 4; uiNum++) {
-        struct gpiod_chip* pChip = gpiod_chip_open_by_number( uiNum );
-        if (!pChip) {
-            cout << "Unable to open GPIO chip:" << uiNum << endl;
-        } else {
-            pChipList[iChips]   = pChip;
-            pThreadList[iChips] = PU_THREAD_CREATE(thread_fct, (void*)pChip, 16*1024);
-            ASSERT(0 != pThreadList[iChips]);
-            iChips++;
-        }
+    // The chip, and the line for both edges
+    struct gpiod_chip* pChip = gpiod_chip_open_by_number(uiChip);
+    if (!pChip) {
+        cout << "Unable to open GPIO chip:" << uiChip << endl;
+        posutils_exit();
+        return (1);
     }
-
-    // Wait for the threads to terminate, clean up the chip handles
-    for (int i = 0; i < iChips; i++) {
-        if (pThreadList[i] != 0) {
-            cout << "Waiting for thread: " << i << endl;
-            pthread_join(pThreadList[i], NULL);
-            cout << "Dead thread: " << i << endl;
-
-            // close the chip
-            gpiod_chip_close(pChipList[i]);
-
-        }
+    cout << "Chip " << gpiod_chip_name(pChip) << " (" << gpiod_chip_label(pChip) << "), "
+         << gpiod_chip_num_lines(pChip) << " lines" << endl;
+    struct gpiod_line* pLine = gpiod_chip_get_line(pChip, uiLine);
+    if (!pLine || (0 != gpiod_line_request_both_edges_events(pLine, "gpiocxx"))) {
+        cout << "Unable to request edge events on line:" << uiLine << endl;
+        gpiod_chip_close(pChip);
+        posutils_exit();
+        return (1);
     }
 
+    // The ring, then the consumer before the producer
+    iRet = pu_ring_create(&ringEdges, RING_SIZE, sizeof(edge_t), true);
+    ASSERT(0 == iRet);
+    pthread_t pidProcess = PU_THREAD_CREATE(process_fct, NULL, 16*1024);
+    pthread_t pidSample  = PU_THREAD_CREATE(sample_fct, (void*)pLine, 16*1024);
+    ASSERT((0 != pidProcess) && (0 != pidSample));
+    cout << "Watching line " << uiLine << " for " << uiSeconds << "s" << endl;
+    sleep(uiSeconds);
+
+    // Stop and join both (the producer first), then clean up
+    pu_thread_request_stop_all();
+    pu_thread_join(pidSample, NULL);
+    pu_thread_join(pidProcess, NULL);
+    cout << "Dropped (ring full): " << uiDropped << endl;
+    pu_ring_destroy(&ringEdges);
+    gpiod_line_release(pLine);
+    gpiod_chip_close(pChip);
+
     // done and dusted
     posutils_exit();
     return (0);
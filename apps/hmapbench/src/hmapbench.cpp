@@ -0,0 +1,245 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+
+
+/**
+ * @file     hmapbench.cpp
+ * @brief    Lookup by ID and by name: a linear SLL scan against the intrusive hash map
+ *
+ * n records (an ID and a name, like a thread registry or the lines of a GPIO chip) are on an SLL
+ * and in two maps, one keyed on the ID (C interface, puhmap.h) and one on the name (C++
+ * wrapper, puhmap.hpp). The same random keys, all present, are then looked up every way.
+ *
+ * Then the growth test: a map and a std::unordered_map grow from empty to a million entries,
+ * and the worst single insert of each is shown. unordered_map rehashes everything in the insert
+ * that crosses its load factor; the hash map moves a few buckets per insert. (On a loaded host
+ * the worst case also catches preemption, run it a few times.)
+ *
+ * Usage: hmapbench [max records] [lookups] [growth entries]
+ * - max records    : largest n, the sizes are 16, 64, 256, ... up to it (default 4096)
+ * - lookups        : lookups per measurement (default 200000)
+ * - growth entries : size reached by the growth test (default 1048576)
+ * .
+ * The makefile targets the BBB cross compiler. For an x86 host run, override the tools:
+ * - make CC=gcc CPP=g++ STRIP=strip
+ * .
+ */
+
+/**** System includes, namespace, then local includes  ***********************/
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <random>
+#include <unordered_map>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "sll.h"
+#include "puhmap.hpp"
+
+// namespace
+using namespace std;
+
+/**** Local (anonymous) namespace *******************************************/
+
+/**** Definitions ************************************************************/
+#define DEF_MAX_RECORDS (4096)
+#define DEF_LOOKUPS     (200000)
+#define DEF_GROWTH      (1024*1024)
+
+typedef struct rec_tag {
+    uint32_t    uiId;
+    const char* szName;
+    char        acName[24];
+    SLL_ENTRY(rec_tag);
+}   rec_t;
+
+typedef pu::hmap_member_traits<rec_t, const char*, &rec_t::szName> rec_by_name;
+
+/**** Macros ****************************************************************/
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static uint32_t    rec_id_hash(const void* pKey);
+static bool        rec_id_equal(const void* pEntry, const void* pKey);
+static const void* rec_id_key(const void* pEntry);
+static void        growth(size_t uiEntries);
+
+/**** Static declarations ***************************************************/
+static const pu_hmap_ops_t opsId    = { rec_id_hash, rec_id_equal, rec_id_key };
+static vector<rec_t>       vRecs;
+static vector<uint32_t>    vKeys;
+static uint64_t            uiMisses = 0;
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+static uint32_t rec_id_hash(const void* pKey) {
+    return pu_hmap_hash_u32(pKey);
+}
+
+static bool rec_id_equal(const void* pEntry, const void* pKey) {
+    return (static_cast<const rec_t*>(pEntry)->uiId == *static_cast<const uint32_t*>(pKey));
+}
+
+static const void* rec_id_key(const void* pEntry) {
+    return &(static_cast<const rec_t*>(pEntry)->uiId);
+}
+
+// ns per lookup of F over the keys, misses counted
+template <typename F>
+static double time_lookups(F fctFind) {
+    auto tStart = chrono::steady_clock::now();
+    for (uint32_t k : vKeys) {
+        const rec_t* pRec = fctFind(k);
+        uiMisses += (pRec && (pRec == &vRecs[k])) ? 0u : 1u;
+    }
+    chrono::duration<double> tElapsed = chrono::steady_clock::now() - tStart;
+    return (tElapsed.count() * 1.0e9 / (double)vKeys.size());
+}
+
+// Worst single insert, in us, growing from empty
+static void growth(size_t uiEntries) {
+    vector<rec_t>                       vGrow(uiEntries);
+    pu_hmap_t                           mapId;
+    unordered_map<uint32_t, rec_t*>     mapStd;
+    double                              dMaxMap = 0.0;
+    double                              dMaxStd = 0.0;
+
+    if (0 != pu_hmap_init(&mapId, &opsId, 0)) {
+        return;
+    }
+    for (size_t i = 0; i < uiEntries; i++) {
+        vGrow[i].uiId = (uint32_t)i;
+        auto tStart = chrono::steady_clock::now();
+        pu_hmap_insert(&mapId, &vGrow[i]);
+        auto tMid = chrono::steady_clock::now();
+        mapStd.emplace(vGrow[i].uiId, &vGrow[i]);
+        auto tEnd = chrono::steady_clock::now();
+        dMaxMap = max(dMaxMap, chrono::duration<double, micro>(tMid - tStart).count());
+        dMaxStd = max(dMaxStd, chrono::duration<double, micro>(tEnd - tMid).count());
+    }
+    for (size_t i = 0; i < uiEntries; i++) {
+        uint32_t uiKey = (uint32_t)i;
+        uiMisses += (pu_hmap_find(&mapId, &uiKey) == &vGrow[i]) ? 0u : 1u;
+    }
+    cout << "Growth to " << uiEntries << " entries, worst single insert: hash map " << fixed << setprecision(1)
+         << dMaxMap << " us, std::unordered_map " << dMaxStd << " us" << endl;
+    pu_hmap_destroy(&mapId);
+}
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * Main
+ * @param argc: argument count
+ * @param argv: [max records] [lookups] [growth entries]
+ * @return 0, 2 if a lookup failed
+ */
+int main( int argc, char *argv[] )
+{
+    size_t uiMax     = (argc > 1) ? (size_t)strtoul(argv[1], NULL, 0) : DEF_MAX_RECORDS;
+    size_t uiLookups = (argc > 2) ? (size_t)strtoul(argv[2], NULL, 0) : DEF_LOOKUPS;
+    size_t uiGrowth  = (argc > 3) ? (size_t)strtoul(argv[3], NULL, 0) : DEF_GROWTH;
+    if ((uiMax < 16) || (0 == uiLookups)) {
+        cout << "Usage: hmapbench [max records >= 16] [lookups] [growth entries]" << endl;
+        return (1);
+    }
+    vRecs.resize(uiMax);
+    for (size_t i = 0; i < uiMax; i++) {
+        vRecs[i].uiId   = (uint32_t)i;
+        vRecs[i].szName = vRecs[i].acName;
+        snprintf(vRecs[i].acName, sizeof(vRecs[i].acName), "worker-%u", (unsigned)i);
+    }
+    mt19937 rng(1);
+
+    cout << "ns per lookup" << endl;
+    cout << left << setw(9) << "RECORDS" << right << setw(11) << "SLL ID" << setw(11) << "SLL NAME"
+         << setw(11) << "HMAP ID" << setw(11) << "HMAP NAME" << endl;
+    vector<size_t> vSizes;
+    for (size_t uiCount = 16; uiCount < uiMax; uiCount *= 4) {
+        vSizes.push_back(uiCount);
+    }
+    vSizes.push_back(uiMax);
+    for (size_t uiCount : vSizes) {
+        rec_t*    pList = NULL;
+        pu_hmap_t mapId;
+        pu::intrusive_hmap<rec_t, rec_by_name> mapName;
+
+        if (0 != pu_hmap_init(&mapId, &opsId, 0)) {
+            return (1);
+        }
+        for (size_t i = uiCount; i > 0; i--) {
+            SLL_ELEM_ADD(pList, &vRecs[i - 1]);
+        }
+        for (size_t i = 0; i < uiCount; i++) {
+            pu_hmap_insert(&mapId, &vRecs[i]);
+            mapName.insert(vRecs[i]);
+        }
+        uniform_int_distribution<uint32_t> dist(0, (uint32_t)(uiCount - 1));
+        vKeys.resize(uiLookups);
+        for (uint32_t& k : vKeys) {
+            k = dist(rng);
+        }
+
+        double dSllId = time_lookups([pList](uint32_t k) -> const rec_t* {
+            rec_t* pRec;
+            SLL_FOR_EACH(pList, pRec) {
+                if (pRec->uiId == k) {
+                    break;
+                }
+            }
+            return pRec;
+        });
+        double dSllName = time_lookups([pList](uint32_t k) -> const rec_t* {
+            const char* szKey = vRecs[k].acName;
+            rec_t*      pRec;
+            SLL_FOR_EACH(pList, pRec) {
+                if (0 == strcmp(pRec->szName, szKey)) {
+                    break;
+                }
+            }
+            return pRec;
+        });
+        double dMapId = time_lookups([&mapId](uint32_t k) -> const rec_t* {
+            return static_cast<const rec_t*>(pu_hmap_find(&mapId, &k));
+        });
+        double dMapName = time_lookups([&mapName](uint32_t k) -> const rec_t* {
+            return mapName.find(vRecs[k].acName);
+        });
+
+        cout << left << setw(9) << uiCount << right << fixed << setprecision(1)
+             << setw(11) << dSllId << setw(11) << dSllName << setw(11) << dMapId
+             << setw(11) << dMapName << endl;
+        pu_hmap_destroy(&mapId);
+    }
+    if (uiGrowth > 0) {
+        growth(uiGrowth);
+    }
+    if (0 != uiMisses) {
+        cout << "ERROR: " << uiMisses << " lookups failed" << endl;
+    }
+    return ((0 == uiMisses) ? 0 : 2);
+}
+/* main */
@@ -0,0 +1,261 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+/**
+ * @file     inversion.cpp
+ * @brief    Priority inversion: worst case lock latency of an RT thread, with and without PI
+ *
+ * The classic three thread setup, all SCHED_FIFO and pinned to CPU 0 so they really compete:
+ * - LOW    (prio 10): takes the mutex, busy for hold_us, releases it, sleeps a bit
+ * - MEDIUM (prio 20): wakes up every 10ms and burns the CPU for burn_us, never touches the mutex
+ * - HIGH   (prio 30): every 2.3ms locks the mutex and records how long that took
+ * .
+ * With a plain mutex HIGH can end up waiting for LOW, which waits for MEDIUM to finish burning:
+ * the latency is bounded by burn_us rather than hold_us. With PI (or a ceiling) LOW runs at
+ * HIGH's priority (or the ceiling) while it holds the mutex and MEDIUM cannot get in between.
+ * The same periods are used for every mutex type, so the runs are comparable.
+ *
+ * Usage: inversion [seconds] [hold_us] [burn_us]
+ * - seconds : duration per mutex type (default 2)
+ * - hold_us : LOW critical section (default 200)
+ * - burn_us : MEDIUM busy period (default 5000)
+ * .
+ * Needs root (or CAP_SYS_NICE) for the RT policies.
+ */
+
+/**** System includes, namespace, then local includes  ***********************/
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include "posutils.h"
+
+// namespace
+using namespace std;
+
+/**** Local (anonymous) namespace *******************************************/
+
+/**** Definitions ************************************************************/
+#define DEF_SECONDS    (2)
+#define DEF_HOLD_US    (200)
+#define DEF_BURN_US    (5000)
+#define LOW_PRIO       (10)
+#define MEDIUM_PRIO    (20)
+#define HIGH_PRIO      (30)
+#define LOW_SLEEP_US   (300)
+#define MEDIUM_PERIOD  (10000)
+#define HIGH_PERIOD    (2300)
+#define STACK_SIZE     (16*1024)
+#define NS_PER_US      (1000L)
+#define NS_PER_SEC     (1000000000L)
+
+/**** Macros ****************************************************************/
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static long  now_ns(void);
+static void  sleep_until(struct timespec* pTs, long lPeriodUs);
+static void  burn_us(long lUs);
+static void* low_fct(void* pArg);
+static void* medium_fct(void* pArg);
+static void* high_fct(void* pArg);
+static void  run_type(const char* szType, pu_mutex_type enType, unsigned int uiSeconds);
+
+/**** Static declarations ***************************************************/
+static pthread_mutex_t mtxShared;
+static long            lHoldUs = DEF_HOLD_US;
+static long            lBurnUs = DEF_BURN_US;
+static vector<long>    vLatency;
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+static long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((long)ts.tv_sec * NS_PER_SEC + ts.tv_nsec);
+}
+
+// Absolute periodic sleep
+static void sleep_until(struct timespec* pTs, long lPeriodUs) {
+    pTs->tv_nsec += lPeriodUs * NS_PER_US;
+    while (pTs->tv_nsec >= NS_PER_SEC) {
+        pTs->tv_nsec -= NS_PER_SEC;
+        pTs->tv_sec++;
+    }
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, pTs, NULL);
+}
+
+// Busy, keeps the CPU
+static void burn_us(long lUs) {
+    long lEnd = now_ns() + lUs * NS_PER_US;
+    while (now_ns() < lEnd) {
+    }
+}
+
+static void* low_fct(void* pArg) {
+    (void)pArg;
+    while (!pu_thread_stop_requested()) {
+        pthread_mutex_lock(&mtxShared);
+        burn_us(lHoldUs);
+        pthread_mutex_unlock(&mtxShared);
+        usleep(LOW_SLEEP_US);
+    }
+    return (NULL);
+}
+
+static void* medium_fct(void* pArg) {
+    struct timespec ts;
+    (void)pArg;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    while (!pu_thread_stop_requested()) {
+        sleep_until(&ts, MEDIUM_PERIOD);
+        burn_us(lBurnUs);
+    }
+    return (NULL);
+}
+
+static void* high_fct(void* pArg) {
+    struct timespec ts;
+    (void)pArg;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    while (!pu_thread_stop_requested()) {
+        sleep_until(&ts, HIGH_PERIOD);
+        long lStart = now_ns();
+        pthread_mutex_lock(&mtxShared);
+        long lWait = now_ns() - lStart;
+        pthread_mutex_unlock(&mtxShared);
+        vLatency.push_back(lWait);
+    }
+    return (NULL);
+}
+
+// One mutex type: start LOW, MEDIUM, HIGH on CPU 0, run, stop, report
+static void run_type(const char* szType, pu_mutex_type enType, unsigned int uiSeconds) {
+    pu_thread_attr_t attr;
+    pthread_t        aPids[3];
+    pu_thread_fct_t  afct[3]  = { low_fct, medium_fct, high_fct };
+    int              aPrio[3] = { LOW_PRIO, MEDIUM_PRIO, HIGH_PRIO };
+    const char*      aName[3] = { "low", "medium", "high" };
+
+    cout << left << setw(10) << szType;
+    if (0 != pu_mutex_create_type(&mtxShared, enType)) {
+        cout << "cannot create the mutex" << endl;
+        return;
+    }
+    if (PU_MUTEX_TYPE_CEILING == enType) {
+        pu_mutex_set_ceiling(&mtxShared, HIGH_PRIO);
+    }
+    vLatency.clear();
+    vLatency.reserve((size_t)uiSeconds * (1000000 / HIGH_PERIOD) + 16);
+
+    pu_thread_attr_init(&attr);
+    attr.uiStackSize = STACK_SIZE;
+    attr.iPolicy     = SCHED_FIFO;
+    attr.uiCpuMask   = 1;
+    attr.bMlock      = true;
+    attr.bPrefault   = true;
+    size_t uiStarted = 0;
+    for (size_t i = 0; i < 3; i++) {
+        attr.iPriority = aPrio[i];
+        aPids[i] = pu_thread_create_attr(afct[i], NULL, &attr, aName[i]);
+        if (0 != aPids[i]) {
+            uiStarted++;
+        }
+    }
+    if (3 == uiStarted) {
+        sleep(uiSeconds);
+    }
+    for (size_t i = 0; i < 3; i++) {
+        if (0 != aPids[i]) {
+            pu_thread_request_stop(aPids[i]);
+        }
+    }
+    for (size_t i = 0; i < 3; i++) {
+        if (0 != aPids[i]) {
+            pu_thread_join(aPids[i], NULL);
+        }
+    }
+    pthread_mutex_destroy(&mtxShared);
+    if (3 != uiStarted) {
+        cout << "skipped (no permission?)" << endl;
+        return;
+    }
+
+    // HIGH may not have got a single lock in (it did not run, or the run was too short)
+    if (vLatency.empty()) {
+        cout << "n=" << setw(6) << 0 << " (no samples)" << endl;
+        return;
+    }
+
+    // Percentiles in microseconds
+    sort(vLatency.begin(), vLatency.end());
+    auto pct = [](double dPct) {
+        size_t uiIdx = (size_t)(dPct * (double)(vLatency.size() - 1) / 100.0);
+        return ((double)vLatency[uiIdx] / 1000.0);
+    };
+    cout << fixed << setprecision(1)
+         << "n=" << setw(6) << vLatency.size()
+         << " p50=" << setw(8) << pct(50.0)
+         << " p99=" << setw(8) << pct(99.0)
+         << " max=" << setw(8) << pct(100.0) << " (us)" << endl;
+}
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * Main
+ * @param argc: argument count
+ * @param argv: [seconds] [hold_us] [burn_us]
+ * @return 0
+ */
+int main( int argc, char *argv[] )
+{
+    unsigned int uiSeconds = (argc > 1) ? (unsigned int)strtoul(argv[1], NULL, 0) : DEF_SECONDS;
+    lHoldUs                = (argc > 2) ? strtol(argv[2], NULL, 0) : DEF_HOLD_US;
+    lBurnUs                = (argc > 3) ? strtol(argv[3], NULL, 0) : DEF_BURN_US;
+
+    if ((0 == uiSeconds) || (lHoldUs <= 0) || (lBurnUs <= 0)) {
+        cout << "Usage: inversion [seconds] [hold_us] [burn_us]" << endl;
+        return (1);
+    }
+    cout << "HIGH lock latency: " << uiSeconds << "s per type, hold=" << lHoldUs << "us"
+         << " burn=" << lBurnUs << "us" << endl;
+
+    int iRet = posutils_init();
+    ASSERT(0 == iRet);
+    if (0 == iRet) {
+        run_type("FAST", PU_MUTEX_TYPE_FAST, uiSeconds);
+        run_type("PI", PU_MUTEX_TYPE_PI, uiSeconds);
+        run_type("CEILING", PU_MUTEX_TYPE_CEILING, uiSeconds);
+    }
+
+    // Clean up
+    posutils_exit();
+    return (0);
+}
+/* main */
@@ -0,0 +1,175 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+/**
+ * @file     jitter.cpp
+ * @brief    Periodic wake-up latency per scheduling policy
+ *
+ * A thread sleeps until an absolute deadline (clock_nanosleep, TIMER_ABSTIME), wakes up, and
+ * records how late it was. This is done for SCHED_OTHER, SCHED_RR and SCHED_FIFO threads created
+ * with pu_thread_create_attr(). The RT threads have their stacks locked and pre-faulted.
+ *
+ * Usage: jitter [loops] [period_us] [priority]
+ * - loops     : wake-ups per policy (default 10000)
+ * - period_us : period in microseconds (default 1000)
+ * - priority  : RT priority (default 80)
+ * .
+ * The RT policies need root (or CAP_SYS_NICE), otherwise they are reported as skipped.
+ * Load the system (e.g. a kernel build, or "stress") while this runs to see the difference.
+ */
+
+/**** System includes, namespace, then local includes  ***********************/
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include "posutils.h"
+
+// namespace
+using namespace std;
+
+/**** Local (anonymous) namespace *******************************************/
+
+/**** Definitions ************************************************************/
+#define DEF_LOOPS     (10000)
+#define DEF_PERIOD_US (1000)
+#define DEF_PRIORITY  (80)
+#define STACK_SIZE    (16*1024)
+#define NS_PER_SEC    (1000000000L)
+
+// Per run parameters and results
+typedef struct {
+    size_t           uiLoops;
+    long             lPeriodNs;
+    vector<long>     vLatency;
+}   jitter_run_t;
+
+/**** Macros ****************************************************************/
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static void* jitter_fct(void* pArg);
+static void  run_policy(const char* szPolicy, int iPolicy, int iPriority, size_t uiLoops, long lPeriodNs);
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+// The periodic thread, records the wake-up latency (ns) of every period
+static void* jitter_fct(void* pArg) {
+    jitter_run_t*   pRun = (jitter_run_t*)pArg;
+    struct timespec tsNext;
+    struct timespec tsNow;
+
+    clock_gettime(CLOCK_MONOTONIC, &tsNext);
+    for (size_t i = 0; i < pRun->uiLoops; i++) {
+        tsNext.tv_nsec += pRun->lPeriodNs;
+        while (tsNext.tv_nsec >= NS_PER_SEC) {
+            tsNext.tv_nsec -= NS_PER_SEC;
+            tsNext.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &tsNext, NULL);
+        clock_gettime(CLOCK_MONOTONIC, &tsNow);
+        pRun->vLatency[i] = (long)(tsNow.tv_sec - tsNext.tv_sec) * NS_PER_SEC + (tsNow.tv_nsec - tsNext.tv_nsec);
+    }
+    return (NULL);
+}
+
+// One policy: create, join, report the percentiles
+static void run_policy(const char* szPolicy, int iPolicy, int iPriority, size_t uiLoops, long lPeriodNs) {
+    jitter_run_t     run;
+    pu_thread_attr_t attr;
+
+    run.uiLoops   = uiLoops;
+    run.lPeriodNs = lPeriodNs;
+    run.vLatency.assign(uiLoops, 0);
+
+    pu_thread_attr_init(&attr);
+    attr.uiStackSize = STACK_SIZE;
+    attr.iPolicy     = iPolicy;
+    if (SCHED_OTHER != iPolicy) {
+        attr.iPriority = iPriority;
+        attr.bMlock    = true;
+        attr.bPrefault = true;
+    }
+
+    cout << left << setw(12) << szPolicy;
+    pthread_t pid = pu_thread_create_attr(jitter_fct, &run, &attr, szPolicy);
+    if (0 == pid) {
+        cout << "skipped (no permission?)" << endl;
+        return;
+    }
+    pu_thread_join(pid, NULL);
+
+    // Percentiles in microseconds
+    vector<long>& v = run.vLatency;
+    sort(v.begin(), v.end());
+    auto pct = [&v](double dPct) {
+        size_t uiIdx = (size_t)(dPct * (double)(v.size() - 1) / 100.0);
+        return ((double)v[uiIdx] / 1000.0);
+    };
+    cout << fixed << setprecision(1)
+         << "min=" << setw(8) << pct(0.0)
+         << " p50=" << setw(8) << pct(50.0)
+         << " p90=" << setw(8) << pct(90.0)
+         << " p99=" << setw(8) << pct(99.0)
+         << " p99.9=" << setw(8) << pct(99.9)
+         << " max=" << setw(8) << pct(100.0) << " (us)" << endl;
+}
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * Main
+ * @param argc: argument count
+ * @param argv: [loops] [period_us] [priority]
+ * @return 0
+ */
+int main( int argc, char *argv[] )
+{
+    size_t uiLoops   = (argc > 1) ? strtoul(argv[1], NULL, 0) : DEF_LOOPS;
+    long   lPeriodUs = (argc > 2) ? strtol(argv[2], NULL, 0) : DEF_PERIOD_US;
+    int    iPriority = (argc > 3) ? atoi(argv[3]) : DEF_PRIORITY;
+
+    if ((0 == uiLoops) || (lPeriodUs <= 0)) {
+        cout << "Usage: jitter [loops] [period_us] [priority]" << endl;
+        return (1);
+    }
+    cout << "Wake-up latency: loops=" << uiLoops << " period=" << lPeriodUs << "us"
+         << " priority=" << iPriority << endl;
+
+    int iRet = posutils_init();
+    ASSERT(0 == iRet);
+    if (0 == iRet) {
+        run_policy("SCHED_OTHER", SCHED_OTHER, 0, uiLoops, lPeriodUs * 1000);
+        run_policy("SCHED_RR", SCHED_RR, iPriority, uiLoops, lPeriodUs * 1000);
+        run_policy("SCHED_FIFO", SCHED_FIFO, iPriority, uiLoops, lPeriodUs * 1000);
+    }
+
+    // Clean up
+    posutils_exit();
+    return (0);
+}
+/* main */
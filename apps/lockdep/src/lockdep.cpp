@@ -0,0 +1,182 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+
+
+/**
+ * @file     lockdep.cpp
+ * @brief    Lock order checking: an A -> B -> C -> A cycle over three threads
+ *
+ * Three error mutexes, three threads, run one after the other so nothing can actually hang:
+ * - thread 1 locks A then B
+ * - thread 2 locks B then C
+ * - thread 3 locks C then A, which closes the cycle and must be reported, once
+ * .
+ * The three orders are then run again, the cycle must not be reported a second time. Last, C
+ * is destroyed and created again at the same address, and A then C is locked: the old "C before
+ * A" went with the destroy, so this is not an inversion.
+ *
+ * The checker only exists in debug builds, this must not be built with NDEBUG.
+ *
+ * Usage: lockdep [rounds]
+ * - rounds : times the three orders are repeated after the first report (default 3)
+ * .
+ * The makefile targets the BBB cross compiler. For an x86 host run, override the tools:
+ * - make CC=gcc CPP=g++ STRIP=strip
+ * .
+ */
+
+/**** System includes, namespace, then local includes  ***********************/
+#include <iostream>
+#include <cstdlib>
+#include "posutils.h"
+#include "logging.h"
+
+#if defined(NDEBUG)
+    #error "lockdep needs a debug build, the lock order checker compiles out with NDEBUG"
+#endif /* defined(NDEBUG) */
+
+// namespace
+using namespace std;
+
+/**** Local (anonymous) namespace *******************************************/
+
+/**** Definitions ************************************************************/
+#define DEF_ROUNDS (3)
+#define DEF_STACK  (32*1024)
+
+/* One lock order: take pFirst, then pSecond */
+typedef struct {
+    pthread_mutex_t* pFirst;
+    pthread_mutex_t* pSecond;
+}   order_t;
+
+/**** Macros ****************************************************************/
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static void* lock_in_order( void* pArg );
+static void  run_order( pthread_mutex_t* pFirst, pthread_mutex_t* pSecond );
+static bool  check( const char* szWhat, size_t uiExpect );
+
+/**** Static variables *******************************************************/
+static pthread_mutex_t mtxA;
+static pthread_mutex_t mtxB;
+static pthread_mutex_t mtxC;
+static uint32_t        uiFailed = 0;
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+/* Thread: nested lock, in the order given */
+void* lock_in_order( void* pArg )
+{
+    order_t* pOrder = static_cast<order_t*>(pArg);
+
+    PU_MUTEX_LOCK_ERROR( pOrder->pFirst );
+    PU_MUTEX_LOCK_ERROR( pOrder->pSecond );
+    PU_MUTEX_UNLOCK_ERROR( pOrder->pSecond );
+    PU_MUTEX_UNLOCK_ERROR( pOrder->pFirst );
+    return (NULL);
+}
+/* lock_in_order */
+
+/* Runs one order on its own thread, and waits for it */
+void run_order( pthread_mutex_t* pFirst, pthread_mutex_t* pSecond )
+{
+    order_t   order = { pFirst, pSecond };
+    pthread_t pid   = PU_THREAD_CREATE( lock_in_order, &order, DEF_STACK );
+
+    if ((0 == pid) || (0 != pu_thread_join( pid, NULL ))) {
+        cout << "ERROR: thread create or join failed" << endl;
+        uiFailed++;
+    }
+}
+/* run_order */
+
+/* Compares the number of reported cycles with what it should be */
+bool check( const char* szWhat, size_t uiExpect )
+{
+    size_t uiCycles = pu_lockdep_get_number_of_cycles();
+
+    cout << (uiCycles == uiExpect ? "OK   " : "FAIL ") << szWhat << ": " << uiCycles
+         << " cycle(s) reported, expected " << uiExpect << endl;
+    if (uiCycles != uiExpect) {
+        uiFailed++;
+        return (false);
+    }
+    return (true);
+}
+/* check */
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * Main
+ * @param argc: argument count
+ * @param argv: [rounds]
+ * @return 0, 2 if a cycle count was wrong
+ */
+int main( int argc, char *argv[] )
+{
+    uint32_t uiRounds = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : DEF_ROUNDS;
+    uint32_t i;
+
+    if ((0 != posutils_init()) ||
+        (0 != pu_mutex_create_type( &mtxA, PU_MUTEX_TYPE_ERROR )) ||
+        (0 != pu_mutex_create_type( &mtxB, PU_MUTEX_TYPE_ERROR )) ||
+        (0 != pu_mutex_create_type( &mtxC, PU_MUTEX_TYPE_ERROR ))) {
+        cout << "ERROR: init failed" << endl;
+        return (1);
+    }
+    cout << "A = " << &mtxA << ", B = " << &mtxB << ", C = " << &mtxC << endl;
+
+    run_order( &mtxA, &mtxB );
+    run_order( &mtxB, &mtxC );
+    check( "A -> B, B -> C", 0 );
+
+    // Closes the cycle, the report (logged) names all three call sites
+    run_order( &mtxC, &mtxA );
+    check( "C -> A", 1 );
+
+    for (i = 0; i < uiRounds; i++) {
+        run_order( &mtxA, &mtxB );
+        run_order( &mtxB, &mtxC );
+        run_order( &mtxC, &mtxA );
+    }
+    check( "same cycle again", 1 );
+
+    // A new C at the old address, without the old one's history
+    PU_MUTEX_DESTROY_ERROR( &mtxC );
+    (void)pu_mutex_create_type( &mtxC, PU_MUTEX_TYPE_ERROR );
+    run_order( &mtxA, &mtxC );
+    check( "C destroyed and created again, A -> C", 1 );
+
+    PU_MUTEX_DESTROY_ERROR( &mtxA );
+    PU_MUTEX_DESTROY_ERROR( &mtxB );
+    PU_MUTEX_DESTROY_ERROR( &mtxC );
+    (void)posutils_exit();
+
+    cout << ((0 == uiFailed) ? "PASSED" : "FAILED") << endl;
+    return ((0 == uiFailed) ? 0 : 2);
+}
+/* main */
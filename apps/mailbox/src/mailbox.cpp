@@ -0,0 +1,276 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+
+/**
+ * @file     mailbox.cpp
+ * @brief    pu_thread mailboxes: actor style message passing between threads
+ *
+ * Three small actor setups:
+ * - Ping-pong: "ping" finds "pong" by name and bounces one message off it [rounds] times. Pong
+ *   replies to whoever sent the message (lookup by the sender's tid), so it keeps no state.
+ *   The same message goes back and forth, nothing is copied or allocated. Prints the round trip.
+ * - Fan-in: [senders] threads post [messages] messages each to one "sink" thread, which checks
+ *   that every sender's messages arrive in order. Prints the throughput.
+ * - Shutdown: messages still in the sink's mailbox when it is stopped are handed back through
+ *   their release function, and a post to the stopped sink fails with ESRCH.
+ * .
+ * Usage: mailbox [rounds] [senders] [messages]
+ * - rounds   : ping-pong round trips (default 20000)
+ * - senders  : fan-in senders (default 4)
+ * - messages : messages per sender (default 100000)
+ * .
+ * The makefile targets the BBB cross compiler. For an x86 host run, override the tools:
+ * - make CC=gcc CPP=g++ STRIP=strip
+ * .
+ */
+
+/**** System includes, namespace, then local includes  ***********************/
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <cstdlib>
+#include <sched.h>
+#include <pthread.h>
+#include "posutils.h"
+#include "pufutex.h"
+
+// namespace
+using namespace std;
+
+/**** Local (anonymous) namespace *******************************************/
+
+/**** Definitions ************************************************************/
+#define DEF_ROUNDS      (20000)
+#define DEF_SENDERS     (4)
+#define DEF_MESSAGES    (100000)
+#define MAX_SENDERS     (32)
+#define STACK_SIZE      (32*1024)
+
+// Message types
+typedef enum {
+    MSG_PING = 1,
+    MSG_PONG,
+    MSG_DATA,
+    MSG_LATE
+}   msg_type_t;
+
+// A message: the header first, then the payload
+typedef struct {
+    pu_msg_t hdr;
+    uint32_t uiSender;
+    uint32_t uiSeq;
+}   data_msg_t;
+
+/**** Macros ****************************************************************/
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static pu_thread_ref_t find(const char* szName);
+static void*           pong_fct(void* pArg);
+static void*           ping_fct(void* pArg);
+static void*           sink_fct(void* pArg);
+static void*           sender_fct(void* pArg);
+static void            late_release(pu_msg_t* pMsg);
+
+/**** Static declarations ***************************************************/
+static uint32_t uiRounds   = DEF_ROUNDS;
+static uint32_t uiSenders  = DEF_SENDERS;
+static uint32_t uiMessages = DEF_MESSAGES;
+static uint64_t uiReceived = 0;
+static uint64_t uiBadOrder = 0;
+static uint32_t uiReleased = 0;
+static double   dRoundUs   = 0.0;
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+// A thread is in the index once it runs, wait for that
+static pu_thread_ref_t find(const char* szName) {
+    pu_thread_ref_t ref;
+    while (0 != pu_thread_lookup_name(szName, &ref)) {
+        sched_yield();
+    }
+    return (ref);
+}
+
+// Sends every ping straight back to its sender, until stopped
+static void* pong_fct(void* pArg) {
+    pu_msg_t*       pMsg;
+    pu_thread_ref_t refFrom;
+    (void)pArg;
+
+    while (NULL != (pMsg = pu_thread_receive(PU_FUTEX_FOREVER))) {
+        if ((MSG_PING == pMsg->uiType) && (0 == pu_thread_lookup_tid(pMsg->tidFrom, &refFrom))) {
+            pMsg->uiType = MSG_PONG;
+            pu_thread_post(refFrom, pMsg);
+        }
+    }
+    return (NULL);
+}
+
+// Bounces one message off pong uiRounds times
+static void* ping_fct(void* pArg) {
+    pu_msg_t        msg = {};
+    pu_thread_ref_t refPong = find("pong");
+    (void)pArg;
+
+    auto tStart = chrono::steady_clock::now();
+    for (uint32_t i = 0; i < uiRounds; i++) {
+        msg.uiType = MSG_PING;
+        pu_thread_post(refPong, &msg);
+        pu_msg_t* pReply = pu_thread_receive(PU_FUTEX_FOREVER);
+        ASSERT((pReply == &msg) && (MSG_PONG == pReply->uiType));
+        (void)pReply;
+    }
+    chrono::duration<double> tElapsed = chrono::steady_clock::now() - tStart;
+    dRoundUs = tElapsed.count() * 1.0e6 / (double)uiRounds;
+    return (NULL);
+}
+
+// Counts and order-checks the data messages, until stopped. The senders own the memory
+static void* sink_fct(void* pArg) {
+    vector<int64_t> vLast(MAX_SENDERS, -1);
+    pu_msg_t*       pMsg;
+    (void)pArg;
+
+    while (NULL != (pMsg = pu_thread_receive(PU_FUTEX_FOREVER))) {
+        if (MSG_DATA == pMsg->uiType) {
+            data_msg_t* pData = (data_msg_t*)pMsg;
+            uiBadOrder += ((int64_t)pData->uiSeq > vLast[pData->uiSender]) ? 0u : 1u;
+            vLast[pData->uiSender] = pData->uiSeq;
+            __atomic_store_n(&uiReceived, uiReceived + 1, __ATOMIC_RELEASE);
+        }
+        else if (MSG_LATE == pMsg->uiType) {
+            // Stay busy so the rest of the late ones are still queued when the stop comes
+            while (!pu_thread_stop_requested()) {
+                sched_yield();
+            }
+            pMsg->fctRelease(pMsg);
+        }
+    }
+    return (NULL);
+}
+
+// Posts uiMessages messages from its own array, the argument is the sender number
+static void* sender_fct(void* pArg) {
+    vector<data_msg_t> vMsgs(uiMessages);
+    pu_thread_ref_t    refSink = find("sink");
+    uint32_t           uiSender = (uint32_t)(uintptr_t)pArg;
+
+    for (uint32_t i = 0; i < uiMessages; i++) {
+        vMsgs[i].hdr.uiType     = MSG_DATA;
+        vMsgs[i].hdr.fctRelease = NULL;
+        vMsgs[i].uiSender       = uiSender;
+        vMsgs[i].uiSeq          = i;
+        pu_thread_post(refSink, &vMsgs[i].hdr);
+    }
+
+    // The array must outlive the messages, wait until the sink has had them all
+    while (__atomic_load_n(&uiReceived, __ATOMIC_RELAXED) < (uint64_t)uiSenders * uiMessages) {
+        sched_yield();
+    }
+    return (NULL);
+}
+
+// Called for a message that was never received
+static void late_release(pu_msg_t* pMsg) {
+    (void)pMsg;
+    uiReleased++;
+}
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * Main
+ * @param argc: argument count
+ * @param argv: [rounds] [senders] [messages]
+ * @return 0, 2 if a message went missing, arrived out of order, or was not released
+ */
+int main( int argc, char *argv[] )
+{
+    uiRounds   = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : DEF_ROUNDS;
+    uiSenders  = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 0) : DEF_SENDERS;
+    uiMessages = (argc > 3) ? (uint32_t)strtoul(argv[3], NULL, 0) : DEF_MESSAGES;
+    if ((0 == uiRounds) || (0 == uiSenders) || (uiSenders > MAX_SENDERS) || (0 == uiMessages)) {
+        cout << "Usage: mailbox [rounds] [senders <= " << MAX_SENDERS << "] [messages]" << endl;
+        return (1);
+    }
+
+    int iRet = posutils_init();
+    ASSERT(0 == iRet);
+    bool bOk = (0 == iRet);
+    if (bOk) {
+        pu_thread_attr_t attr;
+        pu_thread_attr_init(&attr);
+        attr.uiStackSize = STACK_SIZE;
+
+        // Ping-pong
+        pthread_t pidPong = pu_thread_create_attr(pong_fct, NULL, &attr, "pong");
+        pthread_t pidPing = pu_thread_create_attr(ping_fct, NULL, &attr, "ping");
+        pu_thread_join(pidPing, NULL);
+        pu_thread_request_stop(pidPong);
+        pu_thread_join(pidPong, NULL);
+        cout << "Ping-pong: " << uiRounds << " round trips, " << fixed << setprecision(2) << dRoundUs << " us each" << endl;
+
+        // Fan-in
+        vector<pthread_t> vPids(uiSenders, 0);
+        pthread_t pidSink = pu_thread_create_attr(sink_fct, NULL, &attr, "sink");
+        auto tStart = chrono::steady_clock::now();
+        for (uint32_t i = 0; i < uiSenders; i++) {
+            vPids[i] = pu_thread_create_attr(sender_fct, (void*)(uintptr_t)i, &attr, "sender");
+        }
+        for (uint32_t i = 0; i < uiSenders; i++) {
+            pu_thread_join(vPids[i], NULL);
+        }
+        chrono::duration<double> tElapsed = chrono::steady_clock::now() - tStart;
+        cout << "Fan-in: " << uiSenders << " senders, " << uiReceived << " messages, "
+             << setprecision(2) << (double)uiReceived / tElapsed.count() / 1.0e6 << " M messages/s" << endl;
+
+        // Shutdown with messages queued, then a post to the stopped sink
+        pu_thread_ref_t refSink = find("sink");
+        pu_msg_t        aLate[8] = {};
+        for (auto& msg : aLate) {
+            msg.uiType     = MSG_LATE;
+            msg.fctRelease = late_release;
+            pu_thread_post(refSink, &msg);
+        }
+        pu_thread_request_stop(pidSink);
+        pu_thread_join(pidSink, NULL);
+        pu_msg_t msgDead = {};
+        int iDead = pu_thread_post(refSink, &msgDead);
+        cout << "Shutdown: " << uiReleased << " of " << (sizeof(aLate) / sizeof(aLate[0])) << " queued messages released, post to the stopped sink: "
+             << ((ESRCH == iDead) ? "ESRCH" : "unexpected") << endl;
+
+        bOk = (uiReceived == (uint64_t)uiSenders * uiMessages) && (0 == uiBadOrder) &&
+              (uiReleased == (sizeof(aLate) / sizeof(aLate[0]))) && (ESRCH == iDead);
+        if (!bOk) {
+            cout << "ERROR: received=" << uiReceived << " out of order=" << uiBadOrder << endl;
+        }
+    }
+
+    // Clean up
+    posutils_exit();
+    return (bOk ? 0 : 2);
+}
+/* main */
@@ -0,0 +1,371 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+
+/**
+ * @file     mpmcbench.cpp
+ * @brief    MPMC queue stress test, and throughput against a locked SLL queue
+ *
+ * Every item carries its producer and a per-producer sequence number. Two parts:
+ * - Stress: [producers] x [consumers] threads through a small (64 cell) queue, so it wraps and
+ *   runs full and empty all the time. Every item must be delivered exactly once (a per item
+ *   counter), and each consumer must see every producer's items in increasing order.
+ *   Run for the blocking and the polling calls.
+ * - Throughput: million items per second for several producer:consumer mixes, through
+ *   - MPMC_BLOCK: pu_mpmc_push / pu_mpmc_pop (futex sleep when full / empty)
+ *   - MPMC_POLL : pu_mpmc_trypush / pu_mpmc_trypop, sched_yield when full / empty
+ *   - SLL_LOCKED: mutex + two condition variables around an SLL queue (SLLQ, O(1) both ends)
+ *   .
+ *   The order check stays on, the exactly-once counters do not.
+ * .
+ * Usage: mpmcbench [items] [capacity] [producers] [consumers]
+ * - items     : items per producer and run (default 200000)
+ * - capacity  : queue capacity for the throughput runs (default 1024)
+ * - producers : producers for the stress test (default 2 x CPUs)
+ * - consumers : consumers for the stress test (default 2 x CPUs)
+ * .
+ * The makefile targets the BBB cross compiler. For an x86 host run, override the tools:
+ * - make CC=gcc CPP=g++ STRIP=strip
+ * .
+ */
+
+/**** System includes, namespace, then local includes  ***********************/
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <cstdlib>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "posutils.h"
+#include "pufutex.h"
+#include "pumpmc.h"
+#include "sll.h"
+
+// namespace
+using namespace std;
+
+/**** Local (anonymous) namespace *******************************************/
+
+/**** Definitions ************************************************************/
+#define DEF_ITEMS       (200000)
+#define DEF_CAPACITY    (1024)
+#define STRESS_CAPACITY (64)
+#define MAX_THREADS     (64)
+#define STACK_SIZE      (32*1024)
+#define POISON          (UINT32_MAX)
+
+// The queue under test
+typedef enum {
+    QUEUE_MPMC_BLOCK = 0,
+    QUEUE_MPMC_POLL,
+    QUEUE_SLL_LOCKED,
+    QUEUE_ENDDEF
+}   queue_kind_t;
+
+// What goes through the queue
+typedef struct {
+    uint32_t uiProducer;
+    uint32_t uiSeq;
+}   item_t;
+
+// The SLL queue: a list of queued nodes and a free list, both under one mutex
+typedef struct node_tag {
+    item_t item;
+    SLL_ENTRY(node_tag);
+}   node_t;
+
+typedef struct {
+    pthread_mutex_t mtx;
+    pthread_cond_t  condNotEmpty;
+    pthread_cond_t  condNotFull;
+    SLLQ_HEAD(node_tag) qQueued;
+    node_t*         pFree;
+    node_t*         pNodes;
+}   sll_queue_t;
+
+/**** Macros ****************************************************************/
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static void   sll_queue_create(sll_queue_t* pQueue, uint32_t uiCapacity);
+static void   sll_queue_destroy(sll_queue_t* pQueue);
+static void   sll_queue_push(sll_queue_t* pQueue, const item_t* pItem);
+static void   sll_queue_pop(sll_queue_t* pQueue, item_t* pItem);
+static void   push_item(const item_t* pItem);
+static void   pop_item(item_t* pItem);
+static void*  producer_fct(void* pArg);
+static void*  consumer_fct(void* pArg);
+static double run(queue_kind_t enKind, uint32_t uiProducers, uint32_t uiConsumers, uint32_t uiCapacity);
+static bool   stress(queue_kind_t enKind, uint32_t uiProducers, uint32_t uiConsumers);
+
+/**** Static declarations ***************************************************/
+static const char*      aszNames[QUEUE_ENDDEF] = { "MPMC_BLOCK", "MPMC_POLL", "SLL_LOCKED" };
+static queue_kind_t     enQueue;
+static pu_mpmc_t        mpmc;
+static sll_queue_t      sllq;
+static uint32_t         uiItems    = DEF_ITEMS;
+static uint32_t         uiNumProd  = 0;
+static uint32_t*        puiSeen    = NULL;
+static uint64_t         uiBadOrder = 0;
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+// All nodes start on the free list
+static void sll_queue_create(sll_queue_t* pQueue, uint32_t uiCapacity) {
+    pu_mutex_create_type(&pQueue->mtx, PU_MUTEX_TYPE_FAST);
+    pthread_cond_init(&pQueue->condNotEmpty, NULL);
+    pthread_cond_init(&pQueue->condNotFull, NULL);
+    SLLQ_INIT(pQueue->qQueued);
+    pQueue->pFree   = NULL;
+    pQueue->pNodes  = new node_t[uiCapacity];
+    for (uint32_t i = 0; i < uiCapacity; i++) {
+        SLL_ELEM_ADD(pQueue->pFree, &pQueue->pNodes[i]);
+    }
+}
+
+static void sll_queue_destroy(sll_queue_t* pQueue) {
+    pthread_cond_destroy(&pQueue->condNotFull);
+    pthread_cond_destroy(&pQueue->condNotEmpty);
+    pthread_mutex_destroy(&pQueue->mtx);
+    delete[] pQueue->pNodes;
+}
+
+// Take a free node, append it to the queue
+static void sll_queue_push(sll_queue_t* pQueue, const item_t* pItem) {
+    pthread_mutex_lock(&pQueue->mtx);
+    while (NULL == pQueue->pFree) {
+        pthread_cond_wait(&pQueue->condNotFull, &pQueue->mtx);
+    }
+    node_t* pNode = pQueue->pFree;
+    SLL_ELEM_DEL(node_t, pQueue->pFree, pNode);
+    pNode->item = *pItem;
+    SLLQ_PUSH_TAIL(pQueue->qQueued, pNode);
+    pthread_cond_signal(&pQueue->condNotEmpty);
+    pthread_mutex_unlock(&pQueue->mtx);
+}
+
+// Take the head of the queue, return the node to the free list
+static void sll_queue_pop(sll_queue_t* pQueue, item_t* pItem) {
+    pthread_mutex_lock(&pQueue->mtx);
+    while (SLLQ_IS_EMPTY(pQueue->qQueued)) {
+        pthread_cond_wait(&pQueue->condNotEmpty, &pQueue->mtx);
+    }
+    node_t* pNode;
+    SLLQ_POP_HEAD(pQueue->qQueued, pNode);
+    *pItem = pNode->item;
+    SLL_ELEM_ADD(pQueue->pFree, pNode);
+    pthread_cond_signal(&pQueue->condNotFull);
+    pthread_mutex_unlock(&pQueue->mtx);
+}
+
+// One switch per item for all three, so the comparison is fair
+static void push_item(const item_t* pItem) {
+    switch (enQueue) {
+        case QUEUE_MPMC_BLOCK:
+            pu_mpmc_push(&mpmc, pItem, PU_FUTEX_FOREVER);
+            break;
+        case QUEUE_MPMC_POLL:
+            while (!pu_mpmc_trypush(&mpmc, pItem)) {
+                sched_yield();
+            }
+            break;
+        case QUEUE_SLL_LOCKED:
+        default:
+            sll_queue_push(&sllq, pItem);
+            break;
+    }
+}
+
+static void pop_item(item_t* pItem) {
+    switch (enQueue) {
+        case QUEUE_MPMC_BLOCK:
+            pu_mpmc_pop(&mpmc, pItem, PU_FUTEX_FOREVER);
+            break;
+        case QUEUE_MPMC_POLL:
+            while (!pu_mpmc_trypop(&mpmc, pItem)) {
+                sched_yield();
+            }
+            break;
+        case QUEUE_SLL_LOCKED:
+        default:
+            sll_queue_pop(&sllq, pItem);
+            break;
+    }
+}
+
+// Pushes uiItems items, the argument is the producer number
+static void* producer_fct(void* pArg) {
+    item_t item;
+
+    item.uiProducer = (uint32_t)(uintptr_t)pArg;
+    for (item.uiSeq = 0; item.uiSeq < uiItems; item.uiSeq++) {
+        push_item(&item);
+    }
+    return (NULL);
+}
+
+// Pops until poisoned, checks the per producer order, and counts deliveries if asked to
+static void* consumer_fct(void* pArg) {
+    vector<int64_t> vLast(uiNumProd, -1);
+    uint64_t        uiBad = 0;
+    item_t          item;
+    (void)pArg;
+
+    for (;;) {
+        pop_item(&item);
+        if (POISON == item.uiProducer) {
+            break;
+        }
+        uiBad += ((int64_t)item.uiSeq > vLast[item.uiProducer]) ? 0u : 1u;
+        vLast[item.uiProducer] = item.uiSeq;
+        if (puiSeen) {
+            __atomic_fetch_add(&puiSeen[(size_t)item.uiProducer * uiItems + item.uiSeq], 1, __ATOMIC_RELAXED);
+        }
+    }
+    __atomic_fetch_add(&uiBadOrder, uiBad, __ATOMIC_RELAXED);
+    return (NULL);
+}
+
+// One queue kind, one mix. Returns million items per second
+static double run(queue_kind_t enKind, uint32_t uiProducers, uint32_t uiConsumers, uint32_t uiCapacity) {
+    vector<pthread_t> vPids;
+    pu_thread_attr_t  attr;
+    item_t            poison = { POISON, 0 };
+
+    enQueue   = enKind;
+    uiNumProd = uiProducers;
+    if (QUEUE_SLL_LOCKED == enKind) {
+        sll_queue_create(&sllq, uiCapacity);
+    } else {
+        pu_mpmc_create(&mpmc, uiCapacity, sizeof(item_t), (QUEUE_MPMC_BLOCK == enKind));
+    }
+    pu_thread_attr_init(&attr);
+    attr.uiStackSize = STACK_SIZE;
+
+    // Consumers first, then the producers. Once the producers are done, one poison per consumer
+    auto tStart = chrono::steady_clock::now();
+    for (uint32_t i = 0; i < uiConsumers; i++) {
+        vPids.push_back(pu_thread_create_attr(consumer_fct, NULL, &attr, "consumer"));
+    }
+    for (uint32_t i = 0; i < uiProducers; i++) {
+        vPids.push_back(pu_thread_create_attr(producer_fct, (void*)(uintptr_t)i, &attr, "producer"));
+    }
+    for (uint32_t i = 0; i < uiProducers; i++) {
+        pu_thread_join(vPids[uiConsumers + i], NULL);
+    }
+    for (uint32_t i = 0; i < uiConsumers; i++) {
+        push_item(&poison);
+    }
+    for (uint32_t i = 0; i < uiConsumers; i++) {
+        pu_thread_join(vPids[i], NULL);
+    }
+    chrono::duration<double> tElapsed = chrono::steady_clock::now() - tStart;
+
+    if (QUEUE_SLL_LOCKED == enKind) {
+        sll_queue_destroy(&sllq);
+    } else {
+        pu_mpmc_destroy(&mpmc);
+    }
+    return ((double)uiProducers * (double)uiItems / tElapsed.count() / 1.0e6);
+}
+
+// Exactly once, in order, through a small queue
+static bool stress(queue_kind_t enKind, uint32_t uiProducers, uint32_t uiConsumers) {
+    size_t   uiTotal = (size_t)uiProducers * uiItems;
+    uint64_t uiBadBefore = uiBadOrder;
+    size_t   uiLost = 0;
+    size_t   uiDup  = 0;
+
+    puiSeen = new uint32_t[uiTotal]();
+    run(enKind, uiProducers, uiConsumers, STRESS_CAPACITY);
+    for (size_t i = 0; i < uiTotal; i++) {
+        uiLost += (0 == puiSeen[i]) ? 1u : 0u;
+        uiDup  += (puiSeen[i] > 1) ? 1u : 0u;
+    }
+    delete[] puiSeen;
+    puiSeen = NULL;
+
+    cout << "Stress " << left << setw(10) << aszNames[enKind] << right << ": " << uiProducers << " producers, "
+         << uiConsumers << " consumers, " << uiTotal << " items, lost=" << uiLost << " duplicated=" << uiDup
+         << " out of order=" << (uiBadOrder - uiBadBefore) << endl;
+    return ((0 == uiLost) && (0 == uiDup) && (uiBadOrder == uiBadBefore));
+}
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * Main
+ * @param argc: argument count
+ * @param argv: [items] [capacity] [producers] [consumers]
+ * @return 0, 2 if an item was lost, duplicated or out of order
+ */
+int main( int argc, char *argv[] )
+{
+    const uint32_t aMix[][2] = { {1, 1}, {2, 2}, {4, 4}, {1, 4}, {4, 1} };
+    long     lCpus       = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t uiDefault   = (uint32_t)((lCpus > 0) ? 2 * lCpus : 2);
+    uiItems              = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : DEF_ITEMS;
+    uint32_t uiCapacity  = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 0) : DEF_CAPACITY;
+    uint32_t uiProducers = (argc > 3) ? (uint32_t)strtoul(argv[3], NULL, 0) : uiDefault;
+    uint32_t uiConsumers = (argc > 4) ? (uint32_t)strtoul(argv[4], NULL, 0) : uiDefault;
+    bool     bOk         = true;
+
+    if ((0 == uiItems) || (uiCapacity < 2) || (0 == uiProducers) || (0 == uiConsumers) ||
+        (uiProducers > MAX_THREADS) || (uiConsumers > MAX_THREADS)) {
+        cout << "Usage: mpmcbench [items] [capacity] [producers <= " << MAX_THREADS << "] [consumers <= " << MAX_THREADS << "]" << endl;
+        return (1);
+    }
+    cout << "MPMC queue: CPUs=" << lCpus << " items/producer=" << uiItems << endl;
+
+    int iRet = posutils_init();
+    ASSERT(0 == iRet);
+    if (0 == iRet) {
+        bOk = stress(QUEUE_MPMC_BLOCK, uiProducers, uiConsumers) && bOk;
+        bOk = stress(QUEUE_MPMC_POLL, uiProducers, uiConsumers) && bOk;
+
+        cout << "Throughput (M items/s), capacity " << uiCapacity << endl;
+        cout << left << setw(8) << "P:C";
+        for (int k = 0; k < QUEUE_ENDDEF; k++) {
+            cout << right << setw(12) << aszNames[k];
+        }
+        cout << endl;
+        for (const auto& mix : aMix) {
+            cout << left << setw(8) << (to_string(mix[0]) + ":" + to_string(mix[1])) << right << fixed << setprecision(2);
+            for (int k = 0; k < QUEUE_ENDDEF; k++) {
+                cout << setw(12) << run((queue_kind_t)k, mix[0], mix[1], uiCapacity);
+            }
+            cout << endl;
+        }
+        if (0 != uiBadOrder) {
+            cout << "ERROR: " << uiBadOrder << " items out of order" << endl;
+            bOk = false;
+        }
+    }
+
+    // Clean up
+    posutils_exit();
+    return (bOk ? 0 : 2);
+}
+/* main */
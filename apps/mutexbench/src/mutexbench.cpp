@@ -0,0 +1,201 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+/**
+ * @file     mutexbench.cpp
+ * @brief    Lock/unlock cost of the mutex types under 1 to N contending threads
+ *
+ * Every thread increments a shared counter inside a tiny critical section, i.e. the worst
+ * case for a sleeping lock. The threads are created as a batch and start together. Compared:
+ * - FAST     : plain pthread mutex
+ * - ADAPTIVE : PTHREAD_MUTEX_ADAPTIVE_NP
+ * - FUTEX    : pu_futex_mutex_t (bounded spin, then futex)
+ * - PROFILED : pu_mutex_prof_t around a fast mutex, i.e. the cost of the instrumentation
+ * .
+ * Usage: mutexbench [threads] [iterations]
+ * - threads    : maximum number of threads (default 2 x CPUs)
+ * - iterations : lock/unlock pairs per thread (default 1000000)
+ * .
+ * The makefile targets the BBB cross compiler. For an x86 host run, override the tools:
+ * - make CC=gcc CPP=g++ STRIP=strip
+ * .
+ */
+
+/**** System includes, namespace, then local includes  ***********************/
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <cstdlib>
+#include <unistd.h>
+#include <pthread.h>
+#include "posutils.h"
+#include "pufutex.h"
+
+// namespace
+using namespace std;
+
+/**** Local (anonymous) namespace *******************************************/
+
+/**** Definitions ************************************************************/
+#define DEF_ITERATIONS (1000000)
+#define STACK_SIZE     (16*1024)
+
+// The lock under test
+typedef enum {
+    LOCK_FAST = 0,
+    LOCK_ADAPTIVE,
+    LOCK_FUTEX,
+    LOCK_PROFILED,
+    LOCK_ENDDEF
+}   lock_kind_t;
+
+/**** Macros ****************************************************************/
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static void* bench_fct(void* pArg);
+static double run(lock_kind_t enKind, size_t uiThreads);
+
+/**** Static declarations ***************************************************/
+static const char*      aszNames[LOCK_ENDDEF] = { "FAST", "ADAPTIVE", "FUTEX", "PROFILED" };
+static lock_kind_t      enLock;
+static size_t           uiIterations = DEF_ITERATIONS;
+static volatile size_t  uiCounter    = 0;
+static pthread_mutex_t  mtxFast;
+static pthread_mutex_t  mtxAdaptive;
+static pu_futex_mutex_t mtxFutex     = PU_FUTEX_MUTEX_INITIALIZER;
+static pu_mutex_prof_t  mtxProfiled;
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+// The contending thread, one switch per run rather than per iteration
+static void* bench_fct(void* pArg) {
+    (void)pArg;
+    switch (enLock) {
+        case LOCK_FAST:
+            for (size_t i = 0; i < uiIterations; i++) {
+                pthread_mutex_lock(&mtxFast);
+                uiCounter = uiCounter + 1;
+                pthread_mutex_unlock(&mtxFast);
+            }
+            break;
+        case LOCK_ADAPTIVE:
+            for (size_t i = 0; i < uiIterations; i++) {
+                pthread_mutex_lock(&mtxAdaptive);
+                uiCounter = uiCounter + 1;
+                pthread_mutex_unlock(&mtxAdaptive);
+            }
+            break;
+        case LOCK_FUTEX:
+            for (size_t i = 0; i < uiIterations; i++) {
+                pu_futex_mutex_lock(&mtxFutex);
+                uiCounter = uiCounter + 1;
+                pu_futex_mutex_unlock(&mtxFutex);
+            }
+            break;
+        case LOCK_PROFILED:
+        default:
+            for (size_t i = 0; i < uiIterations; i++) {
+                PU_MUTEX_PROF_LOCK(&mtxProfiled);
+                uiCounter = uiCounter + 1;
+                PU_MUTEX_PROF_UNLOCK(&mtxProfiled);
+            }
+            break;
+    }
+    return (NULL);
+}
+
+// One lock kind, one thread count. Returns ns per lock/unlock pair (wall clock / total pairs)
+static double run(lock_kind_t enKind, size_t uiThreads) {
+    vector<pthread_t> vPids(uiThreads, 0);
+    pu_thread_attr_t  attr;
+
+    pu_thread_attr_init(&attr);
+    attr.uiStackSize = STACK_SIZE;
+    enLock    = enKind;
+    uiCounter = 0;
+
+    auto tStart = chrono::steady_clock::now();
+    size_t uiCreated = pu_thread_create_many(bench_fct, NULL, uiThreads, &attr, "bench_fct", true, vPids.data());
+    for (size_t i = 0; i < uiCreated; i++) {
+        pu_thread_join(vPids[i], NULL);
+    }
+    chrono::duration<double> tElapsed = chrono::steady_clock::now() - tStart;
+    ASSERT(uiCreated == uiThreads);
+    ASSERT(uiCounter == uiCreated * uiIterations);
+    return ((tElapsed.count() * 1.0e9) / (double)(uiCreated * uiIterations));
+}
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * Main
+ * @param argc: argument count
+ * @param argv: [threads] [iterations]
+ * @return 0
+ */
+int main( int argc, char *argv[] )
+{
+    long   lCpus      = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t uiThreads  = (argc > 1) ? strtoul(argv[1], NULL, 0) : (size_t)((lCpus > 0) ? 2 * lCpus : 2);
+    uiIterations      = (argc > 2) ? strtoul(argv[2], NULL, 0) : DEF_ITERATIONS;
+
+    if ((0 == uiThreads) || (0 == uiIterations)) {
+        cout << "Usage: mutexbench [threads] [iterations]" << endl;
+        return (1);
+    }
+    cout << "Mutex benchmark: CPUs=" << lCpus << " iterations/thread=" << uiIterations
+         << ", ns per lock/unlock pair (wall clock)" << endl;
+
+    int iRet = posutils_init();
+    ASSERT(0 == iRet);
+    if (0 == iRet) {
+        pu_mutex_create_type(&mtxFast, PU_MUTEX_TYPE_FAST);
+        pu_mutex_create_type(&mtxAdaptive, PU_MUTEX_TYPE_ADAPTIVE);
+        PU_MUTEX_PROF_CREATE(&mtxProfiled, PU_MUTEX_TYPE_FAST);
+
+        cout << left << setw(8) << "THREADS";
+        for (int k = 0; k < LOCK_ENDDEF; k++) {
+            cout << right << setw(10) << aszNames[k];
+        }
+        cout << endl;
+
+        // 1, 2, 4, ... up to the maximum (which is always included)
+        for (size_t uiN = 1; uiN <= uiThreads; uiN = (uiN == uiThreads) ? uiN + 1 : min(uiN * 2, uiThreads)) {
+            cout << left << setw(8) << uiN << right << fixed << setprecision(1);
+            for (int k = 0; k < LOCK_ENDDEF; k++) {
+                cout << setw(10) << run((lock_kind_t)k, uiN);
+            }
+            cout << endl;
+        }
+
+        pthread_mutex_destroy(&mtxFast);
+        pthread_mutex_destroy(&mtxAdaptive);
+    }
+
+    // Clean up, the profiled mutex shows up in the exit report
+    posutils_exit();
+    return (0);
+}
+/* main */
@@ -0,0 +1,178 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+/**
+ * @file     poolbench.cpp
+ * @brief    Task throughput: thread pool versus a pthread per task
+ *
+ * Runs the same number of small tasks three times:
+ * - each task in its own pu_thread (PU_THREAD_CREATE + pu_thread_join, in batches)
+ * - the same again, with the stack and context cache prewarmed
+ * - each task submitted to a work stealing pool
+ * .
+ * Usage: poolbench [tasks] [workers] [work]
+ * - tasks   : number of tasks (default 10000)
+ * - workers : pool workers, 0 is one per CPU (default 0)
+ * - work    : busy loop iterations per task (default 1000)
+ * .
+ * The makefile targets the BBB cross compiler. For an x86 host run, override the tools:
+ * - make CC=gcc CPP=g++ STRIP=strip
+ * .
+ */
+
+/**** System includes, namespace, then local includes  ***********************/
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <pthread.h>
+#include "posutils.h"
+#include "pupool.h"
+
+// namespace
+using namespace std;
+
+/**** Local (anonymous) namespace *******************************************/
+
+/**** Definitions ************************************************************/
+#define DEF_TASKS   (10000)
+#define DEF_WORK    (1000)
+#define BATCH_SIZE  (32)
+#define STACK_SIZE  (16*1024)
+
+/**** Macros ****************************************************************/
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static void  task_fct(void* pArg);
+static void* thread_fct(void* pArg);
+static void  report(const char* szName, size_t uiTasks, double dSecs);
+static double run_threads(size_t uiTasks);
+
+/**** Static declarations ***************************************************/
+static size_t          uiWork = DEF_WORK;
+static volatile size_t uiDone = 0;
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+// The unit of work, a short busy loop and a completion count
+static void task_fct(void* pArg) {
+    volatile size_t uiSink = 0;
+    for (size_t i = 0; i < uiWork; i++) {
+        uiSink += i;
+    }
+    (void)pArg;
+    __atomic_fetch_add(&uiDone, 1, __ATOMIC_RELAXED);
+}
+
+// Same work, thread entry point signature
+static void* thread_fct(void* pArg) {
+    task_fct(pArg);
+    return (NULL);
+}
+
+static void report(const char* szName, size_t uiTasks, double dSecs) {
+    cout << szName << ": " << uiTasks << " tasks in " << dSecs * 1000.0 << " ms, "
+         << (double)uiTasks / dSecs << " tasks/s, "
+         << (dSecs * 1.0e6) / (double)uiTasks << " us/task" << endl;
+}
+
+// A pthread per task, BATCH_SIZE alive at any one time. Returns the elapsed seconds
+static double run_threads(size_t uiTasks) {
+    pthread_t aThreads[BATCH_SIZE];
+
+    uiDone = 0;
+    auto tStart = chrono::steady_clock::now();
+    for (size_t uiBase = 0; uiBase < uiTasks; uiBase += BATCH_SIZE) {
+        size_t uiBatch = min((size_t)BATCH_SIZE, uiTasks - uiBase);
+        for (size_t i = 0; i < uiBatch; i++) {
+            aThreads[i] = PU_THREAD_CREATE(thread_fct, NULL, STACK_SIZE);
+        }
+        for (size_t i = 0; i < uiBatch; i++) {
+            if (0 != aThreads[i]) {
+                pu_thread_join(aThreads[i], NULL);
+            }
+        }
+    }
+    chrono::duration<double> tElapsed = chrono::steady_clock::now() - tStart;
+    ASSERT(uiDone == uiTasks);
+    return (tElapsed.count());
+}
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * Main
+ * @param argc: argument count
+ * @param argv: [tasks] [workers] [work]
+ * @return 0
+ */
+int main( int argc, char *argv[] )
+{
+    size_t uiTasks   = (argc > 1) ? strtoul(argv[1], NULL, 0) : DEF_TASKS;
+    size_t uiWorkers = (argc > 2) ? strtoul(argv[2], NULL, 0) : 0;
+    uiWork           = (argc > 3) ? strtoul(argv[3], NULL, 0) : DEF_WORK;
+
+    cout << "Pool benchmark: tasks=" << uiTasks << " work=" << uiWork << endl;
+
+    int iRet = posutils_init();
+    ASSERT(0 == iRet);
+    if (0 == iRet) {
+        // A pthread per task, glibc stacks
+        double dThreads = run_threads(uiTasks);
+        report("thread/task", uiTasks, dThreads);
+
+        // A pthread per task, cached stacks
+        pu_thread_cache_stats_t stats;
+        pu_thread_cache_prewarm(STACK_SIZE, BATCH_SIZE);
+        double dCached = run_threads(uiTasks);
+        pu_thread_cache_enable(false);
+        pu_thread_cache_get_stats(&stats);
+        report("cached     ", uiTasks, dCached);
+        cout << "Cache: stack hits=" << stats.uiStackHits << " misses=" << stats.uiStackMisses
+             << ", context hits=" << stats.uiContextHits << " misses=" << stats.uiContextMisses << endl;
+
+        // The pool, creation and teardown are not part of the measurement
+        pu_pool_t* pPool = PU_POOL_CREATE(uiWorkers, 1024, STACK_SIZE);
+        ASSERT(pPool);
+        if (pPool) {
+            cout << "Pool workers: " << pu_pool_get_number_of_workers(pPool) << endl;
+            uiDone = 0;
+            auto tStart = chrono::steady_clock::now();
+            for (size_t i = 0; i < uiTasks; i++) {
+                pu_pool_submit(pPool, task_fct, NULL);
+            }
+            pu_pool_wait_idle(pPool);
+            chrono::duration<double> tPool = chrono::steady_clock::now() - tStart;
+            ASSERT(uiDone == uiTasks);
+            report("pool       ", uiTasks, tPool.count());
+            cout << "Speedup: " << dThreads / tPool.count() << "x" << endl;
+            pu_thread_dump_top(stdout, PU_THREAD_SORT_CPU, 0);
+            pu_pool_destroy(pPool);
+        }
+    }
+
+    // Clean up
+    posutils_exit();
+    return (0);
+}
+/* main */
@@ -0,0 +1,269 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+/**
+ * @file     ringbench.cpp
+ * @brief    SPSC ring throughput and hand-over latency
+ *
+ * The records are 24 bytes, the size of a gpiod_line_event. Two tests:
+ * - Throughput: the producer pushes [records] records in batches of 1, 8 and 32, the consumer
+ *   pops in the same batches, either blocking (pu_ring_pop_wait) or polling (pop + yield).
+ *   Every record carries a sequence number which the consumer checks.
+ * - Latency: the producer pushes one time stamped record every 200us (like a slow GPIO edge),
+ *   the consumer sleeps in pu_ring_pop_wait. The delay from push to pop is what a GPIO event
+ *   handed to a processing thread costs on top of the gpiod read.
+ * .
+ * Usage: ringbench [records] [capacity]
+ * - records  : records per throughput run (default 2000000)
+ * - capacity : ring capacity (default 256)
+ * .
+ * The makefile targets the BBB cross compiler. For an x86 host run, override the tools:
+ * - make CC=gcc CPP=g++ STRIP=strip
+ * .
+ */
+
+/**** System includes, namespace, then local includes  ***********************/
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include "posutils.h"
+#include "pufutex.h"
+#include "puring.h"
+
+// namespace
+using namespace std;
+
+/**** Local (anonymous) namespace *******************************************/
+
+/**** Definitions ************************************************************/
+#define DEF_RECORDS     (2000000)
+#define DEF_CAPACITY    (256)
+#define MAX_BATCH       (32)
+#define LAT_RECORDS     (5000)
+#define LAT_PERIOD_NS   (200000L)
+#define STACK_SIZE      (32*1024)
+#define NS_PER_SEC      (1000000000L)
+
+// A GPIO event sized record
+typedef struct {
+    uint64_t uiNs;
+    uint64_t uiSeq;
+    uint32_t uiOffset;
+    int32_t  iType;
+}   record_t;
+
+/**** Macros ****************************************************************/
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static uint64_t now_ns(void);
+static void*    producer_fct(void* pArg);
+static void*    consumer_fct(void* pArg);
+static void*    lat_producer_fct(void* pArg);
+static double   run_throughput(uint32_t uiBatch, bool bBlocking);
+static void     run_latency(void);
+
+/**** Static declarations ***************************************************/
+static pu_ring_t    ring;
+static uint64_t     uiRecords  = DEF_RECORDS;
+static uint32_t     uiCapacity = DEF_CAPACITY;
+static uint32_t     uiBatchSz  = 1;
+static bool         bBlock     = true;
+static uint64_t     uiBadSeq   = 0;
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * NS_PER_SEC + (uint64_t)ts.tv_nsec);
+}
+
+// Pushes uiRecords in batches, yields when the ring is full
+static void* producer_fct(void* pArg) {
+    record_t aBatch[MAX_BATCH];
+    uint64_t uiSeq = 0;
+    (void)pArg;
+
+    while (uiSeq < uiRecords) {
+        uint32_t uiN = (uint32_t)min<uint64_t>(uiBatchSz, uiRecords - uiSeq);
+        for (uint32_t i = 0; i < uiN; i++) {
+            aBatch[i].uiSeq = uiSeq + i;
+        }
+        uint32_t uiDone = 0;
+        while (uiDone < uiN) {
+            uint32_t uiPushed = pu_ring_push(&ring, &aBatch[uiDone], uiN - uiDone);
+            uiDone += uiPushed;
+            if (0 == uiPushed) {
+                sched_yield();
+            }
+        }
+        uiSeq += uiN;
+    }
+    return (NULL);
+}
+
+// Pops until every record has arrived, checks the order
+static void* consumer_fct(void* pArg) {
+    record_t aBatch[MAX_BATCH];
+    uint64_t uiExpect = 0;
+    uint64_t uiBad    = 0;
+    (void)pArg;
+
+    while (uiExpect < uiRecords) {
+        uint32_t uiGot = bBlock ? pu_ring_pop_wait(&ring, aBatch, uiBatchSz, PU_FUTEX_FOREVER)
+                                : pu_ring_pop(&ring, aBatch, uiBatchSz);
+        if (0 == uiGot) {
+            sched_yield();
+        }
+        for (uint32_t i = 0; i < uiGot; i++, uiExpect++) {
+            uiBad += (aBatch[i].uiSeq == uiExpect) ? 0u : 1u;
+        }
+    }
+    uiBadSeq += uiBad;
+    return (NULL);
+}
+
+// One time stamped record per period, then a terminator (uiSeq = UINT64_MAX)
+static void* lat_producer_fct(void* pArg) {
+    struct timespec ts;
+    record_t        rec = {};
+    (void)pArg;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    for (uint64_t i = 0; i <= LAT_RECORDS; i++) {
+        ts.tv_nsec += LAT_PERIOD_NS;
+        if (ts.tv_nsec >= NS_PER_SEC) {
+            ts.tv_nsec -= NS_PER_SEC;
+            ts.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+        rec.uiSeq = (i < LAT_RECORDS) ? i : UINT64_MAX;
+        rec.uiNs  = now_ns();
+        while (0 == pu_ring_push(&ring, &rec, 1)) {
+            sched_yield();
+        }
+    }
+    return (NULL);
+}
+
+// Millions of records per second
+static double run_throughput(uint32_t uiBatch, bool bBlocking) {
+    pu_thread_attr_t attr;
+
+    pu_ring_create(&ring, uiCapacity, sizeof(record_t), bBlocking);
+    pu_thread_attr_init(&attr);
+    attr.uiStackSize = STACK_SIZE;
+    uiBatchSz = uiBatch;
+    bBlock    = bBlocking;
+
+    auto tStart = chrono::steady_clock::now();
+    pthread_t pidC = pu_thread_create_attr(consumer_fct, NULL, &attr, "consumer");
+    pthread_t pidP = pu_thread_create_attr(producer_fct, NULL, &attr, "producer");
+    pu_thread_join(pidP, NULL);
+    pu_thread_join(pidC, NULL);
+    chrono::duration<double> tElapsed = chrono::steady_clock::now() - tStart;
+
+    pu_ring_destroy(&ring);
+    return ((double)uiRecords / tElapsed.count() / 1.0e6);
+}
+
+// Push to pop delay with a sleeping consumer
+static void run_latency(void) {
+    pu_thread_attr_t attr;
+    vector<uint64_t> vLat;
+    record_t         rec;
+
+    vLat.reserve(LAT_RECORDS);
+    pu_ring_create(&ring, uiCapacity, sizeof(record_t), true);
+    pu_thread_attr_init(&attr);
+    attr.uiStackSize = STACK_SIZE;
+    pthread_t pidP = pu_thread_create_attr(lat_producer_fct, NULL, &attr, "producer");
+
+    // This thread is the consumer
+    for (;;) {
+        if (0 == pu_ring_pop_wait(&ring, &rec, 1, PU_FUTEX_FOREVER)) {
+            continue;
+        }
+        uint64_t uiNow = now_ns();
+        if (UINT64_MAX == rec.uiSeq) {
+            break;
+        }
+        vLat.push_back(uiNow - rec.uiNs);
+    }
+    pu_thread_join(pidP, NULL);
+    pu_ring_destroy(&ring);
+
+    sort(vLat.begin(), vLat.end());
+    auto pct = [&vLat](double dPct) {
+        return ((double)vLat[(size_t)(dPct * (double)(vLat.size() - 1) / 100.0)] / 1000.0);
+    };
+    cout << "Latency (us), blocking consumer, " << vLat.size() << " records:" << fixed << setprecision(1)
+         << " p50=" << pct(50.0) << " p99=" << pct(99.0) << " max=" << pct(100.0) << endl;
+}
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * Main
+ * @param argc: argument count
+ * @param argv: [records] [capacity]
+ * @return 0, 2 if records arrived out of order
+ */
+int main( int argc, char *argv[] )
+{
+    uiRecords  = (argc > 1) ? strtoull(argv[1], NULL, 0) : DEF_RECORDS;
+    uiCapacity = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 0) : DEF_CAPACITY;
+    if ((0 == uiRecords) || (uiCapacity < MAX_BATCH)) {
+        cout << "Usage: ringbench [records] [capacity >= " << MAX_BATCH << "]" << endl;
+        return (1);
+    }
+    cout << "SPSC ring: " << sizeof(record_t) << " byte records, capacity " << uiCapacity << endl;
+
+    int iRet = posutils_init();
+    ASSERT(0 == iRet);
+    if (0 == iRet) {
+        cout << "Throughput (M records/s)" << endl;
+        cout << left << setw(8) << "BATCH" << right << setw(10) << "BLOCKING" << setw(10) << "POLLING" << endl;
+        for (uint32_t uiBatch = 1; uiBatch <= MAX_BATCH; uiBatch *= (1 == uiBatch) ? 8 : 4) {
+            cout << left << setw(8) << uiBatch << right << fixed << setprecision(2)
+                 << setw(10) << run_throughput(uiBatch, true)
+                 << setw(10) << run_throughput(uiBatch, false) << endl;
+        }
+        run_latency();
+        if (0 != uiBadSeq) {
+            cout << "ERROR: " << uiBadSeq << " records out of order" << endl;
+        }
+    }
+
+    // Clean up
+    posutils_exit();
+    return ((0 == uiBadSeq) ? 0 : 2);
+}
+/* main */
@@ -0,0 +1,237 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+/**
+ * @file     rwbench.cpp
+ * @brief    Read-mostly shared state: mutex versus rwlock versus seqlock
+ *
+ * The shared state is a 64 byte calibration table. A writer sets every entry to the same new
+ * value, a reader copies the table and checks that all entries match (a torn copy does not).
+ * Every thread does one write per [ratio] reads. Compared:
+ * - MUTEX   : fast pthread mutex around both reads and writes
+ * - RW_READ : rwlock, readers first (pthread default)
+ * - RW_WRITE: rwlock, writers first
+ * - SEQLOCK : pu_seqlock_t, readers copy without writing anything shared
+ * .
+ * Usage: rwbench [threads] [iterations] [ratio]
+ * - threads    : maximum number of threads (default 2 x CPUs)
+ * - iterations : operations per thread (default 1000000)
+ * - ratio      : reads per write (default 100)
+ * .
+ * The makefile targets the BBB cross compiler. For an x86 host run, override the tools:
+ * - make CC=gcc CPP=g++ STRIP=strip
+ * .
+ */
+
+/**** System includes, namespace, then local includes  ***********************/
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <pthread.h>
+#include "posutils.h"
+#include "puseqlock.h"
+
+// namespace
+using namespace std;
+
+/**** Local (anonymous) namespace *******************************************/
+
+/**** Definitions ************************************************************/
+#define DEF_ITERATIONS (1000000)
+#define DEF_RATIO      (100)
+#define CAL_ENTRIES    (16)
+#define STACK_SIZE     (16*1024)
+
+// The lock under test
+typedef enum {
+    LOCK_MUTEX = 0,
+    LOCK_RW_READ,
+    LOCK_RW_WRITE,
+    LOCK_SEQLOCK,
+    LOCK_ENDDEF
+}   lock_kind_t;
+
+// The shared state, one cache line
+typedef struct {
+    uint32_t auiEntry[CAL_ENTRIES];
+}   cal_t;
+
+/**** Macros ****************************************************************/
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static bool  cal_ok(const cal_t* pCal);
+static void* bench_fct(void* pArg);
+static double run(lock_kind_t enKind, size_t uiThreads);
+
+/**** Static declarations ***************************************************/
+static const char*      aszNames[LOCK_ENDDEF] = { "MUTEX", "RW_READ", "RW_WRITE", "SEQLOCK" };
+static lock_kind_t      enLock;
+static size_t           uiIterations = DEF_ITERATIONS;
+static size_t           uiRatio      = DEF_RATIO;
+static size_t           uiTorn       = 0;
+static pthread_mutex_t  mtxCal;
+static pthread_rwlock_t rwlRead;
+static pthread_rwlock_t rwlWrite;
+static pu_seqlock_t     seqCal       = PU_SEQLOCK_INITIALIZER;
+static cal_t            calShared;
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+// A consistent table has every entry equal
+static bool cal_ok(const cal_t* pCal) {
+    for (size_t i = 1; i < CAL_ENTRIES; i++) {
+        if (pCal->auiEntry[i] != pCal->auiEntry[0]) {
+            return (false);
+        }
+    }
+    return (true);
+}
+
+// One write per uiRatio reads, one switch per run rather than per operation
+static void* bench_fct(void* pArg) {
+    pthread_rwlock_t* pRwl = (LOCK_RW_READ == enLock) ? &rwlRead : &rwlWrite;
+    size_t            uiBad = 0;
+    cal_t             cal;
+    (void)pArg;
+
+    for (size_t i = 0; i < uiIterations; i++) {
+        bool bWrite = (0 == (i % (uiRatio + 1)));
+        if (bWrite) {
+            for (size_t k = 0; k < CAL_ENTRIES; k++) {
+                cal.auiEntry[k] = (uint32_t)i;
+            }
+        }
+        switch (enLock) {
+            case LOCK_MUTEX:
+                pthread_mutex_lock(&mtxCal);
+                if (bWrite) { calShared = cal; } else { cal = calShared; }
+                pthread_mutex_unlock(&mtxCal);
+                break;
+            case LOCK_RW_READ:
+            case LOCK_RW_WRITE:
+                if (bWrite) {
+                    pthread_rwlock_wrlock(pRwl);
+                    calShared = cal;
+                } else {
+                    pthread_rwlock_rdlock(pRwl);
+                    cal = calShared;
+                }
+                pthread_rwlock_unlock(pRwl);
+                break;
+            case LOCK_SEQLOCK:
+            default:
+                if (bWrite) {
+                    pu_seqlock_write(&seqCal, &calShared, &cal, sizeof(cal));
+                } else {
+                    pu_seqlock_read(&seqCal, &cal, &calShared, sizeof(cal));
+                }
+                break;
+        }
+        uiBad += cal_ok(&cal) ? 0u : 1u;
+    }
+    __atomic_fetch_add(&uiTorn, uiBad, __ATOMIC_RELAXED);
+    return (NULL);
+}
+
+// One lock kind, one thread count. Returns ns per operation (wall clock / total operations)
+static double run(lock_kind_t enKind, size_t uiThreads) {
+    vector<pthread_t> vPids(uiThreads, 0);
+    pu_thread_attr_t  attr;
+
+    pu_thread_attr_init(&attr);
+    attr.uiStackSize = STACK_SIZE;
+    enLock = enKind;
+    memset(&calShared, 0, sizeof(calShared));
+
+    auto tStart = chrono::steady_clock::now();
+    size_t uiCreated = pu_thread_create_many(bench_fct, NULL, uiThreads, &attr, "bench_fct", true, vPids.data());
+    for (size_t i = 0; i < uiCreated; i++) {
+        pu_thread_join(vPids[i], NULL);
+    }
+    chrono::duration<double> tElapsed = chrono::steady_clock::now() - tStart;
+    ASSERT(uiCreated == uiThreads);
+    return ((tElapsed.count() * 1.0e9) / (double)(uiCreated * uiIterations));
+}
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * Main
+ * @param argc: argument count
+ * @param argv: [threads] [iterations] [ratio]
+ * @return 0, 2 if a torn copy was seen
+ */
+int main( int argc, char *argv[] )
+{
+    long   lCpus      = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t uiThreads  = (argc > 1) ? strtoul(argv[1], NULL, 0) : (size_t)((lCpus > 0) ? 2 * lCpus : 2);
+    uiIterations      = (argc > 2) ? strtoul(argv[2], NULL, 0) : DEF_ITERATIONS;
+    uiRatio           = (argc > 3) ? strtoul(argv[3], NULL, 0) : DEF_RATIO;
+
+    if ((0 == uiThreads) || (0 == uiIterations)) {
+        cout << "Usage: rwbench [threads] [iterations] [ratio]" << endl;
+        return (1);
+    }
+    cout << "Read-mostly benchmark: CPUs=" << lCpus << " operations/thread=" << uiIterations
+         << " write:read=1:" << uiRatio << ", ns per operation (wall clock)" << endl;
+
+    int iRet = posutils_init();
+    ASSERT(0 == iRet);
+    if (0 == iRet) {
+        pu_mutex_create_type(&mtxCal, PU_MUTEX_TYPE_FAST);
+        pu_rwlock_create_type(&rwlRead, PU_RWLOCK_TYPE_READER);
+        pu_rwlock_create_type(&rwlWrite, PU_RWLOCK_TYPE_WRITER);
+
+        cout << left << setw(8) << "THREADS";
+        for (int k = 0; k < LOCK_ENDDEF; k++) {
+            cout << right << setw(10) << aszNames[k];
+        }
+        cout << endl;
+
+        // 1, 2, 4, ... up to the maximum (which is always included)
+        for (size_t uiN = 1; uiN <= uiThreads; uiN = (uiN == uiThreads) ? uiN + 1 : min(uiN * 2, uiThreads)) {
+            cout << left << setw(8) << uiN << right << fixed << setprecision(1);
+            for (int k = 0; k < LOCK_ENDDEF; k++) {
+                cout << setw(10) << run((lock_kind_t)k, uiN);
+            }
+            cout << endl;
+        }
+
+        pthread_mutex_destroy(&mtxCal);
+        pthread_rwlock_destroy(&rwlRead);
+        pthread_rwlock_destroy(&rwlWrite);
+        if (0 != uiTorn) {
+            cout << "ERROR: " << uiTorn << " torn copies" << endl;
+        }
+    }
+
+    // Clean up
+    posutils_exit();
+    return ((0 == uiTorn) ? 0 : 2);
+}
+/* main */
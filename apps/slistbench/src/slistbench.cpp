@@ -0,0 +1,213 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+
+
+/**
+ * @file     slistbench.cpp
+ * @brief    sll.h macros against the pu::intrusive_slist template (sll.hpp)
+ *
+ * Three passes over the same elements, each written once with the macros and once with the
+ * template, best of a few runs:
+ * - Build: push n elements on the front (SLL_ELEM_ADD / push_front)
+ * - Walk:  sum a field over the list (SLL_FOR_EACH / range-for)
+ * - Drain: take the head off until empty (SLL_ELEM_DEL of the head / pop_front)
+ * .
+ * At -O2 (the Makefile's setting) the template's ns/elem should match the macros' within the
+ * noise, at -O0 the template's calls are not inlined and it is slower. The counting variant
+ * (Count = true) pays one increment/decrement per push/pop. The sums are compared, and
+ * std::count_if over the template checks that the std algorithms accept its iterators.
+ *
+ * Usage: slistbench [elements] [rounds]
+ * - elements : list length (default 100000)
+ * - rounds   : runs per measurement, the best one counts (default 20)
+ * .
+ * The makefile targets the BBB cross compiler. For an x86 host run, override the tools:
+ * - make CC=gcc CPP=g++ STRIP=strip
+ * .
+ */
+
+/**** System includes, namespace, then local includes  ***********************/
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include "sll.hpp"
+
+// namespace
+using namespace std;
+
+/**** Local (anonymous) namespace *******************************************/
+
+/**** Definitions ************************************************************/
+#define DEF_ELEMS   (100000)
+#define DEF_ROUNDS  (20)
+
+typedef struct elem_tag {
+    uint32_t uiValue;
+    SLL_ENTRY(elem_tag);
+}   elem_t;
+
+typedef pu::intrusive_slist<elem_t>                             elem_list_t;
+typedef pu::intrusive_slist<elem_t, &elem_t::pSllNextElem, true> elem_clist_t;
+
+static_assert( sizeof(elem_list_t) == sizeof(elem_t*), "the list should be just a head pointer" );
+
+/**** Macros ****************************************************************/
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static void run_macros(double* pBuild, double* pWalk, double* pDrain);
+template <typename L>
+static void run_template(double* pBuild, double* pWalk, double* pDrain);
+
+/**** Static declarations ***************************************************/
+static vector<elem_t> vElems;
+static uint32_t       uiRounds = DEF_ROUNDS;
+static uint64_t       uiExpect = 0;
+static uint64_t       uiErrors = 0;
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+static inline double ns_per_elem(chrono::steady_clock::time_point tStart) {
+    chrono::duration<double> tElapsed = chrono::steady_clock::now() - tStart;
+    return (tElapsed.count() * 1.0e9 / (double)vElems.size());
+}
+
+// Best ns/elem of the rounds, for each pass
+static void run_macros(double* pBuild, double* pWalk, double* pDrain) {
+    for (uint32_t r = 0; r < uiRounds; r++) {
+        elem_t*  pList = NULL;
+        elem_t*  pElem;
+        uint64_t uiSum = 0;
+
+        auto tStart = chrono::steady_clock::now();
+        for (elem_t& e : vElems) {
+            SLL_ELEM_ADD(pList, &e);
+        }
+        *pBuild = min(*pBuild, ns_per_elem(tStart));
+
+        tStart = chrono::steady_clock::now();
+        SLL_FOR_EACH(pList, pElem) {
+            uiSum += pElem->uiValue;
+        }
+        *pWalk = min(*pWalk, ns_per_elem(tStart));
+
+        tStart = chrono::steady_clock::now();
+        size_t uiDrained = 0;
+        while (NULL != (pElem = pList)) {
+            SLL_ELEM_DEL(elem_t, pList, pElem);
+            uiDrained++;
+        }
+        *pDrain = min(*pDrain, ns_per_elem(tStart));
+        uiErrors += ((uiSum == uiExpect) && (uiDrained == vElems.size())) ? 0u : 1u;
+    }
+}
+
+template <typename L>
+static void run_template(double* pBuild, double* pWalk, double* pDrain) {
+    for (uint32_t r = 0; r < uiRounds; r++) {
+        L        lst;
+        uint64_t uiSum = 0;
+
+        auto tStart = chrono::steady_clock::now();
+        for (elem_t& e : vElems) {
+            lst.push_front(e);
+        }
+        *pBuild = min(*pBuild, ns_per_elem(tStart));
+
+        tStart = chrono::steady_clock::now();
+        for (const elem_t& e : lst) {
+            uiSum += e.uiValue;
+        }
+        *pWalk = min(*pWalk, ns_per_elem(tStart));
+
+        // Not timed, checks the iterators against a std algorithm
+        ptrdiff_t iOdd = count_if(lst.cbegin(), lst.cend(), [](const elem_t& e) { return (e.uiValue & 1u) != 0; });
+        uiErrors += ((size_t)iOdd == vElems.size() / 2) ? 0u : 1u;
+
+        tStart = chrono::steady_clock::now();
+        size_t uiDrained = 0;
+        while (!lst.empty()) {
+            lst.pop_front();
+            uiDrained++;
+        }
+        *pDrain = min(*pDrain, ns_per_elem(tStart));
+        uiErrors += ((uiSum == uiExpect) && (uiDrained == vElems.size())) ? 0u : 1u;
+    }
+}
+
+static void print_row(const char* szName, double dBuild, double dWalk, double dDrain) {
+    cout << left << setw(22) << szName << right << fixed << setprecision(2)
+         << setw(12) << dBuild << setw(12) << dWalk << setw(12) << dDrain << endl;
+}
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * Main
+ * @param argc: argument count
+ * @param argv: [elements] [rounds]
+ * @return 0, 2 if a sum or count was wrong
+ */
+int main( int argc, char *argv[] )
+{
+    size_t uiCount = (argc > 1) ? (size_t)strtoul(argv[1], NULL, 0) : DEF_ELEMS;
+    uiRounds = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 0) : DEF_ROUNDS;
+    if ((uiCount < 2) || (uiRounds < 1)) {
+        cout << "Usage: slistbench [elements >= 2] [rounds >= 1]" << endl;
+        return (1);
+    }
+    vElems.resize(uiCount);
+    for (size_t i = 0; i < uiCount; i++) {
+        vElems[i].uiValue = (uint32_t)i;
+        uiExpect += i;
+    }
+
+    double dBuild[3] = { 1.0e9, 1.0e9, 1.0e9 };
+    double dWalk[3]  = { 1.0e9, 1.0e9, 1.0e9 };
+    double dDrain[3] = { 1.0e9, 1.0e9, 1.0e9 };
+    // Interleaved, so that frequency changes hit all three alike
+    for (uint32_t i = 0; i < 3; i++) {
+        run_macros(&dBuild[0], &dWalk[0], &dDrain[0]);
+        run_template<elem_list_t>(&dBuild[1], &dWalk[1], &dDrain[1]);
+        run_template<elem_clist_t>(&dBuild[2], &dWalk[2], &dDrain[2]);
+    }
+
+#if defined(__OPTIMIZE__)
+    cout << uiCount << " elements, best of " << (3 * uiRounds) << " rounds (ns/elem), optimised build" << endl;
+#else
+    cout << uiCount << " elements, best of " << (3 * uiRounds) << " rounds (ns/elem), -O0 build, the template is not inlined" << endl;
+#endif
+    cout << left << setw(22) << "" << right << setw(12) << "BUILD" << setw(12) << "WALK" << setw(12) << "DRAIN" << endl;
+    print_row("sll.h macros", dBuild[0], dWalk[0], dDrain[0]);
+    print_row("intrusive_slist", dBuild[1], dWalk[1], dDrain[1]);
+    print_row("intrusive_slist+size", dBuild[2], dWalk[2], dDrain[2]);
+    if (0 != uiErrors) {
+        cout << "ERROR: " << uiErrors << " wrong sums or counts" << endl;
+    }
+    return ((0 == uiErrors) ? 0 : 2);
+}
+/* main */
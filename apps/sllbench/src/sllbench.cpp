@@ -0,0 +1,206 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+
+/**
+ * @file     sllbench.cpp
+ * @brief    FIFO use of sll.h: SLL_ELEM_ADD_TAIL against the SLLQ queue macros
+ *
+ * For each size n:
+ * - FIFO: queue n elements at the tail, then take them all off the head (checking the order).
+ *   SLL uses SLL_ELEM_ADD_TAIL and SLL_ELEM_DEL of the head, SLLQ uses SLLQ_PUSH_TAIL and
+ *   SLLQ_POP_HEAD.
+ * - Concat: append a list of n/2 elements to another one of n/2, 1000 times over. SLL has to
+ *   walk to the tail, SLLQ_CONCAT does not.
+ * .
+ * Usage: sllbench [max elements]
+ * - max elements : largest n, the sizes are 1000, 10000, ... up to it (default 50000)
+ * .
+ * The makefile targets the BBB cross compiler. For an x86 host run, override the tools:
+ * - make CC=gcc CPP=g++ STRIP=strip
+ * .
+ */
+
+/**** System includes, namespace, then local includes  ***********************/
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <cstdlib>
+#include "sll.h"
+
+// namespace
+using namespace std;
+
+/**** Local (anonymous) namespace *******************************************/
+
+/**** Definitions ************************************************************/
+#define DEF_MAX_ELEMS   (50000)
+#define CONCAT_ROUNDS   (1000)
+
+typedef struct elem_tag {
+    uint32_t uiSeq;
+    SLL_ENTRY(elem_tag);
+}   elem_t;
+
+typedef SLLQ_HEAD(elem_tag) elem_queue_t;
+
+/**** Macros ****************************************************************/
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static double fifo_sll(size_t uiCount);
+static double fifo_sllq(size_t uiCount);
+static double concat_sll(size_t uiCount);
+static double concat_sllq(size_t uiCount);
+
+/**** Static declarations ***************************************************/
+static vector<elem_t> vElems;
+static uint64_t       uiBadOrder = 0;
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+// ns per element, queued and taken off again
+static double fifo_sll(size_t uiCount) {
+    elem_t* pList = NULL;
+    elem_t* pElem;
+
+    auto tStart = chrono::steady_clock::now();
+    for (size_t i = 0; i < uiCount; i++) {
+        SLL_ELEM_ADD_TAIL(elem_t, pList, &vElems[i]);
+    }
+    for (uint32_t uiExpect = 0; NULL != (pElem = pList); uiExpect++) {
+        SLL_ELEM_DEL(elem_t, pList, pElem);
+        uiBadOrder += (pElem->uiSeq == uiExpect) ? 0u : 1u;
+    }
+    chrono::duration<double> tElapsed = chrono::steady_clock::now() - tStart;
+    return (tElapsed.count() * 1.0e9 / (double)uiCount);
+}
+
+static double fifo_sllq(size_t uiCount) {
+    elem_queue_t q = SLLQ_INITIALIZER;
+    elem_t*      pElem;
+
+    auto tStart = chrono::steady_clock::now();
+    for (size_t i = 0; i < uiCount; i++) {
+        SLLQ_PUSH_TAIL(q, &vElems[i]);
+    }
+    for (uint32_t uiExpect = 0; ; uiExpect++) {
+        SLLQ_POP_HEAD(q, pElem);
+        if (NULL == pElem) {
+            break;
+        }
+        uiBadOrder += (pElem->uiSeq == uiExpect) ? 0u : 1u;
+    }
+    chrono::duration<double> tElapsed = chrono::steady_clock::now() - tStart;
+    return (tElapsed.count() * 1.0e9 / (double)uiCount);
+}
+
+// ns per concatenation. The two halves are built once, joined, split again each round
+static double concat_sll(size_t uiCount) {
+    size_t  uiHalf = uiCount / 2;
+    elem_t* pFirst = NULL;
+    elem_t* pSecond;
+
+    for (size_t i = uiHalf; i > 0; i--) {
+        SLL_ELEM_ADD(pFirst, &vElems[i - 1]);
+    }
+    auto tStart = chrono::steady_clock::now();
+    for (uint32_t r = 0; r < CONCAT_ROUNDS; r++) {
+        pSecond = &vElems[uiHalf];
+        vElems[uiCount - 1].pSllNextElem = NULL;
+        elem_t* pTail = pFirst;
+        while (pTail->pSllNextElem) {
+            pTail = pTail->pSllNextElem;
+        }
+        pTail->pSllNextElem = pSecond;
+        vElems[uiHalf - 1].pSllNextElem = NULL;
+    }
+    chrono::duration<double> tElapsed = chrono::steady_clock::now() - tStart;
+    return (tElapsed.count() * 1.0e9 / CONCAT_ROUNDS);
+}
+
+static double concat_sllq(size_t uiCount) {
+    size_t       uiHalf = uiCount / 2;
+    elem_queue_t qFirst = SLLQ_INITIALIZER;
+    elem_queue_t qSecond;
+
+    for (size_t i = 0; i < uiCount; i++) {
+        vElems[i].pSllNextElem = NULL;
+    }
+    for (size_t i = 0; i < uiHalf; i++) {
+        SLLQ_PUSH_TAIL(qFirst, &vElems[i]);
+    }
+    auto tStart = chrono::steady_clock::now();
+    for (uint32_t r = 0; r < CONCAT_ROUNDS; r++) {
+        qSecond.pSllqHead = &vElems[uiHalf];
+        qSecond.pSllqTail = &vElems[uiCount - 1];
+        SLLQ_CONCAT(qFirst, qSecond);
+        qFirst.pSllqTail = &vElems[uiHalf - 1];
+        qFirst.pSllqTail->pSllNextElem = NULL;
+    }
+    chrono::duration<double> tElapsed = chrono::steady_clock::now() - tStart;
+    uiBadOrder += (SLLQ_LAST(qFirst) == &vElems[uiHalf - 1]) ? 0u : 1u;
+    return (tElapsed.count() * 1.0e9 / CONCAT_ROUNDS);
+}
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * Main
+ * @param argc: argument count
+ * @param argv: [max elements]
+ * @return 0, 2 if the FIFO order was wrong
+ */
+int main( int argc, char *argv[] )
+{
+    size_t uiMax = (argc > 1) ? (size_t)strtoul(argv[1], NULL, 0) : DEF_MAX_ELEMS;
+    if (uiMax < 1000) {
+        cout << "Usage: sllbench [max elements >= 1000]" << endl;
+        return (1);
+    }
+    vElems.resize(uiMax);
+
+    cout << left << setw(10) << "ELEMENTS" << right << setw(14) << "FIFO SLL" << setw(14) << "FIFO SLLQ"
+         << setw(14) << "CONCAT SLL" << setw(14) << "CONCAT SLLQ" << endl;
+    cout << left << setw(10) << "" << right << setw(14) << "(ns/elem)" << setw(14) << "(ns/elem)"
+         << setw(14) << "(ns/op)" << setw(14) << "(ns/op)" << endl;
+    vector<size_t> vSizes;
+    for (size_t uiCount = 1000; uiCount < uiMax; uiCount *= 10) {
+        vSizes.push_back(uiCount);
+    }
+    vSizes.push_back(uiMax);
+    for (size_t uiCount : vSizes) {
+        for (size_t i = 0; i < uiCount; i++) {
+            vElems[i].uiSeq = (uint32_t)i;
+        }
+        cout << left << setw(10) << uiCount << right << fixed << setprecision(1)
+             << setw(14) << fifo_sll(uiCount) << setw(14) << fifo_sllq(uiCount)
+             << setw(14) << concat_sll(uiCount) << setw(14) << concat_sllq(uiCount) << endl;
+    }
+    if (0 != uiBadOrder) {
+        cout << "ERROR: " << uiBadOrder << " elements out of order" << endl;
+    }
+    return ((0 == uiBadOrder) ? 0 : 2);
+}
+/* main */
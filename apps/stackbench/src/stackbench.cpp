@@ -0,0 +1,276 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+
+
+/**
+ * @file     stackbench.cpp
+ * @brief    Lock-free SLLS stack against an SLL behind a mutex, 1 to N threads
+ *
+ * A shared free list of nodes (NODES_PER_THREAD per thread). Every thread takes a node, marks it
+ * busy, clears the mark and gives it back, over and over, i.e. the free list traffic of a pool.
+ * Compared:
+ * - LOCKED   : SLL_ELEM_ADD and removal of the head under a PU_MUTEX_TYPE_FAST mutex
+ * - SLLS     : SLLS_POP and SLLS_PUSH
+ * - SLLS+ALL : as SLLS, but every 16th take is SLLS_POP_ALL, keeping the top node and giving the
+ *              rest back with one SLLS_PUSH_CHAIN (the steal-everything path)
+ * .
+ * Only takes that got a node count, one that finds the list empty (another thread holds all of
+ * them, mostly after an SLLS_POP_ALL) is not a pair. The busy mark is an atomic exchange: a node handed to two threads at once (an ABA failure)
+ * is counted, as is a node missing from the list at the end of a run.
+ *
+ * Usage: stackbench [threads] [iterations]
+ * - threads    : maximum number of threads (default 2 x CPUs)
+ * - iterations : take/give back pairs per thread (default 1000000)
+ * .
+ * The makefile targets the BBB cross compiler. For an x86 host run, override the tools:
+ * - make CC=gcc CPP=g++ STRIP=strip
+ * .
+ */
+
+/**** System includes, namespace, then local includes  ***********************/
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <cstdlib>
+#include <unistd.h>
+#include <pthread.h>
+#include "posutils.h"
+#include "sllstack.h"
+
+// namespace
+using namespace std;
+
+/**** Local (anonymous) namespace *******************************************/
+
+/**** Definitions ************************************************************/
+#define DEF_ITERATIONS   (1000000)
+#define NODES_PER_THREAD (4)
+#define POP_ALL_EVERY    (16)
+#define STACK_SIZE       (16*1024)
+
+typedef struct node_tag {
+    uint32_t uiBusy;
+    SLL_ENTRY(node_tag);
+}   node_t;
+
+// The free list under test
+typedef enum {
+    STACK_LOCKED = 0,
+    STACK_SLLS,
+    STACK_SLLS_ALL,
+    STACK_ENDDEF
+}   stack_kind_t;
+
+/**** Macros ****************************************************************/
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static void* bench_fct(void* pArg);
+static double run(stack_kind_t enKind, size_t uiThreads);
+
+/**** Static declarations ***************************************************/
+static const char*       aszNames[STACK_ENDDEF] = { "LOCKED", "SLLS", "SLLS+ALL" };
+static stack_kind_t      enStack;
+static size_t            uiIterations = DEF_ITERATIONS;
+static vector<node_t>    vNodes;
+static uint64_t          uiErrors     = 0;
+static uint64_t          uiPairs      = 0;
+static pthread_mutex_t   mtxList;
+static node_t*           pList        = NULL;
+static SLLS_HEAD(node_tag) stkList    = SLLS_INITIALIZER;
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+// Marks a node as taken, counts it if it already was
+static inline void take(node_t* pNode) {
+    if (0 != __atomic_exchange_n(&(pNode->uiBusy), 1u, __ATOMIC_RELAXED)) {
+        __atomic_add_fetch(&uiErrors, 1u, __ATOMIC_RELAXED);
+    }
+}
+
+static inline void give_back(node_t* pNode) {
+    __atomic_store_n(&(pNode->uiBusy), 0u, __ATOMIC_RELAXED);
+}
+
+// The contending thread, one switch per run rather than per iteration
+static void* bench_fct(void* pArg) {
+    node_t*  pNode;
+    node_t*  pRest;
+    node_t*  pLast;
+    uint64_t uiDone = 0;
+    (void)pArg;
+
+    switch (enStack) {
+        case STACK_LOCKED:
+            for (size_t i = 0; i < uiIterations; i++) {
+                pthread_mutex_lock(&mtxList);
+                pNode = pList;
+                if (NULL != pNode) {
+                    pList = pNode->pSllNextElem;
+                }
+                pthread_mutex_unlock(&mtxList);
+                if (NULL != pNode) {
+                    take(pNode);
+                    give_back(pNode);
+                    uiDone++;
+                    pthread_mutex_lock(&mtxList);
+                    SLL_ELEM_ADD(pList, pNode);
+                    pthread_mutex_unlock(&mtxList);
+                }
+            }
+            break;
+        case STACK_SLLS:
+            for (size_t i = 0; i < uiIterations; i++) {
+                SLLS_POP(stkList, pNode);
+                if (NULL != pNode) {
+                    take(pNode);
+                    give_back(pNode);
+                    uiDone++;
+                    SLLS_PUSH(stkList, pNode);
+                }
+            }
+            break;
+        case STACK_SLLS_ALL:
+        default:
+            for (size_t i = 0; i < uiIterations; i++) {
+                if (0 == (i % POP_ALL_EVERY)) {
+                    SLLS_POP_ALL(stkList, pNode);
+                    if (NULL != pNode) {
+                        pRest = pNode->pSllNextElem;
+                        if (NULL != pRest) {
+                            for (pLast = pRest; NULL != pLast->pSllNextElem; pLast = pLast->pSllNextElem) {}
+                            SLLS_PUSH_CHAIN(stkList, pRest, pLast);
+                        }
+                    }
+                } else {
+                    SLLS_POP(stkList, pNode);
+                }
+                if (NULL != pNode) {
+                    take(pNode);
+                    give_back(pNode);
+                    uiDone++;
+                    SLLS_PUSH(stkList, pNode);
+                }
+            }
+            break;
+    }
+    __atomic_add_fetch(&uiPairs, uiDone, __ATOMIC_RELAXED);
+    return (NULL);
+}
+
+// One stack kind, one thread count. Returns ns per take/give back pair (wall clock / pairs done,
+// a take that finds the list empty does not count)
+static double run(stack_kind_t enKind, size_t uiThreads) {
+    vector<pthread_t> vPids(uiThreads, 0);
+    pu_thread_attr_t  attr;
+    node_t*           pNode;
+    size_t            uiNodes = uiThreads * NODES_PER_THREAD;
+
+    pu_thread_attr_init(&attr);
+    attr.uiStackSize = STACK_SIZE;
+    enStack = enKind;
+    uiPairs = 0;
+    pList   = NULL;
+    SLLS_INIT(stkList);
+    for (size_t i = 0; i < uiNodes; i++) {
+        vNodes[i].uiBusy = 0;
+        if (STACK_LOCKED == enKind) {
+            SLL_ELEM_ADD(pList, &vNodes[i]);
+        } else {
+            SLLS_PUSH(stkList, &vNodes[i]);
+        }
+    }
+
+    auto tStart = chrono::steady_clock::now();
+    size_t uiCreated = pu_thread_create_many(bench_fct, NULL, uiThreads, &attr, "bench_fct", true, vPids.data());
+    for (size_t i = 0; i < uiCreated; i++) {
+        pu_thread_join(vPids[i], NULL);
+    }
+    chrono::duration<double> tElapsed = chrono::steady_clock::now() - tStart;
+    ASSERT(uiCreated == uiThreads);
+
+    // Every node is back on the list
+    size_t uiCount = 0;
+    if (STACK_LOCKED != enKind) {
+        SLLS_POP_ALL(stkList, pList);
+    }
+    SLL_FOR_EACH(pList, pNode) {
+        uiCount++;
+    }
+    uiErrors += (uiCount == uiNodes) ? 0u : 1u;
+    return ((uiPairs > 0) ? (tElapsed.count() * 1.0e9) / (double)uiPairs : 0.0);
+}
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * Main
+ * @param argc: argument count
+ * @param argv: [threads] [iterations]
+ * @return 0, 2 if a node was handed out twice or lost
+ */
+int main( int argc, char *argv[] )
+{
+    long   lCpus      = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t uiThreads  = (argc > 1) ? strtoul(argv[1], NULL, 0) : (size_t)((lCpus > 0) ? 2 * lCpus : 2);
+    uiIterations      = (argc > 2) ? strtoul(argv[2], NULL, 0) : DEF_ITERATIONS;
+
+    if ((0 == uiThreads) || (0 == uiIterations)) {
+        cout << "Usage: stackbench [threads] [iterations]" << endl;
+        return (1);
+    }
+    cout << "Free list benchmark: CPUs=" << lCpus << " iterations/thread=" << uiIterations
+         << ", ns per take/give back pair (wall clock)" << endl;
+    vNodes.resize(uiThreads * NODES_PER_THREAD);
+
+    int iRet = posutils_init();
+    ASSERT(0 == iRet);
+    if (0 == iRet) {
+        pu_mutex_create_type(&mtxList, PU_MUTEX_TYPE_FAST);
+
+        cout << left << setw(8) << "THREADS";
+        for (int k = 0; k < STACK_ENDDEF; k++) {
+            cout << right << setw(10) << aszNames[k];
+        }
+        cout << endl;
+
+        // 1, 2, 4, ... up to the maximum (which is always included)
+        for (size_t uiN = 1; uiN <= uiThreads; uiN = (uiN == uiThreads) ? uiN + 1 : min(uiN * 2, uiThreads)) {
+            cout << left << setw(8) << uiN << right << fixed << setprecision(1);
+            for (int k = 0; k < STACK_ENDDEF; k++) {
+                cout << setw(10) << run((stack_kind_t)k, uiN);
+            }
+            cout << endl;
+        }
+        pthread_mutex_destroy(&mtxList);
+    }
+    posutils_exit();
+
+    if (0 != uiErrors) {
+        cout << "ERROR: " << uiErrors << " nodes handed out twice or lost" << endl;
+    }
+    return ((0 == uiErrors) ? 0 : 2);
+}
+/* main */
@@ -82,13 +82,14 @@ int main( int argc, char *argv[] )
             ASSERT(0 != pThreadList[i]);
         }
 
-        // Wait for the threads to finish
-        for (i = 0; i < NUM_THREADS; i++) {
-            if (pThreadList[i] != 0) {
-                cout << "Waiting for thread: " << i << endl;
-                pthread_join(pThreadList[i], NULL);
-                cout << "Dead thread: " << i << endl;
-            }
+        // Wait for the threads to finish, the registry knows who they are
+        pu_thread_stop_t aReport[NUM_THREADS];
+        size_t           uiReport = NUM_THREADS;
+        cout << "Waiting for the threads" << endl;
+        pu_thread_join_all(1000, aReport, &uiReport);
+        for (size_t j = 0; j < uiReport; j++) {
+            cout << "Dead thread: tid=" << aReport[j].tid << " after " << aReport[j].uiStopNs / 1000 << "us"
+                 << ((PU_THREAD_STOP_JOINED == aReport[j].enHow) ? "" : " (cancelled)") << endl;
         }
     }
 
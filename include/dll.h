@@ -0,0 +1,277 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+
+/**
+ * @file     dll.h
+ * @author   Martin
+ * @date     2026-10-17
+ */
+#ifndef __DLL_H_
+#define __DLL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @brief Double Linked List macros
+ * @defgroup DLL Double Linked List macros
+ * @ingroup SYSUTILS
+ * The companion of the \ref SLL macros, for lists that elements leave from anywhere. Same idea:
+ * the links are a member of the structure (\ref DLL_ENTRY), no allocation, no container. With a
+ * previous pointer in every element and a tail pointer in the list, removing an element is O(1),
+ * where \ref SLL_ELEM_DEL has to search for the predecessor.
+ * @code
+ * // Structure with forward (tag) definition
+ * typedef struct my_struct_tag
+ * {
+ *     int iData;                 // Some data
+ *     DLL_ENTRY(my_struct_tag);  // The list links
+ * }   my_struct_t;
+ *
+ * // The list, initialised to empty
+ * static DLL_HEAD(my_struct_tag) MyList = DLL_INITIALIZER;
+ *
+ * void purge( void )
+ * {
+ *     my_struct_t* pElem;
+ *     my_struct_t* pNext;
+ *
+ *     // Remove every odd element, safe against the removal of the current one
+ *     DLL_FOR_EACH_SAFE( MyList, pElem, pNext )
+ *     {
+ *         if (pElem->iData & 1)
+ *         {
+ *             DLL_ELEM_DEL( MyList, pElem );
+ *             free( pElem );
+ *         }
+ *     }
+ * }
+ * @endcode
+ * Every DLL_HEAD is a distinct (anonymous) struct type. If lists are passed to functions,
+ * typedef it once: typedef DLL_HEAD(my_struct_tag) my_list_t;
+ *
+ * Unless NDEBUG is defined, \ref DLL_ELEM_DEL and \ref DLL_POP_HEAD poison the links of the
+ * removed element (\ref DLL_POISON_NEXT, \ref DLL_POISON_PREV). Deleting it a second time, or
+ * following its links, then faults on a recognisable address instead of corrupting the list.
+ *
+ * @{
+ */
+
+/**** Includes ***************************************************************/
+#include <stdint.h>
+
+/**** Definitions ************************************************************/
+
+/**
+ * Debug values for the links of a removed element, low addresses that are never mapped
+ */
+#define DLL_POISON_NEXT ((uintptr_t)0x100)
+#define DLL_POISON_PREV ((uintptr_t)0x200)
+
+/**
+ * The "next" and "previous" links, added to a structure to make it double-link-list-able
+ * @param[in] tag_type : The forward referenced "tag" type of the structure
+ *
+ * @note
+ * Different names from \ref SLL_ENTRY, so one structure can be on an SLL and a DLL at once
+ */
+#define DLL_ENTRY( tag_type ) struct tag_type* pDllNextElem; struct tag_type* pDllPrevElem
+
+/**
+ * The list: head and tail
+ * @param[in] tag_type : The forward referenced "tag" type of the elements
+ */
+#define DLL_HEAD( tag_type ) struct { struct tag_type* pDllHead; struct tag_type* pDllTail; }
+
+/**
+ * Static initialiser for an empty list
+ */
+#define DLL_INITIALIZER { NULL, NULL }
+
+/**
+ * Empties a list (the elements are not touched)
+ * @param[in] list : The list (not a pointer)
+ */
+#define DLL_INIT( list ) { (list).pDllHead = NULL; (list).pDllTail = NULL; }
+
+/**
+ * True if the list is empty
+ * @param[in] list : The list
+ */
+#define DLL_IS_EMPTY( list ) (NULL == (list).pDllHead)
+
+/**
+ * First, last, next and previous element, NULL at the ends
+ */
+#define DLL_FIRST( list ) ((list).pDllHead)
+#define DLL_LAST( list )  ((list).pDllTail)
+#define DLL_NEXT( elem )  ((elem)->pDllNextElem)
+#define DLL_PREV( elem )  ((elem)->pDllPrevElem)
+
+/* Poisons the links of an element that has just been removed, debug builds only */
+#if !defined(NDEBUG)
+    #define DLL_ELEM_POISON( elem ) {                                       \
+        (elem)->pDllNextElem = (__typeof__((elem)->pDllNextElem))DLL_POISON_NEXT; \
+        (elem)->pDllPrevElem = (__typeof__((elem)->pDllPrevElem))DLL_POISON_PREV; \
+    }
+#else
+    #define DLL_ELEM_POISON( elem ) {}
+#endif /* !defined(NDEBUG) */
+
+/**
+ * Adds an element to the head of the list, O(1)
+ * @param[in] list : The list
+ * @param[in] elem : The element to add (type*)
+ */
+#define DLL_ELEM_ADD( list, elem ) {            \
+    (elem)->pDllPrevElem = NULL;                \
+    (elem)->pDllNextElem = (list).pDllHead;     \
+    if (NULL == (list).pDllHead) {              \
+        (list).pDllTail = (elem);               \
+    } else {                                    \
+        (list).pDllHead->pDllPrevElem = (elem); \
+    }                                           \
+    (list).pDllHead = (elem);                   \
+}
+
+/**
+ * Adds an element to the tail of the list, O(1)
+ * @param[in] list : The list
+ * @param[in] elem : The element to add (type*)
+ */
+#define DLL_ELEM_ADD_TAIL( list, elem ) {       \
+    (elem)->pDllNextElem = NULL;                \
+    (elem)->pDllPrevElem = (list).pDllTail;     \
+    if (NULL == (list).pDllTail) {              \
+        (list).pDllHead = (elem);               \
+    } else {                                    \
+        (list).pDllTail->pDllNextElem = (elem); \
+    }                                           \
+    (list).pDllTail = (elem);                   \
+}
+
+/**
+ * Inserts an element after another one that is on the list, O(1)
+ * @param[in] list : The list
+ * @param[in] pos  : Element on the list
+ * @param[in] elem : The element to insert (type*)
+ */
+#define DLL_ELEM_INSERT_AFTER( list, pos, elem ) { \
+    (elem)->pDllPrevElem = (pos);               \
+    (elem)->pDllNextElem = (pos)->pDllNextElem; \
+    if (NULL == (pos)->pDllNextElem) {          \
+        (list).pDllTail = (elem);               \
+    } else {                                    \
+        (pos)->pDllNextElem->pDllPrevElem = (elem); \
+    }                                           \
+    (pos)->pDllNextElem = (elem);               \
+}
+
+/**
+ * Inserts an element before another one that is on the list, O(1)
+ * @param[in] list : The list
+ * @param[in] pos  : Element on the list
+ * @param[in] elem : The element to insert (type*)
+ */
+#define DLL_ELEM_INSERT_BEFORE( list, pos, elem ) { \
+    (elem)->pDllNextElem = (pos);               \
+    (elem)->pDllPrevElem = (pos)->pDllPrevElem; \
+    if (NULL == (pos)->pDllPrevElem) {          \
+        (list).pDllHead = (elem);               \
+    } else {                                    \
+        (pos)->pDllPrevElem->pDllNextElem = (elem); \
+    }                                           \
+    (pos)->pDllPrevElem = (elem);               \
+}
+
+/**
+ * Removes an element from the list, O(1)
+ * @param[in] list : The list
+ * @param[in] elem : The element to remove, \b must be on this list
+ *
+ * @par Description
+ * Unlike \ref SLL_ELEM_DEL there is no search, so there is no check either: removing an
+ * element that is not on the list corrupts it. Debug builds poison the links of the removed
+ * element, so a double removal faults right away.
+ */
+#define DLL_ELEM_DEL( list, elem ) {            \
+    if (NULL == (elem)->pDllPrevElem) {         \
+        (list).pDllHead = (elem)->pDllNextElem; \
+    } else {                                    \
+        (elem)->pDllPrevElem->pDllNextElem = (elem)->pDllNextElem; \
+    }                                           \
+    if (NULL == (elem)->pDllNextElem) {         \
+        (list).pDllTail = (elem)->pDllPrevElem; \
+    } else {                                    \
+        (elem)->pDllNextElem->pDllPrevElem = (elem)->pDllPrevElem; \
+    }                                           \
+    DLL_ELEM_POISON( elem );                    \
+}
+
+/**
+ * Takes the element at the head of the list, O(1)
+ * @param[in]  list : The list
+ * @param[out] elem : Set to the element, NULL if the list was empty
+ */
+#define DLL_POP_HEAD( list, elem ) {            \
+    (elem) = (list).pDllHead;                   \
+    if (NULL != (elem)) {                       \
+        DLL_ELEM_DEL( list, elem );             \
+    }                                           \
+}
+
+/**
+ * Used to iterate through all the elements in the list, head to tail
+ * @param[in] list : The list
+ * @param[in] temp : The temporary pointer for the current element
+ *
+ * @note The current element must not be removed, use \ref DLL_FOR_EACH_SAFE for that
+ */
+#define DLL_FOR_EACH( list, temp ) for ((temp) = (list).pDllHead; (temp) != NULL; (temp) = (temp)->pDllNextElem)
+
+/**
+ * Used to iterate through all the elements in the list, tail to head
+ * @param[in] list : The list
+ * @param[in] temp : The temporary pointer for the current element
+ */
+#define DLL_FOR_EACH_REVERSE( list, temp ) for ((temp) = (list).pDllTail; (temp) != NULL; (temp) = (temp)->pDllPrevElem)
+
+/**
+ * Iterates head to tail, the current element may be removed (and freed)
+ * @param[in] list : The list
+ * @param[in] temp : The temporary pointer for the current element
+ * @param[in] next : A second temporary, holds the next element before the loop body runs
+ */
+#define DLL_FOR_EACH_SAFE( list, temp, next )                                   \
+    for ((temp) = (list).pDllHead;                                              \
+         ((temp) != NULL) && (((next) = (temp)->pDllNextElem), 1);              \
+         (temp) = (next))
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __DLL_H_ */
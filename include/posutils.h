@@ -41,7 +41,12 @@ extern "C" {
 #include <errno.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
 #include "logging.h"
+#include "sll.h"
+#include "dll.h"
+#include "pumpsc.h"
 
 /**** Definitions ************************************************************/
 
@@ -67,13 +72,16 @@ int posutils_init( void );
  * @brief Closes (exits) the module
  *
  * @retval 0     Success
+ * @retval EBUSY Registered threads are still running, the module is left initialised
  * @retval non-0 Error
  *
  * @pre     None
- * @post    Module shuts down
+ * @post    Module shuts down, unless EBUSY is returned
  *
  * @par Description
- * Exits the module, cleans up any resources.
+ * Exits the module, cleans up any resources. Threads still running are stopped and joined
+ * first; pool workers and detached threads are not, destroy the pools and let detached threads
+ * finish before exiting.
  */
 int posutils_exit( void );
 
@@ -96,6 +104,18 @@ int posutils_exit( void );
  * These are used in scenarios where it is important to know where and when a deadlock occurs. A macro is provided
  * trap deadlocks (\ref PU_MUTEX_LOCK_ERROR). This macro throws a fatal log if a deadlock is detected.
  *
+ * @section pmtx_sect_2a Lock order checking
+ * EDEADLK only catches a thread locking a mutex it already holds. The real hangs are AB/BA bugs:
+ * one thread takes A then B, another takes B then A, and both block. In debug builds the error
+ * macros also record, per thread, which error mutexes are held. Locking B while holding A adds
+ * "A before B" to a global lock order graph, with both call sites. If the graph already allows
+ * B before A (directly or through other mutexes) the inversion is logged, with every call site,
+ * the first time it becomes possible, i.e. without the deadlock having to happen. Use
+ * \ref PU_MUTEX_DESTROY_ERROR so that a destroyed mutex is dropped from the graph.
+ *
+ * With NDEBUG defined all of this compiles out, the macros are the plain pthread calls plus the
+ * error checks (as with logging.h).
+ *
  * @section pmtx_sect_3 Recursive mutexes
  * Last and definitely least, a mutex may be created as a recursive mutex for scenarios where nesting may occur
  * and you want to avoid deadlock. A recursive mutex has the following characteristics:
@@ -108,6 +128,26 @@ int posutils_exit( void );
  * - poorly implemented logic
  * .
  *
+ * @section pmtx_sect_3a Adaptive mutexes
+ * For very short critical sections (a counter, a list insert) on a multi-core system an
+ * adaptive mutex (PTHREAD_MUTEX_ADAPTIVE_NP) spins for a while before going to sleep in the
+ * kernel. On a single core (like the BBB) it behaves like a fast mutex. For an even lighter lock
+ * see \ref pu_futex_mutex_t (pufutex.h).
+ *
+ * @section pmtx_sect_3b Priority inheritance and ceiling mutexes
+ * A mutex shared between an RT thread and lower priority threads can cause unbounded priority
+ * inversion: the RT thread waits for a low priority owner, which in turn never runs because a
+ * medium priority thread hogs the CPU. Two fixes:
+ * - \ref PU_MUTEX_TYPE_PI (PTHREAD_PRIO_INHERIT): the owner is boosted to the priority of the
+ *   highest waiter, only while somebody waits. Costs a system call on contention only.
+ * - \ref PU_MUTEX_TYPE_CEILING (PTHREAD_PRIO_PROTECT): the owner always runs at the ceiling
+ *   priority while it holds the mutex. The ceiling defaults to the maximum SCHED_FIFO priority,
+ *   use \ref pu_mutex_set_ceiling to lower it to the highest priority of its users. Every lock
+ *   and unlock changes the thread priority (system calls), and a thread above the ceiling
+ *   cannot lock it. Changing priority needs root or CAP_SYS_NICE.
+ * .
+ * See the "inversion" app for a measurement of both.
+ *
  * @section pmtx_sect_4 Mutex usage
  * The factory simply creates a standard Posix pthread mutex with some constraints. All the
  * mutex calls may be used as normal, i.e.:
@@ -116,6 +156,11 @@ int posutils_exit( void );
  * - \c pthread_mutex_trylock( pthread_mutex_t* )
  * .
  *
+ * @section pmtx_sect_5 Profiled mutexes
+ * To find out which mutexes are hot, wrap one in a \ref pu_mutex_prof_t and use the
+ * PU_MUTEX_PROF_xxx macros. Acquisitions, contended acquisitions, wait and (sampled) hold time
+ * histograms and call sites are recorded, and a ranked report is printed at \ref posutils_exit.
+ *
  * @{
  */
 
@@ -136,6 +181,9 @@ typedef enum
     PU_MUTEX_TYPE_FAST,     /*!< Default (timed) fast mutex       */
     PU_MUTEX_TYPE_ERROR,    /*!< Error mutex, to trap deadlocks   */
     PU_MUTEX_TYPE_RECURSIVE,/*!< Recursive, avoid like the plague */
+    PU_MUTEX_TYPE_ADAPTIVE, /*!< Spins briefly before sleeping    */
+    PU_MUTEX_TYPE_PI,       /*!< Priority inheritance             */
+    PU_MUTEX_TYPE_CEILING,  /*!< Priority ceiling (protect)       */
     PU_MUTEX_TYPE_ENDDEF    /* Enum terminator                    */
 }   pu_mutex_type;
 
@@ -175,6 +223,21 @@ int pu_mutex_create_type(
     pthread_mutex_t* pMtx,
     pu_mutex_type    enType );
 
+/**
+ * @brief   Sets the priority ceiling of a \ref PU_MUTEX_TYPE_CEILING mutex
+ *
+ * @param[in] pMtx      : Pointer to a ceiling mutex
+ * @param[in] iCeiling  : New ceiling (SCHED_FIFO priority)
+ * @retval  0 for success
+ * @retval  Non-zero (as pthread_mutex_setprioceiling) for failure
+ *
+ * @pre     The mutex is a ceiling mutex, not held by the caller
+ * @post    The ceiling is changed
+ */
+int pu_mutex_set_ceiling(
+    pthread_mutex_t* pMtx,
+    int              iCeiling );
+
 /**
  * @param pMtx: pointer to a mutex
  *
@@ -184,7 +247,7 @@ int pu_mutex_create_type(
  * @note
  * \b ONLY for use with the \ref PU_MUTEX_TYPE_ERROR mutex type
  */
-#define PU_MUTEX_LOCK_ERROR(pMtx) {if (EDEADLK == pthread_mutex_lock( pMtx )) {LOG_FATAL( "MUTEX DEADLOCK (0x%zu)\n", (size_t)(pMtx) );}}
+#define PU_MUTEX_LOCK_ERROR(pMtx) {PU_LOCKDEP_ACQUIRE( pMtx ); if (EDEADLK == pthread_mutex_lock( pMtx )) {LOG_FATAL( "MUTEX DEADLOCK (0x%zu)\n", (size_t)(pMtx) );}}
 
 /**
  * @param pMtx: pointer to a mutex
@@ -198,7 +261,70 @@ int pu_mutex_create_type(
  * @note
  * \b ONLY for use with the \ref PU_MUTEX_TYPE_ERROR mutex type
  */
-#define PU_MUTEX_UNLOCK_ERROR(pMtx) {if (EPERM == pthread_mutex_unlock( pMtx )) {LOG_FATAL("CANT UNLOCK MTX, NOT OWNER (0x%08x)\n", (size_t)(pMtx) );}}
+#define PU_MUTEX_UNLOCK_ERROR(pMtx) {if (EPERM == pthread_mutex_unlock( pMtx )) {LOG_FATAL("CANT UNLOCK MTX, NOT OWNER (0x%zx)\n", (size_t)(pMtx) );} PU_LOCKDEP_RELEASE( pMtx );}
+
+/**
+ * @param pMtx: pointer to a mutex
+ *
+ * @par Description
+ * Destroys an error checking mutex. In debug builds the mutex is also dropped from the lock order
+ * graph, so a new mutex at the same address does not inherit its history.
+ *
+ * @note
+ * \b ONLY for use with the \ref PU_MUTEX_TYPE_ERROR mutex type
+ */
+#define PU_MUTEX_DESTROY_ERROR(pMtx) {PU_LOCKDEP_FORGET( pMtx ); pthread_mutex_destroy( pMtx );}
+
+#if !defined(NDEBUG)
+/**
+ * @brief   Lock order checking: records that the caller is about to lock an error mutex
+ *
+ * @param[in] pMtx   : The mutex
+ * @param[in] szFile : Call site
+ * @param[in] iLine  : Call site
+ *
+ * @pre     The mutex is not held by the caller (holding it is reported as EDEADLK anyway)
+ * @post    The mutex is on the caller's held list, and every "held -> pMtx" order is in the graph
+ *
+ * @par Description
+ * Called by \ref PU_MUTEX_LOCK_ERROR in debug builds, see \ref pmtx_sect_2a. A new order that
+ * closes a cycle in the graph is logged with every call site on the cycle.
+ */
+void pu_lockdep_acquire(
+    const void* pMtx,
+    const char* szFile,
+    int         iLine );
+
+/**
+ * @brief   Lock order checking: records that the caller unlocked an error mutex
+ * @param[in] pMtx : The mutex
+ */
+void pu_lockdep_release( const void* pMtx );
+
+/**
+ * @brief   Lock order checking: drops a mutex that is about to be destroyed from the graph
+ * @param[in] pMtx : The mutex
+ *
+ * @par Description
+ * Called by \ref PU_MUTEX_DESTROY_ERROR. Every order involving the mutex goes, so a mutex
+ * created later at the same address is not blamed for the old one's history.
+ */
+void pu_lockdep_forget( const void* pMtx );
+
+/**
+ * @brief   Number of lock order inversions reported so far
+ * @retval  The count
+ */
+size_t pu_lockdep_get_number_of_cycles( void );
+
+#define PU_LOCKDEP_ACQUIRE(pMtx) pu_lockdep_acquire( (pMtx), __FILE__, __LINE__ )
+#define PU_LOCKDEP_RELEASE(pMtx) pu_lockdep_release( (pMtx) )
+#define PU_LOCKDEP_FORGET(pMtx)  pu_lockdep_forget( (pMtx) )
+#else
+#define PU_LOCKDEP_ACQUIRE(pMtx) ((void)0)
+#define PU_LOCKDEP_RELEASE(pMtx) ((void)0)
+#define PU_LOCKDEP_FORGET(pMtx)  ((void)0)
+#endif /* !defined(NDEBUG) */
 
 /**
  * @deprecated This macro is retained for backwards compatibility. Use \ref pu_mutex_create_type
@@ -236,6 +362,220 @@ int pu_mutex_create_type(
  */
 #define pu_mutex_create( pMtx, bRecursive ) (pu_mutex_create_type(pMtx,(true == bRecursive ? PU_MUTEX_TYPE_RECURSIVE : PU_MUTEX_TYPE_FAST)))
 
+/**
+ * @brief Number of log2 (ns) buckets in the profiled mutex histograms, the last is 2^31 ns and up
+ */
+#define PU_MUTEX_PROF_BUCKETS (32)
+
+/**
+ * @brief One in this many acquisitions of a profiled mutex has its hold time measured (power of 2)
+ */
+#if !defined(PU_MUTEX_PROF_SAMPLE)
+    #define PU_MUTEX_PROF_SAMPLE (16)
+#endif /* !defined(PU_MUTEX_PROF_SAMPLE) */
+
+/**
+ * @brief A profiled (instrumented) mutex
+ *
+ * @par Description
+ * A pthread mutex plus contention statistics. The statistics are only written while the mutex
+ * is held, so they need no atomics. Treat the structure as opaque, use \ref pu_mutex_prof_dump.
+ */
+typedef struct pu_mutex_prof_tag
+{
+    pthread_mutex_t mtx;                                /*!< The mutex itself                 */
+    const char*     szName;                             /*!< Name (persistent)                */
+    const char*     szFile;                             /*!< Creation site                    */
+    int             iLine;                              /*!< Creation site                    */
+    const char*     szLockFile;                         /*!< Site of the current/last lock    */
+    int             iLockLine;                          /*!< Site of the current/last lock    */
+    const char*     szMaxWaitFile;                      /*!< Site of the longest wait         */
+    int             iMaxWaitLine;                       /*!< Site of the longest wait         */
+    const char*     szMaxHoldFile;                      /*!< Site of the longest (sampled) hold */
+    int             iMaxHoldLine;                       /*!< Site of the longest (sampled) hold */
+    uint64_t        uiLockNs;                           /*!< Lock time if sampled, else 0     */
+    uint64_t        uiAcquired;                         /*!< Acquisitions                     */
+    uint64_t        uiContended;                        /*!< Acquisitions that had to wait    */
+    uint64_t        uiWaitNs;                           /*!< Total wait time                  */
+    uint64_t        uiMaxWaitNs;                        /*!< Longest wait                     */
+    uint64_t        uiHoldNs;                           /*!< Total sampled hold time          */
+    uint64_t        uiHoldSamples;                      /*!< Number of hold samples           */
+    uint64_t        uiMaxHoldNs;                        /*!< Longest sampled hold             */
+    uint32_t        aWaitHist[PU_MUTEX_PROF_BUCKETS];   /*!< Wait time histogram (log2 ns)    */
+    uint32_t        aHoldHist[PU_MUTEX_PROF_BUCKETS];   /*!< Hold time histogram (log2 ns)    */
+    DLL_ENTRY(pu_mutex_prof_tag);                       /*!< All profiled mutexes             */
+}   pu_mutex_prof_t;
+
+/**
+ * @brief   Creates a profiled mutex
+ *
+ * @param[in] pMtx   : Profiled mutex
+ * @param[in] enType : Type of the underlying mutex
+ * @param[in] szName : Name for the report, \b MUST be persistent
+ * @param[in] szFile : Creation site
+ * @param[in] iLine  : Creation site
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ *
+ * @pre     The mutex pointer and name are non-null
+ * @post    The mutex is initialised and in the report
+ *
+ * @par Description
+ * Use the macros, \ref PU_MUTEX_PROF_CREATE, \ref PU_MUTEX_PROF_LOCK and
+ * \ref PU_MUTEX_PROF_UNLOCK. The cost on top of a plain mutex is small enough to leave on in
+ * production:
+ * - uncontended: a trylock instead of a lock, a counter, and one clock read per unlock in
+ *   \ref PU_MUTEX_PROF_SAMPLE (hold time sampling)
+ * - contended: two clock reads, but the caller was going to sleep anyway
+ * .
+ * The ranked report (\ref pu_mutex_prof_dump) is printed at \ref posutils_exit.
+ * @code
+ * static pu_mutex_prof_t mtxTable;
+ * PU_MUTEX_PROF_CREATE( &mtxTable, PU_MUTEX_TYPE_FAST );
+ * PU_MUTEX_PROF_LOCK( &mtxTable );
+ * // ...
+ * PU_MUTEX_PROF_UNLOCK( &mtxTable );
+ * @endcode
+ */
+int pu_mutex_prof_create(
+    pu_mutex_prof_t* pMtx,
+    pu_mutex_type    enType,
+    const char*      szName,
+    const char*      szFile,
+    int              iLine );
+
+/**
+ * @brief   Destroys a profiled mutex and takes it out of the report
+ *
+ * @param[in] pMtx : Profiled mutex
+ * @retval  0 for success
+ * @retval  Non-zero (as pthread_mutex_destroy) for failure
+ */
+int pu_mutex_prof_destroy( pu_mutex_prof_t* pMtx );
+
+/**
+ * @brief   Locks a profiled mutex, use \ref PU_MUTEX_PROF_LOCK
+ *
+ * @param[in] pMtx   : Profiled mutex
+ * @param[in] szFile : Call site
+ * @param[in] iLine  : Call site
+ * @retval  0 for success
+ * @retval  Non-zero (as pthread_mutex_lock) for failure
+ */
+int pu_mutex_prof_lock_at(
+    pu_mutex_prof_t* pMtx,
+    const char*      szFile,
+    int              iLine );
+
+/**
+ * @brief   Unlocks a profiled mutex
+ *
+ * @param[in] pMtx : Profiled mutex
+ * @retval  0 for success
+ * @retval  Non-zero (as pthread_mutex_unlock) for failure
+ */
+int pu_mutex_prof_unlock( pu_mutex_prof_t* pMtx );
+
+/**
+ * @brief   Prints the profiled mutexes, most contended (total wait time) first
+ *
+ * @param[in] pOut  : Output stream, NULL for stdout
+ * @param[in] uiMax : Maximum number of mutexes, 0 for all
+ *
+ * @pre     The caller holds none of the profiled mutexes
+ *
+ * @par Description
+ * Each mutex is taken briefly to copy its statistics, so the counters are consistent.
+ * Percentiles come from the log2 histograms, they are upper bounds (power of 2 ns) capped at
+ * the maximum, so WAIT99 never exceeds WAITMAX.
+ */
+void pu_mutex_prof_dump(
+    FILE*  pOut,
+    size_t uiMax );
+
+/**
+ * @brief Creates a profiled mutex named after the variable, with the call site
+ * @param[in] pMtx_ : Pointer to a \ref pu_mutex_prof_t
+ * @param[in] type_ : \ref pu_mutex_type
+ */
+#define PU_MUTEX_PROF_CREATE(pMtx_,type_) pu_mutex_prof_create( (pMtx_), (type_), #pMtx_, __FILE__, __LINE__ )
+
+/**
+ * @brief Locks a profiled mutex, recording the call site
+ * @param[in] pMtx_ : Pointer to a \ref pu_mutex_prof_t
+ */
+#define PU_MUTEX_PROF_LOCK(pMtx_) pu_mutex_prof_lock_at( (pMtx_), __FILE__, __LINE__ )
+
+/**
+ * @brief Unlocks a profiled mutex
+ * @param[in] pMtx_ : Pointer to a \ref pu_mutex_prof_t
+ */
+#define PU_MUTEX_PROF_UNLOCK(pMtx_) pu_mutex_prof_unlock( (pMtx_) )
+
+/**
+ * @}
+ */
+
+/*===========================================================================*/
+/* POSIX READER-WRITER LOCK FUNCTIONS                                        */
+/*===========================================================================*/
+/**
+ * @defgroup PRWL Posix reader-writer lock utility
+ * @ingroup  SYSUTILS
+ *
+ * @brief
+ * A factory for pthread reader-writer locks, the rwlock counterpart of \ref PMTX.
+ *
+ * @section prwl_sect_1 When to use a rwlock
+ * For read-mostly shared state (line configuration, a registry) that many threads read at the
+ * same time. A rwlock is \b NOT free: every reader still writes the lock word, so on a multi-core
+ * system the readers bounce one cache line between them. For a small, often read structure a
+ * seqlock (\ref pu_seqlock_t, puseqlock.h) is cheaper, readers write nothing at all.
+ *
+ * @section prwl_sect_2 Preference
+ * - \ref PU_RWLOCK_TYPE_READER: the pthread default. A new reader gets in while a writer waits,
+ *   so a steady stream of readers can starve the writers forever.
+ * - \ref PU_RWLOCK_TYPE_WRITER: a waiting writer blocks new readers. Writers cannot starve, but
+ *   a thread must \b never take a read lock it already holds (recursively): if a writer arrives
+ *   in between, the second read lock deadlocks.
+ * .
+ *
+ * @section prwl_sect_3 Usage
+ * All the pthread calls may be used as normal, i.e. \c pthread_rwlock_rdlock,
+ * \c pthread_rwlock_wrlock, \c pthread_rwlock_unlock and \c pthread_rwlock_destroy.
+ * See the "rwbench" app for a comparison with a mutex and a seqlock.
+ *
+ * @{
+ */
+
+/**
+ * @brief Reader-writer lock types supported
+ */
+typedef enum
+{
+    PU_RWLOCK_TYPE_READER,  /*!< Default, readers first (writers may starve)     */
+    PU_RWLOCK_TYPE_WRITER,  /*!< Writers first, read locks must not be recursive */
+    PU_RWLOCK_TYPE_ENDDEF   /* Enum terminator                                   */
+}   pu_rwlock_type;
+
+/**
+ * @brief   Creates (initialises) a reader-writer lock of the specified type
+ *
+ * @param[in] pRwl   : Pointer to a valid rwlock
+ * @param[in] enType : Lock type
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ *
+ * @pre     The rwlock pointer is non-null
+ * @post    The rwlock is initialised
+ *
+ * @par Description
+ * Creates a standard Posix pthread rwlock (process private).
+ */
+int pu_rwlock_create_type(
+    pthread_rwlock_t* pRwl,
+    pu_rwlock_type    enType );
+
 /**
  * @}
  */
@@ -249,19 +589,33 @@ int pu_mutex_create_type(
  * @ingroup  SYSUTILS
  * This is a factory that produces Posix pthreads. It handles the multiple creation
  * steps internally, and constrains various options, like:
- * - scheduling scheme (SCHED_OTHER)
+ * - scheduling scheme (SCHED_OTHER, unless explicit attributes are given)
  * - fixed stack sizes
  * - guards for dumb systems (like uClibc)
  * .
  *
  * @par Pthread usage
- * The factory creates a standard Posix pthread with some constraints. All the
- * thread calls (\c pthread_xxx()) may be used as normal.
+ * The factory creates a standard Posix pthread with some constraints. The thread calls
+ * (\c pthread_xxx()) may be used as normal, except for the end of its life: a pu_thread
+ * \b MUST be joined with \ref pu_thread_join (or \ref pu_thread_join_all) or detached with
+ * \ref pu_thread_detach. A raw \c pthread_join() or \c pthread_detach() leaks its registry
+ * slot (and a cached stack).
  *
  * @par Thread lists
- * The factory keeps (on a per process basis) a list of all the threads. As they are created
- * they are added to the list, as they exit they are moved from the list. This list can
- * iterated through. This allows for things like debug and graceful shutdown.
+ * The factory keeps (on a per process basis) a registry of all the threads. As they are created
+ * they are added to the registry, as they are joined (or exit, if detached) they are removed
+ * from it. Both are O(1): the
+ * registry is a fixed array of slots (\ref PU_THREAD_MAX_THREADS) and a stack of free slot
+ * indices. The registry can be iterated through without locking (\ref pu_thread_for_each).
+ * This allows for things like debug and graceful shutdown.
+ *
+ * @par Mailboxes
+ * Every pu_thread has a mailbox. Other threads find it by name or tid (\ref pu_thread_lookup_name,
+ * \ref pu_thread_lookup_tid, O(1) hash indices over the registry) and post messages to it
+ * (\ref pu_thread_post); the thread takes them out with \ref pu_thread_receive. A message is
+ * a user struct with a \ref pu_msg_t header, posting hands over the pointer and with it the
+ * ownership, nothing is copied. Posting is lock-free, a post to a thread that has exited fails
+ * cleanly (the sender keeps the message).
  *
  * @{
  */
@@ -299,7 +653,8 @@ typedef void* (*pu_thread_fct_t)( void* pArg );
  *
  * @par Description
  * Creates a standard pthread (SCHED_OTHER) with the passed in parameters. The stack size will be
- * rounded up to the nearest multiple of the page size, i.e. (n * 4k).
+ * rounded up to the nearest multiple of the page size, i.e. (n * 4k). For RT threads (or CPU
+ * affinity) use \ref pu_thread_create_attr.
  *
  * @par Exit handling
  * The are two main ways a thread can exit. It can terminate on its own either by simply coming to
@@ -349,6 +704,394 @@ pthread_t pu_thread_create(
         (stack_size_),                                     \
         #mainfct_)
 
+/**
+ * @brief Thread creation attributes, see \ref pu_thread_create_attr
+ *
+ * Always start from \ref pu_thread_attr_init, then change what you need. The defaults are what
+ * \ref pu_thread_create uses, i.e. SCHED_OTHER, no affinity, nothing locked.
+ */
+typedef struct
+{
+    size_t   uiStackSize;                    /*!< Stack size (see \ref pu_thread_create)            */
+    int      iPolicy;                        /*!< SCHED_OTHER, SCHED_FIFO or SCHED_RR               */
+    int      iPriority;                      /*!< 0 for SCHED_OTHER, 1..99 for SCHED_FIFO/RR        */
+    uint32_t uiCpuMask;                      /*!< Bit n = may run on CPU n, 0 = no affinity         */
+    bool     bInheritSched;                  /*!< Take policy/priority from the creator instead     */
+    bool     bMlock;                         /*!< Lock the thread stack into RAM (needs privileges) */
+    bool     bPrefault;                      /*!< Touch every stack page before main is called      */
+    bool     bOwned;                         /*!< Joined by its creator, \ref pu_thread_join_all skips it */
+}   pu_thread_attr_t;
+
+/**
+ * @brief   Sets thread attributes to the defaults
+ *
+ * @param[out] pAttr : Attributes to initialise
+ *
+ * @pre     The attribute pointer is non-NULL
+ * @post    The attributes describe a default (non-RT) pu_thread
+ */
+void pu_thread_attr_init( pu_thread_attr_t* pAttr );
+
+/**
+ * @brief   Creates a pthread with explicit attributes, e.g. an RT thread
+ *
+ * @param[in] fctMain  : Thread main function (entry point)
+ * @param[in] pMainArg : Argument for main
+ * @param[in] pAttr    : Thread attributes
+ * @param[in] szName   : Thread name, \b MUST be persistent
+ * @retval  A non-zero pthread ID indicates success
+ * @retval  A zero pthread ID means failure
+ *
+ * @pre     The entry function (main) is non-NULL
+ * @pre     The attributes are non-NULL and initialised with \ref pu_thread_attr_init
+ * @pre     The name is non-NULL
+ * @post    The pthread is created.
+ *
+ * @par Description
+ * Same as \ref pu_thread_create (stack rounding, registry, exit handling), plus:
+ * - explicit scheduling policy and priority (PTHREAD_EXPLICIT_SCHED), or inherited from the creator
+ * - CPU affinity
+ * - the stack can be locked (mlock) and/or pre-faulted by the new thread before main is called,
+ *   so the first pass of an RT loop does not take page faults
+ * .
+ * SCHED_FIFO/SCHED_RR need root or CAP_SYS_NICE (or an RLIMIT_RTPRIO). Without them creation fails
+ * and 0 is returned, it does \b NOT silently fall back to SCHED_OTHER.
+ * @code
+ * pu_thread_attr_t attr;
+ * pu_thread_attr_init( &attr );
+ * attr.uiStackSize = 16*1024;
+ * attr.iPolicy     = SCHED_FIFO;
+ * attr.iPriority   = 80;
+ * attr.bMlock      = true;
+ * attr.bPrefault   = true;
+ * pid = PU_THREAD_CREATE_ATTR( sample_main, pLine, &attr );
+ * @endcode
+ */
+pthread_t pu_thread_create_attr(
+    pu_thread_fct_t         fctMain,
+    void*                   pMainArg,
+    const pu_thread_attr_t* pAttr,
+    const char*             szName );
+
+/**
+ * @brief   Creates an automatically named pthread with explicit attributes
+ *
+ * @param[in] mainfct_ : Thread main function (entry point)
+ * @param[in] mainarg_ : Main argument
+ * @param[in] attr_    : Pointer to the thread attributes
+ * @see pu_thread_create_attr
+ */
+#define PU_THREAD_CREATE_ATTR(mainfct_,mainarg_,attr_)     \
+    pu_thread_create_attr(                                 \
+        (mainfct_),(mainarg_),                             \
+        (attr_),                                           \
+        #mainfct_)
+
+/**
+ * @brief   Creates a batch of identical pthreads, optionally starting them together
+ *
+ * @param[in]  fctMain       : Thread main function (entry point)
+ * @param[in]  apMainArgs    : One argument per thread, NULL passes NULL to all of them
+ * @param[in]  uiCount       : Number of threads (at most \ref PU_THREAD_MAX_THREADS)
+ * @param[in]  pAttr         : Thread attributes, shared by all threads
+ * @param[in]  szName        : Thread name, shared by all threads
+ * @param[in]  bStartBarrier : Hold every thread back until all of them are created
+ * @param[out] aPids         : Array of uiCount Posix thread IDs, zero for the ones not created
+ * @return  Number of threads created, their IDs are at the front of aPids
+ *
+ * @pre     The entry function (main) is non-NULL
+ * @pre     The name, attributes and ID array are non-NULL
+ * @post    Up to uiCount pthreads are created
+ *
+ * @par Description
+ * Same as calling \ref pu_thread_create_attr uiCount times, but cheaper: the pthread attributes
+ * are built once and all registry slots are reserved in a single critical section. Creation
+ * stops at the first failure. With bStartBarrier set no thread enters main until the call
+ * returns, so they all begin work at the same instant. Join each thread with
+ * \ref pu_thread_join.
+ */
+size_t pu_thread_create_many(
+    pu_thread_fct_t         fctMain,
+    void* const*            apMainArgs,
+    size_t                  uiCount,
+    const pu_thread_attr_t* pAttr,
+    const char*             szName,
+    bool                    bStartBarrier,
+    pthread_t*              aPids );
+
+/**
+ * @brief   Creates an automatically named batch of pthreads
+ *
+ * @param[in]  mainfct_ : Thread main function (entry point)
+ * @param[in]  args_    : Array of arguments, or NULL
+ * @param[in]  count_   : Number of threads
+ * @param[in]  attr_    : Pointer to the thread attributes
+ * @param[in]  barrier_ : Start all threads together
+ * @param[out] pids_    : Array of thread IDs
+ * @see pu_thread_create_many
+ */
+#define PU_THREAD_CREATE_MANY(mainfct_,args_,count_,attr_,barrier_,pids_) \
+    pu_thread_create_many(                                 \
+        (mainfct_),(args_),(count_),                       \
+        (attr_),                                           \
+        #mainfct_,                                         \
+        (barrier_),(pids_))
+
+/**
+ * @brief   Joins a pu_thread, recycles its stack if it came from the cache
+ *
+ * @param[in]  pid   : Posix thread ID, as returned by \ref pu_thread_create
+ * @param[out] ppRet : Thread return value, may be NULL
+ * @retval  0 for success
+ * @retval  Non-zero (as pthread_join) for failure
+ *
+ * @pre     The thread is joinable and not yet joined
+ * @post    The thread is joined
+ *
+ * @par Description
+ * Drop in replacement for \c pthread_join(). pu_threads \b MUST be joined with this call (or
+ * \ref pu_thread_join_all) or detached with \ref pu_thread_detach, never with a raw
+ * \c pthread_join() or \c pthread_detach():
+ * - an exited thread keeps its registry slot until it is joined here, so the join-all at
+ *   \ref posutils_exit can catch threads nobody joined
+ * - a cached stack is only recycled (or unmapped) here
+ * .
+ * @see pu_thread_cache_prewarm
+ */
+int pu_thread_join(
+    pthread_t pid,
+    void**    ppRet );
+
+/**
+ * @brief   Detaches a pu_thread
+ *
+ * @param[in] pid : Posix thread ID, as returned by \ref pu_thread_create
+ * @retval  0 for success
+ * @retval  EINVAL if the thread runs on a cached stack, it must be joined
+ * @retval  Non-zero (as pthread_detach) for failure
+ *
+ * @pre     The thread is joinable and not yet joined
+ * @post    The thread is detached, its registry slot is freed when it exits (or now, if it
+ *          already has). \ref pu_thread_join_all skips it
+ *
+ * @par Description
+ * Drop in replacement for \c pthread_detach(), a thread may detach itself.
+ */
+int pu_thread_detach( pthread_t pid );
+
+/**
+ * @brief How a thread stopped, see \ref pu_thread_join_all
+ */
+typedef enum
+{
+    PU_THREAD_STOP_JOINED = 0,               /*!< Stopped on its own (stop token)   */
+    PU_THREAD_STOP_CANCELLED,                /*!< Cancelled after the deadline      */
+    PU_THREAD_STOP_STUCK,                    /*!< Still running                     */
+    PU_THREAD_STOP_ENDDEF
+}   pu_thread_stop_how_t;
+
+/**
+ * @brief Per thread shutdown report, see \ref pu_thread_join_all
+ */
+typedef struct
+{
+    const char*          szName;             /*!< Thread name (persistent)          */
+    pthread_t            pid;                /*!< Posix thread ID                   */
+    pid_t                tid;                /*!< Linux thread ID                   */
+    uint64_t             uiStopNs;           /*!< Time from the stop request (ns)   */
+    pu_thread_stop_how_t enHow;              /*!< How it stopped                    */
+}   pu_thread_stop_t;
+
+/**
+ * @brief Time \ref posutils_exit allows threads that are still running to stop
+ */
+#if !defined(PU_THREAD_EXIT_TIMEOUT_MS)
+    #define PU_THREAD_EXIT_TIMEOUT_MS (500)
+#endif /* !defined(PU_THREAD_EXIT_TIMEOUT_MS) */
+
+/**
+ * @brief Checks the stop token of the calling thread
+ *
+ * @return true if the thread has been asked to stop
+ *
+ * @pre       None
+ * @post      None
+ * @invariant None
+ *
+ * @par Description
+ * Cooperative shutdown: a long running thread polls this in its main loop and returns when it
+ * is set. Cheap, a couple of atomic loads. A thread that is not a pu_thread only sees
+ * \ref pu_thread_request_stop_all, and only until \ref pu_thread_join_all returns.
+ */
+bool pu_thread_stop_requested( void );
+
+/**
+ * @brief Asks one thread to stop
+ *
+ * @param[in] pid : Posix thread ID
+ * @retval 0 for success
+ * @retval ENOENT the thread is not registered (or has already exited)
+ *
+ * @pre       None
+ * @post      \ref pu_thread_stop_requested returns true in that thread
+ * @invariant None
+ */
+int pu_thread_request_stop( pthread_t pid );
+
+/**
+ * @brief Asks every thread to stop, including threads created after the call
+ *
+ * @pre       None
+ * @post      \ref pu_thread_stop_requested returns true in every registered thread, and in
+ *            every other thread until \ref pu_thread_join_all returns
+ * @invariant None
+ */
+void pu_thread_request_stop_all( void );
+
+/**
+ * @brief Stops and joins every registered thread, with a deadline
+ *
+ * @param[in]     uiTimeoutMs : Time allowed for a cooperative stop
+ * @param[out]    aReport     : Per thread report, may be NULL
+ * @param[in,out] puiReport   : In: size of aReport, out: number of entries filled in. May be NULL
+ * @retval 0 all threads have stopped
+ * @retval EBUSY some threads could not be stopped
+ *
+ * @pre       No other thread is joining (or will join) the registered threads, other than the
+ *            ones created with \ref pu_thread_attr_t::bOwned set
+ * @post      The registry is empty (owned threads aside), unless EBUSY is returned
+ * @invariant None
+ *
+ * @par Description
+ * Replaces the hand rolled pthread_join() loop at the end of an app:
+ * 1. Every stop token is set and the threads are joined until the deadline
+ * 2. The stragglers are cancelled, the exit handler cleans up after them, and they get a short
+ *    grace period to go. A straggler asleep on a posutils object (mutex, ring, mailbox, ...) is
+ *    not cancelled, it would take the object down with it
+ * 3. Anything still running is reported as stuck, it is left joinable
+ * .
+ * The calling thread is skipped if it is a pu_thread itself. Owned threads (e.g. pool workers)
+ * are skipped too: their stop token is set, but their owner joins them. The report has the time
+ * each thread took to stop, measured from the call. On return the stop-all flag is cleared,
+ * threads created afterwards start with a clear stop token.
+ * @code
+ * pu_thread_stop_t aReport[8];
+ * size_t           uiReport = 8;
+ * pu_thread_join_all( 200, aReport, &uiReport );
+ * @endcode
+ */
+int pu_thread_join_all(
+    uint32_t          uiTimeoutMs,
+    pu_thread_stop_t* aReport,
+    size_t*           puiReport );
+
+/**
+ * @brief Maximum number of cached stacks per stack size
+ *
+ * Stacks returned to a full bucket are simply unmapped.
+ */
+#if !defined(PU_THREAD_CACHE_MAX_STACKS)
+    #define PU_THREAD_CACHE_MAX_STACKS (32)
+#endif /* !defined(PU_THREAD_CACHE_MAX_STACKS) */
+
+/**
+ * @brief Stack and context cache counters
+ */
+typedef struct
+{
+    size_t uiStackHits;                      /*!< Stacks taken from the cache       */
+    size_t uiStackMisses;                    /*!< Stacks that had to be mapped      */
+    size_t uiStacksCached;                   /*!< Stacks currently in the cache     */
+    size_t uiContextHits;                    /*!< Contexts taken from the pool      */
+    size_t uiContextMisses;                  /*!< Context allocations that grew the pool */
+    size_t uiContextsCached;                 /*!< Free contexts in the pool         */
+}   pu_thread_cache_stats_t;
+
+/**
+ * @brief   Prewarms the stack and context cache, enables the cache
+ *
+ * @param[in] uiStackSize : Stack size, exactly as it will be passed to \ref pu_thread_create
+ * @param[in] uiCount     : Number of stacks to have ready (capped at \ref PU_THREAD_CACHE_MAX_STACKS)
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ *
+ * @pre     None
+ * @post    The cache is enabled
+ *
+ * @par Description
+ * Thread creation cost is dominated by glibc mapping a fresh stack and guard page, then the new
+ * thread faulting it in. With the cache enabled posutils maps the stacks itself:
+ * - each stack has a guard page and is pre-faulted
+ * - stacks are bucketed by the page rounded stack size
+ * - a stack goes back to its bucket when the thread is joined with \ref pu_thread_join
+ * - thread contexts are recycled as soon as the thread exits
+ * .
+ * Contexts come from a block pool (see \ref PBPOOL) whether or not the cache is enabled; the
+ * prewarm just makes sure the pool has uiCount of them committed.
+ * If called before \ref posutils_init the prewarm is done during init, so the allocation cost
+ * is paid at start up:
+ * @code
+ * pu_thread_cache_prewarm( 16*1024, 8 );
+ * posutils_init();
+ * @endcode
+ */
+int pu_thread_cache_prewarm(
+    size_t uiStackSize,
+    size_t uiCount );
+
+/**
+ * @brief   Enables or disables the stack and context cache
+ *
+ * @param[in] bEnable : true to enable
+ *
+ * @par Description
+ * The cache is disabled by default, \ref pu_thread_cache_prewarm enables it. Stacks that are
+ * already out are still unmapped by \ref pu_thread_join after a disable, the registry remembers
+ * which stacks came from the cache.
+ */
+void pu_thread_cache_enable( bool bEnable );
+
+/**
+ * @brief   Gets the stack and context cache counters
+ *
+ * @param[out] pStats : Filled in with a copy of the counters
+ */
+void pu_thread_cache_get_stats( pu_thread_cache_stats_t* pStats );
+
+/**
+ * @brief Maximum number of concurrently registered pu_threads
+ *
+ * The registry is a fixed array of slots, insert and remove are O(1). Override at build time
+ * (-DPU_THREAD_MAX_THREADS=n) if you need more.
+ */
+#if !defined(PU_THREAD_MAX_THREADS)
+    #define PU_THREAD_MAX_THREADS (256)
+#endif /* !defined(PU_THREAD_MAX_THREADS) */
+
+/**
+ * @brief Snapshot of a registered thread, as seen by \ref pu_thread_for_each
+ */
+typedef struct
+{
+    const char* szName;                      /*!< Thread name (persistent)          */
+    pthread_t   pid;                         /*!< Posix thread ID                   */
+    pid_t       tid;                         /*!< Linux thread ID                   */
+    uint64_t    uiStartNs;                   /*!< CLOCK_MONOTONIC (ns) at start     */
+    const void* pBlockedOn;                  /*!< Futex object slept on, or NULL    */
+    const char* szBlockedOn;                 /*!< Kind of that object, or NULL      */
+    uint64_t    uiBlockedNs;                 /*!< CLOCK_MONOTONIC (ns) it went to sleep */
+}   pu_thread_info_t;
+
+/**
+ * @brief   Iteration callback for \ref pu_thread_for_each
+ *
+ * @param[in] pInfo : Thread info, only valid for the duration of the call
+ * @param[in] pArg  : User argument
+ * @retval  true to continue
+ * @retval  false to stop the iteration
+ */
+typedef bool (*pu_thread_iter_fct_t)( const pu_thread_info_t* pInfo, void* pArg );
+
 /**
  * @brief Gets the number of threads running
  *
@@ -364,6 +1107,425 @@ pthread_t pu_thread_create(
  */
 size_t pu_thread_get_number_of_threads( void );
 
+/**
+ * @brief Calls a function for every registered thread
+ *
+ * @param[in] fctIter : Called once per thread, return false to stop the iteration
+ * @param[in] pArg    : Passed through to fctIter
+ * @return Number of threads visited
+ *
+ * @pre       The iterator function is non-NULL
+ * @post      None
+ * @invariant The list is unchanged
+ *
+ * @par Description
+ * Lock-free walk of the thread registry. Threads may start and exit during the walk, a thread
+ * is either visited with a consistent copy of its info or not visited at all.
+ * @code
+ * static bool show( const pu_thread_info_t* pInfo, void* pArg )
+ * {
+ *     printf( "%s (tid=%d)\n", pInfo->szName, (int)pInfo->tid );
+ *     return (true);
+ * }
+ * ...
+ * pu_thread_for_each( show, NULL );
+ * @endcode
+ */
+size_t pu_thread_for_each(
+    pu_thread_iter_fct_t fctIter,
+    void*                pArg );
+
+/**
+ * @brief Prints the registered threads that are asleep on a posutils futex object
+ *
+ * @param[in] pOut : Output stream, NULL for stdout
+ * @return Number of blocked threads printed
+ *
+ * @pre       None
+ * @post      None
+ * @invariant The registry is unchanged
+ *
+ * @par Description
+ * A pu_thread that has to sleep on a futex mutex, event group, semaphore or latch (pufutex.h)
+ * records the object in its registry slot until it wakes up. This prints one line per such
+ * thread: name, tid, object kind and address, and how long it has been asleep. Meant for a
+ * "why is nothing happening" debug hook, e.g. on a signal or from a watchdog.
+ */
+size_t pu_thread_dump_blocked( FILE* pOut );
+
+/**
+ * @brief Message header, the first member of every message posted to a mailbox
+ *
+ * The sender fills in uiType and, if the message needs cleaning up when it cannot be delivered,
+ * fctRelease. The rest belongs to the mailbox.
+ */
+typedef struct pu_msg_tag
+{
+    pu_mpsc_node_t node;                     /*!< Mailbox link, owned by the mailbox    */
+    uint32_t       uiType;                   /*!< Message type, up to the application   */
+    pid_t          tidFrom;                  /*!< Sender's tid (0 if not a pu_thread)   */
+    void (*fctRelease)( struct pu_msg_tag* pMsg ); /*!< Frees an undelivered message, or NULL */
+}   pu_msg_t;
+
+/**
+ * @brief Reference to a registered thread, see \ref pu_thread_lookup_name
+ *
+ * The slot plus the generation of its current occupant: a reference to a thread that has exited
+ * stays harmless, even after its slot has been reused.
+ */
+typedef struct
+{
+    uint32_t uiSlot;                         /*!< Registry slot                         */
+    uint32_t uiGen;                          /*!< Occupant generation                   */
+}   pu_thread_ref_t;
+
+/**
+ * @brief Finds a running thread by name
+ *
+ * @param[in]  szName : Thread name, as passed to the create call
+ * @param[out] pRef   : Reference to the thread
+ * @retval 0 for success
+ * @retval ENOENT no running thread has that name
+ * @retval EINVAL NULL parameter
+ *
+ * @pre       None
+ * @post      None
+ * @invariant The registry is unchanged
+ *
+ * @par Description
+ * O(1), a hash index over the registry. A thread is in the index from the moment it starts
+ * running until it exits. If several threads share a name (\ref pu_thread_create_many) one of
+ * them is returned.
+ */
+int pu_thread_lookup_name(
+    const char*      szName,
+    pu_thread_ref_t* pRef );
+
+/**
+ * @brief Finds a running thread by Linux thread ID
+ *
+ * @param[in]  tid  : Linux thread ID
+ * @param[out] pRef : Reference to the thread
+ * @retval 0 for success
+ * @retval ENOENT no running pu_thread has that tid
+ * @retval EINVAL NULL parameter
+ *
+ * @pre       None
+ * @post      None
+ * @invariant The registry is unchanged
+ */
+int pu_thread_lookup_tid(
+    pid_t            tid,
+    pu_thread_ref_t* pRef );
+
+/**
+ * @brief Context of a pu_thread, opaque. See \ref pu_thread_self
+ */
+typedef struct pu_thread_context_tag pu_thread_context_t;
+
+/**
+ * @brief Gets the calling thread's context
+ *
+ * @return The context, NULL if the caller is not a pu_thread
+ *
+ * @pre       None
+ * @post      None
+ * @invariant The registry is unchanged
+ *
+ * @par Description
+ * O(1) and lock-free, the entry handler keeps the context in a thread local pointer. The
+ * context lives until the thread exits; it belongs to the thread, use a \ref pu_thread_ref_t
+ * (\ref pu_thread_get_ref) to let other threads find it. For logging and profiling code that
+ * wants to say who it runs in:
+ * @code
+ * const char* szWho = pu_thread_get_name( pu_thread_self() );
+ * LOG_TRACE( "%s: queue full\n", szWho ? szWho : "?" );
+ * @endcode
+ */
+pu_thread_context_t* pu_thread_self( void );
+
+/**
+ * @brief Gets the name of a thread
+ *
+ * @param[in] pCtx : Context from \ref pu_thread_self
+ * @return The name, NULL for a NULL context
+ */
+const char* pu_thread_get_name( const pu_thread_context_t* pCtx );
+
+/**
+ * @brief Gets the Linux thread ID of a thread
+ *
+ * @param[in] pCtx : Context from \ref pu_thread_self
+ * @return The tid, 0 for a NULL context
+ */
+pid_t pu_thread_get_tid( const pu_thread_context_t* pCtx );
+
+/**
+ * @brief Gets a reference to a thread, e.g. to hand out as a reply address
+ *
+ * @param[in]  pCtx : Context from \ref pu_thread_self
+ * @param[out] pRef : The reference
+ * @retval 0 for success
+ * @retval EINVAL NULL parameter
+ */
+int pu_thread_get_ref(
+    const pu_thread_context_t* pCtx,
+    pu_thread_ref_t*           pRef );
+
+/**
+ * @brief Gets the user data of a thread
+ *
+ * @param[in] pCtx : Context from \ref pu_thread_self
+ * @return The user data, NULL if never set (or for a NULL context)
+ */
+void* pu_thread_get_user( const pu_thread_context_t* pCtx );
+
+/**
+ * @brief Sets the user data of a thread
+ *
+ * @param[in] pCtx      : Context from \ref pu_thread_self
+ * @param[in] pUserData : Anything. posutils never looks at it, the thread cleans it up
+ *
+ * @par Description
+ * A per-thread slot for the application (a logger prefix, a per-thread statistics block),
+ * without a pthread key of its own. Only the thread itself should set it.
+ */
+void pu_thread_set_user(
+    pu_thread_context_t* pCtx,
+    void*                pUserData );
+
+/**
+ * @brief Posts a message to a thread's mailbox
+ *
+ * @param[in] ref  : The receiver
+ * @param[in] pMsg : Message, uiType (and fctRelease) filled in
+ * @retval 0 for success, the receiver owns the message
+ * @retval ESRCH the receiver has exited, the caller still owns the message
+ * @retval EINVAL bad reference or NULL message
+ *
+ * @pre       The message is not queued anywhere else
+ * @post      The message is in the receiver's mailbox
+ * @invariant None
+ *
+ * @par Description
+ * Lock-free and never blocks, any thread may post. A receiver asleep in \ref pu_thread_receive
+ * is woken. Messages from one sender are received in the order they were posted.
+ */
+int pu_thread_post(
+    pu_thread_ref_t ref,
+    pu_msg_t*       pMsg );
+
+/**
+ * @brief Takes the oldest message out of the calling thread's mailbox
+ *
+ * @param[in] uiTimeoutMs : 0 to poll, PU_FUTEX_FOREVER (UINT32_MAX) to wait without a timeout
+ * @return The message (the caller owns it). NULL on timeout, on a stop request once the mailbox
+ *         is empty, or if the caller is not a pu_thread
+ *
+ * @pre       Called by a pu_thread
+ * @post      None
+ * @invariant None
+ *
+ * @par Description
+ * \ref pu_thread_request_stop and \ref pu_thread_request_stop_all wake a waiting receiver, so
+ * an actor style main loop needs no extra stop handling:
+ * @code
+ * pu_msg_t* pMsg;
+ * while (NULL != (pMsg = pu_thread_receive( PU_FUTEX_FOREVER )))
+ * {
+ *     handle( pMsg );
+ *     free( pMsg );
+ * }
+ * @endcode
+ * Messages still queued when a thread exits are handed to their fctRelease (if set).
+ */
+pu_msg_t* pu_thread_receive( uint32_t uiTimeoutMs );
+
+/**
+ * @brief Runtime statistics of a thread, see \ref pu_thread_stats_snapshot
+ */
+typedef struct
+{
+    const char* szName;                      /*!< Thread name (persistent)          */
+    pthread_t   pid;                         /*!< Posix thread ID                   */
+    pid_t       tid;                         /*!< Linux thread ID                   */
+    uint64_t    uiStartNs;                   /*!< CLOCK_MONOTONIC (ns) at start     */
+    uint64_t    uiUserNs;                    /*!< CPU time in user mode (ns)        */
+    uint64_t    uiSysNs;                     /*!< CPU time in kernel mode (ns)      */
+    uint64_t    uiVolCtxSw;                  /*!< Voluntary context switches        */
+    uint64_t    uiInvolCtxSw;                /*!< Involuntary context switches      */
+    uint64_t    uiMinFlt;                    /*!< Minor page faults                 */
+    uint64_t    uiMajFlt;                    /*!< Major page faults                 */
+}   pu_thread_stats_t;
+
+/**
+ * @brief Sort keys for \ref pu_thread_dump_top (always descending)
+ */
+typedef enum
+{
+    PU_THREAD_SORT_CPU = 0,                  /*!< User + system CPU time            */
+    PU_THREAD_SORT_CTXSW,                    /*!< Voluntary + involuntary switches  */
+    PU_THREAD_SORT_FAULTS,                   /*!< Minor + major faults              */
+    PU_THREAD_SORT_ENDDEF
+}   pu_thread_sort_t;
+
+/**
+ * @brief Gets the runtime statistics of the calling thread
+ *
+ * @param[out] pStats : Statistics
+ * @retval 0 for success
+ * @retval Non-zero for failure
+ *
+ * @pre       pStats is non-NULL
+ * @post      None
+ * @invariant None
+ *
+ * @par Description
+ * Uses getrusage(RUSAGE_THREAD), so it is cheap and needs no procfs. The thread does not have to
+ * be a registered pu_thread. The name and start time are not filled in.
+ */
+int pu_thread_stats_self( pu_thread_stats_t* pStats );
+
+/**
+ * @brief Snapshots the runtime statistics of every registered thread
+ *
+ * @param[out] aStats : Array to fill in
+ * @param[in]  uiMax  : Size of the array (entries)
+ * @return Number of entries filled in
+ *
+ * @pre       aStats is non-NULL, or uiMax is 0
+ * @post      None
+ * @invariant The registry is unchanged
+ *
+ * @par Description
+ * Walks the registry (\ref pu_thread_for_each) and reads /proc/self/task/<tid>/stat and
+ * /proc/self/task/<tid>/status for each thread. Threads that exit during the snapshot are left
+ * out. CPU times have clock tick (_SC_CLK_TCK) resolution. This does file IO, it is meant for
+ * debug and monitoring, not for a hot path.
+ */
+size_t pu_thread_stats_snapshot(
+    pu_thread_stats_t* aStats,
+    size_t             uiMax );
+
+/**
+ * @brief Prints a "top" style table of the registered threads
+ *
+ * @param[in] pOut   : Output stream, NULL for stdout
+ * @param[in] enSort : Sort key
+ * @param[in] uiMax  : Maximum number of rows, 0 for all
+ *
+ * @pre       None
+ * @post      None
+ * @invariant The registry is unchanged
+ *
+ * @par Description
+ * Takes a \ref pu_thread_stats_snapshot, sorts it (descending) and prints one row per thread.
+ * The %CPU column is the CPU time divided by the time since the thread started.
+ */
+void pu_thread_dump_top(
+    FILE*            pOut,
+    pu_thread_sort_t enSort,
+    size_t           uiMax );
+
+/**
+ * @brief Maximum number of thread names in the stack profile
+ */
+#if !defined(PU_THREAD_STACK_PROFILE_MAX)
+    #define PU_THREAD_STACK_PROFILE_MAX (64)
+#endif /* !defined(PU_THREAD_STACK_PROFILE_MAX) */
+
+/**
+ * @brief Names in the stack profile are truncated to this (including the terminator)
+ */
+#define PU_THREAD_STACK_NAME_LEN (32)
+
+/**
+ * @brief Enables or disables stack painting for threads created from now on
+ *
+ * @param[in] bEnable : true to paint
+ *
+ * @pre       None
+ * @post      None
+ * @invariant None
+ *
+ * @par Description
+ * A painted thread fills its unused stack with a pattern before main is called, and records its
+ * peak usage in the stack profile (per thread name) when it exits. Painting touches every page
+ * of the stack, so it costs RAM and start-up time. It is meant for profiling runs, or set the
+ * PU_STACK_PROFILE environment variable to a file name: the profile is then loaded at
+ * \ref posutils_init, painting and autotuning are enabled, and the profile is saved at
+ * \ref posutils_exit.
+ */
+void pu_thread_stack_profile_enable( bool bEnable );
+
+/**
+ * @brief Enables or disables stack size autotuning
+ *
+ * @param[in] bEnable : true to tune
+ *
+ * @pre       None
+ * @post      None
+ * @invariant None
+ *
+ * @par Description
+ * A thread whose name is in the stack profile is created with a stack of the recorded peak plus
+ * a margin (25%, at least a page), instead of the size passed to \ref pu_thread_create. Names
+ * not in the profile get the size asked for.
+ */
+void pu_thread_stack_autotune_enable( bool bEnable );
+
+/**
+ * @brief Peak stack usage of the calling thread so far
+ *
+ * @return Bytes used, 0 if the stack was not painted
+ *
+ * @pre       None
+ * @post      None
+ * @invariant None
+ */
+size_t pu_thread_stack_peak_self( void );
+
+/**
+ * @brief Prints the stack profile: name, peak, stack size, use (%), threads measured
+ *
+ * @param[in] pOut : Output stream, NULL for stdout
+ *
+ * @pre       posutils is initialised
+ * @post      None
+ * @invariant The profile is unchanged
+ */
+void pu_thread_stack_profile_dump( FILE* pOut );
+
+/**
+ * @brief Saves the stack profile to a text file
+ *
+ * @param[in] szFile : File name
+ * @retval 0 for success
+ * @retval Non-zero (errno) for failure
+ *
+ * @pre       posutils is initialised
+ * @post      None
+ * @invariant The profile is unchanged
+ *
+ * @par Description
+ * One line per name: "peak size threads name". Lines starting with '#' are comments.
+ */
+int pu_thread_stack_profile_save( const char* szFile );
+
+/**
+ * @brief Loads a stack profile from a text file, merging it with the current one
+ *
+ * @param[in] szFile : File name
+ * @retval 0 for success
+ * @retval Non-zero (errno) for failure
+ *
+ * @pre       posutils is initialised
+ * @post      The profile holds the worst case of both
+ * @invariant None
+ */
+int pu_thread_stack_profile_load( const char* szFile );
+
+
 
 /**
  * @}
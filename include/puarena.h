@@ -0,0 +1,256 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+#ifndef _PUARENA_H_
+#define _PUARENA_H_
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @file     puarena.h
+ * @date     2026-10-17
+ * @author   Martin
+ * @brief    Bump pointer arena
+ * Interface for:
+ * - An arena of chunks with mark/reset scopes
+ * - The per-thread arena of the calling thread
+ */
+
+/**** Includes ***************************************************************/
+#include <stddef.h>
+#include <stdint.h>
+
+/**** Definitions ************************************************************/
+
+/**
+ * @brief Bump pointer arena
+ * @defgroup PARENA Arena
+ * @ingroup  SYSUTILS
+ *
+ * @brief
+ * For request scoped work that allocates lots of small objects which all die together (parse a
+ * message, build the reply, send it). An allocation moves a pointer forward, there is no free:
+ * the whole lot is released at once by resetting the arena to a mark taken at the start of the
+ * request.
+ *
+ * @section parena_sect_1 Chunks
+ * Memory comes in chunks of uiChunkSize bytes, chained newest first. A reset hands the chunks
+ * allocated after the mark back to a spare list (up to \ref PU_ARENA_MAX_SPARE), so a thread
+ * that runs request after request stops calling malloc once it has seen its largest request.
+ * An allocation bigger than a chunk gets a chunk of its own, and that one is freed on reset.
+ *
+ * @section parena_sect_2 Thread arena
+ * \ref pu_thread_arena returns an arena that belongs to the calling thread: created on first
+ * use, freed by the posutils exit handler when the thread exits (for the main thread, in
+ * \ref posutils_exit). Threads not created with pu_thread_create should not use it, theirs
+ * would leak. Nothing else touches the arena, so there is no locking at all.
+ *
+ * @section parena_sect_3 Poisoning
+ * Unless NDEBUG is defined, new chunks are filled with \ref PU_ARENA_POISON_NEW and memory
+ * released by a reset with \ref PU_ARENA_POISON_FREE. A structure read before it was written,
+ * or after its scope ended, then shows an obvious pattern instead of plausible old data.
+ *
+ * @code
+ * pu_arena_t*     pArena = pu_thread_arena();
+ * pu_arena_mark_t mark   = pu_arena_mark( pArena );
+ *
+ * reply_t* pReply = (reply_t*)pu_arena_alloc( pArena, sizeof(reply_t) );
+ * ...
+ * pu_arena_reset( pArena, &mark );
+ * @endcode
+ * C++ code gets RAII scopes and allocator adaptors from puarena.hpp.
+ *
+ * @{
+ */
+
+/**
+ * @brief Default chunk size of the thread arenas
+ */
+#if !defined(PU_ARENA_CHUNK_SIZE)
+    #define PU_ARENA_CHUNK_SIZE (16*1024)
+#endif /* !defined(PU_ARENA_CHUNK_SIZE) */
+
+/**
+ * @brief Released chunks an arena keeps for reuse
+ */
+#if !defined(PU_ARENA_MAX_SPARE)
+    #define PU_ARENA_MAX_SPARE (4)
+#endif /* !defined(PU_ARENA_MAX_SPARE) */
+
+/**
+ * @brief Alignment of \ref pu_arena_alloc, the same as malloc
+ */
+#define PU_ARENA_ALIGN (2 * sizeof(size_t))
+
+/**
+ * @brief Debug fill patterns
+ */
+#define PU_ARENA_POISON_NEW  (0xCD)
+#define PU_ARENA_POISON_FREE (0xDD)
+
+/**
+ * @brief A chunk, the memory follows the header
+ */
+typedef struct pu_arena_chunk_tag
+{
+    struct pu_arena_chunk_tag* pPrev;        /*!< Older chunk                          */
+    size_t                     uiSize;       /*!< Bytes after the header               */
+}   pu_arena_chunk_t;
+
+/**
+ * @brief Arena. Treat as opaque
+ */
+typedef struct
+{
+    uint8_t*          pCur;                  /*!< Next free byte                       */
+    uint8_t*          pEnd;                  /*!< End of the current chunk             */
+    pu_arena_chunk_t* pChunk;                /*!< Current (newest) chunk               */
+    pu_arena_chunk_t* pSpare;                /*!< Released chunks of uiChunkSize       */
+    size_t            uiChunkSize;           /*!< Bytes per chunk                      */
+    uint32_t          uiSpare;               /*!< Chunks on pSpare                     */
+    uint32_t          uiChunks;              /*!< Chunks allocated (current + spare)   */
+}   pu_arena_t;
+
+/**
+ * @brief A position in an arena, see \ref pu_arena_mark
+ */
+typedef struct
+{
+    pu_arena_chunk_t* pChunk;
+    uint8_t*          pCur;
+}   pu_arena_mark_t;
+
+/**
+ * @brief   Initialises an arena, no memory is allocated yet
+ *
+ * @param[out] pArena      : The arena
+ * @param[in]  uiChunkSize : Bytes per chunk, 0 for \ref PU_ARENA_CHUNK_SIZE
+ */
+void pu_arena_init(
+    pu_arena_t* pArena,
+    size_t      uiChunkSize );
+
+/**
+ * @brief   Frees all the chunks of an arena
+ *
+ * @param[in] pArena : The arena
+ */
+void pu_arena_destroy( pu_arena_t* pArena );
+
+/**
+ * @brief   Frees the spare chunks
+ *
+ * @param[in] pArena : The arena
+ */
+void pu_arena_trim( pu_arena_t* pArena );
+
+/**
+ * @brief   Releases everything allocated since a mark
+ *
+ * @param[in] pArena : The arena
+ * @param[in] pMark  : A mark taken on this arena, and not released by an earlier (outer) reset
+ */
+void pu_arena_reset(
+    pu_arena_t*            pArena,
+    const pu_arena_mark_t* pMark );
+
+/**
+ * @brief   Allocation that does not fit the current chunk, do not call directly
+ */
+void* pu_arena_alloc_slow(
+    pu_arena_t* pArena,
+    size_t      uiSize,
+    size_t      uiAlign );
+
+/**
+ * @brief   Gets the calling thread's arena
+ *
+ * @return  The arena, NULL if out of memory
+ *
+ * @par Description
+ * The arena is created on first use with \ref PU_ARENA_CHUNK_SIZE chunks and freed when the
+ * thread exits.
+ */
+pu_arena_t* pu_thread_arena( void );
+
+/**
+ * @brief   Takes a mark, to reset the arena to later
+ *
+ * @param[in] pArena : The arena
+ * @return  The mark
+ */
+static inline pu_arena_mark_t pu_arena_mark( const pu_arena_t* pArena )
+{
+    pu_arena_mark_t mark;
+
+    mark.pChunk = pArena->pChunk;
+    mark.pCur   = pArena->pCur;
+    return (mark);
+}
+/* pu_arena_mark */
+
+/**
+ * @brief   Allocates with a given alignment
+ *
+ * @param[in] pArena  : The arena
+ * @param[in] uiSize  : Bytes (0 is taken as 1)
+ * @param[in] uiAlign : Alignment, a power of two
+ * @return  The memory (uninitialised), NULL if out of memory
+ */
+static inline void* pu_arena_alloc_aligned(
+    pu_arena_t* pArena,
+    size_t      uiSize,
+    size_t      uiAlign )
+{
+    uintptr_t uiAddr = ((uintptr_t)pArena->pCur + uiAlign - 1) & ~(uintptr_t)(uiAlign - 1);
+
+    uiSize = (0 == uiSize) ? 1 : uiSize;
+    if ((uiAddr <= (uintptr_t)pArena->pEnd) && (uiSize <= (uintptr_t)pArena->pEnd - uiAddr))
+    {
+        pArena->pCur = (uint8_t*)uiAddr + uiSize;
+        return ((void*)uiAddr);
+    }
+    return (pu_arena_alloc_slow( pArena, uiSize, uiAlign ));
+}
+/* pu_arena_alloc_aligned */
+
+/**
+ * @brief   Allocates, aligned like malloc
+ *
+ * @param[in] pArena : The arena
+ * @param[in] uiSize : Bytes (0 is taken as 1)
+ * @return  The memory (uninitialised), NULL if out of memory
+ */
+static inline void* pu_arena_alloc(
+    pu_arena_t* pArena,
+    size_t      uiSize )
+{
+    return (pu_arena_alloc_aligned( pArena, uiSize, PU_ARENA_ALIGN ));
+}
+/* pu_arena_alloc */
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* _PUARENA_H_ */
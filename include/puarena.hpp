@@ -0,0 +1,167 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+#ifndef _PUARENA_HPP_
+#define _PUARENA_HPP_
+
+/**
+ * @file     puarena.hpp
+ * @date     2026-10-17
+ * @author   Martin
+ * @brief    C++ helpers for the bump pointer arena
+ * Interface for:
+ * - pu::arena_scope, resets an arena when it goes out of scope
+ * - pu::arena_allocator, a standard allocator on an arena (C++14)
+ * - pu::arena_resource, a std::pmr::memory_resource on an arena (C++17 and up)
+ */
+
+/**** Includes ***************************************************************/
+#include <cstddef>
+#include <new>
+#if (__cplusplus >= 201703L) && defined(__has_include)
+    #if __has_include(<memory_resource>)
+        #include <memory_resource>
+        #define PU_ARENA_HAS_PMR (1)
+    #endif
+#endif
+#include "puarena.h"
+
+/**
+ * @addtogroup PARENA
+ *
+ * @section parena_sect_4 C++
+ * A scope object per request, and the containers of that request on the arena:
+ * @code
+ * void handle( const request_t& req ) {
+ *     pu::arena_scope scope;                      // the calling thread's arena
+ *     std::vector<item_t, pu::arena_allocator<item_t>> vItems;
+ *     ...
+ * }                                               // everything goes here, in one go
+ * @endcode
+ * Deallocation through the adaptors does nothing, the memory comes back with the scope. So a
+ * container that grows a lot (a vector doubling its capacity) leaves its old buffers in the
+ * arena until then: reserve() up front where the size is known.
+ *
+ * The apps build as C++14, so pu::arena_allocator is the one to use there. C++17 code can
+ * also use pu::arena_resource with the std::pmr containers.
+ * @{
+ */
+
+namespace pu {
+
+/**
+ * @brief Takes a mark on construction, resets the arena to it on destruction
+ *
+ * Throws std::bad_alloc if there is no arena (the thread's could not be allocated).
+ */
+class arena_scope
+{
+public:
+    explicit arena_scope( pu_arena_t* pArena = pu_thread_arena() )
+        : pArena_( checked( pArena ) ), mark_( pu_arena_mark( pArena_ ) ) {}
+    ~arena_scope() { pu_arena_reset( pArena_, &mark_ ); }
+
+    arena_scope( const arena_scope& ) = delete;
+    arena_scope& operator=( const arena_scope& ) = delete;
+
+    pu_arena_t* arena() const { return pArena_; }
+
+private:
+    static pu_arena_t* checked( pu_arena_t* pArena ) {
+        if (nullptr == pArena) {
+            throw std::bad_alloc();
+        }
+        return pArena;
+    }
+
+    pu_arena_t*     pArena_;
+    pu_arena_mark_t mark_;
+};
+
+/**
+ * @brief Standard allocator on an arena, deallocate is a no-op
+ */
+template <typename T>
+class arena_allocator
+{
+public:
+    typedef T value_type;
+
+    explicit arena_allocator( pu_arena_t* pArena = pu_thread_arena() ) noexcept : pArena_( pArena ) {}
+    template <typename U>
+    arena_allocator( const arena_allocator<U>& other ) noexcept : pArena_( other.arena() ) {}
+
+    T* allocate( std::size_t uiCount ) {
+        if (uiCount > static_cast<std::size_t>(-1) / sizeof(T)) {
+            throw std::bad_alloc();
+        }
+        void* p = pu_arena_alloc_aligned( pArena_, uiCount * sizeof(T), alignof(T) );
+        if (nullptr == p) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(p);
+    }
+    void deallocate( T*, std::size_t ) noexcept {}
+
+    pu_arena_t* arena() const noexcept { return pArena_; }
+
+private:
+    pu_arena_t* pArena_;
+};
+
+template <typename T, typename U>
+inline bool operator==( const arena_allocator<T>& a, const arena_allocator<U>& b ) noexcept { return a.arena() == b.arena(); }
+template <typename T, typename U>
+inline bool operator!=( const arena_allocator<T>& a, const arena_allocator<U>& b ) noexcept { return a.arena() != b.arena(); }
+
+#if defined(PU_ARENA_HAS_PMR)
+/**
+ * @brief std::pmr::memory_resource on an arena, deallocate is a no-op
+ */
+class arena_resource : public std::pmr::memory_resource
+{
+public:
+    explicit arena_resource( pu_arena_t* pArena = pu_thread_arena() ) noexcept : pArena_( pArena ) {}
+    pu_arena_t* arena() const noexcept { return pArena_; }
+
+private:
+    void* do_allocate( std::size_t uiBytes, std::size_t uiAlign ) override {
+        void* p = pu_arena_alloc_aligned( pArena_, uiBytes, uiAlign );
+        if (nullptr == p) {
+            throw std::bad_alloc();
+        }
+        return p;
+    }
+    void do_deallocate( void*, std::size_t, std::size_t ) override {}
+    bool do_is_equal( const std::pmr::memory_resource& other ) const noexcept override {
+        const arena_resource* pOther = dynamic_cast<const arena_resource*>(&other);
+        return (nullptr != pOther) && (pOther->pArena_ == pArena_);
+    }
+
+    pu_arena_t* pArena_;
+};
+#endif /* defined(PU_ARENA_HAS_PMR) */
+
+} // namespace pu
+
+/**
+ * @}
+ */
+
+#endif /* _PUARENA_HPP_ */
@@ -0,0 +1,219 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+#ifndef _PUBPOOL_H_
+#define _PUBPOOL_H_
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @file     pubpool.h
+ * @date     2026-10-17
+ * @author   Martin
+ * @brief    Fixed size block pool
+ * Interface for:
+ * - A slab based pool of fixed size blocks with a lock-free free list and per-thread caches
+ */
+
+/**** Includes ***************************************************************/
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**** Definitions ************************************************************/
+
+/**
+ * @brief Block pool
+ * @defgroup PBPOOL Block pool
+ * @ingroup  SYSUTILS
+ *
+ * @brief
+ * Replaces malloc/free for small structs that are allocated and freed on hot paths (thread
+ * contexts, event records, messages). All blocks of a pool have the same size, so there is no
+ * searching, no splitting, no coalescing and no fragmentation.
+ *
+ * @section pbpool_sect_1 Slabs
+ * The pool reserves address space for uiMaxSlabs slabs at create (no memory yet), commits the
+ * first slab, and commits another one whenever the free list runs dry. Slabs are never given
+ * back before the pool is destroyed. Because the slabs sit at fixed offsets in one range, a
+ * block has a 32 bit index that converts to and from its address with a little arithmetic.
+ *
+ * @section pbpool_sect_2 Free list
+ * A Treiber stack: a free block holds the index of the next free block in its first word, and
+ * the head is a single 64 bit word, the index of the top block plus a tag. Alloc and free are
+ * a compare-and-swap on the head. The tag is bumped on every change, so a head that was popped
+ * and pushed back by other threads (same index) still fails the compare (the ABA problem).
+ * Reading the link of a block another thread has just taken is harmless: the slab stays mapped,
+ * and the compare fails.
+ *
+ * @section pbpool_sect_3 Thread caches
+ * A pool created with bThreadCache keeps a small stack of free blocks per thread
+ * (\ref PU_BPOOL_CACHE_SIZE). Alloc and free hit the cache first, without any atomic operation;
+ * the shared free list is only touched to refill or spill half a cache. A thread's caches go
+ * back to their pools when the thread exits. Leave the cache off for blocks that are allocated
+ * and freed by different threads as a rule (e.g. a message freed by its receiver), they would
+ * just pass through the caches.
+ *
+ * @code
+ * static pu_bpool_t* pEvents;
+ * pu_bpool_create( &pEvents, sizeof(event_t), 8, 256, 16, true );
+ *
+ * event_t* pEvent = (event_t*)pu_bpool_alloc( pEvents );
+ * ...
+ * pu_bpool_free( pEvents, pEvent );
+ * @endcode
+ *
+ * @{
+ */
+
+/**
+ * @brief Blocks a thread keeps per pool, half of them move between the cache and the free list
+ */
+#if !defined(PU_BPOOL_CACHE_SIZE)
+    #define PU_BPOOL_CACHE_SIZE (32)
+#endif /* !defined(PU_BPOOL_CACHE_SIZE) */
+
+/**
+ * @brief Number of pools a thread can keep a cache for, allocations from further pools skip the cache
+ */
+#if !defined(PU_BPOOL_THREAD_POOLS)
+    #define PU_BPOOL_THREAD_POOLS (4)
+#endif /* !defined(PU_BPOOL_THREAD_POOLS) */
+
+/**
+ * @brief Block pool, opaque
+ */
+typedef struct pu_bpool_tag pu_bpool_t;
+
+/**
+ * @brief Pool statistics, see \ref pu_bpool_get_stats
+ */
+typedef struct
+{
+    size_t   uiBlockSize;                    /*!< Bytes per block (as requested)        */
+    size_t   uiStride;                       /*!< Bytes per block (with alignment)      */
+    uint32_t uiSlabs;                        /*!< Committed slabs                       */
+    uint32_t uiBlocks;                       /*!< Blocks in the committed slabs         */
+    uint32_t uiInUse;                        /*!< Blocks off the free list (incl. thread caches) */
+    uint32_t uiPeakInUse;                    /*!< High water mark of uiInUse            */
+    uint64_t uiAllocs;                       /*!< Blocks taken from the free list       */
+    uint64_t uiFrees;                        /*!< Blocks returned to the free list      */
+    uint64_t uiEmpty;                        /*!< Allocations that found the free list empty */
+    uint64_t uiFailed;                       /*!< Allocations that failed (pool at uiMaxSlabs) */
+    uint64_t uiCacheHits;                    /*!< Allocations served by a thread cache (as of the last refill/spill) */
+}   pu_bpool_stats_t;
+
+/**
+ * @brief   Creates a pool, commits the first slab
+ *
+ * @param[out] ppPool         : The pool
+ * @param[in]  uiBlockSize    : Bytes per block
+ * @param[in]  uiAlign        : Block alignment, a power of two up to the page size (0 = 8)
+ * @param[in]  uiBlocksPerSlab: Blocks per slab, rounded up to a power of two
+ * @param[in]  uiMaxSlabs     : Slabs the pool may grow to
+ * @param[in]  bThreadCache   : Keep per-thread caches
+ * @retval  0 for success
+ * @retval  EINVAL bad parameter
+ * @retval  ENOMEM
+ *
+ * @pre     None
+ * @post    uiBlocksPerSlab blocks are ready
+ */
+int pu_bpool_create(
+    pu_bpool_t** ppPool,
+    size_t       uiBlockSize,
+    size_t       uiAlign,
+    uint32_t     uiBlocksPerSlab,
+    uint32_t     uiMaxSlabs,
+    bool         bThreadCache );
+
+/**
+ * @brief   Destroys a pool and all its slabs
+ *
+ * @param[in] pPool : The pool
+ *
+ * @pre     Nobody uses the pool any more. Blocks still out (or in other threads' caches) go
+ *          with it
+ */
+void pu_bpool_destroy( pu_bpool_t* pPool );
+
+/**
+ * @brief   Commits slabs until the pool has at least uiBlocks blocks
+ *
+ * @param[in] pPool    : The pool
+ * @param[in] uiBlocks : Blocks wanted
+ * @retval  0 for success
+ * @retval  ENOMEM the pool would grow beyond uiMaxSlabs (it grows as far as it can)
+ *
+ * @par Description
+ * For a startup phase that wants the memory committed (and, with mlockall, locked) before
+ * the real time part starts.
+ */
+int pu_bpool_reserve(
+    pu_bpool_t* pPool,
+    uint32_t    uiBlocks );
+
+/**
+ * @brief   Allocates a block
+ *
+ * @param[in] pPool : The pool
+ * @return  The block (uninitialised), NULL if the pool is exhausted
+ */
+void* pu_bpool_alloc( pu_bpool_t* pPool );
+
+/**
+ * @brief   Frees a block
+ *
+ * @param[in] pPool  : The pool the block came from
+ * @param[in] pBlock : The block, NULL is ignored
+ */
+void pu_bpool_free(
+    pu_bpool_t* pPool,
+    void*       pBlock );
+
+/**
+ * @brief   Tells whether a block lies in the pool's address range
+ *
+ * @param[in] pPool  : The pool
+ * @param[in] pBlock : Any pointer
+ * @return  true if pBlock is inside one of the pool's slabs
+ */
+bool pu_bpool_owns(
+    const pu_bpool_t* pPool,
+    const void*       pBlock );
+
+/**
+ * @brief   Gets the pool statistics
+ *
+ * @param[in]  pPool  : The pool
+ * @param[out] pStats : Snapshot of the counters
+ */
+void pu_bpool_get_stats(
+    pu_bpool_t*       pPool,
+    pu_bpool_stats_t* pStats );
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* _PUBPOOL_H_ */
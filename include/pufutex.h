@@ -0,0 +1,597 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+#ifndef _PUFUTEX_H_
+#define _PUFUTEX_H_
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @file     pufutex.h
+ * @date     2026-10-16
+ * @author   Martin
+ * @brief    Futex based lightweight synchronisation
+ * Interface for:
+ * - A futex mutex with bounded spinning
+ * - Event flag groups, counting semaphores and count-down latches
+ */
+
+/**** Includes ***************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+
+/**** Definitions ************************************************************/
+
+/**
+ * @brief Futex based synchronisation
+ * @defgroup PFUTEX Futex based synchronisation
+ * @ingroup  SYSUTILS
+ *
+ * @brief
+ * Locks built directly on the Linux futex system call. The uncontended paths are a single
+ * atomic instruction, inline in this header, the kernel is only entered when a thread has to
+ * sleep or has to wake a sleeper.
+ *
+ * @section pfutex_sect_1 Futex mutex
+ * A 32 bit word with three states (after "Futexes are tricky", U. Drepper):
+ * - 0 unlocked
+ * - 1 locked, nobody waiting
+ * - 2 locked, maybe somebody waiting
+ * .
+ * Lock is a compare-and-swap 0 -> 1. If that fails the caller spins (bounded,
+ * \ref PU_FUTEX_SPIN) hoping the owner is about to unlock, then marks the word 2 and sleeps in
+ * the kernel. Unlock swaps in 0 and only makes the wake system call if the old value was 2.
+ *
+ * Compared to a pthread mutex there is no owner, no error checking, no priority inheritance and
+ * no recursion. It is for very short critical sections: counters, list inserts, registry
+ * updates. It is not a cancellation point, and must not be held across one.
+ *
+ * @code
+ * static pu_futex_mutex_t mtxCount = PU_FUTEX_MUTEX_INITIALIZER;
+ *
+ * pu_futex_mutex_lock( &mtxCount );
+ * uiCount++;
+ * pu_futex_mutex_unlock( &mtxCount );
+ * @endcode
+ *
+ * @section pfutex_sect_2 Signalling
+ * - \ref pu_futex_event_t : a group of 32 event flags. Wait for any or all of a mask, optionally
+ *   consuming (clearing) the flags that satisfied the wait. Flags are levels, not pulses: a flag
+ *   that is set and cleared again before a waiter runs may be missed.
+ * - \ref pu_futex_sem_t : a counting semaphore.
+ * - \ref pu_futex_latch_t : a one-shot count-down latch. Waiters are released, for good, when
+ *   the count reaches zero.
+ * .
+ * Each object keeps a count of sleeping waiters next to its futex word, so a signal (set, post,
+ * count down) with nobody waiting is one atomic instruction and no system call. Waits take a
+ * timeout in ms (\ref PU_FUTEX_FOREVER for none, 0 to poll) and return 0 or ETIMEDOUT.
+ *
+ * A pu_thread that sleeps on any of these (or on a contended futex mutex) records what it is
+ * blocked on in the thread registry, see \ref pu_thread_dump_blocked.
+ *
+ * @code
+ * static pu_futex_event_t evIo = PU_FUTEX_EVENT_INITIALIZER;
+ *
+ * // GPIO thread
+ * pu_futex_event_set( &evIo, EV_RX );
+ *
+ * // worker: wait up to 100ms for RX or an error, and consume them
+ * uint32_t uiGot;
+ * if (0 == pu_futex_event_wait( &evIo, EV_RX | EV_ERR, PU_FUTEX_EVENT_ANY | PU_FUTEX_EVENT_CLEAR, 100, &uiGot ))
+ * {
+ *     ...
+ * }
+ * @endcode
+ *
+ * @{
+ */
+
+/**
+ * @brief Number of spins before a contended futex mutex goes to sleep in the kernel
+ */
+#if !defined(PU_FUTEX_SPIN)
+    #define PU_FUTEX_SPIN (100)
+#endif /* !defined(PU_FUTEX_SPIN) */
+
+/**
+ * @brief Tells the core we are spinning: lets the other hyperthread run (x86), or saves power (ARM)
+ */
+#if defined(__i386__) || defined(__x86_64__)
+    #define PU_FUTEX_RELAX() __builtin_ia32_pause()
+#elif defined(__arm__) || defined(__aarch64__)
+    #define PU_FUTEX_RELAX() __asm__ __volatile__( "yield" ::: "memory" )
+#else
+    #define PU_FUTEX_RELAX() __asm__ __volatile__( "" ::: "memory" )
+#endif
+
+/**
+ * @brief Futex mutex
+ */
+typedef struct
+{
+    uint32_t uiState;                        /*!< 0 free, 1 locked, 2 locked + waiters */
+}   pu_futex_mutex_t;
+
+/**
+ * @brief Static initialiser for a \ref pu_futex_mutex_t
+ */
+#define PU_FUTEX_MUTEX_INITIALIZER { 0 }
+
+/**
+ * @brief   Contended part of \ref pu_futex_mutex_lock, do not call directly
+ *
+ * @param[in] pMtx : Futex mutex
+ */
+void pu_futex_mutex_lock_slow( pu_futex_mutex_t* pMtx );
+
+/**
+ * @brief   Wakes a waiter, the contended part of \ref pu_futex_mutex_unlock, do not call directly
+ *
+ * @param[in] pMtx : Futex mutex
+ */
+void pu_futex_mutex_wake( pu_futex_mutex_t* pMtx );
+
+/**
+ * @brief   Initialises a futex mutex (unlocked)
+ *
+ * @param[out] pMtx : Futex mutex
+ */
+static inline void pu_futex_mutex_init( pu_futex_mutex_t* pMtx )
+{
+    __atomic_store_n( &(pMtx->uiState), 0, __ATOMIC_RELAXED );
+}
+/* pu_futex_mutex_init */
+
+/**
+ * @brief   Tries to lock a futex mutex, never blocks
+ *
+ * @param[in] pMtx : Futex mutex
+ * @return  true if the mutex was taken
+ */
+static inline bool pu_futex_mutex_trylock( pu_futex_mutex_t* pMtx )
+{
+    uint32_t uiExpected = 0;
+    return (__atomic_compare_exchange_n( &(pMtx->uiState), &uiExpected, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED ));
+}
+/* pu_futex_mutex_trylock */
+
+/**
+ * @brief   Locks a futex mutex
+ *
+ * @param[in] pMtx : Futex mutex
+ */
+static inline void pu_futex_mutex_lock( pu_futex_mutex_t* pMtx )
+{
+    if (!pu_futex_mutex_trylock( pMtx ))
+    {
+        pu_futex_mutex_lock_slow( pMtx );
+    }
+}
+/* pu_futex_mutex_lock */
+
+/**
+ * @brief   Unlocks a futex mutex
+ *
+ * @param[in] pMtx : Futex mutex
+ */
+static inline void pu_futex_mutex_unlock( pu_futex_mutex_t* pMtx )
+{
+    if (2 == __atomic_exchange_n( &(pMtx->uiState), 0, __ATOMIC_RELEASE ))
+    {
+        pu_futex_mutex_wake( pMtx );
+    }
+}
+/* pu_futex_mutex_unlock */
+
+/**
+ * @brief Timeout (ms) meaning "wait forever"
+ */
+#define PU_FUTEX_FOREVER (UINT32_MAX)
+
+/**
+ * @brief Event wait option: any bit of the mask will do (the default)
+ */
+#define PU_FUTEX_EVENT_ANY   (0x0u)
+
+/**
+ * @brief Event wait option: all bits of the mask must be set
+ */
+#define PU_FUTEX_EVENT_ALL   (0x1u)
+
+/**
+ * @brief Event wait option: atomically clear (consume) the bits that satisfied the wait
+ */
+#define PU_FUTEX_EVENT_CLEAR (0x2u)
+
+/**
+ * @brief Event flag group
+ */
+typedef struct
+{
+    uint32_t uiFlags;                        /*!< The flags, also the futex word      */
+    uint32_t uiWaiters;                      /*!< Threads sleeping (or about to)      */
+}   pu_futex_event_t;
+
+/**
+ * @brief Static initialiser for a \ref pu_futex_event_t (all flags clear)
+ */
+#define PU_FUTEX_EVENT_INITIALIZER { 0, 0 }
+
+/**
+ * @brief Counting semaphore
+ */
+typedef struct
+{
+    uint32_t uiCount;                        /*!< The count, also the futex word      */
+    uint32_t uiWaiters;                      /*!< Threads sleeping (or about to)      */
+}   pu_futex_sem_t;
+
+/**
+ * @brief Static initialiser for a \ref pu_futex_sem_t
+ * @param uiCount_ : Initial count
+ */
+#define PU_FUTEX_SEM_INITIALIZER(uiCount_) { (uiCount_), 0 }
+
+/**
+ * @brief One-shot count-down latch
+ */
+typedef struct
+{
+    uint32_t uiCount;                        /*!< Remaining count, also the futex word */
+    uint32_t uiWaiters;                      /*!< Threads sleeping (or about to)       */
+}   pu_futex_latch_t;
+
+/**
+ * @brief Static initialiser for a \ref pu_futex_latch_t
+ * @param uiCount_ : Initial count
+ */
+#define PU_FUTEX_LATCH_INITIALIZER(uiCount_) { (uiCount_), 0 }
+
+/**
+ * @brief   Sleeping part of \ref pu_futex_event_wait, do not call directly
+ */
+int pu_futex_event_wait_slow(
+    pu_futex_event_t* pEvent,
+    uint32_t          uiMask,
+    uint32_t          uiOptions,
+    uint32_t          uiTimeoutMs,
+    uint32_t*         puiFlags );
+
+/**
+ * @brief   Wakes every waiter of an event group, do not call directly
+ */
+void pu_futex_event_wake( pu_futex_event_t* pEvent );
+
+/**
+ * @brief   Sleeping part of \ref pu_futex_sem_wait, do not call directly
+ */
+int pu_futex_sem_wait_slow(
+    pu_futex_sem_t* pSem,
+    uint32_t        uiTimeoutMs );
+
+/**
+ * @brief   Wakes one waiter of a semaphore, do not call directly
+ */
+void pu_futex_sem_wake( pu_futex_sem_t* pSem );
+
+/**
+ * @brief   Sleeping part of \ref pu_futex_latch_wait, do not call directly
+ */
+int pu_futex_latch_wait_slow(
+    pu_futex_latch_t* pLatch,
+    uint32_t          uiTimeoutMs );
+
+/**
+ * @brief   Wakes every waiter of a latch, do not call directly
+ */
+void pu_futex_latch_wake( pu_futex_latch_t* pLatch );
+
+/**
+ * @brief   Initialises an event group
+ *
+ * @param[out] pEvent  : Event group
+ * @param[in]  uiFlags : Initial flags
+ */
+static inline void pu_futex_event_init( pu_futex_event_t* pEvent, uint32_t uiFlags )
+{
+    __atomic_store_n( &(pEvent->uiFlags), uiFlags, __ATOMIC_RELAXED );
+    __atomic_store_n( &(pEvent->uiWaiters), 0, __ATOMIC_RELAXED );
+}
+/* pu_futex_event_init */
+
+/**
+ * @brief   Reads the flags
+ *
+ * @param[in] pEvent : Event group
+ * @return  The flags
+ */
+static inline uint32_t pu_futex_event_get( const pu_futex_event_t* pEvent )
+{
+    return (__atomic_load_n( &(pEvent->uiFlags), __ATOMIC_ACQUIRE ));
+}
+/* pu_futex_event_get */
+
+/**
+ * @brief   Sets flags, waking the waiters if a flag changed and somebody waits
+ *
+ * @param[in] pEvent : Event group
+ * @param[in] uiMask : Flags to set
+ * @return  The flags before the call
+ */
+static inline uint32_t pu_futex_event_set( pu_futex_event_t* pEvent, uint32_t uiMask )
+{
+    uint32_t uiOld = __atomic_fetch_or( &(pEvent->uiFlags), uiMask, __ATOMIC_SEQ_CST );
+    if (((uiOld | uiMask) != uiOld) && (0 != __atomic_load_n( &(pEvent->uiWaiters), __ATOMIC_SEQ_CST )))
+    {
+        pu_futex_event_wake( pEvent );
+    }
+    return (uiOld);
+}
+/* pu_futex_event_set */
+
+/**
+ * @brief   Clears flags, never wakes anybody
+ *
+ * @param[in] pEvent : Event group
+ * @param[in] uiMask : Flags to clear
+ * @return  The flags before the call
+ */
+static inline uint32_t pu_futex_event_clear( pu_futex_event_t* pEvent, uint32_t uiMask )
+{
+    return (__atomic_fetch_and( &(pEvent->uiFlags), ~uiMask, __ATOMIC_ACQ_REL ));
+}
+/* pu_futex_event_clear */
+
+/**
+ * @brief   Checks (and with \ref PU_FUTEX_EVENT_CLEAR consumes) flags, never blocks
+ *
+ * @param[in]  pEvent    : Event group
+ * @param[in]  uiMask    : Flags of interest
+ * @param[in]  uiOptions : PU_FUTEX_EVENT_ANY or PU_FUTEX_EVENT_ALL, optionally | PU_FUTEX_EVENT_CLEAR
+ * @param[out] puiFlags  : The flags seen (before any clearing), may be NULL
+ * @return  true if the condition was met
+ */
+static inline bool pu_futex_event_trywait(
+    pu_futex_event_t* pEvent,
+    uint32_t          uiMask,
+    uint32_t          uiOptions,
+    uint32_t*         puiFlags )
+{
+    uint32_t uiFlags = __atomic_load_n( &(pEvent->uiFlags), __ATOMIC_ACQUIRE );
+    uint32_t uiHit;
+    bool     bMet;
+
+    for (;;)
+    {
+        uiHit = uiFlags & uiMask;
+        bMet  = (0 != (uiOptions & PU_FUTEX_EVENT_ALL)) ? (uiHit == uiMask) : (0 != uiHit);
+        if (!bMet || (0 == (uiOptions & PU_FUTEX_EVENT_CLEAR)))
+        {
+            break;
+        }
+        if (__atomic_compare_exchange_n( &(pEvent->uiFlags), &uiFlags, uiFlags & ~uiHit, true, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE ))
+        {
+            break;
+        }
+    }
+    if (puiFlags)
+    {
+        *puiFlags = uiFlags;
+    }
+    return (bMet);
+}
+/* pu_futex_event_trywait */
+
+/**
+ * @brief   Waits for flags
+ *
+ * @param[in]  pEvent      : Event group
+ * @param[in]  uiMask      : Flags of interest
+ * @param[in]  uiOptions   : PU_FUTEX_EVENT_ANY or PU_FUTEX_EVENT_ALL, optionally | PU_FUTEX_EVENT_CLEAR
+ * @param[in]  uiTimeoutMs : Timeout, \ref PU_FUTEX_FOREVER for none
+ * @param[out] puiFlags    : The flags that met the condition (before any clearing), may be NULL
+ * @retval  0 the condition was met
+ * @retval  ETIMEDOUT
+ */
+static inline int pu_futex_event_wait(
+    pu_futex_event_t* pEvent,
+    uint32_t          uiMask,
+    uint32_t          uiOptions,
+    uint32_t          uiTimeoutMs,
+    uint32_t*         puiFlags )
+{
+    if (pu_futex_event_trywait( pEvent, uiMask, uiOptions, puiFlags ))
+    {
+        return (0);
+    }
+    if (0 == uiTimeoutMs)
+    {
+        return (ETIMEDOUT);
+    }
+    return (pu_futex_event_wait_slow( pEvent, uiMask, uiOptions, uiTimeoutMs, puiFlags ));
+}
+/* pu_futex_event_wait */
+
+/**
+ * @brief   Initialises a semaphore
+ *
+ * @param[out] pSem    : Semaphore
+ * @param[in]  uiCount : Initial count
+ */
+static inline void pu_futex_sem_init( pu_futex_sem_t* pSem, uint32_t uiCount )
+{
+    __atomic_store_n( &(pSem->uiCount), uiCount, __ATOMIC_RELAXED );
+    __atomic_store_n( &(pSem->uiWaiters), 0, __ATOMIC_RELAXED );
+}
+/* pu_futex_sem_init */
+
+/**
+ * @brief   Reads the count
+ *
+ * @param[in] pSem : Semaphore
+ * @return  The count
+ */
+static inline uint32_t pu_futex_sem_get_value( const pu_futex_sem_t* pSem )
+{
+    return (__atomic_load_n( &(pSem->uiCount), __ATOMIC_RELAXED ));
+}
+/* pu_futex_sem_get_value */
+
+/**
+ * @brief   Takes one from the count if it is non-zero, never blocks
+ *
+ * @param[in] pSem : Semaphore
+ * @return  true if the count was taken
+ */
+static inline bool pu_futex_sem_trywait( pu_futex_sem_t* pSem )
+{
+    uint32_t uiCount = __atomic_load_n( &(pSem->uiCount), __ATOMIC_RELAXED );
+
+    while (0 != uiCount)
+    {
+        if (__atomic_compare_exchange_n( &(pSem->uiCount), &uiCount, uiCount - 1, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED ))
+        {
+            return (true);
+        }
+    }
+    return (false);
+}
+/* pu_futex_sem_trywait */
+
+/**
+ * @brief   Takes one from the count, waiting for it to become non-zero
+ *
+ * @param[in] pSem        : Semaphore
+ * @param[in] uiTimeoutMs : Timeout, \ref PU_FUTEX_FOREVER for none
+ * @retval  0 the count was taken
+ * @retval  ETIMEDOUT
+ */
+static inline int pu_futex_sem_wait( pu_futex_sem_t* pSem, uint32_t uiTimeoutMs )
+{
+    if (pu_futex_sem_trywait( pSem ))
+    {
+        return (0);
+    }
+    if (0 == uiTimeoutMs)
+    {
+        return (ETIMEDOUT);
+    }
+    return (pu_futex_sem_wait_slow( pSem, uiTimeoutMs ));
+}
+/* pu_futex_sem_wait */
+
+/**
+ * @brief   Adds one to the count, waking a waiter if there is one
+ *
+ * @param[in] pSem : Semaphore
+ */
+static inline void pu_futex_sem_post( pu_futex_sem_t* pSem )
+{
+    __atomic_fetch_add( &(pSem->uiCount), 1, __ATOMIC_SEQ_CST );
+    if (0 != __atomic_load_n( &(pSem->uiWaiters), __ATOMIC_SEQ_CST ))
+    {
+        pu_futex_sem_wake( pSem );
+    }
+}
+/* pu_futex_sem_post */
+
+/**
+ * @brief   Initialises a latch
+ *
+ * @param[out] pLatch  : Latch
+ * @param[in]  uiCount : Count downs needed to release the waiters
+ */
+static inline void pu_futex_latch_init( pu_futex_latch_t* pLatch, uint32_t uiCount )
+{
+    __atomic_store_n( &(pLatch->uiCount), uiCount, __ATOMIC_RELAXED );
+    __atomic_store_n( &(pLatch->uiWaiters), 0, __ATOMIC_RELAXED );
+}
+/* pu_futex_latch_init */
+
+/**
+ * @brief   Counts down, releasing the waiters when the count reaches zero
+ *
+ * @param[in] pLatch : Latch
+ * @param[in] uiN    : Amount to count down, the count stops at zero
+ */
+static inline void pu_futex_latch_count_down( pu_futex_latch_t* pLatch, uint32_t uiN )
+{
+    uint32_t uiCount = __atomic_load_n( &(pLatch->uiCount), __ATOMIC_RELAXED );
+    uint32_t uiNew;
+
+    do
+    {
+        if (0 == uiCount)
+        {
+            return;
+        }
+        uiNew = (uiCount > uiN) ? (uiCount - uiN) : 0;
+    } while (!__atomic_compare_exchange_n( &(pLatch->uiCount), &uiCount, uiNew, true, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED ));
+
+    if ((0 == uiNew) && (0 != __atomic_load_n( &(pLatch->uiWaiters), __ATOMIC_SEQ_CST )))
+    {
+        pu_futex_latch_wake( pLatch );
+    }
+}
+/* pu_futex_latch_count_down */
+
+/**
+ * @brief   Checks whether a latch is released, never blocks
+ *
+ * @param[in] pLatch : Latch
+ * @return  true if the count is zero
+ */
+static inline bool pu_futex_latch_trywait( const pu_futex_latch_t* pLatch )
+{
+    return (0 == __atomic_load_n( &(pLatch->uiCount), __ATOMIC_ACQUIRE ));
+}
+/* pu_futex_latch_trywait */
+
+/**
+ * @brief   Waits for a latch to be released
+ *
+ * @param[in] pLatch      : Latch
+ * @param[in] uiTimeoutMs : Timeout, \ref PU_FUTEX_FOREVER for none
+ * @retval  0 the latch is released
+ * @retval  ETIMEDOUT
+ */
+static inline int pu_futex_latch_wait( pu_futex_latch_t* pLatch, uint32_t uiTimeoutMs )
+{
+    if (pu_futex_latch_trywait( pLatch ))
+    {
+        return (0);
+    }
+    if (0 == uiTimeoutMs)
+    {
+        return (ETIMEDOUT);
+    }
+    return (pu_futex_latch_wait_slow( pLatch, uiTimeoutMs ));
+}
+/* pu_futex_latch_wait */
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* _PUFUTEX_H_ */
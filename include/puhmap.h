@@ -0,0 +1,255 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+#ifndef _PUHMAP_H_
+#define _PUHMAP_H_
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @file     puhmap.h
+ * @date     2026-10-17
+ * @author   Martin
+ * @brief    Intrusive open addressing hash map
+ * Interface for:
+ * - A hash map of caller owned objects, with caller supplied hash and compare functions
+ * - Hash functions for strings, 32 bit integers and byte strings
+ */
+
+/**** Includes ***************************************************************/
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**** Definitions ************************************************************/
+
+/**
+ * @brief Intrusive hash map
+ * @defgroup PHMAP Hash map
+ * @ingroup  SYSUTILS
+ *
+ * @brief
+ * O(1) lookup of objects by a key they carry (a name, an ID), where an SLL_FOR_EACH scan would
+ * be O(n). The map holds pointers to the objects, it never allocates or frees them; the key is
+ * whatever the pfnKey callback returns for an object.
+ *
+ * @section phmap_sect_1 Layout
+ * Linear probing over two parallel arrays: the 32 bit hashes, and the object pointers. A probe
+ * walks the hash array (16 per cache line) and only looks at an object, and calls pfnEqual, when
+ * the full hash matches. Hash 0 marks an empty bucket (a real 0 is stored as 1).
+ *
+ * @section phmap_sect_2 Deletion
+ * Backward shift: the entries after a removed one that would rather live in its place move back.
+ * There are no tombstones, so probe lengths depend on the current load only, never on how many
+ * objects have come and gone.
+ *
+ * @section phmap_sect_3 Resizing
+ * At 3/4 full the map allocates a table twice the size, but does not move anything yet. Every
+ * later insert and remove moves a few buckets (\ref PU_HMAP_MIGRATE_STEP) from the old table to
+ * the new, lookups search both until the old one is empty and freed. So no single insert pays
+ * for rehashing the whole map. The map does not shrink.
+ *
+ * @section phmap_sect_4 Duplicates and locking
+ * Insert does not look for the key, objects with equal keys may be added (thread names, for
+ * example, need not be unique); a find returns one of them. Call \ref pu_hmap_find first where
+ * keys must be unique. The map has no lock. Find is read only, so concurrent finds under a
+ * read lock are fine; insert and remove need it write held.
+ *
+ * @code
+ * typedef struct { char szName[32]; ... } line_t;
+ *
+ * static const void* line_key( const void* pEntry ) { return ((const line_t*)pEntry)->szName; }
+ * static bool line_equal( const void* pEntry, const void* pKey ) { return (0 == strcmp( ((const line_t*)pEntry)->szName, (const char*)pKey )); }
+ * static const pu_hmap_ops_t opsLine = { pu_hmap_hash_str, line_equal, line_key };
+ *
+ * pu_hmap_t mapLines;
+ * pu_hmap_init( &mapLines, &opsLine, 64 );
+ * pu_hmap_insert( &mapLines, pLine );
+ * line_t* pFound = (line_t*)pu_hmap_find( &mapLines, "LED0" );
+ * @endcode
+ * C++ code gets a typed wrapper from puhmap.hpp.
+ *
+ * @{
+ */
+
+/**
+ * @brief Old table buckets moved per insert/remove while a resize is in progress
+ */
+#if !defined(PU_HMAP_MIGRATE_STEP)
+    #define PU_HMAP_MIGRATE_STEP (8)
+#endif /* !defined(PU_HMAP_MIGRATE_STEP) */
+
+/**
+ * @brief Smallest table
+ */
+#define PU_HMAP_MIN_BUCKETS (8)
+
+/**
+ * @brief Key callbacks, on the caller's objects
+ */
+typedef struct
+{
+    uint32_t    (*pfnHash)( const void* pKey );                      /*!< Hash of a key           */
+    bool        (*pfnEqual)( const void* pEntry, const void* pKey ); /*!< Object has this key     */
+    const void* (*pfnKey)( const void* pEntry );                     /*!< Key of an object        */
+}   pu_hmap_ops_t;
+
+/**
+ * @brief One table
+ */
+typedef struct
+{
+    void**      apEntries;                   /*!< Objects, NULL if empty               */
+    uint32_t*   aHashes;                     /*!< Hashes, 0 if empty                   */
+    size_t      uiBuckets;                   /*!< Power of two                         */
+    size_t      uiCount;                     /*!< Objects in this table                */
+    uint32_t    uiShift;                     /*!< 32 - log2(uiBuckets)                 */
+}   pu_hmap_table_t;
+
+/**
+ * @brief Hash map. Treat as opaque
+ */
+typedef struct
+{
+    const pu_hmap_ops_t* pOps;               /*!< Callbacks                            */
+    pu_hmap_table_t      tblCur;             /*!< Current table, inserts go here       */
+    pu_hmap_table_t      tblOld;             /*!< Table being drained, or empty        */
+    size_t               uiMigrate;          /*!< Next bucket of tblOld to move        */
+}   pu_hmap_t;
+
+/**
+ * @brief   Initialises a map
+ *
+ * @param[out] pMap      : The map
+ * @param[in]  pOps      : Callbacks, must stay valid for the life of the map
+ * @param[in]  uiExpected: Objects it should hold without growing (0 for the smallest table)
+ * @retval  0 for success
+ * @retval  ENOMEM, EINVAL
+ */
+int pu_hmap_init(
+    pu_hmap_t*           pMap,
+    const pu_hmap_ops_t* pOps,
+    size_t               uiExpected );
+
+/**
+ * @brief   Frees the tables, the objects are not touched
+ *
+ * @param[in] pMap : The map
+ */
+void pu_hmap_destroy( pu_hmap_t* pMap );
+
+/**
+ * @brief   Adds an object
+ *
+ * @param[in] pMap   : The map
+ * @param[in] pEntry : The object, not already in this map
+ * @retval  0 for success
+ * @retval  ENOMEM the map is full and could not grow
+ * @retval  EINVAL NULL parameter
+ */
+int pu_hmap_insert(
+    pu_hmap_t* pMap,
+    void*      pEntry );
+
+/**
+ * @brief   Finds an object by key
+ *
+ * @param[in] pMap : The map
+ * @param[in] pKey : Key, as the callbacks understand it
+ * @return  An object with that key, NULL if none
+ */
+void* pu_hmap_find(
+    const pu_hmap_t* pMap,
+    const void*      pKey );
+
+/**
+ * @brief   Removes an object by key
+ *
+ * @param[in] pMap : The map
+ * @param[in] pKey : Key
+ * @return  The removed object, NULL if none had the key
+ */
+void* pu_hmap_remove(
+    pu_hmap_t*  pMap,
+    const void* pKey );
+
+/**
+ * @brief   Removes one particular object (of several with the same key, say)
+ *
+ * @param[in] pMap   : The map
+ * @param[in] pEntry : The object
+ * @retval  true if it was in the map
+ */
+bool pu_hmap_remove_entry(
+    pu_hmap_t* pMap,
+    void*      pEntry );
+
+/**
+ * @brief   Iterates over the objects, in no particular order
+ *
+ * @param[in]     pMap   : The map
+ * @param[in,out] puiPos : Position, 0 to start
+ * @return  The next object, NULL at the end
+ *
+ * @par Description
+ * The map must not change during the iteration.
+ */
+void* pu_hmap_next(
+    const pu_hmap_t* pMap,
+    size_t*          puiPos );
+
+/**
+ * @brief   Number of objects
+ *
+ * @param[in] pMap : The map
+ * @return  The count
+ */
+static inline size_t pu_hmap_count( const pu_hmap_t* pMap )
+{
+    return (pMap->tblCur.uiCount + pMap->tblOld.uiCount);
+}
+/* pu_hmap_count */
+
+/**
+ * @brief   FNV-1a of a NUL terminated string
+ */
+uint32_t pu_hmap_hash_str( const void* pKey );
+
+/**
+ * @brief   FNV-1a of a byte string
+ */
+uint32_t pu_hmap_hash_bytes(
+    const void* pData,
+    size_t      uiLen );
+
+/**
+ * @brief   Hash of a uint32_t (pKey points to it)
+ */
+uint32_t pu_hmap_hash_u32( const void* pKey );
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _PUHMAP_H_ */
@@ -0,0 +1,238 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+#ifndef _PUHMAP_HPP_
+#define _PUHMAP_HPP_
+
+/**
+ * @file     puhmap.hpp
+ * @date     2026-10-17
+ * @author   Martin
+ * @brief    Typed C++ wrapper of the intrusive hash map
+ * Interface for:
+ * - pu::intrusive_hmap, the map of T keyed on a member, with forward iterators
+ * - pu::hmap_member_traits, key/hash/compare for a member key
+ */
+
+/**** Includes ***************************************************************/
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include "puhmap.h"
+
+/**
+ * @addtogroup PHMAP
+ *
+ * @section phmap_sect_cxx C++
+ * The traits say where the key is and how to hash and compare it; the map calls them through
+ * one set of static thunks per type, so there is no per object overhead beyond the C map.
+ * @code
+ * struct line_t {
+ *     const char* szName;
+ *     unsigned    uiOffset;
+ * };
+ * typedef pu::hmap_member_traits<line_t, const char*, &line_t::szName> line_by_name;
+ *
+ * pu::intrusive_hmap<line_t, line_by_name> mapLines( 64 );
+ * mapLines.insert( line );
+ * line_t* pLine = mapLines.find( "LED0" );
+ * @endcode
+ * Integer keys (up to 32 bits) and C strings (const char*) have default hash and compare;
+ * for anything else pass Hash and Equal function objects to hmap_member_traits.
+ * @{
+ */
+
+namespace pu {
+
+/**
+ * @brief Default key hash: integers up to 32 bits, and C strings
+ */
+template <typename K, typename Enable = void>
+struct hmap_hash;
+
+template <typename K>
+struct hmap_hash<K, typename std::enable_if<std::is_integral<K>::value && (sizeof(K) <= sizeof(uint32_t))>::type>
+{
+    uint32_t operator()( K key ) const noexcept {
+        uint32_t uiKey = static_cast<uint32_t>(key);
+        return pu_hmap_hash_u32( &uiKey );
+    }
+};
+
+template <>
+struct hmap_hash<const char*>
+{
+    uint32_t operator()( const char* szKey ) const noexcept { return pu_hmap_hash_str( szKey ); }
+};
+
+/**
+ * @brief Default key compare: operator==, and strcmp for C strings
+ */
+template <typename K>
+struct hmap_equal
+{
+    bool operator()( const K& a, const K& b ) const noexcept { return a == b; }
+};
+
+template <>
+struct hmap_equal<const char*>
+{
+    bool operator()( const char* a, const char* b ) const noexcept { return (a == b) || (0 == std::strcmp( a, b )); }
+};
+
+/**
+ * @brief Traits of a map keyed on a data member of T
+ */
+template <typename T, typename K, K T::*Member, typename Hash = hmap_hash<K>, typename Equal = hmap_equal<K>>
+struct hmap_member_traits
+{
+    typedef K key_type;
+
+    static const K& key( const T& entry ) noexcept { return entry.*Member; }
+    static uint32_t hash( const K& key ) noexcept { return Hash()( key ); }
+    static bool     equal( const K& a, const K& b ) noexcept { return Equal()( a, b ); }
+};
+
+/**
+ * @brief Hash map of T objects (not owned), see \ref PHMAP
+ * @tparam T      : Object type
+ * @tparam Traits : key(), hash() and equal(), e.g. hmap_member_traits
+ */
+template <typename T, typename Traits>
+class intrusive_hmap
+{
+public:
+    typedef typename Traits::key_type key_type;
+    typedef T                         value_type;
+    typedef std::size_t               size_type;
+
+    /**
+     * @brief Forward iterator, in no particular order. The map must not change meanwhile
+     */
+    class iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef T                         value_type;
+        typedef std::ptrdiff_t            difference_type;
+        typedef T*                        pointer;
+        typedef T&                        reference;
+
+        iterator() noexcept : pMap_( nullptr ), uiPos_( 0 ), pEntry_( nullptr ) {}
+        iterator( const pu_hmap_t* pMap ) noexcept : pMap_( pMap ), uiPos_( 0 ), pEntry_( nullptr ) { ++(*this); }
+
+        reference operator*() const noexcept  { return *pEntry_; }
+        pointer   operator->() const noexcept { return pEntry_; }
+        iterator& operator++() noexcept {
+            pEntry_ = static_cast<T*>(pu_hmap_next( pMap_, &uiPos_ ));
+            return *this;
+        }
+        iterator  operator++( int ) noexcept { iterator it( *this ); ++(*this); return it; }
+        bool operator==( const iterator& other ) const noexcept { return pEntry_ == other.pEntry_; }
+        bool operator!=( const iterator& other ) const noexcept { return pEntry_ != other.pEntry_; }
+
+    private:
+        const pu_hmap_t* pMap_;
+        std::size_t      uiPos_;
+        T*               pEntry_;
+    };
+
+    explicit intrusive_hmap( size_type uiExpected = 0 ) {
+        if (0 != pu_hmap_init( &map_, &ops_, uiExpected )) {
+            throw std::bad_alloc();
+        }
+    }
+    ~intrusive_hmap() { pu_hmap_destroy( &map_ ); }
+
+    intrusive_hmap( intrusive_hmap&& other ) noexcept : map_( other.map_ ) {
+        other.map_.tblCur = pu_hmap_table_t();
+        other.map_.tblOld = pu_hmap_table_t();
+    }
+    intrusive_hmap& operator=( intrusive_hmap&& other ) noexcept {
+        if (this != &other) {
+            pu_hmap_destroy( &map_ );
+            map_ = other.map_;
+            other.map_.tblCur = pu_hmap_table_t();
+            other.map_.tblOld = pu_hmap_table_t();
+        }
+        return *this;
+    }
+    intrusive_hmap( const intrusive_hmap& ) = delete;
+    intrusive_hmap& operator=( const intrusive_hmap& ) = delete;
+
+    iterator  begin() const noexcept { return iterator( &map_ ); }
+    iterator  end() const noexcept   { return iterator(); }
+    size_type size() const noexcept  { return pu_hmap_count( &map_ ); }
+    bool      empty() const noexcept { return 0 == size(); }
+
+    /* Adds an object, equal keys allowed. Throws std::bad_alloc if the map cannot grow */
+    void insert( T& entry ) {
+        if (0 != pu_hmap_insert( &map_, &entry )) {
+            throw std::bad_alloc();
+        }
+    }
+
+    /* Adds an object unless one with the same key is there already */
+    bool insert_unique( T& entry ) {
+        if (nullptr != find( Traits::key( entry ) )) {
+            return false;
+        }
+        insert( entry );
+        return true;
+    }
+
+    T* find( const key_type& key ) const noexcept { return static_cast<T*>(pu_hmap_find( &map_, &key )); }
+
+    /* Removes an object with this key, returns it (nullptr if none) */
+    T* erase( const key_type& key ) noexcept { return static_cast<T*>(pu_hmap_remove( &map_, &key )); }
+
+    /* Removes this object */
+    bool erase( T& entry ) noexcept { return pu_hmap_remove_entry( &map_, &entry ); }
+
+private:
+    static uint32_t hash_fct( const void* pKey ) noexcept {
+        return Traits::hash( *static_cast<const key_type*>(pKey) );
+    }
+    static bool equal_fct( const void* pEntry, const void* pKey ) noexcept {
+        return Traits::equal( Traits::key( *static_cast<const T*>(pEntry) ), *static_cast<const key_type*>(pKey) );
+    }
+    static const void* key_fct( const void* pEntry ) noexcept {
+        return &Traits::key( *static_cast<const T*>(pEntry) );
+    }
+
+    static const pu_hmap_ops_t ops_;
+    pu_hmap_t                  map_;
+};
+
+template <typename T, typename Traits>
+const pu_hmap_ops_t intrusive_hmap<T, Traits>::ops_ = {
+    &intrusive_hmap<T, Traits>::hash_fct,
+    &intrusive_hmap<T, Traits>::equal_fct,
+    &intrusive_hmap<T, Traits>::key_fct
+};
+
+} // namespace pu
+
+/**
+ * @}
+ */
+
+#endif /* _PUHMAP_HPP_ */
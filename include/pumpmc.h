@@ -0,0 +1,383 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+#ifndef _PUMPMC_H_
+#define _PUMPMC_H_
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @file     pumpmc.h
+ * @date     2026-10-17
+ * @author   Martin
+ * @brief    Bounded multi-producer / multi-consumer queue
+ * Interface for:
+ * - A fixed size, power of two, MPMC array queue of fixed size elements (after D. Vyukov)
+ */
+
+/**** Includes ***************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+/**** Definitions ************************************************************/
+
+/**
+ * @brief MPMC queue
+ * @defgroup PMPMC MPMC queue
+ * @ingroup  SYSUTILS
+ *
+ * @brief
+ * Hands fixed size records from any number of producer threads (GPIO readers, timers, network
+ * handlers) to any number of consumer threads, with no locks and no allocation after
+ * \ref pu_mpmc_create. It replaces the mutex protected SLL work list: that serialises every
+ * producer and consumer on one lock, and SLL_ELEM_ADD_TAIL walks the whole list on every add.
+ *
+ * @section pmpmc_sect_1 Design
+ * An array of cells, each holding a 32 bit sequence number next to the element. Two free
+ * running positions, the enqueue position and the dequeue position, live on separate cache
+ * lines. The sequence number of a cell says whose turn it is:
+ * - seq == pos     : free, the producer that claims enqueue position pos may fill it
+ * - seq == pos + 1 : full, the consumer that claims dequeue position pos may empty it
+ * - anything else  : the cell is still in use by the previous lap, i.e. full (producer) or
+ *   empty (consumer)
+ * .
+ * A producer reads the cell at its position, and if it is free claims the position with a
+ * compare-and-swap. Losing the race just means another producer got there first: reload and
+ * try the next position. The winner owns the cell outright, copies the element in and bumps the
+ * sequence number to pos + 1. A consumer does the same on the dequeue side and sets the
+ * sequence number to pos + capacity, i.e. free for the producer one lap later. Producers and
+ * consumers only contend with their own kind, and only on the position word.
+ *
+ * @section pmpmc_sect_2 Memory ordering
+ * - The cell sequence number carries the data. The owner of a cell writes the element, then
+ *   stores the sequence number with release semantics. The next owner loads the sequence
+ *   number with acquire semantics before it touches the element. So a consumer always sees the
+ *   complete element, and a producer never overwrites an element a consumer is still copying.
+ * - The position compare-and-swap only decides who owns a cell, it carries no data, so it is
+ *   relaxed. The acquire on the sequence number that made the cell look free is what orders
+ *   the copy.
+ * - The blocking variants add an event count per direction. A sleeper sets bit 0 of the futex
+ *   word, issues a full fence and tries again before it sleeps on that value; the other side
+ *   publishes, issues a full fence and then reads the word. One of the two is bound to see the
+ *   other, so a wake-up cannot be lost. If the bit is set, the waker clears it, bumps the count
+ *   (so a sleeper that is not in the kernel yet does not go in) and wakes every sleeper.
+ * - Only the empty to non-empty (full to non-full) edge makes a system call: once the sleepers
+ *   are awake the bit stays clear until one of them finds the queue empty again. Waking all of
+ *   them costs a few extra context switches when several are asleep, but nobody has to count
+ *   sleepers, and a sleeper that times out cannot swallow a wake-up meant for another.
+ *   Queues created without bBlocking skip the fence and the check.
+ * .
+ *
+ * @section pmpmc_sect_3 Caveats
+ * - Elements are copied in and out, keep them small (a pointer, or a small record).
+ * - The queue is FIFO in the order the positions were claimed. Elements from one producer
+ *   reach any one consumer in the order they were pushed.
+ * - It is not strictly lock-free: a producer preempted between claiming a cell and publishing
+ *   it holds up the consumer of that cell (which sees the queue as empty) until it runs again.
+ *   Under SCHED_FIFO this is the same hazard as a spinlock, use the blocking calls.
+ * .
+ *
+ * @code
+ * pu_mpmc_t queue;
+ * pu_mpmc_create( &queue, 1024, sizeof(job_t), true );
+ *
+ * // any producer, do not wait if full
+ * if (!pu_mpmc_trypush( &queue, &job )) { uiDropped++; }
+ *
+ * // any consumer, wait up to 100ms
+ * if (0 == pu_mpmc_pop( &queue, &job, 100 )) { do_job( &job ); }
+ * @endcode
+ *
+ * @{
+ */
+
+/**
+ * @brief Cache line size the positions are padded to (Cortex-A8 and x86: 64 bytes)
+ */
+#if !defined(PU_MPMC_CACHE_LINE)
+    #define PU_MPMC_CACHE_LINE (64)
+#endif /* !defined(PU_MPMC_CACHE_LINE) */
+
+/**
+ * @brief MPMC queue. Treat as opaque. Heap allocated queues should be PU_MPMC_CACHE_LINE aligned
+ */
+typedef struct
+{
+    /* Read only after create */
+    uint8_t* pCells;                         /*!< uiMask + 1 cells of uiStride bytes   */
+    uint32_t uiMask;                         /*!< Capacity - 1                         */
+    uint32_t uiElemSize;                     /*!< Bytes per element                    */
+    uint32_t uiStride;                       /*!< Bytes per cell (sequence + element)  */
+    bool     bBlocking;                      /*!< pu_mpmc_push/pu_mpmc_pop supported   */
+
+    /* Producers */
+    uint32_t uiEnqPos __attribute__((aligned(PU_MPMC_CACHE_LINE))); /*!< Next cell to fill */
+
+    /* Consumers */
+    uint32_t uiDeqPos __attribute__((aligned(PU_MPMC_CACHE_LINE))); /*!< Next cell to empty */
+
+    /* Futex words of a blocking queue. Bit 0: somebody sleeps (or is about to), bits 1..31: wake count */
+    uint32_t uiNotEmpty __attribute__((aligned(PU_MPMC_CACHE_LINE))); /*!< Consumers sleep here */
+    uint32_t uiNotFull;                      /*!< Producers sleep here                 */
+}   pu_mpmc_t;
+
+/**
+ * @brief   Creates a queue
+ *
+ * @param[out] pQueue     : Queue
+ * @param[in]  uiCapacity : Elements, rounded up to a power of two (2 .. 2^30)
+ * @param[in]  uiElemSize : Bytes per element
+ * @param[in]  bBlocking  : true if \ref pu_mpmc_push or \ref pu_mpmc_pop will be used
+ * @retval  0 for success
+ * @retval  EINVAL for a bad size
+ * @retval  ENOMEM
+ *
+ * @pre     pQueue is non-NULL
+ * @post    The queue is empty
+ */
+int pu_mpmc_create(
+    pu_mpmc_t* pQueue,
+    uint32_t   uiCapacity,
+    uint32_t   uiElemSize,
+    bool       bBlocking );
+
+/**
+ * @brief   Destroys a queue, every producer and consumer must be done with it
+ *
+ * @param[in] pQueue : Queue
+ */
+void pu_mpmc_destroy( pu_mpmc_t* pQueue );
+
+/**
+ * @brief   Sleeping part of \ref pu_mpmc_push, do not call directly
+ */
+int pu_mpmc_push_slow(
+    pu_mpmc_t*  pQueue,
+    const void* pElem,
+    uint32_t    uiTimeoutMs );
+
+/**
+ * @brief   Sleeping part of \ref pu_mpmc_pop, do not call directly
+ */
+int pu_mpmc_pop_slow(
+    pu_mpmc_t* pQueue,
+    void*      pElem,
+    uint32_t   uiTimeoutMs );
+
+/**
+ * @brief   Wakes the sleeping consumers or producers, do not call directly
+ */
+void pu_mpmc_wake( uint32_t* puiWord );
+
+/**
+ * @brief   Capacity of a queue (elements)
+ *
+ * @param[in] pQueue : Queue
+ * @return  Capacity
+ */
+static inline uint32_t pu_mpmc_capacity( const pu_mpmc_t* pQueue )
+{
+    return (pQueue->uiMask + 1);
+}
+/* pu_mpmc_capacity */
+
+/**
+ * @brief   Fill level, a snapshot: it may be stale by the time the caller looks at it
+ *
+ * @param[in] pQueue : Queue
+ * @return  Number of elements claimed by producers and not yet claimed by consumers
+ */
+static inline uint32_t pu_mpmc_count( const pu_mpmc_t* pQueue )
+{
+    uint32_t uiDeq = __atomic_load_n( &(pQueue->uiDeqPos), __ATOMIC_ACQUIRE );
+    uint32_t uiEnq = __atomic_load_n( &(pQueue->uiEnqPos), __ATOMIC_ACQUIRE );
+    uint32_t uiCount = uiEnq - uiDeq;
+
+    /* The two loads are not one snapshot, a consumer may have passed the enqueue position we read */
+    return (((int32_t)uiCount < 0) ? 0 : ((uiCount > pu_mpmc_capacity( pQueue )) ? pu_mpmc_capacity( pQueue ) : uiCount));
+}
+/* pu_mpmc_count */
+
+/**
+ * @brief   Pushes one element, any thread, never blocks
+ *
+ * @param[in] pQueue : Queue
+ * @param[in] pElem  : Element to push (uiElemSize bytes)
+ * @return  true if pushed, false if the queue is full
+ */
+static inline bool pu_mpmc_trypush(
+    pu_mpmc_t*  pQueue,
+    const void* pElem )
+{
+    uint32_t  uiPos = __atomic_load_n( &(pQueue->uiEnqPos), __ATOMIC_RELAXED );
+    uint32_t* pSeq;
+
+    for (;;)
+    {
+        int32_t iDiff;
+
+        pSeq  = (uint32_t*)(void*)(pQueue->pCells + ((size_t)(uiPos & pQueue->uiMask) * pQueue->uiStride));
+        iDiff = (int32_t)(__atomic_load_n( pSeq, __ATOMIC_ACQUIRE ) - uiPos);
+        if (0 == iDiff)
+        {
+            /* Free, claim it. On failure uiPos is reloaded with the winner's value */
+            if (__atomic_compare_exchange_n( &(pQueue->uiEnqPos), &uiPos, uiPos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED ))
+            {
+                break;
+            }
+        }
+        else if (iDiff < 0)
+        {
+            /* Still holds the element from the previous lap */
+            return (false);
+        }
+        else
+        {
+            /* Another producer filled it since we read the position */
+            uiPos = __atomic_load_n( &(pQueue->uiEnqPos), __ATOMIC_RELAXED );
+        }
+    }
+
+    /* The cell is ours, fill it and hand it to the consumer of this position */
+    memcpy( pSeq + 1, pElem, pQueue->uiElemSize );
+    __atomic_store_n( pSeq, uiPos + 1, __ATOMIC_RELEASE );
+
+    /* Pairs with the fence in pu_mpmc_pop_slow: either we see the waiter, or it sees the element */
+    if (pQueue->bBlocking)
+    {
+        __atomic_thread_fence( __ATOMIC_SEQ_CST );
+        if (0 != (__atomic_load_n( &(pQueue->uiNotEmpty), __ATOMIC_RELAXED ) & 1u))
+        {
+            pu_mpmc_wake( &(pQueue->uiNotEmpty) );
+        }
+    }
+    return (true);
+}
+/* pu_mpmc_trypush */
+
+/**
+ * @brief   Pops one element, any thread, never blocks
+ *
+ * @param[in]  pQueue : Queue
+ * @param[out] pElem  : Room for one element (uiElemSize bytes)
+ * @return  true if popped, false if the queue is empty
+ */
+static inline bool pu_mpmc_trypop(
+    pu_mpmc_t* pQueue,
+    void*      pElem )
+{
+    uint32_t  uiPos = __atomic_load_n( &(pQueue->uiDeqPos), __ATOMIC_RELAXED );
+    uint32_t* pSeq;
+
+    for (;;)
+    {
+        int32_t iDiff;
+
+        pSeq  = (uint32_t*)(void*)(pQueue->pCells + ((size_t)(uiPos & pQueue->uiMask) * pQueue->uiStride));
+        iDiff = (int32_t)(__atomic_load_n( pSeq, __ATOMIC_ACQUIRE ) - (uiPos + 1));
+        if (0 == iDiff)
+        {
+            if (__atomic_compare_exchange_n( &(pQueue->uiDeqPos), &uiPos, uiPos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED ))
+            {
+                break;
+            }
+        }
+        else if (iDiff < 0)
+        {
+            /* Not filled yet (or its producer has not published it yet) */
+            return (false);
+        }
+        else
+        {
+            uiPos = __atomic_load_n( &(pQueue->uiDeqPos), __ATOMIC_RELAXED );
+        }
+    }
+
+    /* Empty it and hand it to the producer one lap later */
+    memcpy( pElem, pSeq + 1, pQueue->uiElemSize );
+    __atomic_store_n( pSeq, uiPos + pu_mpmc_capacity( pQueue ), __ATOMIC_RELEASE );
+
+    /* Pairs with the fence in pu_mpmc_push_slow */
+    if (pQueue->bBlocking)
+    {
+        __atomic_thread_fence( __ATOMIC_SEQ_CST );
+        if (0 != (__atomic_load_n( &(pQueue->uiNotFull), __ATOMIC_RELAXED ) & 1u))
+        {
+            pu_mpmc_wake( &(pQueue->uiNotFull) );
+        }
+    }
+    return (true);
+}
+/* pu_mpmc_trypop */
+
+/**
+ * @brief   Pushes one element, waiting for room. Blocking queue only
+ *
+ * @param[in] pQueue      : Queue, created with bBlocking
+ * @param[in] pElem       : Element to push
+ * @param[in] uiTimeoutMs : Timeout, PU_FUTEX_FOREVER (UINT32_MAX) for none
+ * @retval  0 for success
+ * @retval  ETIMEDOUT if the queue stayed full
+ */
+static inline int pu_mpmc_push(
+    pu_mpmc_t*  pQueue,
+    const void* pElem,
+    uint32_t    uiTimeoutMs )
+{
+    if (pu_mpmc_trypush( pQueue, pElem ))
+    {
+        return (0);
+    }
+    return ((0 == uiTimeoutMs) ? ETIMEDOUT : pu_mpmc_push_slow( pQueue, pElem, uiTimeoutMs ));
+}
+/* pu_mpmc_push */
+
+/**
+ * @brief   Pops one element, waiting for one. Blocking queue only
+ *
+ * @param[in]  pQueue      : Queue, created with bBlocking
+ * @param[out] pElem       : Room for one element
+ * @param[in]  uiTimeoutMs : Timeout, PU_FUTEX_FOREVER (UINT32_MAX) for none
+ * @retval  0 for success
+ * @retval  ETIMEDOUT if the queue stayed empty
+ */
+static inline int pu_mpmc_pop(
+    pu_mpmc_t* pQueue,
+    void*      pElem,
+    uint32_t   uiTimeoutMs )
+{
+    if (pu_mpmc_trypop( pQueue, pElem ))
+    {
+        return (0);
+    }
+    return ((0 == uiTimeoutMs) ? ETIMEDOUT : pu_mpmc_pop_slow( pQueue, pElem, uiTimeoutMs ));
+}
+/* pu_mpmc_pop */
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* _PUMPMC_H_ */
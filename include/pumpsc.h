@@ -0,0 +1,209 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+#ifndef _PUMPSC_H_
+#define _PUMPSC_H_
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @file     pumpsc.h
+ * @date     2026-10-17
+ * @author   Martin
+ * @brief    Intrusive multi-producer / single consumer queue
+ * Interface for:
+ * - An unbounded, intrusive, lock-free MPSC queue of linked nodes (after D. Vyukov)
+ */
+
+/**** Includes ***************************************************************/
+#include <stdbool.h>
+#include <stddef.h>
+
+/**** Definitions ************************************************************/
+
+/**
+ * @brief MPSC queue
+ * @defgroup PMPSC MPSC queue
+ * @ingroup  SYSUTILS
+ *
+ * @brief
+ * Any number of threads push, exactly one thread pops. The queue never allocates: the link
+ * lives in the queued object (\ref pu_mpsc_node_t, usually the first member), so pushing a
+ * message hands over the pointer, not a copy. This is what backs the pu_thread mailboxes.
+ *
+ * @section pmpsc_sect_1 Design
+ * A singly linked list from the tail (oldest, consumer end) to the head (newest). A permanent
+ * stub node keeps the list from ever being empty, so push and pop never touch the same pointer:
+ * - push: clear the node's link, swap it in as the new head, then link the previous head to it.
+ *   One atomic exchange, wait-free.
+ * - pop: take the tail if it has a successor. The last node is only taken after the stub has
+ *   been pushed behind it, so the tail always has something to point at.
+ * .
+ *
+ * @section pmpsc_sect_2 Memory ordering
+ * - The head exchange is acquire-release: it orders the node contents (written by the pusher)
+ *   before the node becomes the head, and serialises the pushers among themselves.
+ * - The link store is a release, the consumer loads links with acquire. That is the hand-over:
+ *   a consumer that sees a link sees everything written to the node before the push.
+ * - Between the exchange and the link store the new node is the head but is not yet reachable
+ *   from the tail. A pop in that window reports the queue empty (\ref pu_mpsc_pop returns NULL
+ *   although \ref pu_mpsc_empty says false). The pusher is one store away from finishing, so a
+ *   consumer that polls just tries again; a sleeping consumer is woken after the link store.
+ * .
+ *
+ * @code
+ * typedef struct { pu_mpsc_node_t node; int iData; } item_t;
+ * static pu_mpsc_t queue;
+ *
+ * pu_mpsc_init( &queue );
+ * pu_mpsc_push( &queue, &(pItem->node) );            // any thread
+ * item_t* pGot = (item_t*)pu_mpsc_pop( &queue );      // the consumer, NULL if empty
+ * @endcode
+ *
+ * @{
+ */
+
+/**
+ * @brief Cache line size the ends of the queue are padded to
+ */
+#if !defined(PU_MPSC_CACHE_LINE)
+    #define PU_MPSC_CACHE_LINE (64)
+#endif /* !defined(PU_MPSC_CACHE_LINE) */
+
+/**
+ * @brief Queue link, embed in the queued object. Owned by the queue while the object is queued
+ */
+typedef struct pu_mpsc_node_tag
+{
+    struct pu_mpsc_node_tag* pMpscNext;      /*!< Next (newer) node                    */
+}   pu_mpsc_node_t;
+
+/**
+ * @brief MPSC queue. Treat as opaque. Not copyable: the stub links point into it
+ */
+typedef struct
+{
+    pu_mpsc_node_t* pHead __attribute__((aligned(PU_MPSC_CACHE_LINE))); /*!< Newest, producers swap here */
+    pu_mpsc_node_t* pTail __attribute__((aligned(PU_MPSC_CACHE_LINE))); /*!< Oldest, consumer only */
+    pu_mpsc_node_t  stub;                    /*!< Keeps the list non-empty             */
+}   pu_mpsc_t;
+
+/**
+ * @brief   Initialises a queue to empty
+ *
+ * @param[out] pQueue : Queue
+ */
+static inline void pu_mpsc_init( pu_mpsc_t* pQueue )
+{
+    pQueue->stub.pMpscNext = NULL;
+    pQueue->pTail          = &(pQueue->stub);
+    __atomic_store_n( &(pQueue->pHead), &(pQueue->stub), __ATOMIC_RELEASE );
+}
+/* pu_mpsc_init */
+
+/**
+ * @brief   Pushes a node, any thread, wait-free
+ *
+ * @param[in] pQueue : Queue
+ * @param[in] pNode  : Node, must not be queued already. The queue owns it until it is popped
+ */
+static inline void pu_mpsc_push(
+    pu_mpsc_t*      pQueue,
+    pu_mpsc_node_t* pNode )
+{
+    pu_mpsc_node_t* pPrev;
+
+    __atomic_store_n( &(pNode->pMpscNext), NULL, __ATOMIC_RELAXED );
+    pPrev = __atomic_exchange_n( &(pQueue->pHead), pNode, __ATOMIC_ACQ_REL );
+    __atomic_store_n( &(pPrev->pMpscNext), pNode, __ATOMIC_RELEASE );
+}
+/* pu_mpsc_push */
+
+/**
+ * @brief   Pops the oldest node, consumer only
+ *
+ * @param[in] pQueue : Queue
+ * @return  The node, NULL if the queue is empty (or the newest push is not linked in yet)
+ */
+static inline pu_mpsc_node_t* pu_mpsc_pop( pu_mpsc_t* pQueue )
+{
+    pu_mpsc_node_t* pTail = pQueue->pTail;
+    pu_mpsc_node_t* pNext = __atomic_load_n( &(pTail->pMpscNext), __ATOMIC_ACQUIRE );
+
+    /* Skip the stub */
+    if (pTail == &(pQueue->stub))
+    {
+        if (NULL == pNext)
+        {
+            return (NULL);
+        }
+        pQueue->pTail = pNext;
+        pTail         = pNext;
+        pNext         = __atomic_load_n( &(pTail->pMpscNext), __ATOMIC_ACQUIRE );
+    }
+
+    /* The common case, the tail has a successor */
+    if (NULL != pNext)
+    {
+        pQueue->pTail = pNext;
+        return (pTail);
+    }
+
+    /* The tail is the last linked node. If it is not the head, a push is half way */
+    if (pTail != __atomic_load_n( &(pQueue->pHead), __ATOMIC_ACQUIRE ))
+    {
+        return (NULL);
+    }
+
+    /* Put the stub behind it, then it has a successor */
+    pu_mpsc_push( pQueue, &(pQueue->stub) );
+    pNext = __atomic_load_n( &(pTail->pMpscNext), __ATOMIC_ACQUIRE );
+    if (NULL != pNext)
+    {
+        pQueue->pTail = pNext;
+        return (pTail);
+    }
+    return (NULL);
+}
+/* pu_mpsc_pop */
+
+/**
+ * @brief   Checks for queued nodes, consumer only
+ *
+ * @param[in] pQueue : Queue
+ * @return  true if nothing is queued (or being queued)
+ */
+static inline bool pu_mpsc_empty( pu_mpsc_t* pQueue )
+{
+    /* Any other tail is a node that has not been popped yet */
+    return ((pQueue->pTail == &(pQueue->stub)) &&
+            (NULL == __atomic_load_n( &(pQueue->stub.pMpscNext), __ATOMIC_ACQUIRE )) &&
+            (&(pQueue->stub) == __atomic_load_n( &(pQueue->pHead), __ATOMIC_ACQUIRE )));
+}
+/* pu_mpsc_empty */
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* _PUMPSC_H_ */
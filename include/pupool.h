@@ -0,0 +1,206 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+#ifndef _PUPOOL_H_
+#define _PUPOOL_H_
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @file     pupool.h
+ * @date     2026-10-16
+ * @author   Martin
+ * @brief    Work stealing thread pool
+ * Interface for:
+ * - Pool creation and destruction
+ * - Task submission (blocking and non-blocking)
+ */
+
+/**** Includes ***************************************************************/
+#include <stddef.h>
+#include "posutils.h"
+
+/**** Definitions ************************************************************/
+
+/**
+ * @brief Work stealing thread pool
+ * @defgroup PPOOL Work stealing thread pool
+ * @ingroup  SYSUTILS
+ *
+ * @brief
+ * A fixed set of worker threads that execute small tasks. Creating a pthread per unit of
+ * work is expensive (stack mmap, clone, registry update, join), the pool pays that cost once.
+ *
+ * @section ppool_sect_1 Workers
+ * The workers are normal pu_threads, i.e. they are created with \ref pu_thread_create and
+ * show up in the thread list (\ref pu_thread_get_number_of_threads). They all share the
+ * name passed to \ref pu_pool_create.
+ *
+ * The pool owns its workers: \ref pu_thread_join_all leaves them to \ref pu_pool_destroy. A stop
+ * request to any worker (or \ref pu_thread_request_stop_all) stops the whole pool: new tasks are
+ * refused, the queued ones still run (one that slips in as the pool stops is run by the poster),
+ * then the workers exit. The pool must still be destroyed.
+ *
+ * @section ppool_sect_2 Deques and stealing
+ * Every worker owns a bounded deque of tasks:
+ * - a task submitted by a worker goes to the bottom of its own deque
+ * - a task submitted by any other thread goes to the bottom of a deque picked round robin
+ * - a worker takes tasks from the bottom of its own deque (LIFO, cache warm)
+ * - an idle worker steals from the top of the other deques (FIFO, oldest first)
+ * - when there is nothing to run or to steal the worker sleeps
+ * .
+ * Each deque has its own fast mutex, so the only contention is between an owner and a thief
+ * on the same deque.
+ *
+ * @section ppool_sect_3 Back pressure
+ * The deques are bounded. When every deque is full:
+ * - \ref pu_pool_post fails with EAGAIN
+ * - \ref pu_pool_submit runs the task in the calling thread ("caller runs")
+ * .
+ *
+ * @code
+ * static void my_task( void* pArg ) { ... }
+ *
+ * pu_pool_t* pPool = PU_POOL_CREATE( 4, 256, 16*1024 );
+ * ASSERT( pPool );
+ * for (i = 0; i < 1000; i++) {
+ *     pu_pool_submit( pPool, my_task, &aData[i] );
+ * }
+ * pu_pool_wait_idle( pPool );
+ * pu_pool_destroy( pPool );
+ * @endcode
+ *
+ * @{
+ */
+
+/**
+ * @brief   The function type for a pool task
+ *
+ * @param[in] pArg : Argument passed to the submit/post call
+ */
+typedef void (*pu_pool_task_fct_t)( void* pArg );
+
+/**
+ * @brief Opaque pool type
+ */
+typedef struct pu_pool_tag pu_pool_t;
+
+/**
+ * @brief   Creates a pool and starts the workers
+ *
+ * @param[in] uiNumWorkers : Number of worker threads, 0 means one per online CPU
+ * @param[in] uiQueueDepth : Depth of each worker deque, rounded up to a power of 2
+ * @param[in] uiStackSize  : Worker stack size (see \ref pu_thread_create)
+ * @param[in] szName       : Worker thread name, \b MUST be persistent
+ * @retval  Non-NULL pool on success
+ * @retval  NULL on failure
+ *
+ * @pre     posutils is initialised
+ * @post    All workers are running (and sleeping)
+ */
+pu_pool_t* pu_pool_create(
+    size_t      uiNumWorkers,
+    size_t      uiQueueDepth,
+    size_t      uiStackSize,
+    const char* szName );
+
+/**
+ * @brief   Creates a pool with the default worker name ("pu_pool_worker")
+ *
+ * @param[in] workers_    : Number of workers
+ * @param[in] depth_      : Deque depth per worker
+ * @param[in] stack_size_ : Worker stack size
+ * @see pu_pool_create
+ */
+#define PU_POOL_CREATE(workers_,depth_,stack_size_) \
+    pu_pool_create((workers_),(depth_),(stack_size_),"pu_pool_worker")
+
+/**
+ * @brief   Queues a task, never blocks
+ *
+ * @param[in] pPool   : The pool
+ * @param[in] fctTask : Task function
+ * @param[in] pArg    : Task argument
+ * @retval  0 the task is queued
+ * @retval  EAGAIN all the deques are full
+ * @retval  EINVAL bad parameter, or the pool is being destroyed
+ *
+ * @par Description
+ * Fire and forget. The caller owns the retry policy.
+ */
+int pu_pool_post(
+    pu_pool_t*         pPool,
+    pu_pool_task_fct_t fctTask,
+    void*              pArg );
+
+/**
+ * @brief   Queues a task, runs it in the caller if the pool is saturated
+ *
+ * @param[in] pPool   : The pool
+ * @param[in] fctTask : Task function
+ * @param[in] pArg    : Task argument
+ * @retval  0 the task is queued (or was run by the caller)
+ * @retval  EINVAL bad parameter, or the pool is being destroyed
+ */
+int pu_pool_submit(
+    pu_pool_t*         pPool,
+    pu_pool_task_fct_t fctTask,
+    void*              pArg );
+
+/**
+ * @brief   Waits until every queued task has completed
+ *
+ * @param[in] pPool : The pool
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ *
+ * @note
+ * Must \b NOT be called from a task, it would wait for itself
+ */
+int pu_pool_wait_idle( pu_pool_t* pPool );
+
+/**
+ * @brief   Gets the number of worker threads in the pool
+ *
+ * @param[in] pPool : The pool
+ * @return  Number of workers
+ */
+size_t pu_pool_get_number_of_workers( const pu_pool_t* pPool );
+
+/**
+ * @brief   Drains the pool, stops and joins the workers, frees the pool
+ *
+ * @param[in] pPool : The pool
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ *
+ * @par Description
+ * Tasks already queued are run to completion before the workers stop.
+ */
+int pu_pool_destroy( pu_pool_t* pPool );
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* _PUPOOL_H_ */
@@ -0,0 +1,306 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+#ifndef _PURING_H_
+#define _PURING_H_
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @file     puring.h
+ * @date     2026-10-17
+ * @author   Martin
+ * @brief    Lock-free single producer / single consumer ring buffer
+ * Interface for:
+ * - A fixed size, power of two, SPSC ring of fixed size elements
+ */
+
+/**** Includes ***************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/**** Definitions ************************************************************/
+
+/**
+ * @brief SPSC ring buffer
+ * @defgroup PRING SPSC ring buffer
+ * @ingroup  SYSUTILS
+ *
+ * @brief
+ * Hands fixed size records (e.g. GPIO edge events) from exactly one producer thread to exactly
+ * one consumer thread, with no locks and no allocation after \ref pu_ring_create.
+ *
+ * @section pring_sect_1 Design
+ * - The capacity is a power of two, so a free running 32 bit index is turned into a slot with a
+ *   mask, and head - tail is the fill level even across the wrap.
+ * - Only the producer writes the head, only the consumer writes the tail. Each publishes with a
+ *   release store and reads the other one with an acquire load.
+ * - Head and tail live on separate cache lines, and each side keeps a private copy of the other
+ *   side's index: it only reads the other cache line when its copy says the ring is full
+ *   (producer) or empty (consumer). In steady state the two cores do not share a written line.
+ * - Push and pop take batches. A batch is one or two memcpy calls and one index store, which
+ *   amortises the index traffic over the whole batch.
+ * .
+ *
+ * @section pring_sect_2 Blocking consumer
+ * A ring created with bBlocking set supports \ref pu_ring_pop_wait: an empty consumer announces
+ * that it is going to sleep on a futex word, and the producer checks that word after every push.
+ * The check is a fence and a load, the wake system call only happens when the consumer really
+ * sleeps. Rings without bBlocking skip the check; the consumer then has to poll.
+ *
+ * @code
+ * pu_ring_t ring;
+ * pu_ring_create( &ring, 256, sizeof(edge_t), true );
+ *
+ * // producer
+ * pu_ring_push( &ring, aEdges, uiCount );
+ *
+ * // consumer, up to 16 at a time, wait up to 100ms
+ * uint32_t uiGot = pu_ring_pop_wait( &ring, aEdges, 16, 100 );
+ * @endcode
+ *
+ * @{
+ */
+
+/**
+ * @brief Cache line size the ring is padded to (Cortex-A8 and x86: 64 bytes)
+ */
+#if !defined(PU_RING_CACHE_LINE)
+    #define PU_RING_CACHE_LINE (64)
+#endif /* !defined(PU_RING_CACHE_LINE) */
+
+/**
+ * @brief SPSC ring. Treat as opaque. Heap allocated rings should be PU_RING_CACHE_LINE aligned
+ */
+typedef struct
+{
+    /* Read only after create */
+    uint8_t* pBuf;                           /*!< uiMask + 1 elements                  */
+    uint32_t uiMask;                         /*!< Capacity - 1                         */
+    uint32_t uiElemSize;                     /*!< Bytes per element                    */
+    bool     bBlocking;                      /*!< pu_ring_pop_wait supported           */
+
+    /* Producer side */
+    uint32_t uiHead __attribute__((aligned(PU_RING_CACHE_LINE))); /*!< Next slot to write */
+    uint32_t uiTailCache;                    /*!< Producer's copy of the tail          */
+
+    /* Consumer side */
+    uint32_t uiTail __attribute__((aligned(PU_RING_CACHE_LINE))); /*!< Next slot to read  */
+    uint32_t uiHeadCache;                    /*!< Consumer's copy of the head          */
+
+    /* Futex word, read by the producer after every push of a blocking ring */
+    uint32_t uiSleeping __attribute__((aligned(PU_RING_CACHE_LINE))); /*!< 1 = consumer asleep */
+}   pu_ring_t;
+
+/**
+ * @brief   Creates a ring
+ *
+ * @param[out] pRing      : Ring
+ * @param[in]  uiCapacity : Elements, rounded up to a power of two (2 .. 2^30)
+ * @param[in]  uiElemSize : Bytes per element
+ * @param[in]  bBlocking  : true if the consumer will use \ref pu_ring_pop_wait
+ * @retval  0 for success
+ * @retval  EINVAL for a bad size
+ * @retval  ENOMEM
+ *
+ * @pre     pRing is non-NULL
+ * @post    The ring is empty
+ */
+int pu_ring_create(
+    pu_ring_t* pRing,
+    uint32_t   uiCapacity,
+    uint32_t   uiElemSize,
+    bool       bBlocking );
+
+/**
+ * @brief   Destroys a ring, the producer and consumer must be done with it
+ *
+ * @param[in] pRing : Ring
+ */
+void pu_ring_destroy( pu_ring_t* pRing );
+
+/**
+ * @brief   Sleeping part of \ref pu_ring_pop_wait, do not call directly
+ */
+uint32_t pu_ring_pop_wait_slow(
+    pu_ring_t* pRing,
+    void*      pElems,
+    uint32_t   uiMax,
+    uint32_t   uiTimeoutMs );
+
+/**
+ * @brief   Wakes a sleeping consumer, do not call directly
+ */
+void pu_ring_wake( pu_ring_t* pRing );
+
+/**
+ * @brief   Capacity of a ring (elements)
+ *
+ * @param[in] pRing : Ring
+ * @return  Capacity
+ */
+static inline uint32_t pu_ring_capacity( const pu_ring_t* pRing )
+{
+    return (pRing->uiMask + 1);
+}
+/* pu_ring_capacity */
+
+/**
+ * @brief   Fill level, exact for the producer or consumer, a snapshot for anybody else
+ *
+ * @param[in] pRing : Ring
+ * @return  Number of elements in the ring
+ */
+static inline uint32_t pu_ring_count( const pu_ring_t* pRing )
+{
+    return (__atomic_load_n( &(pRing->uiHead), __ATOMIC_ACQUIRE ) - __atomic_load_n( &(pRing->uiTail), __ATOMIC_ACQUIRE ));
+}
+/* pu_ring_count */
+
+/**
+ * @brief   Pushes up to uiCount elements, producer only, never blocks
+ *
+ * @param[in] pRing   : Ring
+ * @param[in] pElems  : Elements to push
+ * @param[in] uiCount : Number of elements
+ * @return  Number of elements pushed, less than uiCount if the ring is (nearly) full
+ */
+static inline uint32_t pu_ring_push(
+    pu_ring_t*  pRing,
+    const void* pElems,
+    uint32_t    uiCount )
+{
+    uint32_t uiHead = pRing->uiHead;
+    uint32_t uiFree = pu_ring_capacity( pRing ) - (uiHead - pRing->uiTailCache);
+    uint32_t uiSlot;
+    uint32_t uiFirst;
+
+    /* Only look at the consumer's line when the cached tail says there is not enough room */
+    if (uiFree < uiCount)
+    {
+        pRing->uiTailCache = __atomic_load_n( &(pRing->uiTail), __ATOMIC_ACQUIRE );
+        uiFree = pu_ring_capacity( pRing ) - (uiHead - pRing->uiTailCache);
+    }
+    uiCount = (uiCount < uiFree) ? uiCount : uiFree;
+    if (0 == uiCount)
+    {
+        return (0);
+    }
+
+    /* Up to the end of the buffer, then the rest from the start */
+    uiSlot  = uiHead & pRing->uiMask;
+    uiFirst = pu_ring_capacity( pRing ) - uiSlot;
+    uiFirst = (uiCount < uiFirst) ? uiCount : uiFirst;
+    memcpy( pRing->pBuf + ((size_t)uiSlot * pRing->uiElemSize), pElems, (size_t)uiFirst * pRing->uiElemSize );
+    if (uiFirst < uiCount)
+    {
+        memcpy( pRing->pBuf, (const uint8_t*)pElems + ((size_t)uiFirst * pRing->uiElemSize), (size_t)(uiCount - uiFirst) * pRing->uiElemSize );
+    }
+    __atomic_store_n( &(pRing->uiHead), uiHead + uiCount, __ATOMIC_RELEASE );
+
+    /* Pairs with the fence in the consumer: either we see it asleep, or it sees the new head */
+    if (pRing->bBlocking)
+    {
+        __atomic_thread_fence( __ATOMIC_SEQ_CST );
+        if (0 != __atomic_load_n( &(pRing->uiSleeping), __ATOMIC_RELAXED ))
+        {
+            pu_ring_wake( pRing );
+        }
+    }
+    return (uiCount);
+}
+/* pu_ring_push */
+
+/**
+ * @brief   Pops up to uiMax elements, consumer only, never blocks
+ *
+ * @param[in]  pRing  : Ring
+ * @param[out] pElems : Room for uiMax elements
+ * @param[in]  uiMax  : Maximum number of elements
+ * @return  Number of elements popped, 0 if the ring is empty
+ */
+static inline uint32_t pu_ring_pop(
+    pu_ring_t* pRing,
+    void*      pElems,
+    uint32_t   uiMax )
+{
+    uint32_t uiTail  = pRing->uiTail;
+    uint32_t uiAvail = pRing->uiHeadCache - uiTail;
+    uint32_t uiSlot;
+    uint32_t uiFirst;
+
+    /* Only look at the producer's line when the cached head says there is not enough */
+    if (uiAvail < uiMax)
+    {
+        pRing->uiHeadCache = __atomic_load_n( &(pRing->uiHead), __ATOMIC_ACQUIRE );
+        uiAvail = pRing->uiHeadCache - uiTail;
+    }
+    uiMax = (uiMax < uiAvail) ? uiMax : uiAvail;
+    if (0 == uiMax)
+    {
+        return (0);
+    }
+
+    uiSlot  = uiTail & pRing->uiMask;
+    uiFirst = pu_ring_capacity( pRing ) - uiSlot;
+    uiFirst = (uiMax < uiFirst) ? uiMax : uiFirst;
+    memcpy( pElems, pRing->pBuf + ((size_t)uiSlot * pRing->uiElemSize), (size_t)uiFirst * pRing->uiElemSize );
+    if (uiFirst < uiMax)
+    {
+        memcpy( (uint8_t*)pElems + ((size_t)uiFirst * pRing->uiElemSize), pRing->pBuf, (size_t)(uiMax - uiFirst) * pRing->uiElemSize );
+    }
+    __atomic_store_n( &(pRing->uiTail), uiTail + uiMax, __ATOMIC_RELEASE );
+    return (uiMax);
+}
+/* pu_ring_pop */
+
+/**
+ * @brief   Pops up to uiMax elements, waiting for at least one. Consumer of a blocking ring only
+ *
+ * @param[in]  pRing       : Ring, created with bBlocking
+ * @param[out] pElems      : Room for uiMax elements
+ * @param[in]  uiMax       : Maximum number of elements
+ * @param[in]  uiTimeoutMs : Timeout, PU_FUTEX_FOREVER (UINT32_MAX) for none
+ * @return  Number of elements popped, 0 on timeout
+ */
+static inline uint32_t pu_ring_pop_wait(
+    pu_ring_t* pRing,
+    void*      pElems,
+    uint32_t   uiMax,
+    uint32_t   uiTimeoutMs )
+{
+    uint32_t uiGot = pu_ring_pop( pRing, pElems, uiMax );
+    if ((0 != uiGot) || (0 == uiTimeoutMs) || (0 == uiMax))
+    {
+        return (uiGot);
+    }
+    return (pu_ring_pop_wait_slow( pRing, pElems, uiMax, uiTimeoutMs ));
+}
+/* pu_ring_pop_wait */
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* _PURING_H_ */
@@ -0,0 +1,232 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+#ifndef _PUSEQLOCK_H_
+#define _PUSEQLOCK_H_
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @file     puseqlock.h
+ * @date     2026-10-17
+ * @author   Martin
+ * @brief    Sequence lock for read-mostly shared state
+ * Interface for:
+ * - A seqlock with futex serialised writers and lock-free readers
+ */
+
+/**** Includes ***************************************************************/
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sched.h>
+#include "pufutex.h"
+
+/**** Definitions ************************************************************/
+
+/**
+ * @brief Sequence lock
+ * @defgroup PSEQ Sequence lock
+ * @ingroup  SYSUTILS
+ *
+ * @brief
+ * A sequence count protecting a small structure that is read far more often than it is
+ * written (calibration tables, line configuration, statistics).
+ *
+ * @section pseq_sect_1 How it works
+ * A writer makes the count odd, updates the data and makes the count even again. A reader notes
+ * the (even) count, copies the data and checks the count again: if it changed the copy may be
+ * torn, and the reader simply retries. Readers never write anything shared, so any number of
+ * them (on any number of cores) can read without bouncing a cache line, and a reader never
+ * blocks a writer. Writers are serialised by a \ref pu_futex_mutex_t.
+ *
+ * @section pseq_sect_2 Rules
+ * - Readers work on a \b copy, and only use it once \ref pu_seqlock_read_retry says it is good.
+ *   A torn copy must not be dereferenced (no pointers in the protected data, or at least never
+ *   follow them before the check).
+ * - Keep the data small: a reader copies all of it, and retries if a writer was busy.
+ * - A writer must not sleep while the count is odd, readers spin on it.
+ * .
+ * @code
+ * static pu_seqlock_t lockCal = PU_SEQLOCK_INITIALIZER;
+ * static cal_t        calShared;
+ *
+ * // reader
+ * cal_t cal;
+ * pu_seqlock_read( &lockCal, &cal, &calShared, sizeof(cal) );
+ *
+ * // writer
+ * pu_seqlock_write( &lockCal, &calShared, &calNew, sizeof(calNew) );
+ * @endcode
+ *
+ * @{
+ */
+
+/**
+ * @brief Number of spins on an odd count before a reader yields the CPU (the writer may be preempted)
+ */
+#if !defined(PU_SEQLOCK_SPIN)
+    #define PU_SEQLOCK_SPIN (100)
+#endif /* !defined(PU_SEQLOCK_SPIN) */
+
+/**
+ * @brief Sequence lock
+ */
+typedef struct
+{
+    uint32_t         uiSeq;                  /*!< Sequence count, odd = being written */
+    pu_futex_mutex_t mtxWriter;              /*!< Serialises the writers              */
+}   pu_seqlock_t;
+
+/**
+ * @brief Static initialiser for a \ref pu_seqlock_t
+ */
+#define PU_SEQLOCK_INITIALIZER { 0, PU_FUTEX_MUTEX_INITIALIZER }
+
+/**
+ * @brief   Initialises a sequence lock
+ *
+ * @param[out] pLock : Sequence lock
+ */
+static inline void pu_seqlock_init( pu_seqlock_t* pLock )
+{
+    __atomic_store_n( &(pLock->uiSeq), 0, __ATOMIC_RELAXED );
+    pu_futex_mutex_init( &(pLock->mtxWriter) );
+}
+/* pu_seqlock_init */
+
+/**
+ * @brief   Starts a write: takes the writer lock and makes the count odd
+ *
+ * @param[in] pLock : Sequence lock
+ */
+static inline void pu_seqlock_write_begin( pu_seqlock_t* pLock )
+{
+    pu_futex_mutex_lock( &(pLock->mtxWriter) );
+    __atomic_store_n( &(pLock->uiSeq), pLock->uiSeq + 1, __ATOMIC_RELAXED );
+    __atomic_thread_fence( __ATOMIC_RELEASE );
+}
+/* pu_seqlock_write_begin */
+
+/**
+ * @brief   Ends a write: makes the count even and releases the writer lock
+ *
+ * @param[in] pLock : Sequence lock
+ */
+static inline void pu_seqlock_write_end( pu_seqlock_t* pLock )
+{
+    __atomic_store_n( &(pLock->uiSeq), pLock->uiSeq + 1, __ATOMIC_RELEASE );
+    pu_futex_mutex_unlock( &(pLock->mtxWriter) );
+}
+/* pu_seqlock_write_end */
+
+/**
+ * @brief   Starts a read: waits for an even count and returns it
+ *
+ * @param[in] pLock : Sequence lock
+ * @return  The count, to be passed to \ref pu_seqlock_read_retry
+ */
+static inline uint32_t pu_seqlock_read_begin( const pu_seqlock_t* pLock )
+{
+    uint32_t uiSeq;
+    uint32_t uiSpin = 0;
+
+    while ((uiSeq = __atomic_load_n( &(pLock->uiSeq), __ATOMIC_ACQUIRE )) & 1)
+    {
+        if (++uiSpin < PU_SEQLOCK_SPIN)
+        {
+            PU_FUTEX_RELAX();
+        }
+        else
+        {
+            uiSpin = 0;
+            sched_yield();
+        }
+    }
+    return (uiSeq);
+}
+/* pu_seqlock_read_begin */
+
+/**
+ * @brief   Ends a read
+ *
+ * @param[in] pLock : Sequence lock
+ * @param[in] uiSeq : What \ref pu_seqlock_read_begin returned
+ * @return  true if a writer got in, i.e. the copy may be torn and the read must be repeated
+ */
+static inline bool pu_seqlock_read_retry( const pu_seqlock_t* pLock, uint32_t uiSeq )
+{
+    __atomic_thread_fence( __ATOMIC_ACQUIRE );
+    return (uiSeq != __atomic_load_n( &(pLock->uiSeq), __ATOMIC_RELAXED ));
+}
+/* pu_seqlock_read_retry */
+
+/**
+ * @brief   Consistent copy of protected data (read begin, copy, retry until good)
+ *
+ * @param[in]  pLock  : Sequence lock
+ * @param[out] pDst   : Private copy
+ * @param[in]  pSrc   : Protected data
+ * @param[in]  uiSize : Bytes to copy
+ */
+static inline void pu_seqlock_read(
+    const pu_seqlock_t* pLock,
+    void*               pDst,
+    const void*         pSrc,
+    size_t              uiSize )
+{
+    uint32_t uiSeq;
+
+    do
+    {
+        uiSeq = pu_seqlock_read_begin( pLock );
+        memcpy( pDst, pSrc, uiSize );
+    } while (pu_seqlock_read_retry( pLock, uiSeq ));
+}
+/* pu_seqlock_read */
+
+/**
+ * @brief   Replaces protected data (write begin, copy, write end)
+ *
+ * @param[in]  pLock  : Sequence lock
+ * @param[out] pDst   : Protected data
+ * @param[in]  pSrc   : New value
+ * @param[in]  uiSize : Bytes to copy
+ */
+static inline void pu_seqlock_write(
+    pu_seqlock_t* pLock,
+    void*         pDst,
+    const void*   pSrc,
+    size_t        uiSize )
+{
+    pu_seqlock_write_begin( pLock );
+    memcpy( pDst, pSrc, uiSize );
+    pu_seqlock_write_end( pLock );
+}
+/* pu_seqlock_write */
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* _PUSEQLOCK_H_ */
@@ -128,8 +128,8 @@ if (NULL == (list)) {               \
  *
  * @par Description
  * Adds the element to the list. The type of the element must be "type*", i.e. a pointer to a structure
- * of the correct type. Always adds to the tail. The \ref SLL_ELEM_ADD is much more efficient, this call is
- * for cases where you want to treat the SLL like a queue, i.e. FIFO
+ * of the correct type. Always adds to the tail, by walking the whole list: O(n) per call. For a
+ * queue (FIFO) use the SLLQ_XXX macros below, they keep a tail pointer.
  */
 #define SLL_ELEM_ADD_TAIL( type, list, elem ) { \
 if (NULL == (list)) {                           \
@@ -177,6 +177,155 @@ if (NULL == (list)) {                           \
  */
 #define SLL_FOR_EACH( list, temp ) for ((temp) = (list); (temp) != NULL; (temp) = (temp)->pSllNextElem)
 
+/**
+ * A queue: the same elements (\ref SLL_ENTRY), plus a tail pointer
+ * @param[in] tag_type : The forward referenced "tag" type of the structure
+ *
+ * @par Description
+ * Head and tail in one struct, so pushing to the tail, popping the head and joining two queues
+ * are all O(1). The elements are the same as for a plain list, and the head is a plain list
+ * (SLL_FOR_EACH works on it), only the tail has to be kept right. Empty is head == tail == NULL.
+ * @code
+ * typedef struct job_tag
+ * {
+ *     int iId;
+ *     SLL_ENTRY(job_tag);
+ * }   job_t;
+ *
+ * static SLLQ_HEAD(job_tag) qJobs = SLLQ_INITIALIZER;
+ *
+ * SLLQ_PUSH_TAIL( qJobs, pJob );      // producer
+ * SLLQ_POP_HEAD( qJobs, pJob );       // consumer, pJob is NULL if the queue was empty
+ * @endcode
+ * Every SLLQ_HEAD is a distinct (anonymous) struct type. If queues are passed to functions,
+ * typedef it once: typedef SLLQ_HEAD(job_tag) job_queue_t;
+ */
+#define SLLQ_HEAD( tag_type ) struct { struct tag_type* pSllqHead; struct tag_type* pSllqTail; }
+
+/**
+ * Static initialiser for an empty queue
+ */
+#define SLLQ_INITIALIZER { NULL, NULL }
+
+/**
+ * Empties a queue (the elements are not touched)
+ * @param[in] queue : The queue (not a pointer)
+ */
+#define SLLQ_INIT( queue ) { (queue).pSllqHead = NULL; (queue).pSllqTail = NULL; }
+
+/**
+ * True if the queue is empty
+ * @param[in] queue : The queue
+ */
+#define SLLQ_IS_EMPTY( queue ) (NULL == (queue).pSllqHead)
+
+/**
+ * The first (oldest) and last (newest) elements, NULL if the queue is empty
+ * @param[in] queue : The queue
+ */
+#define SLLQ_FIRST( queue ) ((queue).pSllqHead)
+#define SLLQ_LAST( queue )  ((queue).pSllqTail)
+
+/**
+ * Adds an element to the tail of the queue, O(1)
+ * @param[in] queue : The queue
+ * @param[in] elem  : The element to add (type*)
+ */
+#define SLLQ_PUSH_TAIL( queue, elem ) {         \
+    (elem)->pSllNextElem = NULL;                \
+    if (NULL == (queue).pSllqTail) {            \
+        (queue).pSllqHead = (elem);             \
+    } else {                                    \
+        (queue).pSllqTail->pSllNextElem = (elem); \
+    }                                           \
+    (queue).pSllqTail = (elem);                 \
+}
+
+/**
+ * Adds an element to the head of the queue, O(1)
+ * @param[in] queue : The queue
+ * @param[in] elem  : The element to add (type*)
+ */
+#define SLLQ_PUSH_HEAD( queue, elem ) {         \
+    (elem)->pSllNextElem = (queue).pSllqHead;   \
+    if (NULL == (queue).pSllqTail) {            \
+        (queue).pSllqTail = (elem);             \
+    }                                           \
+    (queue).pSllqHead = (elem);                 \
+}
+
+/**
+ * Takes the element at the head of the queue, O(1)
+ * @param[in]  queue : The queue
+ * @param[out] elem  : Set to the element, NULL if the queue was empty
+ */
+#define SLLQ_POP_HEAD( queue, elem ) {          \
+    (elem) = (queue).pSllqHead;                 \
+    if (NULL != (elem)) {                       \
+        (queue).pSllqHead = (elem)->pSllNextElem; \
+        if (NULL == (queue).pSllqHead) {        \
+            (queue).pSllqTail = NULL;           \
+        }                                       \
+        (elem)->pSllNextElem = NULL;            \
+    }                                           \
+}
+
+/**
+ * Appends all of queue2 to the tail of queue1, O(1). queue2 is left empty
+ * @param[in,out] queue1 : The queue to append to
+ * @param[in,out] queue2 : The queue to move (same element type)
+ */
+#define SLLQ_CONCAT( queue1, queue2 ) {         \
+    if (NULL != (queue2).pSllqHead) {           \
+        if (NULL == (queue1).pSllqTail) {       \
+            (queue1).pSllqHead = (queue2).pSllqHead; \
+        } else {                                \
+            (queue1).pSllqTail->pSllNextElem = (queue2).pSllqHead; \
+        }                                       \
+        (queue1).pSllqTail = (queue2).pSllqTail; \
+        SLLQ_INIT( queue2 );                    \
+    }                                           \
+}
+
+/**
+ * Inserts all of queue2 at the head of queue1, O(1). queue2 is left empty
+ * @param[in,out] queue1 : The queue to insert into
+ * @param[in,out] queue2 : The queue to move (same element type)
+ *
+ * @par Description
+ * E.g. to put back a batch that was taken off the head but could not be handled.
+ */
+#define SLLQ_SPLICE_HEAD( queue1, queue2 ) {    \
+    if (NULL != (queue2).pSllqHead) {           \
+        (queue2).pSllqTail->pSllNextElem = (queue1).pSllqHead; \
+        if (NULL == (queue1).pSllqTail) {       \
+            (queue1).pSllqTail = (queue2).pSllqTail; \
+        }                                       \
+        (queue1).pSllqHead = (queue2).pSllqHead; \
+        SLLQ_INIT( queue2 );                    \
+    }                                           \
+}
+
+/**
+ * Takes the whole queue as a plain, NULL terminated list, O(1). The queue is left empty
+ * @param[in,out] queue : The queue
+ * @param[out]    list  : Set to the old head (type*), NULL if the queue was empty
+ *
+ * @par Description
+ * For a consumer that grabs everything under a lock, then works through the list without it.
+ */
+#define SLLQ_TAKE_ALL( queue, list ) {          \
+    (list) = (queue).pSllqHead;                 \
+    SLLQ_INIT( queue );                         \
+}
+
+/**
+ * Used to iterate through all the elements in the queue, head to tail
+ * @param[in] queue : The queue
+ * @param[in] temp  : The temporary pointer for the current element
+ */
+#define SLLQ_FOR_EACH( queue, temp ) SLL_FOR_EACH( (queue).pSllqHead, temp )
+
 /**
  * @}
  */
@@ -0,0 +1,250 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+#ifndef _SLL_HPP_
+#define _SLL_HPP_
+
+/**
+ * @file     sll.hpp
+ * @date     2026-10-17
+ * @author   Martin
+ * @brief    Type safe C++ view of the \ref SLL lists
+ * Interface for:
+ * - pu::intrusive_slist, a single linked list of structures with an SLL_ENTRY (or any T* member)
+ */
+
+/**** Includes ***************************************************************/
+#include <cstddef>
+#include <iterator>
+#include "sll.h"
+
+/**
+ * @addtogroup SLL
+ *
+ * @section sll_sect_cxx C++
+ * pu::intrusive_slist is the same list as the macros: one head pointer, the links in the
+ * elements, nothing allocated. It adds the type checking, forward iterators (so range-for and
+ * the std algorithms work) and, when asked for, a constant time size().
+ * @code
+ * typedef struct my_struct_tag {
+ *     int iData;
+ *     SLL_ENTRY(my_struct_tag);
+ * }   my_struct_t;
+ *
+ * pu::intrusive_slist<my_struct_t> lst;          // links through pSllNextElem
+ * lst.push_front( elem );
+ * for (my_struct_t& e : lst) {
+ *     ...
+ * }
+ * @endcode
+ * Like the macros, removal leaves the link of the removed element as it was.
+ * The list does not own the elements, the destructor leaves them alone. It does own its head,
+ * so it can be moved but not copied. release() and adopt() hand the head over to (and take it
+ * back from) code that uses the macros.
+ * @{
+ */
+
+namespace pu {
+
+namespace detail {
+/* Element count, only there when the list is asked to count */
+template <bool Count>
+struct slist_size
+{
+    void        size_inc() noexcept {}
+    void        size_dec() noexcept {}
+    void        size_set( std::size_t ) noexcept {}
+    void        size_swap( slist_size& ) noexcept {}
+};
+template <>
+struct slist_size<true>
+{
+    std::size_t uiSize_ = 0;
+    void        size_inc() noexcept { uiSize_++; }
+    void        size_dec() noexcept { uiSize_--; }
+    void        size_set( std::size_t uiSize ) noexcept { uiSize_ = uiSize; }
+    void        size_swap( slist_size& other ) noexcept {
+        std::size_t uiTmp = uiSize_; uiSize_ = other.uiSize_; other.uiSize_ = uiTmp;
+    }
+};
+} // namespace detail
+
+/**
+ * @brief Single linked list of T, linked through the member Next
+ * @tparam T     : Element type
+ * @tparam Next  : The link member, pSllNextElem (from SLL_ENTRY) by default
+ * @tparam Count : Keep a count of the elements, for a constant time size()
+ */
+template <typename T, T* T::*Next = &T::pSllNextElem, bool Count = false>
+class intrusive_slist : private detail::slist_size<Count>
+{
+public:
+    typedef T           value_type;
+    typedef T&          reference;
+    typedef const T&    const_reference;
+    typedef std::size_t size_type;
+
+    /**
+     * @brief Forward iterator, C is T or const T
+     */
+    template <typename C>
+    class basic_iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef T                         value_type;
+        typedef std::ptrdiff_t            difference_type;
+        typedef C*                        pointer;
+        typedef C&                        reference;
+
+        basic_iterator() noexcept : pElem_( nullptr ) {}
+        explicit basic_iterator( C* pElem ) noexcept : pElem_( pElem ) {}
+        operator basic_iterator<const T>() const noexcept { return basic_iterator<const T>( pElem_ ); }
+
+        reference       operator*() const noexcept  { return *pElem_; }
+        pointer         operator->() const noexcept { return pElem_; }
+        basic_iterator& operator++() noexcept       { pElem_ = pElem_->*Next; return *this; }
+        basic_iterator  operator++( int ) noexcept  { basic_iterator it( *this ); pElem_ = pElem_->*Next; return it; }
+        bool operator==( const basic_iterator& other ) const noexcept { return pElem_ == other.pElem_; }
+        bool operator!=( const basic_iterator& other ) const noexcept { return pElem_ != other.pElem_; }
+
+    private:
+        C* pElem_;
+    };
+    typedef basic_iterator<T>       iterator;
+    typedef basic_iterator<const T> const_iterator;
+
+    intrusive_slist() noexcept : pHead_( nullptr ) {}
+    intrusive_slist( intrusive_slist&& other ) noexcept : pHead_( nullptr ) { swap( other ); }
+    intrusive_slist& operator=( intrusive_slist&& other ) noexcept {
+        clear();
+        swap( other );
+        return *this;
+    }
+    intrusive_slist( const intrusive_slist& ) = delete;
+    intrusive_slist& operator=( const intrusive_slist& ) = delete;
+
+    iterator       begin() noexcept        { return iterator( pHead_ ); }
+    iterator       end() noexcept          { return iterator(); }
+    const_iterator begin() const noexcept  { return const_iterator( pHead_ ); }
+    const_iterator end() const noexcept    { return const_iterator(); }
+    const_iterator cbegin() const noexcept { return const_iterator( pHead_ ); }
+    const_iterator cend() const noexcept   { return const_iterator(); }
+
+    bool     empty() const noexcept { return nullptr == pHead_; }
+    T&       front() noexcept       { return *pHead_; }
+    const T& front() const noexcept { return *pHead_; }
+
+    /**
+     * @brief Number of elements, only for a counting list (Count = true)
+     */
+    size_type size() const noexcept {
+        static_assert( Count, "size() needs intrusive_slist<T, Next, true>, use std::distance otherwise" );
+        return this->uiSize_;
+    }
+
+    /* As SLL_ELEM_ADD */
+    void push_front( T& elem ) noexcept {
+        elem.*Next = pHead_;
+        pHead_     = &elem;
+        this->size_inc();
+    }
+
+    /* Takes the head off, the list must not be empty */
+    void pop_front() noexcept {
+        T* pElem = pHead_;
+        pHead_ = pElem->*Next;
+        this->size_dec();
+    }
+
+    /* Inserts elem after pos, which is on the list */
+    void insert_after( const_iterator pos, T& elem ) noexcept {
+        T* pPos = const_cast<T*>(&*pos);
+        elem.*Next = pPos->*Next;
+        pPos->*Next = &elem;
+        this->size_inc();
+    }
+
+    /* Takes off the element after pos, returns the one after that */
+    iterator erase_after( const_iterator pos ) noexcept {
+        T* pPos  = const_cast<T*>(&*pos);
+        T* pElem = pPos->*Next;
+        pPos->*Next = pElem->*Next;
+        this->size_dec();
+        return iterator( pPos->*Next );
+    }
+
+    /* As SLL_ELEM_DEL: O(n), false if elem is not on the list */
+    bool remove( T& elem ) noexcept {
+        for (T** ppLink = &pHead_; nullptr != *ppLink; ppLink = &((*ppLink)->*Next)) {
+            if (*ppLink == &elem) {
+                *ppLink = elem.*Next;
+                this->size_dec();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /* Forgets all the elements (their links are left as they are) */
+    void clear() noexcept {
+        pHead_ = nullptr;
+        this->size_set( 0 );
+    }
+
+    void swap( intrusive_slist& other ) noexcept {
+        T* pTmp = pHead_; pHead_ = other.pHead_; other.pHead_ = pTmp;
+        this->size_swap( other );
+    }
+
+    /**
+     * @brief Hands the elements over to a plain SLL head, the list is left empty
+     */
+    T* release() noexcept {
+        T* pHead = pHead_;
+        clear();
+        return pHead;
+    }
+
+    /**
+     * @brief Takes over the elements of a plain SLL head (what was on this list is forgotten)
+     * For a counting list this walks the elements, O(n)
+     */
+    void adopt( T* pHead ) noexcept {
+        pHead_ = pHead;
+        if (Count) {
+            std::size_t uiSize = 0;
+            for (T* p = pHead; nullptr != p; p = p->*Next) {
+                uiSize++;
+            }
+            this->size_set( uiSize );
+        }
+    }
+
+private:
+    T* pHead_;
+};
+
+} // namespace pu
+
+/**
+ * @}
+ */
+
+#endif /* _SLL_HPP_ */
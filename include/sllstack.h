@@ -0,0 +1,201 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+/**
+ * @file     sllstack.h
+ * @author   Martin
+ * @date     2026-10-17
+ */
+#ifndef __SLLSTACK_H_
+#define __SLLSTACK_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * @brief Lock-free stack on the Single Linked List links
+ * @defgroup SLLS Lock-free SLL stack macros
+ * @ingroup SYSUTILS
+ * A Treiber stack: any number of threads push and pop elements without a mutex, one CAS per
+ * operation. The elements are the ones of the \ref SLL macros, linked through the same
+ * \ref SLL_ENTRY, so a chain taken off in one go with \ref SLLS_POP_ALL is an ordinary SLL list.
+ * @code
+ * typedef struct work_tag
+ * {
+ *     int iJob;
+ *     SLL_ENTRY(work_tag);
+ * }   work_t;
+ *
+ * static SLLS_HEAD(work_tag) stkWork = SLLS_INITIALIZER;
+ *
+ * // Any thread
+ * SLLS_PUSH( stkWork, pWork );
+ *
+ * // Any thread, one element
+ * SLLS_POP( stkWork, pWork );
+ * if (NULL != pWork) { ... }
+ *
+ * // Or everything, then walk it without any further atomics (newest first)
+ * work_t* pAll;
+ * SLLS_POP_ALL( stkWork, pAll );
+ * SLL_FOR_EACH( pAll, pWork ) { ... }
+ * @endcode
+ *
+ * @par ABA
+ * The head is one 64 bit word, the pointer plus a tag. Every removal (POP, POP_ALL) bumps the tag,
+ * so a pop that read the head, was preempted, and meanwhile saw the same element popped and pushed
+ * back fails its CAS instead of installing a stale next pointer. On a 32 bit target (the BBB) the
+ * tag is 32 bits; on a 64 bit host user space pointers fit in 48 bits and the tag gets the top 16.
+ * Either way the 64 bit CAS is lock-free (LDREXD/STREXD on ARMv7, CMPXCHG on x86-64).
+ *
+ * @par 64 bit pointer limit
+ * On a 64 bit target the elements must live below 2^48. That does not hold with 5 level paging
+ * (LA57, mappings above 2^47 only when asked for) or with tagged pointers (arm64 TBI, MTE, HWASAN)
+ * whose top byte is in use. A push ASSERTs (debug builds) that the element has no bits above
+ * SLLS_PTR_MASK, the release build would silently lose them.
+ *
+ * @par Element lifetime
+ * A pop reads the next link of the head element before its CAS. That element may be popped and
+ * reused by another thread in between (the CAS then fails and the value is dropped), but it must
+ * still be readable memory. So elements must not go back to free()/munmap while a pop may be
+ * looking at them: take them from something type stable, e.g. a \ref PBPOOL pool, a static array,
+ * or only release them when no thread uses the stack any more.
+ *
+ * @{
+ */
+
+/**** Includes ***************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include "sll.h"
+#include "logging.h"
+
+/**** Definitions ************************************************************/
+
+/* Pointer and tag split of the 64 bit head */
+#if (UINTPTR_MAX == 0xFFFFFFFFu)
+    #define SLLS_TAG_SHIFT (32)
+#else
+    #define SLLS_TAG_SHIFT (48)
+#endif
+#define SLLS_PTR_MASK ((UINT64_C(1) << SLLS_TAG_SHIFT) - 1u)
+#define SLLS_TAG_ONE  (UINT64_C(1) << SLLS_TAG_SHIFT)
+
+/**
+ * The stack head
+ * @param[in] tag_type : The forward referenced "tag" type of the elements
+ *
+ * @note
+ * The pointer member is never used, it only carries the element type for the macros
+ */
+#define SLLS_HEAD( tag_type ) union { uint64_t uiSllsTagged; struct tag_type* pSllsType; }
+
+/**
+ * Static initialiser for an empty stack
+ */
+#define SLLS_INITIALIZER { 0 }
+
+/**
+ * Empties a stack, not thread safe (set up before the stack is shared)
+ * @param[in] list : The stack (not a pointer)
+ */
+#define SLLS_INIT( list ) { (list).uiSllsTagged = 0; }
+
+/* The element pointer held in a head value */
+#define SLLS_PTR_OF( list, tagged ) ((__typeof__((list).pSllsType))(uintptr_t)((tagged) & SLLS_PTR_MASK))
+
+/**
+ * True if the stack is empty (a snapshot, it can change straight after)
+ * @param[in] list : The stack
+ */
+#define SLLS_IS_EMPTY( list ) (0u == (__atomic_load_n( &((list).uiSllsTagged), __ATOMIC_RELAXED ) & SLLS_PTR_MASK))
+
+/**
+ * Pushes a chain of elements, already linked first to last, in one CAS
+ * @param[in] list  : The stack
+ * @param[in] first : First element of the chain (type*), ends up on top
+ * @param[in] last  : Last element of the chain (type*), may be the same as first
+ *
+ * @pre  first has no bits above SLLS_PTR_MASK (see the 64 bit pointer limit above)
+ */
+#define SLLS_PUSH_CHAIN( list, first, last ) {                                                  \
+    uint64_t uiSllsOld = __atomic_load_n( &((list).uiSllsTagged), __ATOMIC_RELAXED );          \
+    uint64_t uiSllsNew;                                                                         \
+    ASSERT( 0u == ((uint64_t)(uintptr_t)(first) & ~SLLS_PTR_MASK) );                            \
+    do {                                                                                        \
+        __atomic_store_n( &((last)->pSllNextElem), SLLS_PTR_OF( list, uiSllsOld ), __ATOMIC_RELAXED ); \
+        uiSllsNew = (uiSllsOld & ~SLLS_PTR_MASK) | (uint64_t)(uintptr_t)(first);               \
+    } while (!__atomic_compare_exchange_n( &((list).uiSllsTagged), &uiSllsOld, uiSllsNew,      \
+                                           true, __ATOMIC_RELEASE, __ATOMIC_RELAXED ));         \
+}
+
+/**
+ * Pushes an element
+ * @param[in] list : The stack
+ * @param[in] elem : The element to push (type*)
+ */
+#define SLLS_PUSH( list, elem ) SLLS_PUSH_CHAIN( list, elem, elem )
+
+/**
+ * Pops the top element
+ * @param[in]  list : The stack
+ * @param[out] elem : Set to the element, NULL if the stack was empty
+ */
+#define SLLS_POP( list, elem ) {                                                                \
+    uint64_t uiSllsOld = __atomic_load_n( &((list).uiSllsTagged), __ATOMIC_ACQUIRE );          \
+    uint64_t uiSllsNew;                                                                         \
+    do {                                                                                        \
+        (elem) = SLLS_PTR_OF( list, uiSllsOld );                                                \
+        if (NULL == (elem)) {                                                                   \
+            break;                                                                              \
+        }                                                                                       \
+        uiSllsNew = ((uiSllsOld & ~SLLS_PTR_MASK) + SLLS_TAG_ONE) |                             \
+                    (uint64_t)(uintptr_t)__atomic_load_n( &((elem)->pSllNextElem), __ATOMIC_RELAXED ); \
+    } while (!__atomic_compare_exchange_n( &((list).uiSllsTagged), &uiSllsOld, uiSllsNew,      \
+                                           true, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE ));         \
+}
+
+/**
+ * Takes every element off the stack in one CAS
+ * @param[in]  list : The stack
+ * @param[out] elem : Set to the old top, the chain is a plain SLL list (NULL if it was empty)
+ */
+#define SLLS_POP_ALL( list, elem ) {                                                            \
+    uint64_t uiSllsOld = __atomic_load_n( &((list).uiSllsTagged), __ATOMIC_RELAXED );          \
+    do {                                                                                        \
+        (elem) = SLLS_PTR_OF( list, uiSllsOld );                                                \
+        if (NULL == (elem)) {                                                                   \
+            break;                                                                              \
+        }                                                                                       \
+    } while (!__atomic_compare_exchange_n( &((list).uiSllsTagged), &uiSllsOld,                 \
+                                           (uiSllsOld & ~SLLS_PTR_MASK) + SLLS_TAG_ONE,         \
+                                           true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED ));         \
+}
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __SLLSTACK_H_ */
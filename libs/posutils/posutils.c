@@ -64,6 +64,14 @@ int posutils_init( void ) {
         iIsInit = 1;
         iRet = pu_thread_init_private();
         ASSERT(0 == iRet);
+        if (0 == iRet) {
+            iRet = pu_cache_init_private(pu_thread_context_size_private());
+            ASSERT(0 == iRet);
+        }
+        if (0 == iRet) {
+            iRet = pu_stack_init_private();
+            ASSERT(0 == iRet);
+        }
     }
     return (iRet);
 }
@@ -78,15 +86,39 @@ int posutils_init( void ) {
  * @post    Module shuts down
  *
  * @par Description
- * Exits the module, cleans up any resources.
+ * Exits the module, cleans up any resources. Registered threads that are still running are
+ * stopped with \ref pu_thread_join_all (\ref PU_THREAD_EXIT_TIMEOUT_MS). If some refuse to
+ * stop EBUSY is returned and the module is left initialised. The same goes for threads the
+ * join-all leaves alone, i.e. pool workers (destroy the pool first) and detached threads that
+ * have not exited yet.
  */
 int posutils_exit( void ) {
-    int iRet = 0;
+    int    iRet = 0;
+    size_t uiLeft;
 
     // Pseudo-atomic exit
     if (iIsInit) {
+        // Threads the app left running (or did not join) are stopped and joined first. If any
+        // of them will not die the module stays up, they still need the registry and cache
+        iRet = pu_thread_join_all(PU_THREAD_EXIT_TIMEOUT_MS, NULL, NULL);
+        if (0 != iRet) {
+            return (iRet);
+        }
+        // Owned and detached threads are not joined above, but they still use everything below
+        uiLeft = pu_thread_count_private();
+        if (0 != uiLeft) {
+            LOG_ERROR("posutils_exit: %zu threads still registered\n", uiLeft);
+            return (EBUSY);
+        }
         iIsInit = 0;
-        pu_thread_exit_private();
+        pu_arena_thread_exit_private();
+        pu_mutex_prof_exit_private();
+        pu_stack_exit_private();
+        iRet = pu_cache_exit_private();
+        ASSERT(0 == iRet);
+        if (0 == iRet) {
+            iRet = pu_thread_exit_private();
+        }
     }
     return (iRet);
 }
@@ -0,0 +1,283 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+
+/**
+ * @file     puarena.c
+ * @brief    Bump pointer arena, chunk handling and the thread arenas
+ */
+
+/**** Includes ***************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include "puarena.h"
+#include "pudefs.h"
+#include "logging.h"
+
+/**** Definitions ************************************************************/
+
+/**** Macros ****************************************************************/
+#define PU_ARENA_DATA(chunk_) ((uint8_t*)((chunk_) + 1))
+
+#if !defined(NDEBUG)
+    #define PU_ARENA_POISON(p_,n_,v_) memset( (p_), (v_), (n_) )
+#else
+    #define PU_ARENA_POISON(p_,n_,v_)
+#endif /* !defined(NDEBUG) */
+
+/**** Static declarations ***************************************************/
+static __thread pu_arena_t* pSelfArena = NULL;
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static pu_arena_chunk_t* pu_arena_chunk_new( pu_arena_t* pArena, size_t uiSize );
+static void              pu_arena_chunk_release( pu_arena_t* pArena, pu_arena_chunk_t* pChunk );
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+static pu_arena_chunk_t* pu_arena_chunk_new( pu_arena_t* pArena, size_t uiSize )
+{
+    pu_arena_chunk_t* pChunk;
+
+    if (uiSize > SIZE_MAX - sizeof(pu_arena_chunk_t))
+    {
+        return (NULL);
+    }
+    pChunk = (pu_arena_chunk_t*)malloc( sizeof(pu_arena_chunk_t) + uiSize );
+    if (NULL == pChunk)
+    {
+        LOG_ERROR( "PU_ARENA: no memory for a %zu byte chunk\n", uiSize );
+        return (NULL);
+    }
+    pChunk->uiSize = uiSize;
+    pArena->uiChunks++;
+    PU_ARENA_POISON( PU_ARENA_DATA(pChunk), uiSize, PU_ARENA_POISON_NEW );
+    return (pChunk);
+}
+/* pu_arena_chunk_new */
+
+/* Standard chunks go to the spare list while there is room, oversized ones are freed */
+static void pu_arena_chunk_release( pu_arena_t* pArena, pu_arena_chunk_t* pChunk )
+{
+    if ((pChunk->uiSize == pArena->uiChunkSize) && (pArena->uiSpare < PU_ARENA_MAX_SPARE))
+    {
+        PU_ARENA_POISON( PU_ARENA_DATA(pChunk), pChunk->uiSize, PU_ARENA_POISON_FREE );
+        pChunk->pPrev  = pArena->pSpare;
+        pArena->pSpare = pChunk;
+        pArena->uiSpare++;
+    }
+    else
+    {
+        pArena->uiChunks--;
+        free( pChunk );
+    }
+}
+/* pu_arena_chunk_release */
+
+/****************************************************************************/
+/* PRIVATE FUNCTION DEFINITIONS                                             */
+/****************************************************************************/
+
+/**
+ * @brief Frees the calling thread's arena, from the thread exit handler (and posutils_exit)
+ */
+void pu_arena_thread_exit_private( void )
+{
+    if (pSelfArena)
+    {
+        pu_arena_destroy( pSelfArena );
+        free( pSelfArena );
+        pSelfArena = NULL;
+    }
+}
+/* pu_arena_thread_exit_private */
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * @brief   Initialises an arena, no memory is allocated yet
+ *
+ * @param[out] pArena      : The arena
+ * @param[in]  uiChunkSize : Bytes per chunk, 0 for PU_ARENA_CHUNK_SIZE
+ */
+void pu_arena_init(
+    pu_arena_t* pArena,
+    size_t      uiChunkSize )
+{
+    ASSERT( pArena );
+    memset( pArena, 0, sizeof(*pArena) );
+    pArena->uiChunkSize = (0 == uiChunkSize) ? PU_ARENA_CHUNK_SIZE : uiChunkSize;
+}
+/* pu_arena_init */
+
+/**
+ * @brief   Frees all the chunks of an arena
+ *
+ * @param[in] pArena : The arena
+ */
+void pu_arena_destroy( pu_arena_t* pArena )
+{
+    pu_arena_mark_t mark = { NULL, NULL };
+
+    ASSERT( pArena );
+    pu_arena_reset( pArena, &mark );
+    pu_arena_trim( pArena );
+    ASSERT( 0 == pArena->uiChunks );
+}
+/* pu_arena_destroy */
+
+/**
+ * @brief   Frees the spare chunks
+ *
+ * @param[in] pArena : The arena
+ */
+void pu_arena_trim( pu_arena_t* pArena )
+{
+    pu_arena_chunk_t* pChunk;
+
+    ASSERT( pArena );
+    while (NULL != (pChunk = pArena->pSpare))
+    {
+        pArena->pSpare = pChunk->pPrev;
+        pArena->uiChunks--;
+        free( pChunk );
+    }
+    pArena->uiSpare = 0;
+}
+/* pu_arena_trim */
+
+/**
+ * @brief   Releases everything allocated since a mark
+ *
+ * @param[in] pArena : The arena
+ * @param[in] pMark  : A mark taken on this arena
+ */
+void pu_arena_reset(
+    pu_arena_t*            pArena,
+    const pu_arena_mark_t* pMark )
+{
+    pu_arena_chunk_t* pChunk;
+    uint8_t*          pUsedEnd = pArena->pCur;
+
+    ASSERT( pArena && pMark );
+
+    /* Chunks newer than the mark's one go entirely */
+    while (pArena->pChunk != pMark->pChunk)
+    {
+        pChunk = pArena->pChunk;
+        ASSERT( pChunk );
+        pArena->pChunk = pChunk->pPrev;
+        pu_arena_chunk_release( pArena, pChunk );
+
+        /* The tail of the mark's chunk was skipped when the next chunk came in, so it was
+         * never handed out; poisoning it all the way is harmless */
+        pUsedEnd = NULL;
+    }
+
+    /* Back to the mark's position in its chunk */
+    if (pMark->pChunk)
+    {
+        pArena->pEnd = PU_ARENA_DATA(pMark->pChunk) + pMark->pChunk->uiSize;
+        pUsedEnd     = pUsedEnd ? pUsedEnd : pArena->pEnd;
+        ASSERT( (pMark->pCur >= PU_ARENA_DATA(pMark->pChunk)) && (pMark->pCur <= pUsedEnd) );
+        PU_ARENA_POISON( pMark->pCur, (size_t)(pUsedEnd - pMark->pCur), PU_ARENA_POISON_FREE );
+    }
+    else
+    {
+        pArena->pEnd = NULL;
+    }
+    pArena->pCur = pMark->pCur;
+    (void)pUsedEnd;
+}
+/* pu_arena_reset */
+
+/**
+ * @brief   Allocation that does not fit the current chunk: starts a new chunk
+ *
+ * @param[in] pArena  : The arena
+ * @param[in] uiSize  : Bytes
+ * @param[in] uiAlign : Alignment, a power of two
+ * @return  The memory, NULL if out of memory
+ *
+ * @par Description
+ * Whatever is left of the current chunk is abandoned. A request bigger than a chunk gets a
+ * chunk of exactly its size, anything else a standard chunk (a spare one if there is one).
+ */
+void* pu_arena_alloc_slow(
+    pu_arena_t* pArena,
+    size_t      uiSize,
+    size_t      uiAlign )
+{
+    pu_arena_chunk_t* pChunk;
+    size_t            uiNeed;
+
+    ASSERT( pArena && (0 != uiAlign) && (0 == (uiAlign & (uiAlign - 1))) );
+    if (uiSize > SIZE_MAX - uiAlign)
+    {
+        return (NULL);
+    }
+    uiNeed = uiSize + uiAlign - 1;
+    if (uiNeed > pArena->uiChunkSize)
+    {
+        pChunk = pu_arena_chunk_new( pArena, uiNeed );
+    }
+    else if (pArena->pSpare)
+    {
+        pChunk         = pArena->pSpare;
+        pArena->pSpare = pChunk->pPrev;
+        pArena->uiSpare--;
+    }
+    else
+    {
+        pChunk = pu_arena_chunk_new( pArena, pArena->uiChunkSize );
+    }
+    if (NULL == pChunk)
+    {
+        return (NULL);
+    }
+    pChunk->pPrev  = pArena->pChunk;
+    pArena->pChunk = pChunk;
+    pArena->pCur   = PU_ARENA_DATA(pChunk);
+    pArena->pEnd   = PU_ARENA_DATA(pChunk) + pChunk->uiSize;
+    return (pu_arena_alloc_aligned( pArena, uiSize, uiAlign ));
+}
+/* pu_arena_alloc_slow */
+
+/**
+ * @brief   Gets the calling thread's arena, created on first use
+ *
+ * @return  The arena, NULL if out of memory
+ */
+pu_arena_t* pu_thread_arena( void )
+{
+    if (NULL == pSelfArena)
+    {
+        pSelfArena = (pu_arena_t*)malloc( sizeof(pu_arena_t) );
+        if (pSelfArena)
+        {
+            pu_arena_init( pSelfArena, PU_ARENA_CHUNK_SIZE );
+        }
+    }
+    return (pSelfArena);
+}
+/* pu_thread_arena */
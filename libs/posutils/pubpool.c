@@ -0,0 +1,687 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+
+/**
+ * @file     pubpool.c
+ * @brief    Fixed size block pool: slabs, the lock-free free list and the thread caches
+ *
+ * Layout of a pool with uiMaxSlabs = 4, two slabs committed:
+ * @code
+ * | slab 0 (RW) | slab 1 (RW) | slab 2 (PROT_NONE) | slab 3 (PROT_NONE) |
+ * ^ pBase         each slab: uiPerSlab blocks of uiStride bytes, page padded
+ * @endcode
+ * Block index i lives in slab i / uiPerSlab at block i % uiPerSlab. The free list head holds
+ * index + 1 in its low half (0 = empty) and the ABA tag in its high half, a free block holds
+ * the next index + 1 in its first word.
+ */
+
+/**** Includes ***************************************************************/
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "pubpool.h"
+#include "posutils.h"
+#include "logging.h"
+
+/**** Definitions ************************************************************/
+#define PU_BPOOL_CACHE_LINE  (64)
+#define PU_BPOOL_BATCH       (PU_BPOOL_CACHE_SIZE / 2)
+#define PU_BPOOL_MAX_POOLS   (32)
+#define PU_BPOOL_MIN_ALIGN   (sizeof(uint32_t))
+
+struct pu_bpool_tag
+{
+    /* Read only after create */
+    uint8_t*        pBase;                   /* uiMaxSlabs slabs of address space    */
+    size_t          uiSlabBytes;             /* Bytes per slab, page multiple        */
+    size_t          uiBlockSize;             /* As requested                         */
+    uint32_t        uiStride;                /* Bytes per block                      */
+    uint32_t        uiPerSlab;               /* Blocks per slab, power of two        */
+    uint32_t        uiPerSlabShift;          /* log2(uiPerSlab)                      */
+    uint32_t        uiMaxSlabs;
+    uint32_t        uiId;                    /* Tells a reused pool address apart    */
+    bool            bThreadCache;
+
+    /* Free list, on its own line */
+    uint64_t        uiHead __attribute__((aligned(PU_BPOOL_CACHE_LINE)));
+
+    /* Growth (under mtxGrow) and counters (relaxed atomics) */
+    pthread_mutex_t mtxGrow __attribute__((aligned(PU_BPOOL_CACHE_LINE)));
+    uint32_t        uiSlabs;
+    uint32_t        uiInUse;
+    uint32_t        uiPeakInUse;
+    uint64_t        uiAllocs;
+    uint64_t        uiFrees;
+    uint64_t        uiEmpty;
+    uint64_t        uiFailed;
+    uint64_t        uiCacheHits;
+};
+
+/* One thread's cache for one pool */
+typedef struct
+{
+    pu_bpool_t* pPool;                       /* NULL = unused                        */
+    uint32_t    uiId;                        /* pPool->uiId when claimed             */
+    uint32_t    uiCount;                     /* Blocks in apBlocks                   */
+    uint64_t    uiHits;                      /* Not yet added to pPool->uiCacheHits  */
+    void*       apBlocks[PU_BPOOL_CACHE_SIZE];
+}   pu_bpool_cache_t;
+
+/**** Macros ****************************************************************/
+#define PU_BPOOL_LINK(block_)    ((uint32_t*)(void*)(block_))
+#define PU_BPOOL_HEAD(tag_,idx_) ((((uint64_t)(tag_)) << 32) | (uint64_t)(idx_))
+
+/**** Static declarations ***************************************************/
+
+/* Live pools, so an exiting thread does not hand its cache to a destroyed pool */
+static pthread_mutex_t  mtxPools = PTHREAD_MUTEX_INITIALIZER;
+static pu_bpool_t*      apPools[PU_BPOOL_MAX_POOLS];
+static uint32_t         uiNextId = 1;
+
+/* Per-thread caches, flushed by the key destructor */
+static pthread_once_t   onceKey = PTHREAD_ONCE_INIT;
+static pthread_key_t    keyCache;
+static __thread pu_bpool_cache_t aCaches[PU_BPOOL_THREAD_POOLS];
+static __thread bool             bCacheKeySet = false;
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static uint8_t*          pu_bpool_block( const pu_bpool_t* pPool, uint32_t uiIdx );
+static uint32_t          pu_bpool_index( const pu_bpool_t* pPool, const void* pBlock );
+static void*             pu_bpool_pop( pu_bpool_t* pPool );
+static void              pu_bpool_push_chain( pu_bpool_t* pPool, void* pFirst, void* pLast );
+static void              pu_bpool_spill( pu_bpool_t* pPool, void** apBlocks, uint32_t uiCount );
+static int               pu_bpool_commit( pu_bpool_t* pPool );
+static int               pu_bpool_grow( pu_bpool_t* pPool );
+static void              pu_bpool_count_out( pu_bpool_t* pPool, uint32_t uiCount );
+static void*             pu_bpool_alloc_global( pu_bpool_t* pPool );
+static pu_bpool_cache_t* pu_bpool_cache_find( pu_bpool_t* pPool );
+static void              pu_bpool_cache_flush( pu_bpool_cache_t* pCache );
+static void              pu_bpool_cache_key_create( void );
+static void              pu_bpool_cache_exit( void* pArg );
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+static uint8_t* pu_bpool_block( const pu_bpool_t* pPool, uint32_t uiIdx )
+{
+    return (pPool->pBase
+        + (size_t)(uiIdx >> pPool->uiPerSlabShift) * pPool->uiSlabBytes
+        + (size_t)(uiIdx & (pPool->uiPerSlab - 1)) * pPool->uiStride);
+}
+/* pu_bpool_block */
+
+static uint32_t pu_bpool_index( const pu_bpool_t* pPool, const void* pBlock )
+{
+    size_t uiOffset = (size_t)((const uint8_t*)pBlock - pPool->pBase);
+    size_t uiSlab   = uiOffset / pPool->uiSlabBytes;
+
+    return ((uint32_t)(uiSlab << pPool->uiPerSlabShift)
+          + (uint32_t)((uiOffset - uiSlab * pPool->uiSlabBytes) / pPool->uiStride));
+}
+/* pu_bpool_index */
+
+/* Treiber pop. The link of the top block may be stale by the time we read it (another thread
+ * popped and reused the block), but then the head has moved on, the tag with it, and the
+ * compare fails */
+static void* pu_bpool_pop( pu_bpool_t* pPool )
+{
+    uint64_t uiOld = __atomic_load_n( &(pPool->uiHead), __ATOMIC_ACQUIRE );
+    uint64_t uiNew;
+    uint8_t* pBlock;
+
+    do
+    {
+        if (0 == (uint32_t)uiOld)
+        {
+            return (NULL);
+        }
+        pBlock = pu_bpool_block( pPool, (uint32_t)uiOld - 1 );
+        uiNew  = PU_BPOOL_HEAD( (uiOld >> 32) + 1, __atomic_load_n( PU_BPOOL_LINK(pBlock), __ATOMIC_RELAXED ) );
+    }
+    while (!__atomic_compare_exchange_n( &(pPool->uiHead), &uiOld, uiNew, true, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE ));
+    return (pBlock);
+}
+/* pu_bpool_pop */
+
+/* Treiber push of a chain that is already linked from pFirst to pLast */
+static void pu_bpool_push_chain( pu_bpool_t* pPool, void* pFirst, void* pLast )
+{
+    uint64_t uiOld   = __atomic_load_n( &(pPool->uiHead), __ATOMIC_RELAXED );
+    uint32_t uiFirst = pu_bpool_index( pPool, pFirst ) + 1;
+    uint64_t uiNew;
+
+    do
+    {
+        __atomic_store_n( PU_BPOOL_LINK(pLast), (uint32_t)uiOld, __ATOMIC_RELAXED );
+        uiNew = PU_BPOOL_HEAD( (uiOld >> 32) + 1, uiFirst );
+    }
+    while (!__atomic_compare_exchange_n( &(pPool->uiHead), &uiOld, uiNew, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED ));
+}
+/* pu_bpool_push_chain */
+
+/* Links uiCount blocks and pushes them with one compare-and-swap */
+static void pu_bpool_spill( pu_bpool_t* pPool, void** apBlocks, uint32_t uiCount )
+{
+    uint32_t i;
+
+    for (i = 0; i + 1 < uiCount; i++)
+    {
+        __atomic_store_n( PU_BPOOL_LINK(apBlocks[i]), pu_bpool_index( pPool, apBlocks[i + 1] ) + 1, __ATOMIC_RELAXED );
+    }
+    pu_bpool_push_chain( pPool, apBlocks[0], apBlocks[uiCount - 1] );
+    __atomic_fetch_sub( &(pPool->uiInUse), uiCount, __ATOMIC_RELAXED );
+    __atomic_fetch_add( &(pPool->uiFrees), uiCount, __ATOMIC_RELAXED );
+}
+/* pu_bpool_spill */
+
+/* Commits the next slab and pushes its blocks, called with mtxGrow held */
+static int pu_bpool_commit( pu_bpool_t* pPool )
+{
+    uint8_t* pSlab;
+    uint32_t uiFirst;
+    uint32_t i;
+
+    if (pPool->uiSlabs >= pPool->uiMaxSlabs)
+    {
+        return (ENOMEM);
+    }
+    pSlab = pPool->pBase + (size_t)pPool->uiSlabs * pPool->uiSlabBytes;
+    if (0 != mprotect( pSlab, pPool->uiSlabBytes, PROT_READ | PROT_WRITE ))
+    {
+        LOG_ERROR( "PU_BPOOL(commit): cannot commit %zu bytes\n", pPool->uiSlabBytes );
+        return (ENOMEM);
+    }
+
+    /* Linking writes every block, so the pages are faulted in here and not on first use */
+    uiFirst = pPool->uiSlabs << pPool->uiPerSlabShift;
+    for (i = 0; i + 1 < pPool->uiPerSlab; i++)
+    {
+        *PU_BPOOL_LINK(pSlab + (size_t)i * pPool->uiStride) = uiFirst + i + 2;
+    }
+    pu_bpool_push_chain( pPool, pSlab, pSlab + (size_t)(pPool->uiPerSlab - 1) * pPool->uiStride );
+    __atomic_store_n( &(pPool->uiSlabs), pPool->uiSlabs + 1, __ATOMIC_RELAXED );
+    return (0);
+}
+/* pu_bpool_commit */
+
+/* Threads that find the list empty at the same time queue up on the mutex, the later ones see
+ * the list refilled and leave it at that */
+static int pu_bpool_grow( pu_bpool_t* pPool )
+{
+    int iResult = 0;
+
+    pthread_mutex_lock( &(pPool->mtxGrow) );
+    if (0 == (uint32_t)__atomic_load_n( &(pPool->uiHead), __ATOMIC_ACQUIRE ))
+    {
+        iResult = pu_bpool_commit( pPool );
+    }
+    pthread_mutex_unlock( &(pPool->mtxGrow) );
+    return (iResult);
+}
+/* pu_bpool_grow */
+
+static void pu_bpool_count_out( pu_bpool_t* pPool, uint32_t uiCount )
+{
+    uint32_t uiInUse = __atomic_add_fetch( &(pPool->uiInUse), uiCount, __ATOMIC_RELAXED );
+    uint32_t uiPeak  = __atomic_load_n( &(pPool->uiPeakInUse), __ATOMIC_RELAXED );
+
+    while ((uiInUse > uiPeak) &&
+           !__atomic_compare_exchange_n( &(pPool->uiPeakInUse), &uiPeak, uiInUse, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED ))
+    {
+    }
+    __atomic_fetch_add( &(pPool->uiAllocs), uiCount, __ATOMIC_RELAXED );
+}
+/* pu_bpool_count_out */
+
+/* One block off the free list, growing the pool if need be */
+static void* pu_bpool_alloc_global( pu_bpool_t* pPool )
+{
+    void* pBlock = pu_bpool_pop( pPool );
+
+    while (NULL == pBlock)
+    {
+        __atomic_fetch_add( &(pPool->uiEmpty), 1, __ATOMIC_RELAXED );
+        if (0 != pu_bpool_grow( pPool ))
+        {
+            /* A free from another thread may still have come in */
+            pBlock = pu_bpool_pop( pPool );
+            if (NULL == pBlock)
+            {
+                __atomic_fetch_add( &(pPool->uiFailed), 1, __ATOMIC_RELAXED );
+                return (NULL);
+            }
+            break;
+        }
+        pBlock = pu_bpool_pop( pPool );
+    }
+    pu_bpool_count_out( pPool, 1 );
+    return (pBlock);
+}
+/* pu_bpool_alloc_global */
+
+/* This thread's cache for the pool, claims a free entry if there is none yet. An entry left
+ * behind by a destroyed pool is recognised by the id and dropped (its blocks went with the
+ * pool) */
+static pu_bpool_cache_t* pu_bpool_cache_find( pu_bpool_t* pPool )
+{
+    pu_bpool_cache_t* pFree = NULL;
+    uint32_t          i;
+
+    for (i = 0; i < PU_BPOOL_THREAD_POOLS; i++)
+    {
+        if (aCaches[i].pPool == pPool)
+        {
+            if (aCaches[i].uiId == pPool->uiId)
+            {
+                return (&aCaches[i]);
+            }
+            aCaches[i].pPool = NULL;
+        }
+        if ((NULL == pFree) && ((NULL == aCaches[i].pPool) || (0 == aCaches[i].uiCount)))
+        {
+            pFree = &aCaches[i];
+        }
+    }
+    if (pFree)
+    {
+        /* An empty entry of another pool can be taken over, only the hit count goes with it */
+        if (pFree->pPool && (0 != pFree->uiHits))
+        {
+            pu_bpool_cache_flush( pFree );
+        }
+        if (!bCacheKeySet)
+        {
+            pthread_once( &onceKey, pu_bpool_cache_key_create );
+            pthread_setspecific( keyCache, aCaches );
+            bCacheKeySet = true;
+        }
+        pFree->pPool   = pPool;
+        pFree->uiId    = pPool->uiId;
+        pFree->uiCount = 0;
+        pFree->uiHits  = 0;
+    }
+    return (pFree);
+}
+/* pu_bpool_cache_find */
+
+/* Gives a cache back to its pool, if the pool still exists */
+static void pu_bpool_cache_flush( pu_bpool_cache_t* pCache )
+{
+    uint32_t i;
+
+    pthread_mutex_lock( &mtxPools );
+    for (i = 0; i < PU_BPOOL_MAX_POOLS; i++)
+    {
+        if ((apPools[i] == pCache->pPool) && (apPools[i]->uiId == pCache->uiId))
+        {
+            if (0 != pCache->uiCount)
+            {
+                pu_bpool_spill( pCache->pPool, pCache->apBlocks, pCache->uiCount );
+            }
+            __atomic_fetch_add( &(pCache->pPool->uiCacheHits), pCache->uiHits, __ATOMIC_RELAXED );
+            break;
+        }
+    }
+    pthread_mutex_unlock( &mtxPools );
+    pCache->pPool   = NULL;
+    pCache->uiCount = 0;
+    pCache->uiHits  = 0;
+}
+/* pu_bpool_cache_flush */
+
+static void pu_bpool_cache_key_create( void )
+{
+    int iResult = pthread_key_create( &keyCache, pu_bpool_cache_exit );
+    ASSERT( 0 == iResult );
+    (void)iResult;
+}
+/* pu_bpool_cache_key_create */
+
+/* Key destructor, runs in the exiting thread. The __thread caches are still there */
+static void pu_bpool_cache_exit( void* pArg )
+{
+    uint32_t i;
+    (void)pArg;
+
+    for (i = 0; i < PU_BPOOL_THREAD_POOLS; i++)
+    {
+        if (aCaches[i].pPool)
+        {
+            pu_bpool_cache_flush( &aCaches[i] );
+        }
+    }
+}
+/* pu_bpool_cache_exit */
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * @brief   Creates a pool, commits the first slab
+ *
+ * @param[out] ppPool         : The pool
+ * @param[in]  uiBlockSize    : Bytes per block
+ * @param[in]  uiAlign        : Block alignment, power of two up to the page size (0 = 8)
+ * @param[in]  uiBlocksPerSlab: Blocks per slab, rounded up to a power of two
+ * @param[in]  uiMaxSlabs     : Slabs the pool may grow to
+ * @param[in]  bThreadCache   : Keep per-thread caches
+ * @retval  0 for success
+ * @retval  EINVAL bad parameter
+ * @retval  ENOMEM
+ */
+int pu_bpool_create(
+    pu_bpool_t** ppPool,
+    size_t       uiBlockSize,
+    size_t       uiAlign,
+    uint32_t     uiBlocksPerSlab,
+    uint32_t     uiMaxSlabs,
+    bool         bThreadCache )
+{
+    pu_bpool_t* pPool    = NULL;
+    size_t      uiPage   = (size_t)sysconf( _SC_PAGESIZE );
+    size_t      uiStride;
+    uint32_t    uiPerSlab;
+    uint32_t    i;
+    void*       pMem;
+    int         iResult;
+
+    ASSERT( ppPool );
+    uiAlign = (0 == uiAlign) ? 8 : uiAlign;
+    uiAlign = (uiAlign < PU_BPOOL_MIN_ALIGN) ? PU_BPOOL_MIN_ALIGN : uiAlign;
+    if ((NULL == ppPool) || (0 == uiBlockSize) || (0 == uiBlocksPerSlab) || (0 == uiMaxSlabs) ||
+        (0 != (uiAlign & (uiAlign - 1))) || (uiAlign > uiPage) || (uiBlocksPerSlab > (1u << 24)))
+    {
+        return (EINVAL);
+    }
+    uiStride  = (uiBlockSize + uiAlign - 1) & ~(uiAlign - 1);
+    uiPerSlab = (uiBlocksPerSlab & (uiBlocksPerSlab - 1)) ? (1u << (32 - __builtin_clz( uiBlocksPerSlab ))) : uiBlocksPerSlab;
+    if ((uiStride > UINT32_MAX / uiPerSlab) || ((uint64_t)uiPerSlab * uiMaxSlabs >= UINT32_MAX))
+    {
+        return (EINVAL);
+    }
+
+    if (0 != posix_memalign( &pMem, PU_BPOOL_CACHE_LINE, sizeof(pu_bpool_t) ))
+    {
+        return (ENOMEM);
+    }
+    pPool = (pu_bpool_t*)pMem;
+    memset( pPool, 0, sizeof(*pPool) );
+    pPool->uiBlockSize    = uiBlockSize;
+    pPool->uiStride       = (uint32_t)uiStride;
+    pPool->uiPerSlab      = uiPerSlab;
+    pPool->uiPerSlabShift = (uint32_t)__builtin_ctz( uiPerSlab );
+    pPool->uiMaxSlabs     = uiMaxSlabs;
+    pPool->uiSlabBytes    = (((size_t)uiPerSlab * uiStride) + uiPage - 1) & ~(uiPage - 1);
+    pPool->bThreadCache   = bThreadCache;
+    if (pPool->uiSlabBytes > SIZE_MAX / uiMaxSlabs)
+    {
+        free( pPool );
+        return (EINVAL);
+    }
+
+    /* Address space only, slabs are committed by pu_bpool_grow */
+    pPool->pBase = (uint8_t*)mmap( NULL, pPool->uiSlabBytes * uiMaxSlabs, PROT_NONE,
+                                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+    if (MAP_FAILED == pPool->pBase)
+    {
+        LOG_ERROR( "PU_BPOOL(create): cannot reserve %u x %zu bytes\n", uiMaxSlabs, pPool->uiSlabBytes );
+        free( pPool );
+        return (ENOMEM);
+    }
+    iResult = pu_mutex_create_type( &(pPool->mtxGrow), PU_MUTEX_TYPE_FAST );
+    if (0 == iResult)
+    {
+        iResult = pu_bpool_grow( pPool );
+        if (0 != iResult)
+        {
+            pthread_mutex_destroy( &(pPool->mtxGrow) );
+        }
+    }
+
+    /* Register, so thread caches can be handed back */
+    if (0 == iResult)
+    {
+        iResult = ENOMEM;
+        pthread_mutex_lock( &mtxPools );
+        for (i = 0; i < PU_BPOOL_MAX_POOLS; i++)
+        {
+            if (NULL == apPools[i])
+            {
+                pPool->uiId = uiNextId++;
+                apPools[i]  = pPool;
+                iResult     = 0;
+                break;
+            }
+        }
+        pthread_mutex_unlock( &mtxPools );
+        if (0 != iResult)
+        {
+            LOG_ERROR( "PU_BPOOL(create): more than %u pools\n", PU_BPOOL_MAX_POOLS );
+            pthread_mutex_destroy( &(pPool->mtxGrow) );
+        }
+    }
+    if (0 != iResult)
+    {
+        munmap( pPool->pBase, pPool->uiSlabBytes * uiMaxSlabs );
+        free( pPool );
+        pPool = NULL;
+    }
+    *ppPool = pPool;
+    return (iResult);
+}
+/* pu_bpool_create */
+
+/**
+ * @brief   Destroys a pool and all its slabs
+ *
+ * @param[in] pPool : The pool
+ */
+void pu_bpool_destroy( pu_bpool_t* pPool )
+{
+    uint32_t i;
+
+    ASSERT( pPool );
+    if (NULL == pPool)
+    {
+        return;
+    }
+
+    /* This thread's cache goes now, the other threads drop theirs on the id mismatch */
+    for (i = 0; i < PU_BPOOL_THREAD_POOLS; i++)
+    {
+        if (aCaches[i].pPool == pPool)
+        {
+            aCaches[i].pPool   = NULL;
+            aCaches[i].uiCount = 0;
+        }
+    }
+    pthread_mutex_lock( &mtxPools );
+    for (i = 0; i < PU_BPOOL_MAX_POOLS; i++)
+    {
+        if (apPools[i] == pPool)
+        {
+            apPools[i] = NULL;
+        }
+    }
+    pthread_mutex_unlock( &mtxPools );
+
+    pthread_mutex_destroy( &(pPool->mtxGrow) );
+    munmap( pPool->pBase, pPool->uiSlabBytes * pPool->uiMaxSlabs );
+    free( pPool );
+}
+/* pu_bpool_destroy */
+
+/**
+ * @brief   Commits slabs until the pool has at least uiBlocks blocks
+ *
+ * @param[in] pPool    : The pool
+ * @param[in] uiBlocks : Blocks wanted
+ * @retval  0 for success
+ * @retval  ENOMEM the pool would grow beyond uiMaxSlabs
+ */
+int pu_bpool_reserve(
+    pu_bpool_t* pPool,
+    uint32_t    uiBlocks )
+{
+    int iResult = 0;
+
+    ASSERT( pPool );
+    pthread_mutex_lock( &(pPool->mtxGrow) );
+    while ((0 == iResult) && ((uint64_t)pPool->uiSlabs * pPool->uiPerSlab < uiBlocks))
+    {
+        iResult = pu_bpool_commit( pPool );
+    }
+    pthread_mutex_unlock( &(pPool->mtxGrow) );
+    return (iResult);
+}
+/* pu_bpool_reserve */
+
+/**
+ * @brief   Allocates a block
+ *
+ * @param[in] pPool : The pool
+ * @return  The block, NULL if the pool is exhausted
+ */
+void* pu_bpool_alloc( pu_bpool_t* pPool )
+{
+    pu_bpool_cache_t* pCache;
+    void*             pBlock;
+
+    ASSERT( pPool );
+    if (!pPool->bThreadCache || (NULL == (pCache = pu_bpool_cache_find( pPool ))))
+    {
+        return (pu_bpool_alloc_global( pPool ));
+    }
+    if (0 != pCache->uiCount)
+    {
+        pCache->uiHits++;
+        return (pCache->apBlocks[--pCache->uiCount]);
+    }
+
+    /* Refill half the cache, plus the one we hand out */
+    pBlock = pu_bpool_alloc_global( pPool );
+    if (pBlock)
+    {
+        while (pCache->uiCount < PU_BPOOL_BATCH)
+        {
+            void* pNext = pu_bpool_pop( pPool );
+            if (NULL == pNext)
+            {
+                break;
+            }
+            pCache->apBlocks[pCache->uiCount++] = pNext;
+        }
+        if (0 != pCache->uiCount)
+        {
+            pu_bpool_count_out( pPool, pCache->uiCount );
+        }
+        if (0 != pCache->uiHits)
+        {
+            __atomic_fetch_add( &(pPool->uiCacheHits), pCache->uiHits, __ATOMIC_RELAXED );
+            pCache->uiHits = 0;
+        }
+    }
+    return (pBlock);
+}
+/* pu_bpool_alloc */
+
+/**
+ * @brief   Frees a block
+ *
+ * @param[in] pPool  : The pool the block came from
+ * @param[in] pBlock : The block, NULL is ignored
+ */
+void pu_bpool_free(
+    pu_bpool_t* pPool,
+    void*       pBlock )
+{
+    pu_bpool_cache_t* pCache;
+
+    ASSERT( pPool );
+    if (NULL == pBlock)
+    {
+        return;
+    }
+    ASSERT( pu_bpool_owns( pPool, pBlock ) );
+    if (!pPool->bThreadCache || (NULL == (pCache = pu_bpool_cache_find( pPool ))))
+    {
+        pu_bpool_spill( pPool, &pBlock, 1 );
+        return;
+    }
+
+    /* Full: the older half goes back to the free list in one push */
+    if (PU_BPOOL_CACHE_SIZE == pCache->uiCount)
+    {
+        pu_bpool_spill( pPool, pCache->apBlocks, PU_BPOOL_BATCH );
+        memmove( pCache->apBlocks, &(pCache->apBlocks[PU_BPOOL_BATCH]), (PU_BPOOL_CACHE_SIZE - PU_BPOOL_BATCH) * sizeof(void*) );
+        pCache->uiCount -= PU_BPOOL_BATCH;
+    }
+    pCache->apBlocks[pCache->uiCount++] = pBlock;
+}
+/* pu_bpool_free */
+
+/**
+ * @brief   Tells whether a block lies in the pool's address range
+ *
+ * @param[in] pPool  : The pool
+ * @param[in] pBlock : Any pointer
+ * @return  true if pBlock is inside one of the pool's slabs
+ */
+bool pu_bpool_owns(
+    const pu_bpool_t* pPool,
+    const void*       pBlock )
+{
+    const uint8_t* p = (const uint8_t*)pBlock;
+
+    return ((p >= pPool->pBase) &&
+            (p <  pPool->pBase + (size_t)__atomic_load_n( &(pPool->uiSlabs), __ATOMIC_RELAXED ) * pPool->uiSlabBytes));
+}
+/* pu_bpool_owns */
+
+/**
+ * @brief   Gets the pool statistics
+ *
+ * @param[in]  pPool  : The pool
+ * @param[out] pStats : Snapshot of the counters
+ */
+void pu_bpool_get_stats(
+    pu_bpool_t*       pPool,
+    pu_bpool_stats_t* pStats )
+{
+    ASSERT( pPool && pStats );
+    pStats->uiBlockSize = pPool->uiBlockSize;
+    pStats->uiStride    = pPool->uiStride;
+    pStats->uiSlabs     = __atomic_load_n( &(pPool->uiSlabs), __ATOMIC_RELAXED );
+    pStats->uiBlocks    = pStats->uiSlabs * pPool->uiPerSlab;
+    pStats->uiInUse     = __atomic_load_n( &(pPool->uiInUse), __ATOMIC_RELAXED );
+    pStats->uiPeakInUse = __atomic_load_n( &(pPool->uiPeakInUse), __ATOMIC_RELAXED );
+    pStats->uiAllocs    = __atomic_load_n( &(pPool->uiAllocs), __ATOMIC_RELAXED );
+    pStats->uiFrees     = __atomic_load_n( &(pPool->uiFrees), __ATOMIC_RELAXED );
+    pStats->uiEmpty     = __atomic_load_n( &(pPool->uiEmpty), __ATOMIC_RELAXED );
+    pStats->uiFailed    = __atomic_load_n( &(pPool->uiFailed), __ATOMIC_RELAXED );
+    pStats->uiCacheHits = __atomic_load_n( &(pPool->uiCacheHits), __ATOMIC_RELAXED );
+}
+/* pu_bpool_get_stats */
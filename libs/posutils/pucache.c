@@ -0,0 +1,494 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+/**
+ * @file     pucache.c
+ * @brief    Thread stack and context cache
+ *
+ * Stacks are mmap'ed by us rather than by glibc:
+ * @code
+ * | guard page (PROT_NONE) | stack (uiSize bytes, pre-faulted) ............ |
+ * ^ mapping                ^ stack address given to pthread_attr_setstack()
+ * @endcode
+ * The creator records in the registry slot whether the stack came from here, the join hands
+ * back only those. Nothing is read from a stack to find out, a glibc stack may be gone by then.
+ *
+ * Stacks are bucketed by the page rounded size from pu_thread_stacksize_fix(). Contexts are all
+ * the same size, they come from a block pool (pubpool.h) with room for every registry slot:
+ * creating a thread takes one off the lock-free free list, the exiting thread puts it back.
+ */
+
+/**** Includes ***************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "posutils.h"
+#include "pudefs.h"
+#include "logging.h"
+#include "pubpool.h"
+#include "sll.h"
+
+/**** Definitions ************************************************************/
+
+/* A bucket of cached stacks, all the same size */
+typedef struct pu_cache_bucket_tag
+{
+    size_t uiSize;                                  /* Stack size (excluding guard) */
+    size_t uiCount;                                 /* Number of cached stacks      */
+    void*  apStacks[PU_THREAD_CACHE_MAX_STACKS];    /* Cached stacks (LIFO)         */
+    SLL_ENTRY(pu_cache_bucket_tag);
+}   pu_cache_bucket_t;
+
+/* A prewarm request, recorded if made before posutils_init() */
+typedef struct
+{
+    size_t uiStackSize;                      /* Requested (unfixed) stack size     */
+    size_t uiCount;                          /* Number of stacks                   */
+}   pu_cache_prewarm_t;
+
+#define PU_CACHE_MAX_PREWARM  (8)
+#define PU_CACHE_CTX_ALIGN    (64)
+#define PU_CACHE_CTX_PER_SLAB (16)
+#define PU_CACHE_CTX_SLABS    ((PU_THREAD_MAX_THREADS / PU_CACHE_CTX_PER_SLAB) + 2)
+
+/**** Macros ****************************************************************/
+
+/**** Static declarations ***************************************************/
+static pthread_mutex_t         mtxCache;
+static bool                    bIsInit      = false;
+static bool                    bEnabled     = false;
+static size_t                  uiPageSize   = 0;
+static size_t                  uiCtxSize    = 0;
+static pu_cache_bucket_t*      pBucketList  = NULL;
+static pu_bpool_t*             pCtxPool     = NULL;
+static size_t                  uiStacksOut  = 0;
+static pu_thread_cache_stats_t stats;
+
+/* Requests made before init */
+static pu_cache_prewarm_t      aPrewarm[PU_CACHE_MAX_PREWARM];
+static size_t                  uiNumPrewarm = 0;
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static pu_cache_bucket_t* pu_cache_bucket_find( size_t uiSize, bool bCreate );
+static void*              pu_cache_stack_map( size_t uiSize );
+static void               pu_cache_stack_unmap( void* pStack, size_t uiSize );
+static int                pu_cache_prewarm_now( size_t uiStackSize, size_t uiCount );
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+/* Called with the cache lock held. There are only ever a handful of sizes, a list is fine */
+static pu_cache_bucket_t* pu_cache_bucket_find( size_t uiSize, bool bCreate )
+{
+    pu_cache_bucket_t* pBucket;
+
+    SLL_FOR_EACH( pBucketList, pBucket )
+    {
+        if (pBucket->uiSize == uiSize)
+        {
+            return (pBucket);
+        }
+    }
+    if (bCreate)
+    {
+        pBucket = (pu_cache_bucket_t*)calloc( 1, sizeof(pu_cache_bucket_t) );
+        if (pBucket)
+        {
+            pBucket->uiSize = uiSize;
+            SLL_ELEM_ADD( pBucketList, pBucket );
+        }
+    }
+    return (pBucket);
+}
+/* pu_cache_bucket_find */
+
+/* Maps, guards and pre-faults a stack */
+static void* pu_cache_stack_map( size_t uiSize )
+{
+    uint8_t* pMap;
+    uint8_t* pStack;
+    size_t   uiOffset;
+
+    pMap = (uint8_t*)mmap(
+        NULL,
+        uiSize + uiPageSize,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK,
+        -1,
+        0 );
+    if (MAP_FAILED == pMap)
+    {
+        LOG_ERROR( "PU_CACHE:cannot map %zu byte stack\n", uiSize );
+        return (NULL);
+    }
+    if (0 != mprotect( pMap, uiPageSize, PROT_NONE ))
+    {
+        munmap( pMap, uiSize + uiPageSize );
+        return (NULL);
+    }
+
+    /* Touch every page so the first run of the thread doesn't take the faults */
+    pStack = pMap + uiPageSize;
+    for (uiOffset = 0; uiOffset < uiSize; uiOffset += uiPageSize)
+    {
+        pStack[uiOffset] = 0;
+    }
+    return (pStack);
+}
+/* pu_cache_stack_map */
+
+static void pu_cache_stack_unmap( void* pStack, size_t uiSize )
+{
+    munmap( (uint8_t*)pStack - uiPageSize, uiSize + uiPageSize );
+}
+/* pu_cache_stack_unmap */
+
+/* Fills a bucket up to uiCount cached stacks. Needs the page size, so only after init */
+static int pu_cache_prewarm_now( size_t uiStackSize, size_t uiCount )
+{
+    pu_cache_bucket_t* pBucket;
+    size_t             uiSize = pu_thread_stacksize_fix( uiStackSize );
+    void*              pStack;
+    int                iResult = 0;
+
+    if (uiCount > PU_THREAD_CACHE_MAX_STACKS)
+    {
+        uiCount = PU_THREAD_CACHE_MAX_STACKS;
+    }
+    pthread_mutex_lock( &mtxCache );
+    pBucket = pu_cache_bucket_find( uiSize, true );
+    while (pBucket && (pBucket->uiCount < uiCount))
+    {
+        pStack = pu_cache_stack_map( uiSize );
+        if (NULL == pStack)
+        {
+            iResult = ENOMEM;
+            break;
+        }
+        pBucket->apStacks[pBucket->uiCount++] = pStack;
+        stats.uiStacksCached++;
+    }
+
+    pthread_mutex_unlock( &mtxCache );
+
+    /* Contexts, one per prewarmed stack */
+    if ((0 == iResult) && pCtxPool && (0 != pu_bpool_reserve( pCtxPool, (uint32_t)uiCount )))
+    {
+        iResult = ENOMEM;
+    }
+    return (iResult);
+}
+/* pu_cache_prewarm_now */
+
+/****************************************************************************/
+/* PRIVATE FUNCTION DEFINITIONS                                             */
+/****************************************************************************/
+
+/**
+ * @brief Initialises the cache, runs any prewarm requests made before init
+ *
+ * @param[in] uiContextSize : Size of a thread context
+ * @retval 0     Success
+ * @retval non-0 Error
+ */
+int pu_cache_init_private( size_t uiContextSize )
+{
+    int    iResult;
+    size_t i;
+
+    uiPageSize = (size_t)sysconf( _SC_PAGESIZE );
+    uiCtxSize  = uiContextSize;
+    memset( &stats, 0, sizeof(stats) );
+
+    /* A context has cache line aligned members (the mailbox). It is freed by the exiting thread,
+     * not the creator, so a per-thread cache would not help */
+    iResult = pu_bpool_create( &pCtxPool, uiCtxSize, PU_CACHE_CTX_ALIGN, PU_CACHE_CTX_PER_SLAB, PU_CACHE_CTX_SLABS, false );
+    ASSERT( 0 == iResult );
+    if (0 == iResult)
+    {
+        iResult = pu_mutex_create_type( &mtxCache, PU_MUTEX_TYPE_FAST );
+        ASSERT( 0 == iResult );
+    }
+    if (0 == iResult)
+    {
+        bIsInit = true;
+        for (i = 0; i < uiNumPrewarm; i++)
+        {
+            pu_cache_prewarm_now( aPrewarm[i].uiStackSize, aPrewarm[i].uiCount );
+        }
+        uiNumPrewarm = 0;
+    }
+    return (iResult);
+}
+/* pu_cache_init_private */
+
+/**
+ * @brief Empties the cache, unmaps the stacks, frees the contexts
+ *
+ * @retval 0     Success
+ * @retval EBUSY Stacks or contexts are still out, nothing was freed
+ * @retval non-0 Error
+ *
+ * @par Description
+ * Stacks and contexts still out belong to threads that have not been joined. They would come
+ * back through \ref pu_cache_stack_put and \ref pu_cache_context_put, which need the pool and
+ * the lock, so the cache stays as it is.
+ */
+int pu_cache_exit_private( void )
+{
+    pu_cache_bucket_t* pBucket;
+    pu_bpool_stats_t   poolStats;
+
+    if (!bIsInit)
+    {
+        return (0);
+    }
+    pthread_mutex_lock( &mtxCache );
+    memset( &poolStats, 0, sizeof(poolStats) );
+    if (pCtxPool)
+    {
+        pu_bpool_get_stats( pCtxPool, &poolStats );
+    }
+    if ((0 != poolStats.uiInUse) || (0 != __atomic_load_n( &uiStacksOut, __ATOMIC_RELAXED )))
+    {
+        LOG_ERROR( "PU_CACHE(exit): %zu contexts and %zu stacks still out\n",
+            (size_t)poolStats.uiInUse, __atomic_load_n( &uiStacksOut, __ATOMIC_RELAXED ) );
+        pthread_mutex_unlock( &mtxCache );
+        return (EBUSY);
+    }
+    while (NULL != (pBucket = pBucketList))
+    {
+        while (pBucket->uiCount > 0)
+        {
+            pu_cache_stack_unmap( pBucket->apStacks[--pBucket->uiCount], pBucket->uiSize );
+        }
+        pBucketList = pBucket->pSllNextElem;
+        free( pBucket );
+    }
+    if (pCtxPool)
+    {
+        pu_bpool_destroy( pCtxPool );
+    }
+    pCtxPool = NULL;
+    bIsInit  = false;
+    bEnabled = false;
+    pthread_mutex_unlock( &mtxCache );
+    return (pthread_mutex_destroy( &mtxCache ));
+}
+/* pu_cache_exit_private */
+
+/**
+ * @brief Gets a stack of the (already fixed) size
+ *
+ * @param[in] uiSize : Stack size, as returned by pu_thread_stacksize_fix()
+ * @return Stack address, NULL if the cache is disabled (let glibc do it)
+ */
+void* pu_cache_stack_get( size_t uiSize )
+{
+    pu_cache_bucket_t* pBucket;
+    void*              pStack = NULL;
+
+    if (!bIsInit || !__atomic_load_n( &bEnabled, __ATOMIC_RELAXED ))
+    {
+        return (NULL);
+    }
+    pthread_mutex_lock( &mtxCache );
+    pBucket = pu_cache_bucket_find( uiSize, false );
+    if (pBucket && (pBucket->uiCount > 0))
+    {
+        pStack = pBucket->apStacks[--pBucket->uiCount];
+        stats.uiStacksCached--;
+        stats.uiStackHits++;
+    }
+    else
+    {
+        stats.uiStackMisses++;
+    }
+    pthread_mutex_unlock( &mtxCache );
+
+    /* Miss, map a new one outside the lock. It still comes back to the cache on join */
+    if (NULL == pStack)
+    {
+        pStack = pu_cache_stack_map( uiSize );
+    }
+    if (pStack)
+    {
+        __atomic_fetch_add( &uiStacksOut, 1, __ATOMIC_RELAXED );
+    }
+    return (pStack);
+}
+/* pu_cache_stack_get */
+
+/**
+ * @brief Returns a stack after the owning thread has been joined
+ *
+ * @param[in] pStack : Stack from \ref pu_cache_stack_get, NULL does nothing
+ * @param[in] uiSize : Stack size
+ *
+ * @par Description
+ * The stack is cached, or unmapped if the bucket is full or the cache has been disabled since.
+ */
+void pu_cache_stack_put( void* pStack, size_t uiSize )
+{
+    pu_cache_bucket_t* pBucket;
+    bool               bCached = false;
+
+    if (NULL == pStack)
+    {
+        return;
+    }
+    __atomic_fetch_sub( &uiStacksOut, 1, __ATOMIC_RELAXED );
+    if (bIsInit && __atomic_load_n( &bEnabled, __ATOMIC_RELAXED ))
+    {
+        pthread_mutex_lock( &mtxCache );
+        pBucket = pu_cache_bucket_find( uiSize, true );
+        if (pBucket && (pBucket->uiCount < PU_THREAD_CACHE_MAX_STACKS))
+        {
+            pBucket->apStacks[pBucket->uiCount++] = pStack;
+            stats.uiStacksCached++;
+            bCached = true;
+        }
+        pthread_mutex_unlock( &mtxCache );
+    }
+    if (!bCached)
+    {
+        pu_cache_stack_unmap( pStack, uiSize );
+    }
+}
+/* pu_cache_stack_put */
+
+/**
+ * @brief Gets a thread context
+ *
+ * @return Context (uninitialised), NULL if out of memory
+ */
+void* pu_cache_context_get( void )
+{
+    void* pCtx = NULL;
+
+    if (pCtxPool)
+    {
+        return (pu_bpool_alloc( pCtxPool ));
+    }
+    return ((0 == posix_memalign( &pCtx, PU_CACHE_CTX_ALIGN, uiCtxSize )) ? pCtx : NULL);
+}
+/* pu_cache_context_get */
+
+/**
+ * @brief Returns a thread context
+ *
+ * @param[in] pContext : The context
+ */
+void pu_cache_context_put( void* pContext )
+{
+    if (pCtxPool && pu_bpool_owns( pCtxPool, pContext ))
+    {
+        pu_bpool_free( pCtxPool, pContext );
+    }
+    else
+    {
+        free( pContext );
+    }
+}
+/* pu_cache_context_put */
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * @brief Enables or disables the thread stack and context cache
+ *
+ * @param[in] bEnable : true to enable
+ */
+void pu_thread_cache_enable( bool bEnable )
+{
+    __atomic_store_n( &bEnabled, bEnable, __ATOMIC_RELAXED );
+}
+/* pu_thread_cache_enable */
+
+/**
+ * @brief Prewarms the cache with stacks (and contexts), enables the cache
+ *
+ * @param[in] uiStackSize : Stack size, as would be passed to \ref pu_thread_create
+ * @param[in] uiCount     : Number of stacks to have ready
+ * @retval 0     Success
+ * @retval non-0 Error
+ */
+int pu_thread_cache_prewarm(
+    size_t uiStackSize,
+    size_t uiCount )
+{
+    int iResult = 0;
+
+    pu_thread_cache_enable( true );
+    if (bIsInit)
+    {
+        iResult = pu_cache_prewarm_now( uiStackSize, uiCount );
+    }
+
+    /* Not initialised yet, do it in posutils_init() */
+    else if (uiNumPrewarm < PU_CACHE_MAX_PREWARM)
+    {
+        aPrewarm[uiNumPrewarm].uiStackSize = uiStackSize;
+        aPrewarm[uiNumPrewarm].uiCount     = uiCount;
+        uiNumPrewarm++;
+    }
+    else
+    {
+        iResult = ENOMEM;
+    }
+    return (iResult);
+}
+/* pu_thread_cache_prewarm */
+
+/**
+ * @brief Gets the cache counters
+ *
+ * @param[out] pStats : Filled in with a copy of the counters
+ */
+void pu_thread_cache_get_stats( pu_thread_cache_stats_t* pStats )
+{
+    ASSERT( pStats );
+    if (pStats)
+    {
+        if (bIsInit)
+        {
+            pu_bpool_stats_t poolStats;
+
+            pthread_mutex_lock( &mtxCache );
+            *pStats = stats;
+            pthread_mutex_unlock( &mtxCache );
+
+            /* Contexts: a miss is an allocation that found the pool empty and had to grow it */
+            pu_bpool_get_stats( pCtxPool, &poolStats );
+            pStats->uiContextMisses  = (size_t)poolStats.uiEmpty;
+            pStats->uiContextHits    = (size_t)(poolStats.uiAllocs - (poolStats.uiEmpty - poolStats.uiFailed));
+            pStats->uiContextsCached = poolStats.uiBlocks - poolStats.uiInUse;
+        }
+        else
+        {
+            memset( pStats, 0, sizeof(*pStats) );
+        }
+    }
+}
+/* pu_thread_cache_get_stats */
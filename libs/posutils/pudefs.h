@@ -31,12 +31,47 @@ extern "C" {
  */
 
 /**** Includes ***************************************************************/
+#include <stddef.h>
 #include <stdbool.h>
 #include <stdint.h>
 
 /**** Definitions ************************************************************/
 int pu_thread_init_private( void );
 int pu_thread_exit_private( void );
+size_t pu_thread_stacksize_fix( size_t uiStackSize );
+size_t pu_thread_context_size_private( void );
+size_t pu_thread_count_private( void );
+uint64_t pu_thread_now_ns_private( void );
+void pu_thread_blocked_private( const void* pObj, const char* szKind );
+void pu_thread_stop_hook_private( void (*fctHook)( void* ), void* pArg );
+
+/* Futex system call wrappers */
+struct timespec;
+int pu_futex_wait_private( uint32_t* puiAddr, uint32_t uiVal, const struct timespec* pTimeout );
+int pu_futex_wake_private( uint32_t* puiAddr, int iCount );
+void pu_futex_deadline_private( struct timespec* pDeadline, uint32_t uiTimeoutMs );
+int pu_futex_wait_until_private( uint32_t* puiAddr, uint32_t uiVal, const struct timespec* pDeadline );
+
+/* Profiled mutexes */
+void pu_mutex_prof_exit_private( void );
+
+/* Stack and context cache */
+int   pu_cache_init_private( size_t uiContextSize );
+int   pu_cache_exit_private( void );
+void* pu_cache_stack_get( size_t uiSize );
+void  pu_cache_stack_put( void* pStack, size_t uiSize );
+void* pu_cache_context_get( void );
+void  pu_cache_context_put( void* pContext );
+
+/* Stack painting and profile */
+int    pu_stack_init_private( void );
+int    pu_stack_exit_private( void );
+void   pu_stack_paint_private( void );
+void   pu_stack_measure_private( const char* szName );
+size_t pu_stack_tune_private( const char* szName, size_t uiStackSize );
+
+/* Thread arenas */
+void pu_arena_thread_exit_private( void );
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,320 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+/**
+ * @file     pufutex.c
+ * @brief    Futex based synchronisation, the slow (kernel) paths
+ *
+ * The waits use FUTEX_WAIT_BITSET, which takes an absolute CLOCK_MONOTONIC deadline: a waiter that
+ * wakes up for nothing (another thread took the count, a flag was cleared again) goes back to
+ * sleep without having to recompute its timeout.
+ */
+
+/**** Includes ***************************************************************/
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "pufutex.h"
+#include "pudefs.h"
+#include "logging.h"
+
+/**** Definitions ************************************************************/
+
+/**** Macros ****************************************************************/
+
+/**** Static declarations ***************************************************/
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+/**
+ * @brief Sleeps while *puiAddr == uiVal (private futex)
+ *
+ * @param[in] puiAddr  : Futex word
+ * @param[in] uiVal    : Expected value
+ * @param[in] pTimeout : Relative timeout, NULL for none
+ * @retval 0 woken (or spurious)
+ * @retval Non-zero errno, EAGAIN if the value had already changed, ETIMEDOUT
+ */
+int pu_futex_wait_private( uint32_t* puiAddr, uint32_t uiVal, const struct timespec* pTimeout )
+{
+    if (0 != syscall( SYS_futex, puiAddr, FUTEX_WAIT_PRIVATE, uiVal, pTimeout, NULL, 0 ))
+    {
+        return (errno);
+    }
+    return (0);
+}
+/* pu_futex_wait_private */
+
+/**
+ * @brief Wakes up to iCount threads sleeping on the futex word (private futex)
+ *
+ * @param[in] puiAddr : Futex word
+ * @param[in] iCount  : Number of threads to wake, INT_MAX for all
+ * @return Number of threads woken
+ */
+int pu_futex_wake_private( uint32_t* puiAddr, int iCount )
+{
+    return ((int)syscall( SYS_futex, puiAddr, FUTEX_WAKE_PRIVATE, iCount, NULL, NULL, 0 ));
+}
+/* pu_futex_wake_private */
+
+/* Absolute CLOCK_MONOTONIC deadline uiTimeoutMs from now */
+void pu_futex_deadline_private( struct timespec* pDeadline, uint32_t uiTimeoutMs )
+{
+    clock_gettime( CLOCK_MONOTONIC, pDeadline );
+    pDeadline->tv_sec  += (time_t)(uiTimeoutMs / 1000);
+    pDeadline->tv_nsec += (long)(uiTimeoutMs % 1000) * 1000000L;
+    if (pDeadline->tv_nsec >= 1000000000L)
+    {
+        pDeadline->tv_nsec -= 1000000000L;
+        pDeadline->tv_sec++;
+    }
+}
+/* pu_futex_deadline_private */
+
+/**
+ * @brief Sleeps while *puiAddr == uiVal, until an absolute deadline (private futex)
+ *
+ * @param[in] puiAddr   : Futex word
+ * @param[in] uiVal     : Expected value
+ * @param[in] pDeadline : Absolute CLOCK_MONOTONIC deadline, NULL for none
+ * @retval 0 woken (or spurious, or the value had already changed)
+ * @retval ETIMEDOUT
+ */
+int pu_futex_wait_until_private( uint32_t* puiAddr, uint32_t uiVal, const struct timespec* pDeadline )
+{
+    if (0 != syscall( SYS_futex, puiAddr, FUTEX_WAIT_BITSET_PRIVATE, uiVal, pDeadline, NULL, FUTEX_BITSET_MATCH_ANY ))
+    {
+        return ((ETIMEDOUT == errno) ? ETIMEDOUT : 0);
+    }
+    return (0);
+}
+/* pu_futex_wait_until_private */
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * @brief   Contended part of the futex mutex lock
+ *
+ * @param[in] pMtx : Futex mutex
+ *
+ * @par Description
+ * Spin first, a short critical section on another core is probably about to end. Then mark the
+ * word "locked with waiters" (2) and sleep until it is handed back as 0.
+ */
+void pu_futex_mutex_lock_slow( pu_futex_mutex_t* pMtx )
+{
+    uint32_t uiState;
+    uint32_t i;
+
+    /* Bounded spin, read only until it looks free so the cache line is not bounced */
+    for (i = 0; i < PU_FUTEX_SPIN; i++)
+    {
+        uiState = __atomic_load_n( &(pMtx->uiState), __ATOMIC_RELAXED );
+        if ((0 == uiState) && pu_futex_mutex_trylock( pMtx ))
+        {
+            return;
+        }
+        if (2 == uiState)
+        {
+            break; /* Others are already asleep, join them */
+        }
+        PU_FUTEX_RELAX();
+    }
+
+    /* Sleep. Whoever gets it from here on leaves it at 2, so the unlock will wake the next one */
+    uiState = __atomic_exchange_n( &(pMtx->uiState), 2, __ATOMIC_ACQUIRE );
+    if (0 != uiState)
+    {
+        pu_thread_blocked_private( pMtx, "futex mutex" );
+        while (0 != uiState)
+        {
+            pu_futex_wait_private( &(pMtx->uiState), 2, NULL );
+            uiState = __atomic_exchange_n( &(pMtx->uiState), 2, __ATOMIC_ACQUIRE );
+        }
+        pu_thread_blocked_private( NULL, NULL );
+    }
+}
+/* pu_futex_mutex_lock_slow */
+
+/**
+ * @brief   Wakes one waiter of a futex mutex
+ *
+ * @param[in] pMtx : Futex mutex
+ */
+void pu_futex_mutex_wake( pu_futex_mutex_t* pMtx )
+{
+    pu_futex_wake_private( &(pMtx->uiState), 1 );
+}
+/* pu_futex_mutex_wake */
+
+/**
+ * @brief   Sleeping part of the event wait
+ *
+ * @par Description
+ * The waiter count goes up before the flags are checked again, and the setter changes the flags
+ * before it reads the waiter count (both sequentially consistent): either the setter sees the
+ * waiter, or the waiter sees the flags. A flag change between the check and the sleep makes the
+ * futex wait return at once.
+ */
+int pu_futex_event_wait_slow(
+    pu_futex_event_t* pEvent,
+    uint32_t          uiMask,
+    uint32_t          uiOptions,
+    uint32_t          uiTimeoutMs,
+    uint32_t*         puiFlags )
+{
+    struct timespec deadline;
+    uint32_t        uiSeen;
+    int             iResult = 0;
+
+    if (PU_FUTEX_FOREVER != uiTimeoutMs)
+    {
+        pu_futex_deadline_private( &deadline, uiTimeoutMs );
+    }
+    __atomic_fetch_add( &(pEvent->uiWaiters), 1, __ATOMIC_SEQ_CST );
+    pu_thread_blocked_private( pEvent, "event" );
+    while (!pu_futex_event_trywait( pEvent, uiMask, uiOptions, &uiSeen ))
+    {
+        iResult = pu_futex_wait_until_private( &(pEvent->uiFlags), uiSeen, (PU_FUTEX_FOREVER != uiTimeoutMs) ? &deadline : NULL );
+        if (ETIMEDOUT == iResult)
+        {
+            iResult = pu_futex_event_trywait( pEvent, uiMask, uiOptions, &uiSeen ) ? 0 : ETIMEDOUT;
+            break;
+        }
+    }
+    pu_thread_blocked_private( NULL, NULL );
+    __atomic_fetch_sub( &(pEvent->uiWaiters), 1, __ATOMIC_RELAXED );
+    if (puiFlags && (0 == iResult))
+    {
+        *puiFlags = uiSeen;
+    }
+    return (iResult);
+}
+/* pu_futex_event_wait_slow */
+
+/**
+ * @brief   Wakes every waiter of an event group, each one rechecks its own mask
+ *
+ * @param[in] pEvent : Event group
+ */
+void pu_futex_event_wake( pu_futex_event_t* pEvent )
+{
+    pu_futex_wake_private( &(pEvent->uiFlags), INT_MAX );
+}
+/* pu_futex_event_wake */
+
+/**
+ * @brief   Sleeping part of the semaphore wait
+ *
+ * @par Description
+ * Sleeps while the count is 0. A post wakes one waiter, which may find the count already taken
+ * by a thread on the fast path: it then simply sleeps again.
+ */
+int pu_futex_sem_wait_slow(
+    pu_futex_sem_t* pSem,
+    uint32_t        uiTimeoutMs )
+{
+    struct timespec deadline;
+    int             iResult = 0;
+
+    if (PU_FUTEX_FOREVER != uiTimeoutMs)
+    {
+        pu_futex_deadline_private( &deadline, uiTimeoutMs );
+    }
+    __atomic_fetch_add( &(pSem->uiWaiters), 1, __ATOMIC_SEQ_CST );
+    pu_thread_blocked_private( pSem, "semaphore" );
+    while (!pu_futex_sem_trywait( pSem ))
+    {
+        iResult = pu_futex_wait_until_private( &(pSem->uiCount), 0, (PU_FUTEX_FOREVER != uiTimeoutMs) ? &deadline : NULL );
+        if (ETIMEDOUT == iResult)
+        {
+            iResult = pu_futex_sem_trywait( pSem ) ? 0 : ETIMEDOUT;
+            break;
+        }
+    }
+    pu_thread_blocked_private( NULL, NULL );
+    __atomic_fetch_sub( &(pSem->uiWaiters), 1, __ATOMIC_RELAXED );
+    return (iResult);
+}
+/* pu_futex_sem_wait_slow */
+
+/**
+ * @brief   Wakes one waiter of a semaphore
+ *
+ * @param[in] pSem : Semaphore
+ */
+void pu_futex_sem_wake( pu_futex_sem_t* pSem )
+{
+    pu_futex_wake_private( &(pSem->uiCount), 1 );
+}
+/* pu_futex_sem_wake */
+
+/**
+ * @brief   Sleeping part of the latch wait
+ */
+int pu_futex_latch_wait_slow(
+    pu_futex_latch_t* pLatch,
+    uint32_t          uiTimeoutMs )
+{
+    struct timespec deadline;
+    uint32_t        uiCount;
+    int             iResult = 0;
+
+    if (PU_FUTEX_FOREVER != uiTimeoutMs)
+    {
+        pu_futex_deadline_private( &deadline, uiTimeoutMs );
+    }
+    __atomic_fetch_add( &(pLatch->uiWaiters), 1, __ATOMIC_SEQ_CST );
+    pu_thread_blocked_private( pLatch, "latch" );
+    while (0 != (uiCount = __atomic_load_n( &(pLatch->uiCount), __ATOMIC_SEQ_CST )))
+    {
+        iResult = pu_futex_wait_until_private( &(pLatch->uiCount), uiCount, (PU_FUTEX_FOREVER != uiTimeoutMs) ? &deadline : NULL );
+        if (ETIMEDOUT == iResult)
+        {
+            iResult = pu_futex_latch_trywait( pLatch ) ? 0 : ETIMEDOUT;
+            break;
+        }
+    }
+    pu_thread_blocked_private( NULL, NULL );
+    __atomic_fetch_sub( &(pLatch->uiWaiters), 1, __ATOMIC_RELAXED );
+    return (iResult);
+}
+/* pu_futex_latch_wait_slow */
+
+/**
+ * @brief   Wakes every waiter of a latch
+ *
+ * @param[in] pLatch : Latch
+ */
+void pu_futex_latch_wake( pu_futex_latch_t* pLatch )
+{
+    pu_futex_wake_private( &(pLatch->uiCount), INT_MAX );
+}
+/* pu_futex_latch_wake */
@@ -0,0 +1,517 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+
+
+/**
+ * @file     puhmap.c
+ * @brief    Intrusive open addressing hash map: probing, backward shift, incremental resize
+ *
+ * The home bucket of a hash is its top bits after a Fibonacci multiply, so weak hashes (small
+ * consecutive integers) still spread. While tblOld is being drained, every bucket of it below
+ * uiMigrate is empty: entries are only ever moved out of it (never in), and a backward shift
+ * moves an entry to an earlier bucket of its own run, which cannot reach back past an empty one.
+ */
+
+/**** Includes ***************************************************************/
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "puhmap.h"
+#include "logging.h"
+
+/**** Definitions ************************************************************/
+#define PU_HMAP_FIB       (0x9E3779B1u)
+#define PU_HMAP_NOT_FOUND ((size_t)-1)
+
+/**** Macros ****************************************************************/
+#define PU_HMAP_HOME(tbl_,hash_) ((size_t)(((hash_) * PU_HMAP_FIB) >> (tbl_)->uiShift))
+#define PU_HMAP_NEXT(tbl_,i_)    (((i_) + 1) & ((tbl_)->uiBuckets - 1))
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static uint32_t pu_hmap_hash( const pu_hmap_t* pMap, const void* pKey );
+static int      pu_hmap_table_alloc( pu_hmap_table_t* pTbl, size_t uiBuckets );
+static void     pu_hmap_table_free( pu_hmap_table_t* pTbl );
+static void     pu_hmap_table_put( pu_hmap_table_t* pTbl, uint32_t uiHash, void* pEntry );
+static void     pu_hmap_table_del( pu_hmap_table_t* pTbl, size_t i );
+static size_t   pu_hmap_table_find( const pu_hmap_t* pMap, const pu_hmap_table_t* pTbl, uint32_t uiHash, const void* pKey );
+static size_t   pu_hmap_table_find_entry( const pu_hmap_table_t* pTbl, uint32_t uiHash, const void* pEntry );
+static void     pu_hmap_migrate( pu_hmap_t* pMap, size_t uiSteps );
+static int      pu_hmap_grow( pu_hmap_t* pMap );
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+/* Caller's hash, with 0 kept free for empty buckets */
+static uint32_t pu_hmap_hash( const pu_hmap_t* pMap, const void* pKey )
+{
+    uint32_t uiHash = pMap->pOps->pfnHash( pKey );
+    return ((0 == uiHash) ? 1u : uiHash);
+}
+/* pu_hmap_hash */
+
+/* Pointers first, they have the stricter alignment */
+static int pu_hmap_table_alloc( pu_hmap_table_t* pTbl, size_t uiBuckets )
+{
+    uint32_t uiBits = 0;
+
+    while (((size_t)1 << uiBits) < uiBuckets)
+    {
+        uiBits++;
+    }
+    pTbl->apEntries = (void**)calloc( uiBuckets, sizeof(void*) + sizeof(uint32_t) );
+    if (NULL == pTbl->apEntries)
+    {
+        LOG_ERROR( "PU_HMAP: no memory for %zu buckets\n", uiBuckets );
+        return (ENOMEM);
+    }
+    pTbl->aHashes   = (uint32_t*)(void*)(pTbl->apEntries + uiBuckets);
+    pTbl->uiBuckets = uiBuckets;
+    pTbl->uiCount   = 0;
+    pTbl->uiShift   = 32u - uiBits;
+    return (0);
+}
+/* pu_hmap_table_alloc */
+
+static void pu_hmap_table_free( pu_hmap_table_t* pTbl )
+{
+    free( pTbl->apEntries );
+    memset( pTbl, 0, sizeof(*pTbl) );
+}
+/* pu_hmap_table_free */
+
+/* There is always an empty bucket, the load stays under 3/4 (or the insert failed earlier) */
+static void pu_hmap_table_put( pu_hmap_table_t* pTbl, uint32_t uiHash, void* pEntry )
+{
+    size_t i = PU_HMAP_HOME( pTbl, uiHash );
+
+    while (0 != pTbl->aHashes[i])
+    {
+        i = PU_HMAP_NEXT( pTbl, i );
+    }
+    pTbl->aHashes[i]   = uiHash;
+    pTbl->apEntries[i] = pEntry;
+    pTbl->uiCount++;
+}
+/* pu_hmap_table_put */
+
+/* Backward shift deletion: pull back every later entry of the run that may live at i, i.e.
+ * whose home bucket is not cyclically in (i, j]
+ */
+static void pu_hmap_table_del( pu_hmap_table_t* pTbl, size_t i )
+{
+    size_t j;
+    size_t k;
+
+    for (j = PU_HMAP_NEXT( pTbl, i ); 0 != pTbl->aHashes[j]; j = PU_HMAP_NEXT( pTbl, j ))
+    {
+        k = PU_HMAP_HOME( pTbl, pTbl->aHashes[j] );
+        if ((i <= j) ? ((k <= i) || (k > j)) : ((k <= i) && (k > j)))
+        {
+            pTbl->aHashes[i]   = pTbl->aHashes[j];
+            pTbl->apEntries[i] = pTbl->apEntries[j];
+            i = j;
+        }
+    }
+    pTbl->aHashes[i]   = 0;
+    pTbl->apEntries[i] = NULL;
+    pTbl->uiCount--;
+}
+/* pu_hmap_table_del */
+
+static size_t pu_hmap_table_find( const pu_hmap_t* pMap, const pu_hmap_table_t* pTbl, uint32_t uiHash, const void* pKey )
+{
+    size_t   i;
+    uint32_t uiSlotHash;
+
+    if (0 == pTbl->uiCount)
+    {
+        return (PU_HMAP_NOT_FOUND);
+    }
+    for (i = PU_HMAP_HOME( pTbl, uiHash ); 0 != (uiSlotHash = pTbl->aHashes[i]); i = PU_HMAP_NEXT( pTbl, i ))
+    {
+        if ((uiSlotHash == uiHash) && pMap->pOps->pfnEqual( pTbl->apEntries[i], pKey ))
+        {
+            return (i);
+        }
+    }
+    return (PU_HMAP_NOT_FOUND);
+}
+/* pu_hmap_table_find */
+
+static size_t pu_hmap_table_find_entry( const pu_hmap_table_t* pTbl, uint32_t uiHash, const void* pEntry )
+{
+    size_t i;
+
+    if (0 == pTbl->uiCount)
+    {
+        return (PU_HMAP_NOT_FOUND);
+    }
+    for (i = PU_HMAP_HOME( pTbl, uiHash ); 0 != pTbl->aHashes[i]; i = PU_HMAP_NEXT( pTbl, i ))
+    {
+        if (pTbl->apEntries[i] == pEntry)
+        {
+            return (i);
+        }
+    }
+    return (PU_HMAP_NOT_FOUND);
+}
+/* pu_hmap_table_find_entry */
+
+/* Moves up to uiSteps buckets of the old table, frees it once it is empty. A bucket that is
+ * moved is refilled by the backward shift, so the cursor only advances past empty ones
+ */
+static void pu_hmap_migrate( pu_hmap_t* pMap, size_t uiSteps )
+{
+    pu_hmap_table_t* pOld = &(pMap->tblOld);
+    size_t           i;
+
+    while ((uiSteps-- > 0) && (pOld->uiCount > 0))
+    {
+        i = pMap->uiMigrate;
+        ASSERT( i < pOld->uiBuckets );
+        if (0 != pOld->aHashes[i])
+        {
+            pu_hmap_table_put( &(pMap->tblCur), pOld->aHashes[i], pOld->apEntries[i] );
+            pu_hmap_table_del( pOld, i );
+        }
+        else
+        {
+            pMap->uiMigrate++;
+        }
+    }
+    if ((NULL != pOld->apEntries) && (0 == pOld->uiCount))
+    {
+        pu_hmap_table_free( pOld );
+        pMap->uiMigrate = 0;
+    }
+}
+/* pu_hmap_migrate */
+
+/* Starts a resize: the current table becomes the old one. A resize still in progress (only if
+ * the step is tuned too low for the growth) is finished first
+ */
+static int pu_hmap_grow( pu_hmap_t* pMap )
+{
+    pu_hmap_table_t tblNew;
+    int             iResult;
+
+    pu_hmap_migrate( pMap, (size_t)-1 );
+    if (pMap->tblCur.uiBuckets > ((size_t)1 << 30))
+    {
+        return (ENOMEM);
+    }
+    iResult = pu_hmap_table_alloc( &tblNew, 2 * pMap->tblCur.uiBuckets );
+    if (0 == iResult)
+    {
+        pMap->tblOld    = pMap->tblCur;
+        pMap->tblCur    = tblNew;
+        pMap->uiMigrate = 0;
+    }
+    return (iResult);
+}
+/* pu_hmap_grow */
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * @brief   Initialises a map
+ *
+ * @param[out] pMap      : The map
+ * @param[in]  pOps      : Callbacks
+ * @param[in]  uiExpected: Objects it should hold without growing
+ * @retval  0 for success
+ * @retval  ENOMEM, EINVAL
+ */
+int pu_hmap_init(
+    pu_hmap_t*           pMap,
+    const pu_hmap_ops_t* pOps,
+    size_t               uiExpected )
+{
+    size_t uiBuckets = PU_HMAP_MIN_BUCKETS;
+
+    ASSERT( pMap && pOps && pOps->pfnHash && pOps->pfnEqual && pOps->pfnKey );
+    if ((NULL == pMap) || (NULL == pOps) || (NULL == pOps->pfnHash) || (NULL == pOps->pfnEqual) || (NULL == pOps->pfnKey))
+    {
+        return (EINVAL);
+    }
+    memset( pMap, 0, sizeof(*pMap) );
+    pMap->pOps = pOps;
+
+    /* Under 3/4 full with uiExpected objects */
+    while ((uiBuckets < ((size_t)1 << 30)) && ((uiBuckets / 4) * 3 <= uiExpected))
+    {
+        uiBuckets *= 2;
+    }
+    return (pu_hmap_table_alloc( &(pMap->tblCur), uiBuckets ));
+}
+/* pu_hmap_init */
+
+/**
+ * @brief   Frees the tables, the objects are not touched
+ *
+ * @param[in] pMap : The map
+ */
+void pu_hmap_destroy( pu_hmap_t* pMap )
+{
+    ASSERT( pMap );
+    if (pMap)
+    {
+        pu_hmap_table_free( &(pMap->tblCur) );
+        pu_hmap_table_free( &(pMap->tblOld) );
+        pMap->uiMigrate = 0;
+    }
+}
+/* pu_hmap_destroy */
+
+/**
+ * @brief   Adds an object
+ *
+ * @param[in] pMap   : The map
+ * @param[in] pEntry : The object
+ * @retval  0 for success
+ * @retval  ENOMEM the map is full and could not grow
+ * @retval  EINVAL NULL parameter
+ */
+int pu_hmap_insert(
+    pu_hmap_t* pMap,
+    void*      pEntry )
+{
+    pu_hmap_table_t* pCur;
+
+    ASSERT( pMap && pEntry && pMap->tblCur.apEntries );
+    if ((NULL == pMap) || (NULL == pEntry) || (NULL == pMap->tblCur.apEntries))
+    {
+        return (EINVAL);
+    }
+    pu_hmap_migrate( pMap, PU_HMAP_MIGRATE_STEP );
+
+    /* Grow at 3/4. If that fails, carry on until only one bucket is left (probing needs it) */
+    pCur = &(pMap->tblCur);
+    if ((pu_hmap_count( pMap ) + 1) > (pCur->uiBuckets / 4) * 3)
+    {
+        if ((0 != pu_hmap_grow( pMap )) && ((pCur->uiCount + 1) >= pCur->uiBuckets))
+        {
+            return (ENOMEM);
+        }
+    }
+    pu_hmap_table_put( pCur, pu_hmap_hash( pMap, pMap->pOps->pfnKey( pEntry ) ), pEntry );
+    return (0);
+}
+/* pu_hmap_insert */
+
+/**
+ * @brief   Finds an object by key
+ *
+ * @param[in] pMap : The map
+ * @param[in] pKey : Key
+ * @return  An object with that key, NULL if none
+ */
+void* pu_hmap_find(
+    const pu_hmap_t* pMap,
+    const void*      pKey )
+{
+    uint32_t uiHash;
+    size_t   i;
+
+    ASSERT( pMap );
+    if (NULL == pMap)
+    {
+        return (NULL);
+    }
+    uiHash = pu_hmap_hash( pMap, pKey );
+    i      = pu_hmap_table_find( pMap, &(pMap->tblCur), uiHash, pKey );
+    if (PU_HMAP_NOT_FOUND != i)
+    {
+        return (pMap->tblCur.apEntries[i]);
+    }
+    i = pu_hmap_table_find( pMap, &(pMap->tblOld), uiHash, pKey );
+    return ((PU_HMAP_NOT_FOUND != i) ? pMap->tblOld.apEntries[i] : NULL);
+}
+/* pu_hmap_find */
+
+/**
+ * @brief   Removes an object by key
+ *
+ * @param[in] pMap : The map
+ * @param[in] pKey : Key
+ * @return  The removed object, NULL if none had the key
+ */
+void* pu_hmap_remove(
+    pu_hmap_t*  pMap,
+    const void* pKey )
+{
+    pu_hmap_table_t* apTbl[2];
+    void*            pEntry = NULL;
+    uint32_t         uiHash;
+    size_t           i;
+    size_t           t;
+
+    ASSERT( pMap );
+    if (NULL == pMap)
+    {
+        return (NULL);
+    }
+    pu_hmap_migrate( pMap, PU_HMAP_MIGRATE_STEP );
+    uiHash   = pu_hmap_hash( pMap, pKey );
+    apTbl[0] = &(pMap->tblCur);
+    apTbl[1] = &(pMap->tblOld);
+    for (t = 0; (t < 2) && (NULL == pEntry); t++)
+    {
+        i = pu_hmap_table_find( pMap, apTbl[t], uiHash, pKey );
+        if (PU_HMAP_NOT_FOUND != i)
+        {
+            pEntry = apTbl[t]->apEntries[i];
+            pu_hmap_table_del( apTbl[t], i );
+        }
+    }
+    return (pEntry);
+}
+/* pu_hmap_remove */
+
+/**
+ * @brief   Removes one particular object
+ *
+ * @param[in] pMap   : The map
+ * @param[in] pEntry : The object
+ * @retval  true if it was in the map
+ */
+bool pu_hmap_remove_entry(
+    pu_hmap_t* pMap,
+    void*      pEntry )
+{
+    pu_hmap_table_t* apTbl[2];
+    uint32_t         uiHash;
+    size_t           i;
+    size_t           t;
+
+    ASSERT( pMap && pEntry );
+    if ((NULL == pMap) || (NULL == pEntry))
+    {
+        return (false);
+    }
+    pu_hmap_migrate( pMap, PU_HMAP_MIGRATE_STEP );
+    uiHash   = pu_hmap_hash( pMap, pMap->pOps->pfnKey( pEntry ) );
+    apTbl[0] = &(pMap->tblCur);
+    apTbl[1] = &(pMap->tblOld);
+    for (t = 0; t < 2; t++)
+    {
+        i = pu_hmap_table_find_entry( apTbl[t], uiHash, pEntry );
+        if (PU_HMAP_NOT_FOUND != i)
+        {
+            pu_hmap_table_del( apTbl[t], i );
+            return (true);
+        }
+    }
+    return (false);
+}
+/* pu_hmap_remove_entry */
+
+/**
+ * @brief   Iterates over the objects
+ *
+ * @param[in]     pMap   : The map
+ * @param[in,out] puiPos : Position, 0 to start
+ * @return  The next object, NULL at the end
+ */
+void* pu_hmap_next(
+    const pu_hmap_t* pMap,
+    size_t*          puiPos )
+{
+    size_t uiCur;
+    size_t i;
+    void*  pEntry;
+
+    ASSERT( pMap && puiPos );
+    if ((NULL == pMap) || (NULL == puiPos))
+    {
+        return (NULL);
+    }
+
+    /* Positions run through the current table, then the old one */
+    uiCur = pMap->tblCur.uiBuckets;
+    for (i = *puiPos; i < uiCur + pMap->tblOld.uiBuckets; i++)
+    {
+        pEntry = (i < uiCur) ? pMap->tblCur.apEntries[i] : pMap->tblOld.apEntries[i - uiCur];
+        if (NULL != pEntry)
+        {
+            *puiPos = i + 1;
+            return (pEntry);
+        }
+    }
+    *puiPos = i;
+    return (NULL);
+}
+/* pu_hmap_next */
+
+/**
+ * @brief   FNV-1a of a NUL terminated string
+ */
+uint32_t pu_hmap_hash_str( const void* pKey )
+{
+    const uint8_t* p      = (const uint8_t*)pKey;
+    uint32_t       uiHash = 2166136261u;
+
+    while (*p)
+    {
+        uiHash ^= *p++;
+        uiHash *= 16777619u;
+    }
+    return (uiHash);
+}
+/* pu_hmap_hash_str */
+
+/**
+ * @brief   FNV-1a of a byte string
+ */
+uint32_t pu_hmap_hash_bytes(
+    const void* pData,
+    size_t      uiLen )
+{
+    const uint8_t* p      = (const uint8_t*)pData;
+    uint32_t       uiHash = 2166136261u;
+
+    while (uiLen-- > 0)
+    {
+        uiHash ^= *p++;
+        uiHash *= 16777619u;
+    }
+    return (uiHash);
+}
+/* pu_hmap_hash_bytes */
+
+/**
+ * @brief   Hash of a uint32_t. The murmur3 finaliser, one to one, so equal hashes mean equal keys
+ */
+uint32_t pu_hmap_hash_u32( const void* pKey )
+{
+    uint32_t uiHash = *(const uint32_t*)pKey;
+
+    uiHash ^= uiHash >> 16;
+    uiHash *= 0x85EBCA6Bu;
+    uiHash ^= uiHash >> 13;
+    uiHash *= 0xC2B2AE35u;
+    uiHash ^= uiHash >> 16;
+    return (uiHash);
+}
+/* pu_hmap_hash_u32 */
@@ -0,0 +1,421 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+/**
+ * @file     pulockdep.c
+ * @brief    Lock order checking for the error checking mutexes (debug builds only)
+ *
+ * Every thread keeps a small stack of the error mutexes it holds. Taking mutex B while holding
+ * A records the edge A -> B in a global graph, together with both call sites. Before a new edge
+ * is added the graph is searched for a path B -> ... -> A: if there is one the two orders can
+ * deadlock, and the whole path is reported. Each edge is only added (and checked) once, so a
+ * given inversion is reported the first time it becomes possible, not every time it runs.
+ *
+ * The graph is protected by a single mutex. This is debug code, it trades speed for simplicity.
+ */
+
+/**** Includes ***************************************************************/
+#if !defined(_GNU_SOURCE)
+    #define _GNU_SOURCE
+#endif /* !defined(_GNU_SOURCE) */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include "posutils.h"
+#include "logging.h"
+
+#if !defined(NDEBUG)
+
+/**** Definitions ************************************************************/
+#define PU_LOCKDEP_MAX_LOCKS  (256)              /* Distinct error mutexes that can be tracked  */
+#define PU_LOCKDEP_MAX_EDGES  (1024)             /* Distinct "A before B" orders                */
+#define PU_LOCKDEP_MAX_HELD   (16)               /* Error mutexes one thread may hold at once   */
+#define PU_LOCKDEP_NONE       (0xFFFF)           /* End of an edge list, or "no node"           */
+#define PU_LOCKDEP_WORDS      (PU_LOCKDEP_MAX_LOCKS / 32)
+
+/* A node, i.e. one mutex. The key is the mutex address; a forgotten node becomes a tombstone */
+typedef struct
+{
+    const void* pMtx;                            /* NULL = empty, &uiTomb = tombstone            */
+    const char* szFile;                          /* Where it was first locked                    */
+    int         iLine;
+    uint16_t    uiFirstEdge;                     /* Outgoing edges (index into aEdges)           */
+    uint32_t    auiAfter[PU_LOCKDEP_WORDS];      /* Bit n: there is an edge to node n            */
+} pu_lockdep_node_t;
+
+/* An edge: "uiTo was locked while holding uiFrom", with both call sites */
+typedef struct
+{
+    uint16_t    uiFrom;
+    uint16_t    uiTo;
+    uint16_t    uiNext;                          /* Next edge of uiFrom, or the free list        */
+    const char* szFromFile;
+    int         iFromLine;
+    const char* szToFile;
+    int         iToLine;
+} pu_lockdep_edge_t;
+
+/* A held mutex, per thread */
+typedef struct
+{
+    const void* pMtx;
+    const char* szFile;
+    int         iLine;
+} pu_lockdep_held_t;
+
+/**** Macros ****************************************************************/
+
+/**** Static declarations ***************************************************/
+static pthread_mutex_t   mtxGraph = PTHREAD_MUTEX_INITIALIZER;
+static pu_lockdep_node_t aNodes[PU_LOCKDEP_MAX_LOCKS];
+static pu_lockdep_edge_t aEdges[PU_LOCKDEP_MAX_EDGES];
+static uint16_t          uiFreeEdge  = PU_LOCKDEP_NONE;
+static uint16_t          uiUsedEdges = 0;
+static bool              bFull       = false;
+static size_t            uiCycles    = 0;
+static const uint32_t    uiTomb      = 0;
+
+static __thread pu_lockdep_held_t aHeld[PU_LOCKDEP_MAX_HELD];
+static __thread size_t            uiHeld = 0;
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static uint16_t pu_lockdep_find( const void* pMtx, bool bInsert );
+static uint16_t pu_lockdep_edge_new( void );
+static bool     pu_lockdep_path( uint16_t uiFrom, uint16_t uiTo, uint16_t* aVia );
+static void     pu_lockdep_report( const pu_lockdep_held_t* pHeld, const void* pMtx, const char* szFile, int iLine, uint16_t uiFrom, uint16_t uiTo, const uint16_t* aVia );
+static void     pu_lockdep_table_full( void );
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+/* Open addressing lookup of a mutex, optionally inserting it. Caller holds mtxGraph */
+static uint16_t pu_lockdep_find( const void* pMtx, bool bInsert )
+{
+    size_t   uiHash = ((size_t)pMtx >> 4) * 2654435761u;
+    uint16_t uiTomb1st = PU_LOCKDEP_NONE;
+    size_t   i;
+
+    for (i = 0; i < PU_LOCKDEP_MAX_LOCKS; i++)
+    {
+        uint16_t uiIdx = (uint16_t)((uiHash + i) % PU_LOCKDEP_MAX_LOCKS);
+        if (pMtx == aNodes[uiIdx].pMtx)
+        {
+            return (uiIdx);
+        }
+        if ((&uiTomb == aNodes[uiIdx].pMtx) && (PU_LOCKDEP_NONE == uiTomb1st))
+        {
+            uiTomb1st = uiIdx;
+        }
+        if (NULL == aNodes[uiIdx].pMtx)
+        {
+            if (!bInsert)
+            {
+                return (PU_LOCKDEP_NONE);
+            }
+            uiIdx = (PU_LOCKDEP_NONE != uiTomb1st) ? uiTomb1st : uiIdx;
+            memset( &aNodes[uiIdx], 0, sizeof(aNodes[uiIdx]) );
+            aNodes[uiIdx].pMtx        = pMtx;
+            aNodes[uiIdx].uiFirstEdge = PU_LOCKDEP_NONE;
+            return (uiIdx);
+        }
+    }
+
+    /* No empty slot, a tombstone will do */
+    if (bInsert && (PU_LOCKDEP_NONE != uiTomb1st))
+    {
+        memset( &aNodes[uiTomb1st], 0, sizeof(aNodes[uiTomb1st]) );
+        aNodes[uiTomb1st].pMtx        = pMtx;
+        aNodes[uiTomb1st].uiFirstEdge = PU_LOCKDEP_NONE;
+        return (uiTomb1st);
+    }
+    return (PU_LOCKDEP_NONE);
+}
+/* pu_lockdep_find */
+
+/* Takes an edge from the free list (or the unused tail). Caller holds mtxGraph */
+static uint16_t pu_lockdep_edge_new( void )
+{
+    uint16_t uiIdx = PU_LOCKDEP_NONE;
+
+    if (PU_LOCKDEP_NONE != uiFreeEdge)
+    {
+        uiIdx      = uiFreeEdge;
+        uiFreeEdge = aEdges[uiIdx].uiNext;
+    }
+    else if (uiUsedEdges < PU_LOCKDEP_MAX_EDGES)
+    {
+        uiIdx = uiUsedEdges++;
+    }
+    return (uiIdx);
+}
+/* pu_lockdep_edge_new */
+
+/**
+ * Breadth first search for a path uiFrom -> ... -> uiTo. On success aVia[n] holds the edge used
+ * to reach node n, so the path can be walked back from uiTo. Caller holds mtxGraph
+ */
+static bool pu_lockdep_path( uint16_t uiFrom, uint16_t uiTo, uint16_t* aVia )
+{
+    uint16_t aQueue[PU_LOCKDEP_MAX_LOCKS];
+    uint32_t auiSeen[PU_LOCKDEP_WORDS];
+    size_t   uiHead = 0;
+    size_t   uiTail = 0;
+
+    memset( auiSeen, 0, sizeof(auiSeen) );
+    auiSeen[uiFrom / 32] |= (1u << (uiFrom % 32));
+    aQueue[uiTail++] = uiFrom;
+    while (uiHead < uiTail)
+    {
+        uint16_t uiNode = aQueue[uiHead++];
+        uint16_t uiEdge;
+        for (uiEdge = aNodes[uiNode].uiFirstEdge; PU_LOCKDEP_NONE != uiEdge; uiEdge = aEdges[uiEdge].uiNext)
+        {
+            uint16_t uiNext = aEdges[uiEdge].uiTo;
+            if (0 != (auiSeen[uiNext / 32] & (1u << (uiNext % 32))))
+            {
+                continue;
+            }
+            auiSeen[uiNext / 32] |= (1u << (uiNext % 32));
+            aVia[uiNext] = uiEdge;
+            if (uiNext == uiTo)
+            {
+                return (true);
+            }
+            aQueue[uiTail++] = uiNext;
+        }
+    }
+    return (false);
+}
+/* pu_lockdep_path */
+
+/* Logs the new order and the existing (opposite) one, edge by edge. Caller holds mtxGraph */
+static void pu_lockdep_report(
+    const pu_lockdep_held_t* pHeld,
+    const void*              pMtx,
+    const char*              szFile,
+    int                      iLine,
+    uint16_t                 uiFrom,
+    uint16_t                 uiTo,
+    const uint16_t*          aVia )
+{
+    char        szName[16] = "?";
+    const char* szWho      = pu_thread_get_name( pu_thread_self() );
+    uint16_t    uiNode;
+
+    /* pu_threads know their name, anybody else asks the kernel */
+    if (NULL == szWho)
+    {
+        pthread_getname_np( pthread_self(), szName, sizeof(szName) );
+        szWho = szName;
+    }
+    LOG_ERROR( "LOCK ORDER INVERSION, possible deadlock\n" );
+    LOG_ERROR( "  thread %s locks %p at %s:%d while holding %p locked at %s:%d\n",
+        szWho, pMtx, szFile, iLine, pHeld->pMtx, pHeld->szFile, pHeld->iLine );
+    LOG_ERROR( "  but the opposite order was seen before:\n" );
+
+    /* Walk back from the held mutex to the one being locked, printing the edges in reverse */
+    for (uiNode = uiTo; uiNode != uiFrom; uiNode = aEdges[aVia[uiNode]].uiFrom)
+    {
+        const pu_lockdep_edge_t* pEdge = &aEdges[aVia[uiNode]];
+        LOG_ERROR( "    %p locked at %s:%d while holding %p locked at %s:%d\n",
+            aNodes[pEdge->uiTo].pMtx, pEdge->szToFile, pEdge->iToLine,
+            aNodes[pEdge->uiFrom].pMtx, pEdge->szFromFile, pEdge->iFromLine );
+    }
+    uiCycles++;
+}
+/* pu_lockdep_report */
+
+/* One warning, then the checker stops adding to the graph. Caller holds mtxGraph */
+static void pu_lockdep_table_full( void )
+{
+    if (!bFull)
+    {
+        LOG_ERROR( "lockdep tables full (%d locks, %d edges), lock order checking disabled\n",
+            PU_LOCKDEP_MAX_LOCKS, PU_LOCKDEP_MAX_EDGES );
+        bFull = true;
+    }
+}
+/* pu_lockdep_table_full */
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * @brief Records the acquisition of an error mutex, before it is locked
+ */
+void pu_lockdep_acquire(
+    const void* pMtx,
+    const char* szFile,
+    int         iLine )
+{
+    size_t i;
+
+    /* Re-locking a held mutex is EDEADLK, which PU_MUTEX_LOCK_ERROR already traps */
+    for (i = 0; i < uiHeld; i++)
+    {
+        if (pMtx == aHeld[i].pMtx)
+        {
+            return;
+        }
+    }
+
+    pthread_mutex_lock( &mtxGraph );
+    uint16_t uiTo = bFull ? PU_LOCKDEP_NONE : pu_lockdep_find( pMtx, true );
+    if (PU_LOCKDEP_NONE == uiTo)
+    {
+        pu_lockdep_table_full();
+    }
+    else
+    {
+        if (NULL == aNodes[uiTo].szFile)
+        {
+            aNodes[uiTo].szFile = szFile;
+            aNodes[uiTo].iLine  = iLine;
+        }
+        for (i = 0; (i < uiHeld) && !bFull; i++)
+        {
+            uint16_t aVia[PU_LOCKDEP_MAX_LOCKS];
+            uint16_t uiFrom = pu_lockdep_find( aHeld[i].pMtx, false );
+            if ((PU_LOCKDEP_NONE == uiFrom) || (0 != (aNodes[uiFrom].auiAfter[uiTo / 32] & (1u << (uiTo % 32)))))
+            {
+                continue;
+            }
+
+            /* A new order. Is the opposite one possible already? */
+            if (pu_lockdep_path( uiTo, uiFrom, aVia ))
+            {
+                pu_lockdep_report( &aHeld[i], pMtx, szFile, iLine, uiTo, uiFrom, aVia );
+            }
+
+            uint16_t uiEdge = pu_lockdep_edge_new();
+            if (PU_LOCKDEP_NONE == uiEdge)
+            {
+                pu_lockdep_table_full();
+                break;
+            }
+            aEdges[uiEdge].uiFrom     = uiFrom;
+            aEdges[uiEdge].uiTo       = uiTo;
+            aEdges[uiEdge].szFromFile = aHeld[i].szFile;
+            aEdges[uiEdge].iFromLine  = aHeld[i].iLine;
+            aEdges[uiEdge].szToFile   = szFile;
+            aEdges[uiEdge].iToLine    = iLine;
+            aEdges[uiEdge].uiNext     = aNodes[uiFrom].uiFirstEdge;
+            aNodes[uiFrom].uiFirstEdge = uiEdge;
+            aNodes[uiFrom].auiAfter[uiTo / 32] |= (1u << (uiTo % 32));
+        }
+    }
+    pthread_mutex_unlock( &mtxGraph );
+
+    if (uiHeld < PU_LOCKDEP_MAX_HELD)
+    {
+        aHeld[uiHeld].pMtx   = pMtx;
+        aHeld[uiHeld].szFile = szFile;
+        aHeld[uiHeld].iLine  = iLine;
+        uiHeld++;
+    }
+    else
+    {
+        LOG_ERROR( "more than %d error mutexes held, %p is not tracked\n", PU_LOCKDEP_MAX_HELD, pMtx );
+    }
+}
+/* pu_lockdep_acquire */
+
+/**
+ * @brief Records the release of an error mutex (in any order)
+ */
+void pu_lockdep_release( const void* pMtx )
+{
+    size_t i;
+
+    for (i = uiHeld; i > 0; i--)
+    {
+        if (pMtx == aHeld[i - 1].pMtx)
+        {
+            memmove( &aHeld[i - 1], &aHeld[i], (uiHeld - i) * sizeof(aHeld[0]) );
+            uiHeld--;
+            return;
+        }
+    }
+}
+/* pu_lockdep_release */
+
+/**
+ * @brief Drops a mutex (and every order involving it) from the graph
+ *
+ * A mutex created later at the same address starts with no history. If the caller still holds
+ * it, it comes off the caller's held list too.
+ */
+void pu_lockdep_forget( const void* pMtx )
+{
+    pu_lockdep_release( pMtx );
+
+    pthread_mutex_lock( &mtxGraph );
+    uint16_t uiNode = pu_lockdep_find( pMtx, false );
+    if (PU_LOCKDEP_NONE != uiNode)
+    {
+        size_t n;
+        for (n = 0; n < PU_LOCKDEP_MAX_LOCKS; n++)
+        {
+            /* Unlink every edge into or out of the node, onto the free list */
+            uint16_t* puiLink = &aNodes[n].uiFirstEdge;
+            if ((NULL == aNodes[n].pMtx) || (&uiTomb == aNodes[n].pMtx))
+            {
+                continue;
+            }
+            while (PU_LOCKDEP_NONE != *puiLink)
+            {
+                uint16_t uiEdge = *puiLink;
+                if ((uiNode == aEdges[uiEdge].uiFrom) || (uiNode == aEdges[uiEdge].uiTo))
+                {
+                    *puiLink = aEdges[uiEdge].uiNext;
+                    aEdges[uiEdge].uiNext = uiFreeEdge;
+                    uiFreeEdge = uiEdge;
+                }
+                else
+                {
+                    puiLink = &aEdges[uiEdge].uiNext;
+                }
+            }
+            aNodes[n].auiAfter[uiNode / 32] &= ~(1u << (uiNode % 32));
+        }
+        memset( &aNodes[uiNode], 0, sizeof(aNodes[uiNode]) );
+        aNodes[uiNode].pMtx        = &uiTomb;
+        aNodes[uiNode].uiFirstEdge = PU_LOCKDEP_NONE;
+    }
+    pthread_mutex_unlock( &mtxGraph );
+}
+/* pu_lockdep_forget */
+
+/**
+ * @brief Number of lock order inversions reported so far
+ */
+size_t pu_lockdep_get_number_of_cycles( void )
+{
+    pthread_mutex_lock( &mtxGraph );
+    size_t uiRet = uiCycles;
+    pthread_mutex_unlock( &mtxGraph );
+    return (uiRet);
+}
+/* pu_lockdep_get_number_of_cycles */
+
+#endif /* !defined(NDEBUG) */
@@ -0,0 +1,248 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+
+/**
+ * @file     pumpmc.c
+ * @brief    MPMC queue, creation and the blocking (kernel) paths
+ */
+
+/**** Includes ***************************************************************/
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pumpmc.h"
+#include "pufutex.h"
+#include "pudefs.h"
+#include "logging.h"
+
+/**** Definitions ************************************************************/
+#define PU_MPMC_MAX_CAPACITY (1u << 30)
+
+/**** Macros ****************************************************************/
+
+/**** Static declarations ***************************************************/
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static uint32_t pu_mpmc_announce( uint32_t* puiWord );
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+/* Sets bit 0 of a futex word (a sleeper is coming), returns the value to sleep on */
+static uint32_t pu_mpmc_announce( uint32_t* puiWord )
+{
+    uint32_t uiSeen = __atomic_load_n( puiWord, __ATOMIC_RELAXED );
+
+    while ((0 == (uiSeen & 1u)) &&
+           !__atomic_compare_exchange_n( puiWord, &uiSeen, uiSeen | 1u, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED ))
+    {
+        /* uiSeen was reloaded, go again */
+    }
+    return (uiSeen | 1u);
+}
+/* pu_mpmc_announce */
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * @brief   Creates a queue
+ *
+ * @param[out] pQueue     : Queue
+ * @param[in]  uiCapacity : Elements, rounded up to a power of two
+ * @param[in]  uiElemSize : Bytes per element
+ * @param[in]  bBlocking  : true if the blocking push/pop will be used
+ * @retval  0 for success
+ * @retval  EINVAL for a bad size
+ * @retval  ENOMEM
+ *
+ * @par Description
+ * Each cell is the 32 bit sequence number followed by the element, padded to 4 bytes so the
+ * next sequence number is aligned. Cell i starts with sequence number i, i.e. free for the
+ * producer of position i.
+ */
+int pu_mpmc_create(
+    pu_mpmc_t* pQueue,
+    uint32_t   uiCapacity,
+    uint32_t   uiElemSize,
+    bool       bBlocking )
+{
+    void*    pCells = NULL;
+    uint32_t uiCap;
+    uint32_t uiStride;
+    uint32_t i;
+
+    ASSERT( pQueue );
+    if ((NULL == pQueue) || (0 == uiElemSize) || (uiElemSize > (1u << 16)) || (uiCapacity < 2) || (uiCapacity > PU_MPMC_MAX_CAPACITY))
+    {
+        return (EINVAL);
+    }
+
+    /* Next power of two, and a cell size that keeps the sequence numbers aligned */
+    uiCap    = (uiCapacity & (uiCapacity - 1)) ? (1u << (32 - __builtin_clz( uiCapacity ))) : uiCapacity;
+    uiStride = (uint32_t)sizeof(uint32_t) + ((uiElemSize + 3u) & ~3u);
+    if (0 != posix_memalign( &pCells, PU_MPMC_CACHE_LINE, (size_t)uiCap * uiStride ))
+    {
+        LOG_ERROR( "PU_MPMC(create): no memory for %u x %u bytes\n", uiCap, uiStride );
+        return (ENOMEM);
+    }
+    memset( pQueue, 0, sizeof(*pQueue) );
+    pQueue->pCells     = (uint8_t*)pCells;
+    pQueue->uiMask     = uiCap - 1;
+    pQueue->uiElemSize = uiElemSize;
+    pQueue->uiStride   = uiStride;
+    pQueue->bBlocking  = bBlocking;
+    for (i = 0; i < uiCap; i++)
+    {
+        *(uint32_t*)(void*)(pQueue->pCells + ((size_t)i * uiStride)) = i;
+    }
+    __atomic_thread_fence( __ATOMIC_RELEASE );
+    return (0);
+}
+/* pu_mpmc_create */
+
+/**
+ * @brief   Destroys a queue
+ *
+ * @param[in] pQueue : Queue
+ */
+void pu_mpmc_destroy( pu_mpmc_t* pQueue )
+{
+    ASSERT( pQueue );
+    if (pQueue)
+    {
+        free( pQueue->pCells );
+        pQueue->pCells = NULL;
+    }
+}
+/* pu_mpmc_destroy */
+
+/**
+ * @brief   Sleeping part of the blocking push
+ *
+ * @par Description
+ * Set the sleeper bit of uiNotFull, full fence, try again, then sleep on the value with the bit
+ * set. A consumer that makes room fences and then reads the word, so one of the two sees the
+ * other. If a consumer cleared the bit after we set it, the futex wait returns at once. Another
+ * producer may take the room we were woken for; then we simply go round again.
+ */
+int pu_mpmc_push_slow(
+    pu_mpmc_t*  pQueue,
+    const void* pElem,
+    uint32_t    uiTimeoutMs )
+{
+    struct timespec deadline;
+    uint32_t        uiSeen;
+    int             iResult = 0;
+
+    ASSERT( pQueue->bBlocking );
+    if (PU_FUTEX_FOREVER != uiTimeoutMs)
+    {
+        pu_futex_deadline_private( &deadline, uiTimeoutMs );
+    }
+    pu_thread_blocked_private( pQueue, "mpmc push" );
+    for (;;)
+    {
+        uiSeen = pu_mpmc_announce( &(pQueue->uiNotFull) );
+        __atomic_thread_fence( __ATOMIC_SEQ_CST );
+        if (pu_mpmc_trypush( pQueue, pElem ))
+        {
+            break;
+        }
+        if (ETIMEDOUT == pu_futex_wait_until_private( &(pQueue->uiNotFull), uiSeen, (PU_FUTEX_FOREVER != uiTimeoutMs) ? &deadline : NULL ))
+        {
+            iResult = pu_mpmc_trypush( pQueue, pElem ) ? 0 : ETIMEDOUT;
+            break;
+        }
+    }
+    pu_thread_blocked_private( NULL, NULL );
+    return (iResult);
+}
+/* pu_mpmc_push_slow */
+
+/**
+ * @brief   Sleeping part of the blocking pop
+ *
+ * @par Description
+ * The mirror image of \ref pu_mpmc_push_slow, on uiNotEmpty.
+ */
+int pu_mpmc_pop_slow(
+    pu_mpmc_t* pQueue,
+    void*      pElem,
+    uint32_t   uiTimeoutMs )
+{
+    struct timespec deadline;
+    uint32_t        uiSeen;
+    int             iResult = 0;
+
+    ASSERT( pQueue->bBlocking );
+    if (PU_FUTEX_FOREVER != uiTimeoutMs)
+    {
+        pu_futex_deadline_private( &deadline, uiTimeoutMs );
+    }
+    pu_thread_blocked_private( pQueue, "mpmc pop" );
+    for (;;)
+    {
+        uiSeen = pu_mpmc_announce( &(pQueue->uiNotEmpty) );
+        __atomic_thread_fence( __ATOMIC_SEQ_CST );
+        if (pu_mpmc_trypop( pQueue, pElem ))
+        {
+            break;
+        }
+        if (ETIMEDOUT == pu_futex_wait_until_private( &(pQueue->uiNotEmpty), uiSeen, (PU_FUTEX_FOREVER != uiTimeoutMs) ? &deadline : NULL ))
+        {
+            iResult = pu_mpmc_trypop( pQueue, pElem ) ? 0 : ETIMEDOUT;
+            break;
+        }
+    }
+    pu_thread_blocked_private( NULL, NULL );
+    return (iResult);
+}
+/* pu_mpmc_pop_slow */
+
+/**
+ * @brief   Wakes everybody sleeping on a futex word
+ *
+ * @param[in] puiWord : uiNotEmpty or uiNotFull
+ *
+ * @par Description
+ * Clear the sleeper bit and bump the count in one step (odd + 1 is even), so a sleeper that
+ * has not reached the kernel yet finds the word changed. If another waker got there first the
+ * bit is already clear, and that waker does the system call.
+ */
+void pu_mpmc_wake( uint32_t* puiWord )
+{
+    uint32_t uiSeen = __atomic_load_n( puiWord, __ATOMIC_RELAXED );
+
+    while (0 != (uiSeen & 1u))
+    {
+        if (__atomic_compare_exchange_n( puiWord, &uiSeen, uiSeen + 1u, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED ))
+        {
+            pu_futex_wake_private( puiWord, INT_MAX );
+            break;
+        }
+    }
+}
+/* pu_mpmc_wake */
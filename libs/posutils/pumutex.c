@@ -25,26 +25,98 @@
  */
 
 /**** Includes ***************************************************************/
+#if !defined(_GNU_SOURCE)
+    #define _GNU_SOURCE
+#endif /* !defined(_GNU_SOURCE) */
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sched.h>
 #include "posutils.h"
+#include "pudefs.h"
 #include "logging.h"
+#include "dll.h"
 
 /**** Definitions ************************************************************/
+#define PU_MUTEX_PROF_REPORT_MAX (16)
 
 /**** Macros ****************************************************************/
 
 /**** Static declarations ***************************************************/
 
+/* Every profiled mutex. Statically initialised, profiled mutexes may be created before init */
+static DLL_HEAD(pu_mutex_prof_tag) lstProf     = DLL_INITIALIZER;
+static pthread_mutex_t             mtxProfList = PTHREAD_MUTEX_INITIALIZER;
+
 /**** Globals and externs ***************************************************/
 
 /**** Local function prototypes (NB Use static modifier) ********************/
+static uint32_t pu_mutex_prof_bucket( uint64_t uiNs );
+static uint64_t pu_mutex_prof_pct( const uint32_t* aHist, uint64_t uiTotal, uint32_t uiPct, uint64_t uiMaxNs );
+static int      pu_mutex_prof_compare( const void* pA, const void* pB );
 
 /****************************************************************************/
 /* LOCAL FUNCTION DEFINITIONS                                               */
 /****************************************************************************/
 
+/* log2 bucket: 0 for 0ns, n for [2^(n-1), 2^n) ns */
+static uint32_t pu_mutex_prof_bucket( uint64_t uiNs )
+{
+    uint32_t uiBucket = (0 == uiNs) ? 0 : (uint32_t)(64 - __builtin_clzll( uiNs ));
+    return ((uiBucket < PU_MUTEX_PROF_BUCKETS) ? uiBucket : (PU_MUTEX_PROF_BUCKETS - 1));
+}
+/* pu_mutex_prof_bucket */
+
+/* Upper bound (ns) of the bucket holding the given percentile, no more than the largest sample */
+static uint64_t pu_mutex_prof_pct( const uint32_t* aHist, uint64_t uiTotal, uint32_t uiPct, uint64_t uiMaxNs )
+{
+    uint64_t uiTarget = (uiTotal * uiPct + 99) / 100;
+    uint64_t uiSum    = 0;
+    uint32_t i;
+
+    for (i = 0; i < PU_MUTEX_PROF_BUCKETS; i++)
+    {
+        uiSum += aHist[i];
+        if ((uiSum >= uiTarget) && (uiSum > 0))
+        {
+            return ((((uint64_t)1 << i) < uiMaxNs) ? ((uint64_t)1 << i) : uiMaxNs);
+        }
+    }
+    return (0);
+}
+/* pu_mutex_prof_pct */
+
+/* Most total wait time first, then most contended */
+static int pu_mutex_prof_compare( const void* pA, const void* pB )
+{
+    const pu_mutex_prof_t* pMtxA = *(const pu_mutex_prof_t* const*)pA;
+    const pu_mutex_prof_t* pMtxB = *(const pu_mutex_prof_t* const*)pB;
+
+    if (pMtxA->uiWaitNs != pMtxB->uiWaitNs)
+    {
+        return ((pMtxA->uiWaitNs < pMtxB->uiWaitNs) ? 1 : -1);
+    }
+    if (pMtxA->uiContended != pMtxB->uiContended)
+    {
+        return ((pMtxA->uiContended < pMtxB->uiContended) ? 1 : -1);
+    }
+    return (0);
+}
+/* pu_mutex_prof_compare */
+
+/**
+ * @brief Prints the profiled mutex report (if there are any), called from posutils_exit
+ */
+void pu_mutex_prof_exit_private( void )
+{
+    if (NULL != __atomic_load_n( &(lstProf.pDllHead), __ATOMIC_RELAXED ))
+    {
+        pu_mutex_prof_dump( stdout, PU_MUTEX_PROF_REPORT_MAX );
+    }
+}
+/* pu_mutex_prof_exit_private */
+
 /****************************************************************************/
 /* PUBLIC FUNCTION DEFINITIONS                                              */
 /****************************************************************************/
@@ -116,6 +188,55 @@ int pu_mutex_create_type(
             }
             pthread_mutexattr_destroy( &attr );
         }
+
+        /* Adaptive (spin then sleep) mutex */
+        else if (PU_MUTEX_TYPE_ADAPTIVE == enType)
+        {
+            iResult = pthread_mutexattr_init( &attr );
+            if (0 == iResult)
+            {
+                iResult = pthread_mutexattr_settype( &attr, PTHREAD_MUTEX_ADAPTIVE_NP );
+            }
+            if (0 == iResult)
+            {
+                iResult = pthread_mutex_init( pMtx, &attr );
+            }
+            pthread_mutexattr_destroy( &attr );
+        }
+
+        /* Priority inheritance mutex */
+        else if (PU_MUTEX_TYPE_PI == enType)
+        {
+            iResult = pthread_mutexattr_init( &attr );
+            if (0 == iResult)
+            {
+                iResult = pthread_mutexattr_setprotocol( &attr, PTHREAD_PRIO_INHERIT );
+            }
+            if (0 == iResult)
+            {
+                iResult = pthread_mutex_init( pMtx, &attr );
+            }
+            pthread_mutexattr_destroy( &attr );
+        }
+
+        /* Priority ceiling mutex, the ceiling starts at the top and can be lowered */
+        else if (PU_MUTEX_TYPE_CEILING == enType)
+        {
+            iResult = pthread_mutexattr_init( &attr );
+            if (0 == iResult)
+            {
+                iResult = pthread_mutexattr_setprotocol( &attr, PTHREAD_PRIO_PROTECT );
+            }
+            if (0 == iResult)
+            {
+                iResult = pthread_mutexattr_setprioceiling( &attr, sched_get_priority_max( SCHED_FIFO ) );
+            }
+            if (0 == iResult)
+            {
+                iResult = pthread_mutex_init( pMtx, &attr );
+            }
+            pthread_mutexattr_destroy( &attr );
+        }
     }
 
     /* post-condition */
@@ -124,3 +245,268 @@ int pu_mutex_create_type(
 }
 /* pu_mutex_create_type */
 
+/**
+ * @brief   Sets the priority ceiling of a ceiling mutex
+ *
+ * @param[in] pMtx     : Pointer to a ceiling mutex
+ * @param[in] iCeiling : New ceiling
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_mutex_set_ceiling(
+    pthread_mutex_t* pMtx,
+    int              iCeiling )
+{
+    int iOldCeiling;
+
+    ASSERT( pMtx );
+    if (NULL == pMtx)
+    {
+        return (EINVAL);
+    }
+    return (pthread_mutex_setprioceiling( pMtx, iCeiling, &iOldCeiling ));
+}
+/* pu_mutex_set_ceiling */
+
+/**
+ * @brief   Creates a profiled mutex
+ *
+ * @param[in] pMtx   : Profiled mutex
+ * @param[in] enType : Type of the underlying mutex
+ * @param[in] szName : Name for the report
+ * @param[in] szFile : Creation site
+ * @param[in] iLine  : Creation site
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_mutex_prof_create(
+    pu_mutex_prof_t* pMtx,
+    pu_mutex_type    enType,
+    const char*      szName,
+    const char*      szFile,
+    int              iLine )
+{
+    int iResult = EINVAL;
+
+    ASSERT( pMtx );
+    ASSERT( szName );
+    if (pMtx && szName)
+    {
+        memset( pMtx, 0, sizeof(pu_mutex_prof_t) );
+        iResult = pu_mutex_create_type( &(pMtx->mtx), enType );
+        if (0 == iResult)
+        {
+            /* The macro stringises the argument, usually "&mtxSomething" */
+            pMtx->szName = ('&' == szName[0]) ? (szName + 1) : szName;
+            pMtx->szFile = szFile;
+            pMtx->iLine  = iLine;
+            pthread_mutex_lock( &mtxProfList );
+            DLL_ELEM_ADD( lstProf, pMtx );
+            pthread_mutex_unlock( &mtxProfList );
+        }
+    }
+    return (iResult);
+}
+/* pu_mutex_prof_create */
+
+/**
+ * @brief   Destroys a profiled mutex and takes it out of the report
+ *
+ * @param[in] pMtx : Profiled mutex
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_mutex_prof_destroy( pu_mutex_prof_t* pMtx )
+{
+    ASSERT( pMtx );
+    if (NULL == pMtx)
+    {
+        return (EINVAL);
+    }
+    pthread_mutex_lock( &mtxProfList );
+    DLL_ELEM_DEL( lstProf, pMtx );
+    pthread_mutex_unlock( &mtxProfList );
+    return (pthread_mutex_destroy( &(pMtx->mtx) ));
+}
+/* pu_mutex_prof_destroy */
+
+/**
+ * @brief   Locks a profiled mutex
+ *
+ * @param[in] pMtx   : Profiled mutex
+ * @param[in] szFile : Call site
+ * @param[in] iLine  : Call site
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ *
+ * @par Description
+ * A trylock first. Only if that fails is the wait timed, so the uncontended path costs no more
+ * than a counter. The statistics are updated once the mutex is held.
+ */
+int pu_mutex_prof_lock_at(
+    pu_mutex_prof_t* pMtx,
+    const char*      szFile,
+    int              iLine )
+{
+    uint64_t uiStartNs = 0;
+    uint64_t uiNowNs   = 0;
+    uint64_t uiWaitNs;
+    int      iResult;
+
+    ASSERT( pMtx );
+    iResult = pthread_mutex_trylock( &(pMtx->mtx) );
+    if (EBUSY == iResult)
+    {
+        uiStartNs = pu_thread_now_ns_private();
+        iResult   = pthread_mutex_lock( &(pMtx->mtx) );
+        uiNowNs   = pu_thread_now_ns_private();
+    }
+    if (0 != iResult)
+    {
+        return (iResult);
+    }
+
+    /* Held from here, plain updates */
+    pMtx->uiAcquired++;
+    if (0 != uiStartNs)
+    {
+        uiWaitNs = uiNowNs - uiStartNs;
+        pMtx->uiContended++;
+        pMtx->uiWaitNs += uiWaitNs;
+        pMtx->aWaitHist[pu_mutex_prof_bucket( uiWaitNs )]++;
+        if (uiWaitNs > pMtx->uiMaxWaitNs)
+        {
+            pMtx->uiMaxWaitNs   = uiWaitNs;
+            pMtx->szMaxWaitFile = szFile;
+            pMtx->iMaxWaitLine  = iLine;
+        }
+    }
+    pMtx->szLockFile = szFile;
+    pMtx->iLockLine  = iLine;
+    pMtx->uiLockNs   = 0;
+    if (0 == (pMtx->uiAcquired & (PU_MUTEX_PROF_SAMPLE - 1)))
+    {
+        pMtx->uiLockNs = uiNowNs ? uiNowNs : pu_thread_now_ns_private();
+    }
+    return (0);
+}
+/* pu_mutex_prof_lock_at */
+
+/**
+ * @brief   Unlocks a profiled mutex
+ *
+ * @param[in] pMtx : Profiled mutex
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_mutex_prof_unlock( pu_mutex_prof_t* pMtx )
+{
+    uint64_t uiHoldNs;
+
+    ASSERT( pMtx );
+    if (0 != pMtx->uiLockNs)
+    {
+        uiHoldNs = pu_thread_now_ns_private() - pMtx->uiLockNs;
+        pMtx->uiLockNs = 0;
+        pMtx->uiHoldNs += uiHoldNs;
+        pMtx->uiHoldSamples++;
+        pMtx->aHoldHist[pu_mutex_prof_bucket( uiHoldNs )]++;
+        if (uiHoldNs > pMtx->uiMaxHoldNs)
+        {
+            pMtx->uiMaxHoldNs   = uiHoldNs;
+            pMtx->szMaxHoldFile = pMtx->szLockFile;
+            pMtx->iMaxHoldLine  = pMtx->iLockLine;
+        }
+    }
+    return (pthread_mutex_unlock( &(pMtx->mtx) ));
+}
+/* pu_mutex_prof_unlock */
+
+/**
+ * @brief   Prints the profiled mutexes, most contended first
+ *
+ * @param[in] pOut  : Output stream, NULL for stdout
+ * @param[in] uiMax : Maximum number of mutexes, 0 for all
+ *
+ * @par Description
+ * Each mutex's statistics are copied while holding it (64 bit counters tear on a 32 bit CPU),
+ * the sort and the printing work on the copies.
+ */
+void pu_mutex_prof_dump(
+    FILE*  pOut,
+    size_t uiMax )
+{
+    pu_mutex_prof_t** apMtx;
+    pu_mutex_prof_t*  aSnap;
+    pu_mutex_prof_t*  pMtx;
+    size_t            uiCount = 0;
+    size_t            i;
+
+    if (NULL == pOut)
+    {
+        pOut = stdout;
+    }
+    pthread_mutex_lock( &mtxProfList );
+    DLL_FOR_EACH( lstProf, pMtx )
+    {
+        uiCount++;
+    }
+    apMtx = (pu_mutex_prof_t**)malloc( (uiCount + 1) * sizeof(pu_mutex_prof_t*) );
+    aSnap = (pu_mutex_prof_t*)malloc( (uiCount + 1) * sizeof(pu_mutex_prof_t) );
+    ASSERT( apMtx && aSnap );
+    if ((NULL == apMtx) || (NULL == aSnap))
+    {
+        pthread_mutex_unlock( &mtxProfList );
+        free( apMtx );
+        free( aSnap );
+        return;
+    }
+    i = 0;
+    DLL_FOR_EACH( lstProf, pMtx )
+    {
+        pthread_mutex_lock( &(pMtx->mtx) );
+        aSnap[i] = *pMtx;
+        pthread_mutex_unlock( &(pMtx->mtx) );
+        apMtx[i] = &aSnap[i];
+        i++;
+    }
+    pthread_mutex_unlock( &mtxProfList );
+
+    qsort( apMtx, uiCount, sizeof(pu_mutex_prof_t*), pu_mutex_prof_compare );
+    if ((0 == uiMax) || (uiMax > uiCount))
+    {
+        uiMax = uiCount;
+    }
+
+    fprintf( pOut, "Mutex contention (%zu profiled, hold times sampled 1/%d, times in us)\n", uiCount, PU_MUTEX_PROF_SAMPLE );
+    fprintf( pOut, "%-24s %10s %6s %10s %8s %8s %8s %8s %8s\n",
+        "NAME", "ACQUIRED", "CONT%", "WAIT", "WAIT50", "WAIT99", "WAITMAX", "HOLDAVG", "HOLDMAX" );
+    for (i = 0; i < uiMax; i++)
+    {
+        pMtx = apMtx[i];
+        fprintf( pOut, "%-24.24s %10llu %6.2f %10.1f %8.1f %8.1f %8.1f %8.2f %8.1f\n",
+            pMtx->szName,
+            (unsigned long long)pMtx->uiAcquired,
+            pMtx->uiAcquired ? ((100.0 * (double)pMtx->uiContended) / (double)pMtx->uiAcquired) : 0.0,
+            (double)pMtx->uiWaitNs / 1000.0,
+            (double)pu_mutex_prof_pct( pMtx->aWaitHist, pMtx->uiContended, 50, pMtx->uiMaxWaitNs ) / 1000.0,
+            (double)pu_mutex_prof_pct( pMtx->aWaitHist, pMtx->uiContended, 99, pMtx->uiMaxWaitNs ) / 1000.0,
+            (double)pMtx->uiMaxWaitNs / 1000.0,
+            pMtx->uiHoldSamples ? (((double)pMtx->uiHoldNs / (double)pMtx->uiHoldSamples) / 1000.0) : 0.0,
+            (double)pMtx->uiMaxHoldNs / 1000.0 );
+        fprintf( pOut, "    created %s:%d", pMtx->szFile ? pMtx->szFile : "?", pMtx->iLine );
+        if (pMtx->szMaxWaitFile)
+        {
+            fprintf( pOut, ", longest wait %s:%d", pMtx->szMaxWaitFile, pMtx->iMaxWaitLine );
+        }
+        if (pMtx->szMaxHoldFile)
+        {
+            fprintf( pOut, ", longest hold %s:%d", pMtx->szMaxHoldFile, pMtx->iMaxHoldLine );
+        }
+        fprintf( pOut, "\n" );
+    }
+    fflush( pOut );
+    free( apMtx );
+    free( aSnap );
+}
+/* pu_mutex_prof_dump */
@@ -0,0 +1,578 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+/**
+ * @file     pupool.c
+ * @brief    Implementation of the work stealing thread pool
+ */
+
+/**** Includes ***************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "posutils.h"
+#include "pupool.h"
+#include "pudefs.h"
+#include "logging.h"
+
+/**** Definitions ************************************************************/
+
+/* A queued task */
+typedef struct
+{
+    pu_pool_task_fct_t fctTask;              /* Task function                      */
+    void*              pArg;                 /* Task argument                      */
+}   pu_pool_task_t;
+
+/* Per worker deque. The owner works at the bottom, thieves at the top.
+ * The indices are free running, the ring index is (index & uiMask)
+ */
+typedef struct
+{
+    pthread_mutex_t mtx;                     /* Protects the deque                 */
+    pu_pool_task_t* pRing;                   /* Task ring                          */
+    size_t          uiMask;                  /* Ring size - 1                      */
+    size_t          uiTop;                   /* Steal end (oldest)                 */
+    size_t          uiBottom;                /* Owner end (newest)                 */
+}   pu_pool_deque_t;
+
+/* Per worker context */
+typedef struct
+{
+    struct pu_pool_tag* pPool;               /* Owning pool                        */
+    size_t              uiIndex;             /* Worker index, also the deque index */
+    pthread_t           pid;                 /* Posix thread ID                    */
+}   pu_pool_worker_t;
+
+/* The pool */
+struct pu_pool_tag
+{
+    size_t            uiNumWorkers;          /* Number of workers                  */
+    pu_pool_worker_t* pWorkers;              /* Worker contexts                    */
+    pu_pool_deque_t*  pDeques;               /* One deque per worker               */
+    pthread_mutex_t   mtx;                   /* Protects the sleep/idle conditions */
+    pthread_cond_t    condWork;              /* Signalled when work is queued      */
+    pthread_cond_t    condIdle;              /* Signalled when the pool drains     */
+    size_t            uiPending;             /* Queued, not yet taken (atomic)     */
+    size_t            uiInFlight;            /* Queued or running (atomic)         */
+    size_t            uiSleeping;            /* Workers waiting for work (atomic)  */
+    size_t            uiNextDeque;           /* Round robin for foreign submits    */
+    bool              bStop;                 /* Workers must exit (atomic)         */
+};
+
+/**** Macros ****************************************************************/
+#define PU_POOL_MIN_DEPTH (16)
+
+/**** Static declarations ***************************************************/
+
+/* The worker (if any) the calling thread is */
+static __thread pu_pool_worker_t* pSelfWorker = NULL;
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static size_t pu_pool_round_pow2( size_t uiValue );
+static bool   pu_pool_deque_push( pu_pool_deque_t* pDeque, pu_pool_task_fct_t fctTask, void* pArg );
+static bool   pu_pool_deque_pop( pu_pool_deque_t* pDeque, pu_pool_task_t* pTask );
+static bool   pu_pool_deque_steal( pu_pool_deque_t* pDeque, pu_pool_task_t* pTask );
+static int    pu_pool_enqueue( pu_pool_t* pPool, pu_pool_task_fct_t fctTask, void* pArg );
+static bool   pu_pool_find_task( pu_pool_worker_t* pWorker, pu_pool_task_t* pTask );
+static void   pu_pool_task_done( pu_pool_t* pPool );
+static void   pu_pool_wake( void* pArg );
+static void   pu_pool_drain( pu_pool_t* pPool );
+static void*  pu_pool_worker_main( void* pArg );
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+static size_t pu_pool_round_pow2( size_t uiValue )
+{
+    size_t uiPow2 = PU_POOL_MIN_DEPTH;
+    while (uiPow2 < uiValue)
+    {
+        uiPow2 <<= 1;
+    }
+    return (uiPow2);
+}
+/* pu_pool_round_pow2 */
+
+static bool pu_pool_deque_push( pu_pool_deque_t* pDeque, pu_pool_task_fct_t fctTask, void* pArg )
+{
+    bool bPushed = false;
+
+    pthread_mutex_lock( &(pDeque->mtx) );
+    if ((pDeque->uiBottom - pDeque->uiTop) <= pDeque->uiMask)
+    {
+        pu_pool_task_t* pSlot = &(pDeque->pRing[pDeque->uiBottom & pDeque->uiMask]);
+        pSlot->fctTask = fctTask;
+        pSlot->pArg    = pArg;
+        pDeque->uiBottom++;
+        bPushed = true;
+    }
+    pthread_mutex_unlock( &(pDeque->mtx) );
+    return (bPushed);
+}
+/* pu_pool_deque_push */
+
+static bool pu_pool_deque_pop( pu_pool_deque_t* pDeque, pu_pool_task_t* pTask )
+{
+    bool bPopped = false;
+
+    pthread_mutex_lock( &(pDeque->mtx) );
+    if (pDeque->uiBottom != pDeque->uiTop)
+    {
+        pDeque->uiBottom--;
+        *pTask  = pDeque->pRing[pDeque->uiBottom & pDeque->uiMask];
+        bPopped = true;
+    }
+    pthread_mutex_unlock( &(pDeque->mtx) );
+    return (bPopped);
+}
+/* pu_pool_deque_pop */
+
+static bool pu_pool_deque_steal( pu_pool_deque_t* pDeque, pu_pool_task_t* pTask )
+{
+    bool bStolen = false;
+
+    /* Don't queue up behind the owner, just move on to the next victim */
+    if (0 == pthread_mutex_trylock( &(pDeque->mtx) ))
+    {
+        if (pDeque->uiBottom != pDeque->uiTop)
+        {
+            *pTask  = pDeque->pRing[pDeque->uiTop & pDeque->uiMask];
+            pDeque->uiTop++;
+            bStolen = true;
+        }
+        pthread_mutex_unlock( &(pDeque->mtx) );
+    }
+    return (bStolen);
+}
+/* pu_pool_deque_steal */
+
+static int pu_pool_enqueue( pu_pool_t* pPool, pu_pool_task_fct_t fctTask, void* pArg )
+{
+    size_t uiStart;
+    size_t i;
+    bool   bQueued = false;
+
+    /* Workers feed their own deque, everybody else goes round robin */
+    if (pSelfWorker && (pSelfWorker->pPool == pPool))
+    {
+        uiStart = pSelfWorker->uiIndex;
+    }
+    else
+    {
+        uiStart = __atomic_fetch_add( &(pPool->uiNextDeque), 1, __ATOMIC_RELAXED );
+    }
+
+    /* Count it before it becomes visible, a fast worker may finish it before we return */
+    __atomic_fetch_add( &(pPool->uiInFlight), 1, __ATOMIC_SEQ_CST );
+    __atomic_fetch_add( &(pPool->uiPending), 1, __ATOMIC_SEQ_CST );
+    for (i = 0; (i < pPool->uiNumWorkers) && !bQueued; i++)
+    {
+        bQueued = pu_pool_deque_push( &(pPool->pDeques[(uiStart + i) % pPool->uiNumWorkers]), fctTask, pArg );
+    }
+    if (!bQueued)
+    {
+        __atomic_fetch_sub( &(pPool->uiPending), 1, __ATOMIC_SEQ_CST );
+        pu_pool_task_done( pPool );
+        return (EAGAIN);
+    }
+
+    /* Wake a sleeper. The sleeper increments uiSleeping before it re-checks uiPending
+     * (both sequentially consistent), so one of us always sees the other.
+     */
+    if (__atomic_load_n( &(pPool->uiSleeping), __ATOMIC_SEQ_CST ) > 0)
+    {
+        pthread_mutex_lock( &(pPool->mtx) );
+        pthread_cond_signal( &(pPool->condWork) );
+        pthread_mutex_unlock( &(pPool->mtx) );
+    }
+
+    /* The pool was stopped under us. A worker sets bStop before it looks at uiPending for the
+     * last time, we counted in uiPending before looking at bStop: either it stays for the task,
+     * or we see the stop and run what is left ourselves, the workers may all have gone
+     */
+    if (__atomic_load_n( &(pPool->bStop), __ATOMIC_SEQ_CST ))
+    {
+        pu_pool_drain( pPool );
+    }
+    return (0);
+}
+/* pu_pool_enqueue */
+
+static bool pu_pool_find_task( pu_pool_worker_t* pWorker, pu_pool_task_t* pTask )
+{
+    pu_pool_t* pPool = pWorker->pPool;
+    size_t     i;
+    bool       bFound;
+
+    /* Own deque first, then try each of the others once */
+    bFound = pu_pool_deque_pop( &(pPool->pDeques[pWorker->uiIndex]), pTask );
+    for (i = 1; (i < pPool->uiNumWorkers) && !bFound; i++)
+    {
+        bFound = pu_pool_deque_steal( &(pPool->pDeques[(pWorker->uiIndex + i) % pPool->uiNumWorkers]), pTask );
+    }
+    if (bFound)
+    {
+        __atomic_fetch_sub( &(pPool->uiPending), 1, __ATOMIC_SEQ_CST );
+    }
+    return (bFound);
+}
+/* pu_pool_find_task */
+
+static void pu_pool_task_done( pu_pool_t* pPool )
+{
+    /* Last one out wakes anyone waiting for the pool to drain */
+    if (1 == __atomic_fetch_sub( &(pPool->uiInFlight), 1, __ATOMIC_SEQ_CST ))
+    {
+        pthread_mutex_lock( &(pPool->mtx) );
+        pthread_cond_broadcast( &(pPool->condIdle) );
+        pthread_mutex_unlock( &(pPool->mtx) );
+    }
+}
+/* pu_pool_task_done */
+
+/* Stop hook: a worker has been asked to stop, get it off the condition variable */
+static void pu_pool_wake( void* pArg )
+{
+    pu_pool_t* pPool = (pu_pool_t*)pArg;
+
+    pthread_mutex_lock( &(pPool->mtx) );
+    pthread_cond_broadcast( &(pPool->condWork) );
+    pthread_mutex_unlock( &(pPool->mtx) );
+}
+/* pu_pool_wake */
+
+/* Runs whatever is queued in the calling thread, for a pool that has stopped */
+static void pu_pool_drain( pu_pool_t* pPool )
+{
+    pu_pool_task_t task;
+    size_t         i;
+
+    for (i = 0; i < pPool->uiNumWorkers; i++)
+    {
+        while (pu_pool_deque_pop( &(pPool->pDeques[i]), &task ))
+        {
+            __atomic_fetch_sub( &(pPool->uiPending), 1, __ATOMIC_SEQ_CST );
+            task.fctTask( task.pArg );
+            pu_pool_task_done( pPool );
+        }
+    }
+}
+/* pu_pool_drain */
+
+static void* pu_pool_worker_main( void* pArg )
+{
+    pu_pool_worker_t* pWorker = (pu_pool_worker_t*)pArg;
+    pu_pool_t*        pPool   = pWorker->pPool;
+    pu_pool_task_t    task;
+
+    pSelfWorker = pWorker;
+    pu_thread_stop_hook_private( pu_pool_wake, pPool );
+    for (;;)
+    {
+        if (pu_pool_find_task( pWorker, &task ))
+        {
+            task.fctTask( task.pArg );
+            pu_pool_task_done( pPool );
+            continue;
+        }
+
+        /* Nothing to do. Sleep until there is, a pending task may be sitting in a deque whose
+         * owner is busy, the trylock steal skipped it, so go round again rather than sleep
+         */
+        pthread_mutex_lock( &(pPool->mtx) );
+        __atomic_fetch_add( &(pPool->uiSleeping), 1, __ATOMIC_SEQ_CST );
+        while ((0 == __atomic_load_n( &(pPool->uiPending), __ATOMIC_SEQ_CST )) &&
+               !__atomic_load_n( &(pPool->bStop), __ATOMIC_SEQ_CST ) && !pu_thread_stop_requested())
+        {
+            pthread_cond_wait( &(pPool->condWork), &(pPool->mtx) );
+        }
+        __atomic_fetch_sub( &(pPool->uiSleeping), 1, __ATOMIC_SEQ_CST );
+
+        /* Asked to stop (the hook woke us), the whole pool goes: take the others with us */
+        if (!__atomic_load_n( &(pPool->bStop), __ATOMIC_SEQ_CST ) && pu_thread_stop_requested())
+        {
+            __atomic_store_n( &(pPool->bStop), true, __ATOMIC_SEQ_CST );
+            pthread_cond_broadcast( &(pPool->condWork) );
+        }
+        if (__atomic_load_n( &(pPool->bStop), __ATOMIC_SEQ_CST ) &&
+            (0 == __atomic_load_n( &(pPool->uiPending), __ATOMIC_SEQ_CST )))
+        {
+            pthread_mutex_unlock( &(pPool->mtx) );
+            break;
+        }
+        pthread_mutex_unlock( &(pPool->mtx) );
+    }
+    pSelfWorker = NULL;
+    return (NULL);
+}
+/* pu_pool_worker_main */
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * @brief   Creates a pool and starts the workers
+ *
+ * @param[in] uiNumWorkers : Number of worker threads, 0 means one per online CPU
+ * @param[in] uiQueueDepth : Depth of each worker deque, rounded up to a power of 2
+ * @param[in] uiStackSize  : Worker stack size (see \ref pu_thread_create)
+ * @param[in] szName       : Worker thread name, \b MUST be persistent
+ * @retval  Non-NULL pool on success
+ * @retval  NULL on failure
+ */
+pu_pool_t* pu_pool_create(
+    size_t      uiNumWorkers,
+    size_t      uiQueueDepth,
+    size_t      uiStackSize,
+    const char* szName )
+{
+    pu_pool_t*       pPool;
+    pu_thread_attr_t attr;
+    void**           apArgs  = NULL;
+    pthread_t*       aPids   = NULL;
+    size_t           uiDepth;
+    size_t           i;
+    int              iResult = 0;
+
+    /* pre-condition */
+    ASSERT( szName );
+    if (NULL == szName)
+    {
+        return (NULL);
+    }
+    if (0 == uiNumWorkers)
+    {
+        long lCpus   = sysconf( _SC_NPROCESSORS_ONLN );
+        uiNumWorkers = (lCpus > 0) ? (size_t)lCpus : 1;
+    }
+    uiDepth = pu_pool_round_pow2( uiQueueDepth );
+
+    pPool = (pu_pool_t*)calloc( 1, sizeof(pu_pool_t) );
+    ASSERT( pPool );
+    if (NULL == pPool)
+    {
+        return (NULL);
+    }
+    pPool->uiNumWorkers = uiNumWorkers;
+    pPool->pWorkers     = (pu_pool_worker_t*)calloc( uiNumWorkers, sizeof(pu_pool_worker_t) );
+    pPool->pDeques      = (pu_pool_deque_t*)calloc( uiNumWorkers, sizeof(pu_pool_deque_t) );
+    if ((NULL == pPool->pWorkers) || (NULL == pPool->pDeques))
+    {
+        free( pPool->pWorkers );
+        free( pPool->pDeques );
+        free( pPool );
+        return (NULL);
+    }
+    pu_mutex_create_type( &(pPool->mtx), PU_MUTEX_TYPE_FAST );
+    pthread_cond_init( &(pPool->condWork), NULL );
+    pthread_cond_init( &(pPool->condIdle), NULL );
+
+    /* The deques */
+    for (i = 0; (i < uiNumWorkers) && (0 == iResult); i++)
+    {
+        pu_pool_deque_t* pDeque = &(pPool->pDeques[i]);
+        iResult = pu_mutex_create_type( &(pDeque->mtx), PU_MUTEX_TYPE_FAST );
+        pDeque->uiMask = uiDepth - 1;
+        pDeque->pRing  = (pu_pool_task_t*)calloc( uiDepth, sizeof(pu_pool_task_t) );
+        if (NULL == pDeque->pRing)
+        {
+            iResult = ENOMEM;
+        }
+    }
+
+    /* The workers, all named the same, created as one batch */
+    if (0 == iResult)
+    {
+        apArgs = (void**)calloc( uiNumWorkers, sizeof(void*) );
+        aPids  = (pthread_t*)calloc( uiNumWorkers, sizeof(pthread_t) );
+        iResult = (apArgs && aPids) ? 0 : ENOMEM;
+    }
+    if (0 == iResult)
+    {
+        for (i = 0; i < uiNumWorkers; i++)
+        {
+            pPool->pWorkers[i].pPool   = pPool;
+            pPool->pWorkers[i].uiIndex = i;
+            apArgs[i] = &(pPool->pWorkers[i]);
+        }
+        pu_thread_attr_init( &attr );
+        attr.uiStackSize = uiStackSize;
+        attr.bOwned      = true;
+        if (uiNumWorkers != pu_thread_create_many( pu_pool_worker_main, apArgs, uiNumWorkers, &attr, szName, false, aPids ))
+        {
+            iResult = EAGAIN;
+        }
+        for (i = 0; i < uiNumWorkers; i++)
+        {
+            pPool->pWorkers[i].pid = aPids[i];
+        }
+    }
+    free( apArgs );
+    free( aPids );
+
+    /* Partial failure, unwind whatever was started */
+    if (0 != iResult)
+    {
+        LOG_ERROR( "PU_POOL(create):cannot create %s pool (%d)\n", szName, iResult );
+        pu_pool_destroy( pPool );
+        pPool = NULL;
+    }
+    return (pPool);
+}
+/* pu_pool_create */
+
+/**
+ * @brief   Queues a task, never blocks
+ *
+ * @param[in] pPool   : The pool
+ * @param[in] fctTask : Task function
+ * @param[in] pArg    : Task argument
+ * @retval  0 the task is queued
+ * @retval  EAGAIN all the deques are full
+ * @retval  EINVAL bad parameter, or the pool is being destroyed
+ */
+int pu_pool_post(
+    pu_pool_t*         pPool,
+    pu_pool_task_fct_t fctTask,
+    void*              pArg )
+{
+    ASSERT( pPool );
+    ASSERT( fctTask );
+    if ((NULL == pPool) || (NULL == fctTask) || __atomic_load_n( &(pPool->bStop), __ATOMIC_SEQ_CST ))
+    {
+        return (EINVAL);
+    }
+    return (pu_pool_enqueue( pPool, fctTask, pArg ));
+}
+/* pu_pool_post */
+
+/**
+ * @brief   Queues a task, runs it in the caller if the pool is saturated
+ *
+ * @param[in] pPool   : The pool
+ * @param[in] fctTask : Task function
+ * @param[in] pArg    : Task argument
+ * @retval  0 the task is queued (or was run by the caller)
+ * @retval  EINVAL bad parameter, or the pool is being destroyed
+ */
+int pu_pool_submit(
+    pu_pool_t*         pPool,
+    pu_pool_task_fct_t fctTask,
+    void*              pArg )
+{
+    int iResult;
+
+    iResult = pu_pool_post( pPool, fctTask, pArg );
+    if (EAGAIN == iResult)
+    {
+        fctTask( pArg );
+        iResult = 0;
+    }
+    return (iResult);
+}
+/* pu_pool_submit */
+
+/**
+ * @brief   Waits until every queued task has completed
+ *
+ * @param[in] pPool : The pool
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_pool_wait_idle( pu_pool_t* pPool )
+{
+    ASSERT( pPool );
+    ASSERT( (NULL == pSelfWorker) || (pSelfWorker->pPool != pPool) );
+    if (NULL == pPool)
+    {
+        return (EINVAL);
+    }
+    pthread_mutex_lock( &(pPool->mtx) );
+    while (__atomic_load_n( &(pPool->uiInFlight), __ATOMIC_SEQ_CST ) > 0)
+    {
+        pthread_cond_wait( &(pPool->condIdle), &(pPool->mtx) );
+    }
+    pthread_mutex_unlock( &(pPool->mtx) );
+    return (0);
+}
+/* pu_pool_wait_idle */
+
+/**
+ * @brief   Gets the number of worker threads in the pool
+ *
+ * @param[in] pPool : The pool
+ * @return  Number of workers
+ */
+size_t pu_pool_get_number_of_workers( const pu_pool_t* pPool )
+{
+    return (pPool ? pPool->uiNumWorkers : 0);
+}
+/* pu_pool_get_number_of_workers */
+
+/**
+ * @brief   Drains the pool, stops and joins the workers, frees the pool
+ *
+ * @param[in] pPool : The pool
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_pool_destroy( pu_pool_t* pPool )
+{
+    size_t i;
+
+    ASSERT( pPool );
+    if (NULL == pPool)
+    {
+        return (EINVAL);
+    }
+
+    /* Drain, then tell the workers to leave */
+    pu_pool_wait_idle( pPool );
+    pthread_mutex_lock( &(pPool->mtx) );
+    __atomic_store_n( &(pPool->bStop), true, __ATOMIC_SEQ_CST );
+    pthread_cond_broadcast( &(pPool->condWork) );
+    pthread_mutex_unlock( &(pPool->mtx) );
+    for (i = 0; i < pPool->uiNumWorkers; i++)
+    {
+        if (0 != pPool->pWorkers[i].pid)
+        {
+            pu_thread_join( pPool->pWorkers[i].pid, NULL );
+        }
+    }
+
+    /* Free the lot */
+    for (i = 0; i < pPool->uiNumWorkers; i++)
+    {
+        pthread_mutex_destroy( &(pPool->pDeques[i].mtx) );
+        free( pPool->pDeques[i].pRing );
+    }
+    pthread_cond_destroy( &(pPool->condWork) );
+    pthread_cond_destroy( &(pPool->condIdle) );
+    pthread_mutex_destroy( &(pPool->mtx) );
+    free( pPool->pDeques );
+    free( pPool->pWorkers );
+    free( pPool );
+    return (0);
+}
+/* pu_pool_destroy */
@@ -0,0 +1,168 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+/**
+ * @file     puring.c
+ * @brief    SPSC ring buffer, creation and the blocking (kernel) paths
+ */
+
+/**** Includes ***************************************************************/
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "puring.h"
+#include "pufutex.h"
+#include "pudefs.h"
+#include "logging.h"
+
+/**** Definitions ************************************************************/
+#define PU_RING_MAX_CAPACITY (1u << 30)
+
+/**** Macros ****************************************************************/
+
+/**** Static declarations ***************************************************/
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * @brief   Creates a ring
+ *
+ * @param[out] pRing      : Ring
+ * @param[in]  uiCapacity : Elements, rounded up to a power of two
+ * @param[in]  uiElemSize : Bytes per element
+ * @param[in]  bBlocking  : true if the consumer will use pu_ring_pop_wait
+ * @retval  0 for success
+ * @retval  EINVAL for a bad size
+ * @retval  ENOMEM
+ */
+int pu_ring_create(
+    pu_ring_t* pRing,
+    uint32_t   uiCapacity,
+    uint32_t   uiElemSize,
+    bool       bBlocking )
+{
+    void*    pBuf = NULL;
+    uint32_t uiCap;
+
+    ASSERT( pRing );
+    if ((NULL == pRing) || (0 == uiElemSize) || (uiCapacity < 2) || (uiCapacity > PU_RING_MAX_CAPACITY))
+    {
+        return (EINVAL);
+    }
+
+    /* Next power of two */
+    uiCap = (uiCapacity & (uiCapacity - 1)) ? (1u << (32 - __builtin_clz( uiCapacity ))) : uiCapacity;
+    if (0 != posix_memalign( &pBuf, PU_RING_CACHE_LINE, (size_t)uiCap * uiElemSize ))
+    {
+        LOG_ERROR( "PU_RING(create): no memory for %u x %u bytes\n", uiCap, uiElemSize );
+        return (ENOMEM);
+    }
+    memset( pRing, 0, sizeof(*pRing) );
+    pRing->pBuf       = (uint8_t*)pBuf;
+    pRing->uiMask     = uiCap - 1;
+    pRing->uiElemSize = uiElemSize;
+    pRing->bBlocking  = bBlocking;
+    __atomic_thread_fence( __ATOMIC_RELEASE );
+    return (0);
+}
+/* pu_ring_create */
+
+/**
+ * @brief   Destroys a ring
+ *
+ * @param[in] pRing : Ring
+ */
+void pu_ring_destroy( pu_ring_t* pRing )
+{
+    ASSERT( pRing );
+    if (pRing)
+    {
+        free( pRing->pBuf );
+        pRing->pBuf = NULL;
+    }
+}
+/* pu_ring_destroy */
+
+/**
+ * @brief   Sleeping part of the blocking pop
+ *
+ * @par Description
+ * Announce the sleep, full fence, look again: the producer stores the head, fences, then looks
+ * at uiSleeping. One of the two is bound to see the other, so a push cannot be missed. A push
+ * between the look and the futex wait clears uiSleeping, and the wait returns at once.
+ */
+uint32_t pu_ring_pop_wait_slow(
+    pu_ring_t* pRing,
+    void*      pElems,
+    uint32_t   uiMax,
+    uint32_t   uiTimeoutMs )
+{
+    struct timespec deadline;
+    uint32_t        uiGot = 0;
+
+    ASSERT( pRing->bBlocking );
+    if (PU_FUTEX_FOREVER != uiTimeoutMs)
+    {
+        pu_futex_deadline_private( &deadline, uiTimeoutMs );
+    }
+    pu_thread_blocked_private( pRing, "ring" );
+    for (;;)
+    {
+        __atomic_store_n( &(pRing->uiSleeping), 1, __ATOMIC_RELAXED );
+        __atomic_thread_fence( __ATOMIC_SEQ_CST );
+        uiGot = pu_ring_pop( pRing, pElems, uiMax );
+        if (0 != uiGot)
+        {
+            break;
+        }
+        if (ETIMEDOUT == pu_futex_wait_until_private( &(pRing->uiSleeping), 1, (PU_FUTEX_FOREVER != uiTimeoutMs) ? &deadline : NULL ))
+        {
+            uiGot = pu_ring_pop( pRing, pElems, uiMax );
+            break;
+        }
+    }
+    __atomic_store_n( &(pRing->uiSleeping), 0, __ATOMIC_RELAXED );
+    pu_thread_blocked_private( NULL, NULL );
+    return (uiGot);
+}
+/* pu_ring_pop_wait_slow */
+
+/**
+ * @brief   Wakes the consumer, if it is (still) asleep
+ *
+ * @param[in] pRing : Ring
+ */
+void pu_ring_wake( pu_ring_t* pRing )
+{
+    if (0 != __atomic_exchange_n( &(pRing->uiSleeping), 0, __ATOMIC_RELAXED ))
+    {
+        pu_futex_wake_private( &(pRing->uiSleeping), 1 );
+    }
+}
+/* pu_ring_wake */
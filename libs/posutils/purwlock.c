@@ -0,0 +1,102 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+/**
+ * @file     purwlock.c
+ * @brief    Reader-writer lock factory
+ */
+
+/**** Includes ***************************************************************/
+#if !defined(_GNU_SOURCE)
+    #define _GNU_SOURCE
+#endif /* !defined(_GNU_SOURCE) */
+#include <pthread.h>
+#include "posutils.h"
+#include "logging.h"
+
+/**** Definitions ************************************************************/
+
+/**** Macros ****************************************************************/
+
+/**** Static declarations ***************************************************/
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * @brief   Creates (initialises) a reader-writer lock of the specified type
+ *
+ * @param[in] pRwl   : Pointer to a valid rwlock
+ * @param[in] enType : Lock type
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ *
+ * @par Description
+ * The writer preference is the glibc "nonrecursive" flavour: the recursive one does not
+ * actually prefer writers, for the very reason that it has to let a recursive reader in.
+ */
+int pu_rwlock_create_type(
+    pthread_rwlock_t* pRwl,
+    pu_rwlock_type    enType )
+{
+    pthread_rwlockattr_t attr;
+    int                  iResult = -1;
+
+    /* pre-condition */
+    ASSERT( pRwl );
+    ASSERT( (enType >= PU_RWLOCK_TYPE_READER) && (enType < PU_RWLOCK_TYPE_ENDDEF) );
+    if ((pRwl)                           &&
+        (enType >= PU_RWLOCK_TYPE_READER) &&
+        (enType < PU_RWLOCK_TYPE_ENDDEF) )
+    {
+        /* Default - readers first */
+        if (PU_RWLOCK_TYPE_READER == enType)
+        {
+            iResult = pthread_rwlock_init( pRwl, NULL );
+        }
+
+        /* Writers first */
+        else if (PU_RWLOCK_TYPE_WRITER == enType)
+        {
+            iResult = pthread_rwlockattr_init( &attr );
+            if (0 == iResult)
+            {
+                iResult = pthread_rwlockattr_setkind_np( &attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP );
+            }
+            if (0 == iResult)
+            {
+                iResult = pthread_rwlock_init( pRwl, &attr );
+            }
+            pthread_rwlockattr_destroy( &attr );
+        }
+    }
+
+    /* post-condition */
+    ASSERT( 0 == iResult );
+    return (iResult);
+}
+/* pu_rwlock_create_type */
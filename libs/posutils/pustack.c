@@ -0,0 +1,439 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+/**
+ * @file     pustack.c
+ * @brief    Stack high water mark measurement and stack size autotuning
+ *
+ * When painting is enabled a new thread fills its (unused) stack with a pattern before calling
+ * main. The stack grows down, so the deepest word that no longer holds the pattern marks the
+ * peak usage:
+ * @code
+ * | pattern pattern pattern | used ......................... | TLS, pthread |
+ * ^ low                     ^ high water mark                              ^ high
+ * @endcode
+ *
+ * The peak is recorded per thread name when the thread exits, the profile keeps the worst case
+ * seen. A profile can be saved to and loaded from a text file. With autotuning enabled a thread
+ * whose name is in the profile gets a stack of (peak + margin), regardless of the size asked for.
+ *
+ * Setting the PU_STACK_PROFILE environment variable to a file name does all of this without
+ * any code changes: the file is loaded (if it exists) at init, painting and autotuning are
+ * enabled, and the updated profile is written back at exit.
+ */
+
+/**** Includes ***************************************************************/
+#if !defined(_GNU_SOURCE)
+    #define _GNU_SOURCE
+#endif /* !defined(_GNU_SOURCE) */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "posutils.h"
+#include "pudefs.h"
+#include "logging.h"
+
+/**** Definitions ************************************************************/
+
+/* A profile entry, the name is copied since loaded names have no persistent string */
+typedef struct
+{
+    char   szName[PU_THREAD_STACK_NAME_LEN]; /* Thread name (truncated)            */
+    size_t uiPeak;                           /* Worst case usage (bytes)           */
+    size_t uiSize;                           /* Stack size it was measured in      */
+    size_t uiCount;                          /* Number of threads measured         */
+}   pu_stack_entry_t;
+
+#define PU_STACK_PATTERN     ((uintptr_t)0xC33CA55Au)
+#define PU_STACK_PAINT_GAP   (512)           /* Left unpainted below the current frame */
+#define PU_STACK_MARGIN      (4096)          /* Minimum margin added by the autotuner  */
+#define PU_STACK_ENV         "PU_STACK_PROFILE"
+
+/**** Macros ****************************************************************/
+
+/**** Static declarations ***************************************************/
+static pu_stack_entry_t aProfile[PU_THREAD_STACK_PROFILE_MAX];
+static size_t           uiNumEntries = 0;
+static pthread_mutex_t  mtxProfile;
+static bool             bIsInit      = false;
+static bool             bPaint       = false;
+static bool             bAutotune    = false;
+static const char*      szEnvFile    = NULL;
+
+/* Painted stack of the calling thread, zero if it was not painted */
+static __thread uintptr_t uiPaintLow  = 0;
+static __thread size_t    uiPaintSize = 0;
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static size_t            pu_stack_scan( uintptr_t uiLow, size_t uiSize );
+static pu_stack_entry_t* pu_stack_find( const char* szName, bool bAdd );
+static void              pu_stack_record( const char* szName, size_t uiPeak, size_t uiSize, size_t uiCount );
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+/* Peak usage of a painted stack: everything above the last untouched pattern word */
+static size_t pu_stack_scan( uintptr_t uiLow, size_t uiSize )
+{
+    uintptr_t uiAddr = uiLow;
+    uintptr_t uiHigh = uiLow + uiSize;
+
+    while ((uiAddr < uiHigh) && (PU_STACK_PATTERN == *(volatile uintptr_t*)uiAddr))
+    {
+        uiAddr += sizeof(uintptr_t);
+    }
+    return ((size_t)(uiHigh - uiAddr));
+}
+/* pu_stack_scan */
+
+/* Linear search, the profile is small. Lock held by the caller */
+static pu_stack_entry_t* pu_stack_find( const char* szName, bool bAdd )
+{
+    pu_stack_entry_t* pEntry = NULL;
+    size_t            i;
+
+    for (i = 0; i < uiNumEntries; i++)
+    {
+        if (0 == strncmp( aProfile[i].szName, szName, PU_THREAD_STACK_NAME_LEN - 1 ))
+        {
+            return (&(aProfile[i]));
+        }
+    }
+    if (bAdd && (uiNumEntries < PU_THREAD_STACK_PROFILE_MAX))
+    {
+        pEntry = &(aProfile[uiNumEntries++]);
+        memset( pEntry, 0, sizeof(pu_stack_entry_t) );
+        strncpy( pEntry->szName, szName, PU_THREAD_STACK_NAME_LEN - 1 );
+    }
+    return (pEntry);
+}
+/* pu_stack_find */
+
+/* Merges a measurement into the profile, keeps the worst case */
+static void pu_stack_record( const char* szName, size_t uiPeak, size_t uiSize, size_t uiCount )
+{
+    pu_stack_entry_t* pEntry;
+
+    pthread_mutex_lock( &mtxProfile );
+    pEntry = pu_stack_find( szName, true );
+    if (pEntry)
+    {
+        if (uiPeak >= pEntry->uiPeak)
+        {
+            pEntry->uiPeak = uiPeak;
+            pEntry->uiSize = uiSize;
+        }
+        pEntry->uiCount += uiCount;
+    }
+    else
+    {
+        LOG_ERROR( "PU_STACK: profile full, %s not recorded\n", szName );
+    }
+    pthread_mutex_unlock( &mtxProfile );
+}
+/* pu_stack_record */
+
+/**
+ * @brief Initialises the stack profiler, picks up PU_STACK_PROFILE
+ *
+ * @retval 0     Success
+ * @retval non-0 Error
+ */
+int pu_stack_init_private( void )
+{
+    int iResult;
+
+    iResult = pu_mutex_create_type( &mtxProfile, PU_MUTEX_TYPE_FAST );
+    ASSERT( 0 == iResult );
+    if (0 == iResult)
+    {
+        uiNumEntries = 0;
+        bIsInit      = true;
+        szEnvFile    = getenv( PU_STACK_ENV );
+        if (szEnvFile && *szEnvFile)
+        {
+            /* A missing file is fine, this run creates it */
+            (void)pu_thread_stack_profile_load( szEnvFile );
+            pu_thread_stack_profile_enable( true );
+            pu_thread_stack_autotune_enable( true );
+        }
+        else
+        {
+            szEnvFile = NULL;
+        }
+    }
+    return (iResult);
+}
+/* pu_stack_init_private */
+
+/**
+ * @brief Closes the stack profiler, saves the profile if PU_STACK_PROFILE is set
+ *
+ * @retval 0     Success
+ * @retval non-0 Error
+ */
+int pu_stack_exit_private( void )
+{
+    int iResult = 0;
+
+    if (szEnvFile)
+    {
+        iResult = pu_thread_stack_profile_save( szEnvFile );
+        szEnvFile = NULL;
+    }
+    pu_thread_stack_profile_enable( false );
+    pu_thread_stack_autotune_enable( false );
+    bIsInit = false;
+    pthread_mutex_destroy( &mtxProfile );
+    return (iResult);
+}
+/* pu_stack_exit_private */
+
+/**
+ * @brief Paints the stack of the calling (new) thread, if painting is enabled
+ *
+ * @par Description
+ * Called from the thread entry handler before main. Paints from the bottom of the stack up to
+ * a gap below the current frame, so the live frames are not touched.
+ */
+void pu_stack_paint_private( void )
+{
+    pthread_attr_t attr;
+    void*          pStack;
+    size_t         uiSize;
+    uintptr_t      uiAddr;
+    uintptr_t      uiTop;
+
+    uiPaintLow  = 0;
+    uiPaintSize = 0;
+    if (!__atomic_load_n( &bPaint, __ATOMIC_RELAXED ) || (0 != pthread_getattr_np( pthread_self(), &attr )))
+    {
+        return;
+    }
+    pthread_attr_getstack( &attr, &pStack, &uiSize );
+    pthread_attr_destroy( &attr );
+
+    uiTop = (uintptr_t)&uiAddr - PU_STACK_PAINT_GAP;
+    for (uiAddr = (uintptr_t)pStack; uiAddr < uiTop; uiAddr += sizeof(uintptr_t))
+    {
+        *(volatile uintptr_t*)uiAddr = PU_STACK_PATTERN;
+    }
+    uiPaintLow  = (uintptr_t)pStack;
+    uiPaintSize = uiSize;
+}
+/* pu_stack_paint_private */
+
+/**
+ * @brief Records the peak stack usage of the calling (exiting) thread
+ *
+ * @param[in] szName : Thread name
+ */
+void pu_stack_measure_private( const char* szName )
+{
+    if (uiPaintSize > 0)
+    {
+        pu_stack_record( szName, pu_stack_scan( uiPaintLow, uiPaintSize ), uiPaintSize, 1 );
+        uiPaintLow  = 0;
+        uiPaintSize = 0;
+    }
+}
+/* pu_stack_measure_private */
+
+/**
+ * @brief Stack size for a new thread, tuned from the profile if autotuning is enabled
+ *
+ * @param[in] szName      : Thread name
+ * @param[in] uiStackSize : Requested size
+ * @return Size to use (not yet page rounded)
+ */
+size_t pu_stack_tune_private( const char* szName, size_t uiStackSize )
+{
+    pu_stack_entry_t* pEntry;
+    size_t            uiMargin;
+
+    if (bIsInit && __atomic_load_n( &bAutotune, __ATOMIC_RELAXED ))
+    {
+        pthread_mutex_lock( &mtxProfile );
+        pEntry = pu_stack_find( szName, false );
+        if (pEntry && (pEntry->uiPeak > 0))
+        {
+            uiMargin    = pEntry->uiPeak / 4;
+            uiStackSize = pEntry->uiPeak + ((uiMargin > PU_STACK_MARGIN) ? uiMargin : PU_STACK_MARGIN);
+        }
+        pthread_mutex_unlock( &mtxProfile );
+    }
+    return (uiStackSize);
+}
+/* pu_stack_tune_private */
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * @brief   Enables or disables stack painting for threads created from now on
+ *
+ * @param[in] bEnable : true to paint
+ */
+void pu_thread_stack_profile_enable( bool bEnable )
+{
+    __atomic_store_n( &bPaint, bEnable, __ATOMIC_RELAXED );
+}
+/* pu_thread_stack_profile_enable */
+
+/**
+ * @brief   Enables or disables stack size autotuning from the profile
+ *
+ * @param[in] bEnable : true to tune
+ */
+void pu_thread_stack_autotune_enable( bool bEnable )
+{
+    __atomic_store_n( &bAutotune, bEnable, __ATOMIC_RELAXED );
+}
+/* pu_thread_stack_autotune_enable */
+
+/**
+ * @brief   Peak stack usage of the calling thread so far
+ *
+ * @return  Bytes used, 0 if the stack was not painted
+ */
+size_t pu_thread_stack_peak_self( void )
+{
+    return ((uiPaintSize > 0) ? pu_stack_scan( uiPaintLow, uiPaintSize ) : 0);
+}
+/* pu_thread_stack_peak_self */
+
+/**
+ * @brief   Prints the stack profile
+ *
+ * @param[in] pOut : Output stream, NULL for stdout
+ */
+void pu_thread_stack_profile_dump( FILE* pOut )
+{
+    size_t i;
+
+    ASSERT( bIsInit );
+    if (!bIsInit)
+    {
+        return;
+    }
+    if (NULL == pOut)
+    {
+        pOut = stdout;
+    }
+    fprintf( pOut, "%-31s %10s %10s %5s %8s\n", "NAME", "PEAK", "SIZE", "USE%", "THREADS" );
+    pthread_mutex_lock( &mtxProfile );
+    for (i = 0; i < uiNumEntries; i++)
+    {
+        fprintf( pOut, "%-31s %10zu %10zu %5.1f %8zu\n",
+            aProfile[i].szName,
+            aProfile[i].uiPeak,
+            aProfile[i].uiSize,
+            aProfile[i].uiSize ? ((100.0 * (double)aProfile[i].uiPeak) / (double)aProfile[i].uiSize) : 0.0,
+            aProfile[i].uiCount );
+    }
+    pthread_mutex_unlock( &mtxProfile );
+    fflush( pOut );
+}
+/* pu_thread_stack_profile_dump */
+
+/**
+ * @brief   Saves the stack profile to a text file
+ *
+ * @param[in] szFile : File name
+ * @retval  0 for success
+ * @retval  Non-zero (errno) for failure
+ */
+int pu_thread_stack_profile_save( const char* szFile )
+{
+    FILE*  pFile;
+    size_t i;
+    int    iResult = 0;
+
+    ASSERT( bIsInit );
+    ASSERT( szFile );
+    if (!bIsInit || (NULL == szFile))
+    {
+        return (EINVAL);
+    }
+    pFile = fopen( szFile, "w" );
+    if (NULL == pFile)
+    {
+        LOG_ERROR( "PU_STACK: cannot write %s (%d)\n", szFile, errno );
+        return (errno);
+    }
+    fprintf( pFile, "# peak size threads name\n" );
+    pthread_mutex_lock( &mtxProfile );
+    for (i = 0; i < uiNumEntries; i++)
+    {
+        fprintf( pFile, "%zu %zu %zu %s\n", aProfile[i].uiPeak, aProfile[i].uiSize, aProfile[i].uiCount, aProfile[i].szName );
+    }
+    pthread_mutex_unlock( &mtxProfile );
+    if (0 != fclose( pFile ))
+    {
+        iResult = errno;
+    }
+    return (iResult);
+}
+/* pu_thread_stack_profile_save */
+
+/**
+ * @brief   Loads (merges) a stack profile from a text file
+ *
+ * @param[in] szFile : File name
+ * @retval  0 for success
+ * @retval  Non-zero (errno) for failure
+ */
+int pu_thread_stack_profile_load( const char* szFile )
+{
+    FILE*  pFile;
+    char   szLine[PU_THREAD_STACK_NAME_LEN + 96];
+    char   szName[PU_THREAD_STACK_NAME_LEN];
+    char   szFormat[32];
+    size_t uiPeak;
+    size_t uiSize;
+    size_t uiCount;
+
+    ASSERT( bIsInit );
+    ASSERT( szFile );
+    if (!bIsInit || (NULL == szFile))
+    {
+        return (EINVAL);
+    }
+    pFile = fopen( szFile, "r" );
+    if (NULL == pFile)
+    {
+        return (errno);
+    }
+    /* The name width follows PU_THREAD_STACK_NAME_LEN, a literal would not */
+    snprintf( szFormat, sizeof(szFormat), "%%zu %%zu %%zu %%%d[^\n]", PU_THREAD_STACK_NAME_LEN - 1 );
+    while (fgets( szLine, sizeof(szLine), pFile ))
+    {
+        if (('#' != szLine[0]) && (4 == sscanf( szLine, szFormat, &uiPeak, &uiSize, &uiCount, szName )))
+        {
+            pu_stack_record( szName, uiPeak, uiSize, uiCount );
+        }
+    }
+    fclose( pFile );
+    return (0);
+}
+/* pu_thread_stack_profile_load */
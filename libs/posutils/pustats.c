@@ -0,0 +1,343 @@
+//=============================================================================
+// This is free and unencumbered software released into the public domain.
+//
+// Anyone is free to copy, modify, publish, use, compile, sell, or
+// distribute this software, either in source code form or as a compiled
+// binary, for any purpose, commercial or non-commercial, and by any
+// means.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+// IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+// OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+//
+// This is a simplified version of UNLICENSE. For more information,
+// please refer to <http://unlicense.org/>
+//=============================================================================
+
+/**
+ * @file     pustats.c
+ * @brief    Per thread runtime statistics
+ *
+ * The calling thread can ask the kernel directly (RUSAGE_THREAD). For every other thread the
+ * numbers come from procfs, keyed on the Linux thread ID held in the registry:
+ * - /proc/self/task/<tid>/stat   : minflt (10), majflt (12), utime (14), stime (15)
+ * - /proc/self/task/<tid>/status : voluntary_ctxt_switches, nonvoluntary_ctxt_switches
+ * .
+ */
+
+/**** Includes ***************************************************************/
+#if !defined(_GNU_SOURCE)
+    #define _GNU_SOURCE
+#endif /* !defined(_GNU_SOURCE) */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include "posutils.h"
+#include "pudefs.h"
+#include "logging.h"
+
+/**** Definitions ************************************************************/
+
+/* Collects the registry into an array */
+typedef struct
+{
+    pu_thread_stats_t* aStats;               /* Destination                        */
+    size_t             uiMax;                /* Capacity                           */
+    size_t             uiCount;              /* Entries used                       */
+}   pu_stats_collect_t;
+
+#define PU_STATS_LINE_LEN (256)
+
+/**** Macros ****************************************************************/
+
+/**** Static declarations ***************************************************/
+
+/**** Local function prototypes (NB Use static modifier) ********************/
+static bool     pu_stats_collect( const pu_thread_info_t* pInfo, void* pArg );
+static bool     pu_stats_read_proc( pu_thread_stats_t* pStats );
+static int      pu_stats_compare_keys( uint64_t uiA, uint64_t uiB );
+static int      pu_stats_compare_cpu( const void* pA, const void* pB );
+static int      pu_stats_compare_ctxsw( const void* pA, const void* pB );
+static int      pu_stats_compare_faults( const void* pA, const void* pB );
+
+/****************************************************************************/
+/* LOCAL FUNCTION DEFINITIONS                                               */
+/****************************************************************************/
+
+static bool pu_stats_collect( const pu_thread_info_t* pInfo, void* pArg )
+{
+    pu_stats_collect_t* pCollect = (pu_stats_collect_t*)pArg;
+    pu_thread_stats_t*  pStats;
+
+    if (pCollect->uiCount >= pCollect->uiMax)
+    {
+        return (false);
+    }
+    pStats = &(pCollect->aStats[pCollect->uiCount]);
+    memset( pStats, 0, sizeof(pu_thread_stats_t) );
+    pStats->szName    = pInfo->szName;
+    pStats->pid       = pInfo->pid;
+    pStats->tid       = pInfo->tid;
+    pStats->uiStartNs = pInfo->uiStartNs;
+    pCollect->uiCount++;
+    return (true);
+}
+/* pu_stats_collect */
+
+/* Returns false if the thread has gone (the task directory no longer exists) */
+static bool pu_stats_read_proc( pu_thread_stats_t* pStats )
+{
+    char               szPath[64];
+    char               szLine[PU_STATS_LINE_LEN];
+    FILE*              pFile;
+    char*              pFields;
+    unsigned long      ulMinFlt = 0;
+    unsigned long      ulMajFlt = 0;
+    unsigned long      ulUtime  = 0;
+    unsigned long      ulStime  = 0;
+    unsigned long      ulValue;
+    long               lTicks   = sysconf( _SC_CLK_TCK );
+    bool               bOk      = false;
+
+    /* stat: the comm field may contain spaces and brackets, so parse from the last ')' */
+    snprintf( szPath, sizeof(szPath), "/proc/self/task/%d/stat", (int)pStats->tid );
+    pFile = fopen( szPath, "r" );
+    if (pFile)
+    {
+        if (fgets( szLine, sizeof(szLine), pFile ) && (NULL != (pFields = strrchr( szLine, ')' ))))
+        {
+            /* state(3) ppid pgrp session tty_nr tpgid flags minflt(10) cminflt majflt(12) cmajflt utime(14) stime(15) */
+            bOk = (4 == sscanf(
+                pFields + 1,
+                " %*c %*d %*d %*d %*d %*d %*u %lu %*u %lu %*u %lu %lu",
+                &ulMinFlt, &ulMajFlt, &ulUtime, &ulStime ));
+        }
+        fclose( pFile );
+    }
+    if (!bOk)
+    {
+        return (false);
+    }
+    if (lTicks <= 0)
+    {
+        lTicks = 100;
+    }
+    pStats->uiMinFlt = ulMinFlt;
+    pStats->uiMajFlt = ulMajFlt;
+    pStats->uiUserNs = ((uint64_t)ulUtime * 1000000000ull) / (uint64_t)lTicks;
+    pStats->uiSysNs  = ((uint64_t)ulStime * 1000000000ull) / (uint64_t)lTicks;
+
+    /* status: context switches */
+    snprintf( szPath, sizeof(szPath), "/proc/self/task/%d/status", (int)pStats->tid );
+    pFile = fopen( szPath, "r" );
+    if (pFile)
+    {
+        while (fgets( szLine, sizeof(szLine), pFile ))
+        {
+            if (1 == sscanf( szLine, "voluntary_ctxt_switches: %lu", &ulValue ))
+            {
+                pStats->uiVolCtxSw = ulValue;
+            }
+            else if (1 == sscanf( szLine, "nonvoluntary_ctxt_switches: %lu", &ulValue ))
+            {
+                pStats->uiInvolCtxSw = ulValue;
+            }
+        }
+        fclose( pFile );
+    }
+    return (true);
+}
+/* pu_stats_read_proc */
+
+/* Descending */
+static int pu_stats_compare_keys( uint64_t uiA, uint64_t uiB )
+{
+    return ((uiA < uiB) ? 1 : ((uiA > uiB) ? -1 : 0));
+}
+/* pu_stats_compare_keys */
+
+/* One comparator per sort key, qsort has no context argument */
+static int pu_stats_compare_cpu( const void* pA, const void* pB )
+{
+    const pu_thread_stats_t* pStatsA = (const pu_thread_stats_t*)pA;
+    const pu_thread_stats_t* pStatsB = (const pu_thread_stats_t*)pB;
+    return (pu_stats_compare_keys( pStatsA->uiUserNs + pStatsA->uiSysNs, pStatsB->uiUserNs + pStatsB->uiSysNs ));
+}
+/* pu_stats_compare_cpu */
+
+static int pu_stats_compare_ctxsw( const void* pA, const void* pB )
+{
+    const pu_thread_stats_t* pStatsA = (const pu_thread_stats_t*)pA;
+    const pu_thread_stats_t* pStatsB = (const pu_thread_stats_t*)pB;
+    return (pu_stats_compare_keys( pStatsA->uiVolCtxSw + pStatsA->uiInvolCtxSw, pStatsB->uiVolCtxSw + pStatsB->uiInvolCtxSw ));
+}
+/* pu_stats_compare_ctxsw */
+
+static int pu_stats_compare_faults( const void* pA, const void* pB )
+{
+    const pu_thread_stats_t* pStatsA = (const pu_thread_stats_t*)pA;
+    const pu_thread_stats_t* pStatsB = (const pu_thread_stats_t*)pB;
+    return (pu_stats_compare_keys( pStatsA->uiMinFlt + pStatsA->uiMajFlt, pStatsB->uiMinFlt + pStatsB->uiMajFlt ));
+}
+/* pu_stats_compare_faults */
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * @brief   Gets the runtime statistics of the calling thread
+ *
+ * @param[out] pStats : Statistics
+ * @retval  0 for success
+ * @retval  Non-zero for failure
+ */
+int pu_thread_stats_self( pu_thread_stats_t* pStats )
+{
+    struct rusage        usage;
+    pu_thread_context_t* pSelf = pu_thread_self();
+    int                  iResult;
+
+    ASSERT( pStats );
+    if (NULL == pStats)
+    {
+        return (EINVAL);
+    }
+    memset( pStats, 0, sizeof(pu_thread_stats_t) );
+    iResult = getrusage( RUSAGE_THREAD, &usage );
+    if (0 == iResult)
+    {
+        pStats->pid          = pthread_self();
+        pStats->szName       = pu_thread_get_name( pSelf );
+        pStats->tid          = pSelf ? pu_thread_get_tid( pSelf ) : (pid_t)syscall( SYS_gettid );
+        pStats->uiUserNs     = ((uint64_t)usage.ru_utime.tv_sec * 1000000000ull) + ((uint64_t)usage.ru_utime.tv_usec * 1000ull);
+        pStats->uiSysNs      = ((uint64_t)usage.ru_stime.tv_sec * 1000000000ull) + ((uint64_t)usage.ru_stime.tv_usec * 1000ull);
+        pStats->uiVolCtxSw   = (uint64_t)usage.ru_nvcsw;
+        pStats->uiInvolCtxSw = (uint64_t)usage.ru_nivcsw;
+        pStats->uiMinFlt     = (uint64_t)usage.ru_minflt;
+        pStats->uiMajFlt     = (uint64_t)usage.ru_majflt;
+    }
+    return (iResult);
+}
+/* pu_thread_stats_self */
+
+/**
+ * @brief   Snapshots the runtime statistics of every registered thread
+ *
+ * @param[out] aStats : Array to fill in
+ * @param[in]  uiMax  : Size of the array
+ * @return  Number of entries filled in
+ */
+size_t pu_thread_stats_snapshot(
+    pu_thread_stats_t* aStats,
+    size_t             uiMax )
+{
+    pu_stats_collect_t collect;
+    size_t             uiIn;
+    size_t             uiOut = 0;
+
+    ASSERT( aStats || (0 == uiMax) );
+    collect.aStats  = aStats;
+    collect.uiMax   = uiMax;
+    collect.uiCount = 0;
+    if (aStats && (uiMax > 0))
+    {
+        pu_thread_for_each( pu_stats_collect, &collect );
+    }
+
+    /* Threads that exited since the registry walk are squeezed out */
+    for (uiIn = 0; uiIn < collect.uiCount; uiIn++)
+    {
+        if (pu_stats_read_proc( &(aStats[uiIn]) ))
+        {
+            if (uiOut != uiIn)
+            {
+                aStats[uiOut] = aStats[uiIn];
+            }
+            uiOut++;
+        }
+    }
+    return (uiOut);
+}
+/* pu_thread_stats_snapshot */
+
+/**
+ * @brief   Prints a "top" style table of the registered threads
+ *
+ * @param[in] pOut   : Where to print, NULL for stdout
+ * @param[in] enSort : Sort key (descending)
+ * @param[in] uiMax  : Maximum number of rows, 0 for all
+ */
+void pu_thread_dump_top(
+    FILE*            pOut,
+    pu_thread_sort_t enSort,
+    size_t           uiMax )
+{
+    pu_thread_stats_t* aStats;
+    size_t             uiCount;
+    size_t             i;
+    uint64_t           uiNow = pu_thread_now_ns_private();
+    uint64_t           uiCpuNs;
+    uint64_t           uiAgeNs;
+    int                (*fctCompare)( const void*, const void* );
+
+    if (NULL == pOut)
+    {
+        pOut = stdout;
+    }
+    aStats = (pu_thread_stats_t*)malloc( PU_THREAD_MAX_THREADS * sizeof(pu_thread_stats_t) );
+    ASSERT( aStats );
+    if (NULL == aStats)
+    {
+        return;
+    }
+    uiCount = pu_thread_stats_snapshot( aStats, PU_THREAD_MAX_THREADS );
+
+    switch (enSort)
+    {
+        case PU_THREAD_SORT_CTXSW:
+            fctCompare = pu_stats_compare_ctxsw;
+            break;
+        case PU_THREAD_SORT_FAULTS:
+            fctCompare = pu_stats_compare_faults;
+            break;
+        case PU_THREAD_SORT_CPU:
+        default:
+            fctCompare = pu_stats_compare_cpu;
+            break;
+    }
+    qsort( aStats, uiCount, sizeof(pu_thread_stats_t), fctCompare );
+    if ((0 == uiMax) || (uiMax > uiCount))
+    {
+        uiMax = uiCount;
+    }
+
+    fprintf( pOut, "%7s %-20s %10s %6s %8s %8s %8s %6s\n",
+        "TID", "NAME", "CPU(ms)", "%CPU", "VCSW", "IVCSW", "MINFLT", "MAJFLT" );
+    for (i = 0; i < uiMax; i++)
+    {
+        pu_thread_stats_t* pStats = &(aStats[i]);
+        uiCpuNs = pStats->uiUserNs + pStats->uiSysNs;
+        uiAgeNs = (uiNow > pStats->uiStartNs) ? (uiNow - pStats->uiStartNs) : 1;
+        fprintf( pOut, "%7d %-20.20s %10.1f %6.1f %8llu %8llu %8llu %6llu\n",
+            (int)pStats->tid,
+            pStats->szName ? pStats->szName : "?",
+            (double)uiCpuNs / 1.0e6,
+            (100.0 * (double)uiCpuNs) / (double)uiAgeNs,
+            (unsigned long long)pStats->uiVolCtxSw,
+            (unsigned long long)pStats->uiInvolCtxSw,
+            (unsigned long long)pStats->uiMinFlt,
+            (unsigned long long)pStats->uiMajFlt );
+    }
+    fflush( pOut );
+    free( aStats );
+}
+/* pu_thread_dump_top */
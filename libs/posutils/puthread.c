@@ -24,6 +24,9 @@
  */
 
 /**** Includes ***************************************************************/
+#if !defined(_GNU_SOURCE)
+    #define _GNU_SOURCE
+#endif /* !defined(_GNU_SOURCE) */
 #include <stdlib.h>
 #include <string.h>
 #include <malloc.h>
@@ -34,59 +37,183 @@
 #include <sys/syscall.h>
 #include <sys/types.h>
 #include <sys/prctl.h>
+#include <sys/mman.h>
 #include <sched.h>
 #include <limits.h>
+#include <time.h>
 #if !defined(__USE_GNU)
     #define  __USE_GNU
 #endif /* !defined(__USE_GNU) */
 #include "posutils.h"
+#include "pufutex.h"
+#include "puhmap.h"
 #include "logging.h"
 #include "pudefs.h"
-#include "sll.h"
 
 /**** Definitions ************************************************************/
 
-/* Per thread context structure */
-typedef struct pu_thread_context_tag
+/* Mailbox: an MPSC queue of messages, the owning thread is the consumer */
+typedef struct
+{
+    pu_mpsc_t queue;                         /* Posted, not yet received messages  */
+    uint32_t  uiSleeping;                    /* Futex word, 1 = owner in receive   */
+}   pu_thread_mailbox_t;
+
+/* Per thread context structure, pu_thread_context_t (opaque in posutils.h) */
+struct pu_thread_context_tag
 {
     pu_thread_fct_t fctMain;                 /* Thread main function (entry point) */
     void*           pMainArg;                /* Main argument                      */
     pthread_t       pid;                     /* Posix thread ID                    */
     pid_t           tid;                     /* Linux thread ID                    */
     char*           szName;                  /* Thread name                        */
-    SLL_ENTRY(pu_thread_context_tag);
-}   pu_thread_context_t;
+    uint32_t        uiSlot;                  /* Registry slot index                */
+    uint64_t        uiStartNs;               /* CLOCK_MONOTONIC at thread start    */
+    bool            bMlock;                  /* Lock the stack into RAM at start   */
+    bool            bPrefault;               /* Touch the stack at start           */
+    bool            bOwned;                  /* Joined by the creator, not a join-all */
+    struct pu_thread_gate_tag* pGate;        /* Start gate, NULL if none           */
+    bool            bStop;                   /* Stop token, set by another thread  */
+    void            (*fctStopHook)( void* ); /* Wakes a library wait on a stop request */
+    void*           pStopHookArg;            /* Stop hook argument                 */
+    void*           pUserData;               /* Per-thread user data               */
+    pu_thread_mailbox_t mbox;                /* Mailbox                            */
+};
+
+/* Start gate for pu_thread_create_many(). A pthread barrier needs the thread count up front,
+ * which is not known if a create fails half way, so this is a simple gate: the threads wait
+ * until the creator opens it. Reference counted, the last one through frees it.
+ */
+typedef struct pu_thread_gate_tag
+{
+    pthread_mutex_t mtxGate;                 /* Protects bOpen                     */
+    pthread_cond_t  cndGate;                 /* Signalled when opened              */
+    bool            bOpen;                   /* Threads may start                  */
+    uint32_t        uiRefs;                  /* Creator + waiting threads          */
+}   pu_thread_gate_t;
+
+/* Registry slot. The slot carries a copy of the public thread info so that readers never
+ * dereference a context node, which may be freed under their feet. The copy is protected by
+ * a per slot sequence count (odd while it is being written). Only one party ever writes a slot
+ * at a time (the creator, the thread, then the joiner), so writers need no lock.
+ *
+ * A slot outlives its thread: when the thread exits the context goes (pNode = NULL) but the IDs
+ * stay until it is joined. That way a join-all also catches threads that have finished and
+ * are waiting to be joined. A detached thread frees its slot on the way out.
+ *
+ * The creator also puts the slot in the pid index (pidJoin, under the index lock) as soon as it
+ * has the Posix ID, so a join finds the slot in O(1), even before the thread has started.
+ */
+typedef struct
+{
+    uint32_t             uiSeq;              /* Sequence count, odd = being written */
+    uint32_t             uiGen;              /* Bumped for every new occupant       */
+    uint32_t             uiPosters;          /* Posts in progress, the context must stay */
+    pu_thread_context_t* pNode;              /* Context, NULL when the slot is free */
+    const char*          szName;             /* Copy of the thread name             */
+    pthread_t            pid;                /* Copy of the Posix thread ID         */
+    pid_t                tid;                /* Copy of the Linux thread ID         */
+    uint64_t             uiStartNs;          /* Copy of the start time              */
+    uint64_t             uiExitNs;           /* Exit time, 0 while running          */
+    const void*          pBlockedOn;         /* Futex object slept on, or NULL      */
+    const char*          szBlockedOn;        /* Kind of that object                 */
+    uint64_t             uiBlockedNs;        /* When it went to sleep               */
+    pthread_t            pidJoin;            /* Pid index key, creator to reap      */
+    void*                pCacheStack;        /* Stack from the cache, NULL if glibc's */
+    size_t               uiCacheStackSize;   /* Its size                            */
+    bool                 bOwned;             /* Joined by the creator, not a join-all */
+    uint32_t             uiLife;             /* PU_THREAD_LIFE_xxx (atomic)         */
+}   pu_thread_slot_t;
 
 #define PU_THREAD_STUPID_STACKSIZE (1024*1024)
+#define PU_THREAD_READ_RETRIES     (16)
+#define PU_THREAD_CANCEL_GRACE_MS  (100)
+
+/* Exit/detach handshake on pu_thread_slot_t::uiLife, whoever sets the second bit frees the slot */
+#define PU_THREAD_LIFE_EXITED      (1u)
+#define PU_THREAD_LIFE_DETACHED    (2u)
+#define PU_THREAD_LIFE_STOP        (4u)      /* Stop requested before the thread got going */
+#define PU_THREAD_LIFE_INDEXED     (8u)      /* The creator has put the slot in the pid index */
 
 /**** Macros ****************************************************************/
 
 /**** Static declarations ***************************************************/
-static pthread_rwlock_t     rwlock;
-static pu_thread_context_t* pThreadList  = NULL;
+static pu_thread_slot_t     aSlots[PU_THREAD_MAX_THREADS];
+static uint32_t             aFreeSlots[PU_THREAD_MAX_THREADS];
+static size_t               uiNumFree    = 0;
+static size_t               uiSlotHigh   = 0;
+static pthread_mutex_t      mtxSlots;
+static pthread_mutex_t      mtxIndex;
 static size_t               uiNumThreads = 0;
 static size_t               uiPageSize   = 0;
+static bool                 bStopAll     = false;
+
+/* Context of the calling thread, NULL if it is not a pu_thread */
+static __thread pu_thread_context_t* pSelfThread = NULL;
 
 /* 16 + extra NULLs */
 static char szProcName[20] = "";
 
 /**** Local function prototypes (NB Use static modifier) ********************/
-static size_t               pu_thread_stacksize_fix( size_t uiStackSize );
 static void*                pu_thread_entry_handler( void* pArg );
 static void                 pu_thread_exit_handler( void* pArg );
+static int                  pu_thread_attr_apply( pthread_attr_t* pAttr, const pu_thread_attr_t* pPuAttr );
+static void                 pu_thread_stack_prepare( pu_thread_context_t* pNode );
+static int                  pu_thread_attr_build( pthread_attr_t* pAttr, const pu_thread_attr_t* pPuAttr, void* pStack, size_t uiStackSize );
+static pu_thread_context_t* pu_thread_context_new( pu_thread_fct_t fctMain, void* pMainArg, const pu_thread_attr_t* pPuAttr, const char* szName );
+static int                  pu_thread_spawn( pthread_attr_t* pAttr, pu_thread_context_t* pNode, void* pStack, size_t uiStackSize, pthread_t* pPid );
+static void                 pu_thread_gate_put( pu_thread_gate_t* pGate );
+static void                 pu_thread_gate_wait( pu_thread_gate_t* pGate );
+static int                  pu_thread_join_until( pthread_t pid, void** ppRet, const struct timespec* pDeadline, uint64_t* puiExitNs );
+static void                 pu_thread_deadline( struct timespec* pDeadline, uint32_t uiTimeoutMs );
+static size_t               pu_thread_collect( pu_thread_stop_t* aStop, uint32_t* auiSlots );
+static bool                 pu_thread_slot_reserve( uint32_t* puiSlot );
+static bool                 pu_thread_slot_reserve_many( uint32_t* auiSlots, size_t uiCount );
+static void                 pu_thread_slot_release( uint32_t uiSlot );
+static void                 pu_thread_slot_release_many( const uint32_t* auiSlots, size_t uiCount );
+static void                 pu_thread_slot_write( pu_thread_slot_t* pSlot, pu_thread_context_t* pNode );
+static bool                 pu_thread_slot_read( pu_thread_slot_t* pSlot, pu_thread_info_t* pInfo );
+static void                 pu_thread_slot_retire( pu_thread_slot_t* pSlot );
+static void                 pu_thread_slot_claim( uint32_t uiSlot, pthread_t pid, bool bOwned );
+static bool                 pu_thread_slot_find( pthread_t pid, uint32_t* puiSlot );
+static void                 pu_thread_slot_reap( uint32_t uiSlot, uint64_t* puiExitNs );
+static uint32_t             pu_thread_pid_hash( const void* pKey );
+static bool                 pu_thread_pid_equal( const void* pEntry, const void* pKey );
+static const void*          pu_thread_pid_key( const void* pEntry );
+static uint32_t             pu_thread_tid_hash( const void* pKey );
+static bool                 pu_thread_tid_equal( const void* pEntry, const void* pKey );
+static const void*          pu_thread_tid_key( const void* pEntry );
+static bool                 pu_thread_name_equal( const void* pEntry, const void* pKey );
+static const void*          pu_thread_name_key( const void* pEntry );
+static void                 pu_thread_mailbox_wake( pu_thread_context_t* pNode );
+static void                 pu_thread_stop_wake( pu_thread_context_t* pNode );
+static bool                 pu_thread_slot_stop( pu_thread_slot_t* pSlot, const pthread_t* pPid );
+static void                 pu_thread_mailbox_drain( pu_thread_context_t* pNode );
+
+/* Hash indices (Posix ID, tid and name) over the registry slots, sized for a full registry so
+ * they never grow. They have their own lock (mtxIndex), a thread starting or exiting never takes
+ * the registry lock for them
+ */
+static const pu_hmap_ops_t  opsPid  = { pu_thread_pid_hash, pu_thread_pid_equal, pu_thread_pid_key };
+static const pu_hmap_ops_t  opsTid  = { pu_thread_tid_hash, pu_thread_tid_equal, pu_thread_tid_key };
+static const pu_hmap_ops_t  opsName = { pu_hmap_hash_str, pu_thread_name_equal, pu_thread_name_key };
+static pu_hmap_t            mapPid;
+static pu_hmap_t            mapTid;
+static pu_hmap_t            mapName;
 
 /****************************************************************************/
 /* LOCAL FUNCTION DEFINITIONS                                               */
 /****************************************************************************/
 
-static inline size_t pu_thread_stacksize_fix( size_t uiStackSize )
+/* Also used by the stack cache, the cache buckets are keyed on this size */
+size_t pu_thread_stacksize_fix( size_t uiStackSize )
 {
     size_t uiNewSize = uiStackSize;
 
     /* Less than the PTHREAD minimum, set size to the minimum + a guard page */
-    if (uiNewSize < PTHREAD_STACK_MIN)
+    if (uiNewSize < (size_t)PTHREAD_STACK_MIN)
     {
-        uiNewSize = (PTHREAD_STACK_MIN + uiPageSize);
+        uiNewSize = ((size_t)PTHREAD_STACK_MIN + uiPageSize);
     }
 
     /* Greater than or equal to the PTHREAD minimum
@@ -107,285 +234,1865 @@ static inline size_t pu_thread_stacksize_fix( size_t uiStackSize )
 }
 /* pu_thread_stacksize_fix */
 
-static void* pu_thread_entry_handler( void* pArg )
+/* Takes a free slot index off the free stack, O(1). The lock only covers the index stack */
+static bool pu_thread_slot_reserve( uint32_t* puiSlot )
 {
-    pu_thread_context_t* pNode = (pu_thread_context_t*)pArg;
-    void*                pReturn;
+    bool bReserved = false;
 
-    /* Get the system thread ID */
-    pNode->tid = (pid_t)syscall( SYS_gettid );
+    pthread_mutex_lock( &mtxSlots );
+    if (uiNumFree > 0)
+    {
+        *puiSlot = aFreeSlots[--uiNumFree];
+        if (*puiSlot >= uiSlotHigh)
+        {
+            __atomic_store_n( &uiSlotHigh, (size_t)*puiSlot + 1, __ATOMIC_RELEASE );
+        }
+        bReserved = true;
+    }
+    pthread_mutex_unlock( &mtxSlots );
+    return (bReserved);
+}
+/* pu_thread_slot_reserve */
 
-    /* Trace thread creation */
-    LOG_TRACE(
-        "PU_THREAD(create):proc=%s, thrd=%s, tid=%d\n",
-        szProcName,
-        pNode->szName,
-        (int)pNode->tid );
+/* Takes uiCount slots in one go, all or nothing */
+static bool pu_thread_slot_reserve_many( uint32_t* auiSlots, size_t uiCount )
+{
+    bool   bReserved = false;
+    size_t uiHigh    = 0;
+    size_t i;
 
-    /* Insert the node at the head of the thread linked list */
-    pthread_rwlock_wrlock( &rwlock );
-    SLL_ELEM_ADD( pThreadList, pNode );
-    uiNumThreads++;
-    pthread_rwlock_unlock( &rwlock );
-    
-    /* register the exist handler */
-    pthread_cleanup_push( pu_thread_exit_handler, pNode );
+    pthread_mutex_lock( &mtxSlots );
+    if (uiNumFree >= uiCount)
+    {
+        for (i = 0; i < uiCount; i++)
+        {
+            auiSlots[i] = aFreeSlots[--uiNumFree];
+            if (auiSlots[i] >= uiHigh)
+            {
+                uiHigh = (size_t)auiSlots[i] + 1;
+            }
+        }
+        if (uiHigh > uiSlotHigh)
+        {
+            __atomic_store_n( &uiSlotHigh, uiHigh, __ATOMIC_RELEASE );
+        }
+        bReserved = true;
+    }
+    pthread_mutex_unlock( &mtxSlots );
+    return (bReserved);
+}
+/* pu_thread_slot_reserve_many */
 
-    /* Thread real main entry */  
-    pReturn = pNode->fctMain( pNode->pMainArg );
-    pthread_cleanup_pop( 1 );
-    
-    /* pass back the actual thread return value */
-    return (pReturn);
+/* Puts a slot index back on the free stack, O(1) */
+static void pu_thread_slot_release( uint32_t uiSlot )
+{
+    pthread_mutex_lock( &mtxSlots );
+    ASSERT( uiNumFree < PU_THREAD_MAX_THREADS );
+    aFreeSlots[uiNumFree++] = uiSlot;
+    pthread_mutex_unlock( &mtxSlots );
 }
-/* pu_thread_entry_handler */
+/* pu_thread_slot_release */
 
-static void pu_thread_exit_handler( void* pArg )
+/* Gives back uiCount unused slots in one go */
+static void pu_thread_slot_release_many( const uint32_t* auiSlots, size_t uiCount )
 {
-    pu_thread_context_t* pNode = (pu_thread_context_t*)pArg;
-    ASSERT( pNode );
-    
-    /* Remove the corresponding node from thread list
-     * We needn't check the case: (pThreadList == NULL), it will never happen.
-     * But.. in debug we do anyway..
-     */
-    pthread_rwlock_wrlock( &rwlock );
-    ASSERT( pThreadList );
-    ASSERT( uiNumThreads > 0 );
+    size_t i;
 
-    /* Delete it. free the memory */
-    SLL_ELEM_DEL( pu_thread_context_t, pThreadList, pNode );
-    free( pNode );
-    pNode = NULL;
-    uiNumThreads--;
-    pthread_rwlock_unlock( &rwlock );  
+    pthread_mutex_lock( &mtxSlots );
+    ASSERT( (uiNumFree + uiCount) <= PU_THREAD_MAX_THREADS );
+    for (i = uiCount; i > 0; i--)
+    {
+        aFreeSlots[uiNumFree++] = auiSlots[i - 1];
+    }
+    pthread_mutex_unlock( &mtxSlots );
 }
-/* pu_thread_exit_handler */
+/* pu_thread_slot_release_many */
 
-/****************************************************************************/
-/* PUBLIC FUNCTION DEFINITIONS                                              */
-/****************************************************************************/
+/* Publishes (pNode != NULL) or clears (pNode == NULL) a slot. Single writer per slot */
+static void pu_thread_slot_write( pu_thread_slot_t* pSlot, pu_thread_context_t* pNode )
+{
+    uint32_t uiSeq = __atomic_load_n( &(pSlot->uiSeq), __ATOMIC_RELAXED );
 
-/**
- * @brief Initialises the module
- *
- * @retval 0     Success
- * @retval non-0 Error
- *
- * @pre     None
- * @post    Module is initialised
- *
- * @par Description
- * Initialises the module. Creates any resources needed.
- * Wrapped in the init, no init/exit test needed
+    __atomic_store_n( &(pSlot->uiSeq), uiSeq + 1, __ATOMIC_RELAXED );
+    __atomic_thread_fence( __ATOMIC_RELEASE );
+    if (pNode)
+    {
+        __atomic_store_n( &(pSlot->uiGen), pSlot->uiGen + 1, __ATOMIC_RELAXED );
+    }
+    /* Release: whoever sees the new occupant sees its generation too (see pu_thread_post) */
+    __atomic_store_n( &(pSlot->pNode),  pNode, __ATOMIC_RELEASE );
+    __atomic_store_n( &(pSlot->szName), (pNode ? pNode->szName : NULL), __ATOMIC_RELAXED );
+    __atomic_store_n( &(pSlot->pid),    (pNode ? pNode->pid : (pthread_t)0), __ATOMIC_RELAXED );
+    __atomic_store_n( &(pSlot->tid),    (pNode ? pNode->tid : 0), __ATOMIC_RELAXED );
+    __atomic_store_n( &(pSlot->uiStartNs), (pNode ? pNode->uiStartNs : 0), __ATOMIC_RELAXED );
+    __atomic_store_n( &(pSlot->uiExitNs), 0, __ATOMIC_RELAXED );
+    __atomic_store_n( &(pSlot->pBlockedOn), NULL, __ATOMIC_RELAXED );
+    __atomic_store_n( &(pSlot->szBlockedOn), NULL, __ATOMIC_RELAXED );
+    __atomic_store_n( &(pSlot->uiBlockedNs), 0, __ATOMIC_RELAXED );
+    __atomic_store_n( &(pSlot->uiSeq), uiSeq + 2, __ATOMIC_RELEASE );
+}
+/* pu_thread_slot_write */
+
+/* The thread has exited: the context goes, the IDs stay until the join. Only the exiting thread
+ * writes the slot, no lock
  */
-int pu_thread_init_private( void )
+static void pu_thread_slot_retire( pu_thread_slot_t* pSlot )
 {
-    int      iResult = -1;
-    intptr_t iPageSize;
-    
-    /* Safe page size query - make sure it is at least 1K - this is merely for sanity */
-    iPageSize = sysconf( _SC_PAGESIZE );
-    ASSERT( iPageSize >= 1024 );
-    if (iPageSize >= 1024)
+    uint32_t uiSeq = __atomic_load_n( &(pSlot->uiSeq), __ATOMIC_RELAXED );
+
+    __atomic_store_n( &(pSlot->uiSeq), uiSeq + 1, __ATOMIC_RELAXED );
+    __atomic_thread_fence( __ATOMIC_RELEASE );
+    __atomic_store_n( &(pSlot->pNode), NULL, __ATOMIC_RELAXED );
+    __atomic_store_n( &(pSlot->uiExitNs), pu_thread_now_ns_private(), __ATOMIC_RELAXED );
+    __atomic_store_n( &(pSlot->uiSeq), uiSeq + 2, __ATOMIC_RELEASE );
+}
+/* pu_thread_slot_retire */
+
+/* The creator has the Posix ID: index the slot by it. The thread may already have exited */
+static void pu_thread_slot_claim( uint32_t uiSlot, pthread_t pid, bool bOwned )
+{
+    pu_thread_slot_t* pSlot = &(aSlots[uiSlot]);
+
+    pthread_mutex_lock( &mtxIndex );
+    pSlot->pidJoin = pid;
+    pSlot->bOwned  = bOwned;
+    if (0 != pu_hmap_insert( &mapPid, pSlot ))
     {
-        /* Store for posterity.. */
-        uiPageSize = (size_t)iPageSize;
+        /* Cannot happen, the index is sized for a full registry */
+        LOG_ERROR( "PU_THREAD(create):proc=%s, slot %u not indexed\n", szProcName, uiSlot );
+    }
+    pthread_mutex_unlock( &mtxIndex );
+    __atomic_fetch_or( &(pSlot->uiLife), PU_THREAD_LIFE_INDEXED, __ATOMIC_RELEASE );
+}
+/* pu_thread_slot_claim */
 
-        /* Initialise the readers-writers lock */
-        iResult = pthread_rwlock_init( &rwlock, NULL );
-        ASSERT( 0 == iResult );
+/* Slot of a thread that has not been joined yet, O(1). Only then is the Posix ID unique */
+static bool pu_thread_slot_find( pthread_t pid, uint32_t* puiSlot )
+{
+    const pu_thread_slot_t* pSlot;
 
-        /* flood with NULL up to 1 byte PAST the 16 byte count. The name will be up to 16 bytes. It will
-         * only be null terminated if it is less than 16 bytes. We enforce NULL termination
-         * regardless of length
-         */
-        memset( szProcName, 0, 17 );
-        if (0 != prctl( PR_GET_NAME, (unsigned long)szProcName, 0, 0, 0 ))
-        {
-            sprintf( szProcName, "????????");
-        }
+    pthread_mutex_lock( &mtxIndex );
+    pSlot = (const pu_thread_slot_t*)pu_hmap_find( &mapPid, &pid );
+    if (pSlot)
+    {
+        *puiSlot = (uint32_t)(pSlot - aSlots);
     }
-    return (iResult);
+    pthread_mutex_unlock( &mtxIndex );
+    return (NULL != pSlot);
 }
-/* pu_thread_init_private */
+/* pu_thread_slot_find */
 
-/**
- * @brief Closes (exits) the module
- *
- * @retval 0     Success
- * @retval non-0 Error
- *
- * @pre     None
- * @post    Module shuts down
- *
- * @par Description
- * Exits the module, cleans up any resources.
- * Wrapped in the sysutils exit, no init/exit test needed
- */
-int pu_thread_exit_private( void )
+/* Frees the slot of a joined (or detached and exited) thread, O(1) */
+static void pu_thread_slot_reap( uint32_t uiSlot, uint64_t* puiExitNs )
 {
-    int iResult;
+    pu_thread_slot_t* pSlot = &(aSlots[uiSlot]);
 
-    /* Destroy the readers-writers lock */
-    uiPageSize = 0;
-    iResult    = pthread_rwlock_destroy( &rwlock );
-    ASSERT( 0 == iResult );
-    return (iResult);
+    pthread_mutex_lock( &mtxIndex );
+    pu_hmap_remove_entry( &mapPid, pSlot );
+    pSlot->pidJoin = (pthread_t)0;
+    pSlot->bOwned  = false;
+    pthread_mutex_unlock( &mtxIndex );
+    if (puiExitNs)
+    {
+        *puiExitNs = __atomic_load_n( &(pSlot->uiExitNs), __ATOMIC_RELAXED );
+    }
+    pu_thread_slot_write( pSlot, NULL );
+    pu_thread_slot_release( uiSlot );
 }
-/* pu_thread_exit_private */
+/* pu_thread_slot_reap */
 
-/**
- * @brief   Creates a non-RT pthread with the Comet constraints applied
- *
- * @param[in] fctMain     : Thread main function (entry point)
- * @param[in] pMainArg    : Argument for main
- * @param[in] fctExit     : Thread exit handler function
- * @param[in] pExitArg    : Exit handler argument
- * @param[in] uiStackSize : Stack size
- * @param[in] szName      : Thread name
- * @retval  A non-zero pthread ID indicates success
- * @retval  A zero pthread ID means failure
- *
- * @pre     The entry function (main) is non-NULL
- * @pre     The name is non-NULL
- * @post    The pthread is created.
- *
- * @par Description
- * Creates a standard pthread (SCHED_OTHER) with the passed in parameters. The stack size will be
- * rounded up to the nearest multiple of the page size, i.e. (n * 4k).
- *
- * @par Exit handling
- * The are two main ways a thread can exit. It can terminate on its own either by simply coming to
- * the end of the main loop or invoking pthread_exit(). In this case the thread is aware it is going to exit,
- * and will naturally clean up after itself. The second scenario is when the thread is terminated
- * by another thread, i.e. as a result of a call to pthread_cancel(pid). Is this case the exit handler
- * will be invoked. This allows us to do clean up during an on-demand process shutdown.
- *
- * @par Note
- * If there is no need for an exit handler, then simply set the \c fctExit parameter to NULL.
- *
- * @par Note
- * The thread name (szName) \b MUST be persistent and null terminated.. In the code the \b pointer to the
- * name will simply be copied, the string itself will not be copied (i.e. there will be no strcpy call).
- * If you use the provided macros this will not be an issue, as the entry function is string-ised into a
- * constant persistent string.
- */
-pthread_t pu_thread_create(
-    pu_thread_fct_t fctMain,
-    void*           pMainArg,
-    size_t          uiStackSize,
-    const char*     szName )
+/* Lock-free consistent copy of a slot. Returns false if the slot is free (or too busy) */
+static bool pu_thread_slot_read( pu_thread_slot_t* pSlot, pu_thread_info_t* pInfo )
 {
-    pthread_attr_t       attr;
-    int                  iResult = -1;
-    pu_thread_context_t* pNode = NULL;
-    pthread_t            iPid = (pthread_t)0;
+    uint32_t uiSeq1;
+    uint32_t uiSeq2;
+    size_t   uiTry;
+    bool     bUsed;
 
-    /* pre-condition */
-    ASSERT( uiPageSize > 0 );
-    ASSERT( fctMain );
-    ASSERT( szName );
-    ASSERT( uiStackSize <= PU_THREAD_STUPID_STACKSIZE);
-    if ((uiPageSize > 0) && fctMain && szName && (uiStackSize <= PU_THREAD_STUPID_STACKSIZE))
+    for (uiTry = 0; uiTry < PU_THREAD_READ_RETRIES; uiTry++)
     {
-        iResult = pthread_attr_init( &attr );
-        ASSERT( 0 == iResult );
-        if (0 == iResult)
+        uiSeq1 = __atomic_load_n( &(pSlot->uiSeq), __ATOMIC_ACQUIRE );
+        if (uiSeq1 & 1)
         {
-            /* set stack size and guard size */
-            uiStackSize = pu_thread_stacksize_fix( uiStackSize );
-            iResult = pthread_attr_setstacksize( &attr, uiStackSize );
-            ASSERT( 0 == iResult );
-
-            /* GLIBC will by default set the guard size to one page whenever we set the stack size.
-             * uClibC does NOT do this, so we always force the guard size
-             */
-            if (0 == iResult)
-            {
-                iResult = pthread_attr_setguardsize( &attr, uiPageSize );
-                ASSERT( 0 == iResult );
-            }
-            if (0 == iResult)
-            {
-                pNode = (pu_thread_context_t*)malloc( sizeof( pu_thread_context_t ) );
-                ASSERT( NULL != pNode );
-                if (NULL != pNode)
-                {
-                    memset( pNode, 0, sizeof(pu_thread_context_t) );
-                    pNode->fctMain  = fctMain;
-                    pNode->pMainArg = pMainArg;
-
-                    /* simply copy the name pointer. This is constant and persistent,
-                     * it does not need a separate allocation
-                     */
-                    pNode->szName = (char*)szName;
-                    iResult = pthread_create(
-                        &(pNode->pid),
-                        &attr,
-                        pu_thread_entry_handler,
-                        (void*)pNode );
-                    ASSERT( 0 == iResult );
-                    if (0 != iResult)
-                    {
-                        free( pNode );
-                    }
-
-                    /* Store the PID, set the system thread name. This name is 15+null long,
-                     * so will often cause the input name to be truncated. This means the debug name and
-                     * the name in the system may be different.
-                     */
-                    else
-                    {
-                        iPid = pNode->pid;
-                        char szSysName[16];
-                        strncpy( szSysName, szName, 16 );
-                        szSysName[15] = 0;
-                        pthread_setname_np( iPid, szSysName );
-
-                        /* TODO: Find a way around this!!
-                         * At this point we would like to use:
-                         * - pthread_setname_np()
-                         * to set the thread name in the system. but it does not seem
-                         * to work
-                         *
-                         * char szSysName[16];
-                         * strncpy( szSysName, szName, 16 );
-                         * szSysName[15] = 0;
-                         * pthread_setname_np( iPid, szSysName );
-                         */
-                    }
-                }
-            }
-            pthread_attr_destroy( &attr );
+            sched_yield();
+            continue;
+        }
+        bUsed          = (NULL != __atomic_load_n( &(pSlot->pNode), __ATOMIC_RELAXED ));
+        pInfo->szName  = __atomic_load_n( &(pSlot->szName), __ATOMIC_RELAXED );
+        pInfo->pid     = __atomic_load_n( &(pSlot->pid), __ATOMIC_RELAXED );
+        pInfo->tid     = __atomic_load_n( &(pSlot->tid), __ATOMIC_RELAXED );
+        pInfo->uiStartNs = __atomic_load_n( &(pSlot->uiStartNs), __ATOMIC_RELAXED );
+        pInfo->pBlockedOn  = __atomic_load_n( &(pSlot->pBlockedOn), __ATOMIC_RELAXED );
+        pInfo->szBlockedOn = __atomic_load_n( &(pSlot->szBlockedOn), __ATOMIC_RELAXED );
+        pInfo->uiBlockedNs = __atomic_load_n( &(pSlot->uiBlockedNs), __ATOMIC_RELAXED );
+        __atomic_thread_fence( __ATOMIC_ACQUIRE );
+        uiSeq2 = __atomic_load_n( &(pSlot->uiSeq), __ATOMIC_RELAXED );
+        if (uiSeq1 == uiSeq2)
+        {
+            return (bUsed);
         }
     }
-    if (0 == iPid)
+    return (false);
+}
+/* pu_thread_slot_read */
+
+/* Index callbacks, on the creator's copy of the Posix ID and the slot copies of the tid and name */
+static uint32_t pu_thread_pid_hash( const void* pKey )
+{
+    return (pu_hmap_hash_bytes( pKey, sizeof(pthread_t) ));
+}
+/* pu_thread_pid_hash */
+
+static bool pu_thread_pid_equal( const void* pEntry, const void* pKey )
+{
+    return (0 != pthread_equal( ((const pu_thread_slot_t*)pEntry)->pidJoin, *(const pthread_t*)pKey ));
+}
+/* pu_thread_pid_equal */
+
+static const void* pu_thread_pid_key( const void* pEntry )
+{
+    return (&(((const pu_thread_slot_t*)pEntry)->pidJoin));
+}
+/* pu_thread_pid_key */
+
+static uint32_t pu_thread_tid_hash( const void* pKey )
+{
+    uint32_t uiTid = (uint32_t)*(const pid_t*)pKey;
+    return (pu_hmap_hash_u32( &uiTid ));
+}
+/* pu_thread_tid_hash */
+
+static bool pu_thread_tid_equal( const void* pEntry, const void* pKey )
+{
+    return (((const pu_thread_slot_t*)pEntry)->tid == *(const pid_t*)pKey);
+}
+/* pu_thread_tid_equal */
+
+static const void* pu_thread_tid_key( const void* pEntry )
+{
+    return (&(((const pu_thread_slot_t*)pEntry)->tid));
+}
+/* pu_thread_tid_key */
+
+static bool pu_thread_name_equal( const void* pEntry, const void* pKey )
+{
+    const char* szSlotName = ((const pu_thread_slot_t*)pEntry)->szName;
+    return ((szSlotName == (const char*)pKey) || (0 == strcmp( szSlotName, (const char*)pKey )));
+}
+/* pu_thread_name_equal */
+
+static const void* pu_thread_name_key( const void* pEntry )
+{
+    return (((const pu_thread_slot_t*)pEntry)->szName);
+}
+/* pu_thread_name_key */
+
+/* Wakes the owner if it sleeps in pu_thread_receive() */
+static void pu_thread_mailbox_wake( pu_thread_context_t* pNode )
+{
+    __atomic_thread_fence( __ATOMIC_SEQ_CST );
+    if ((0 != __atomic_load_n( &(pNode->mbox.uiSleeping), __ATOMIC_RELAXED )) &&
+        (0 != __atomic_exchange_n( &(pNode->mbox.uiSleeping), 0, __ATOMIC_RELAXED )))
     {
-        LOG_ERROR( "PU_THREAD(create):proc=%s, cannot create %s\n", szProcName, szName );
-        ASSERT(0 != iPid);
+        pu_futex_wake_private( &(pNode->mbox.uiSleeping), 1 );
     }
+}
+/* pu_thread_mailbox_wake */
 
-    /* Done */
-    return (iPid);
+/* The stop token is set: wake the thread wherever a library call may have put it to sleep.
+ * Caller is counted in on the slot (uiPosters), so the context and whatever the hook points at
+ * stay put
+ */
+static void pu_thread_stop_wake( pu_thread_context_t* pNode )
+{
+    void (*fctHook)( void* ) = __atomic_load_n( &(pNode->fctStopHook), __ATOMIC_ACQUIRE );
+
+    pu_thread_mailbox_wake( pNode );
+    if (fctHook)
+    {
+        fctHook( pNode->pStopHookArg );
+    }
 }
-/* pu_thread_create */
+/* pu_thread_stop_wake */
 
-/**
- * @brief Gets the number of threads in the list
- *
- * @return Number of threads in the list
- *
- * @pre       None
- * @post      Number of threads is returned
- * @invariant The list is unchanged
- *
- * @par Description
- * Simple query for number of active threads. This works in both debug and non-debug builds
+/* Sets the stop token of the thread in a slot (pPid NULL: whoever it is) and wakes it. Same
+ * handshake as a post, so it needs no lock. Returns true if the slot held a matching thread
  */
-size_t pu_thread_get_number_of_threads( void )
+static bool pu_thread_slot_stop( pu_thread_slot_t* pSlot, const pthread_t* pPid )
 {
-   return (uiNumThreads);
+    pu_thread_context_t* pNode;
+    bool                 bMatch = false;
+
+    __atomic_fetch_add( &(pSlot->uiPosters), 1, __ATOMIC_SEQ_CST );
+    pNode = __atomic_load_n( &(pSlot->pNode), __ATOMIC_SEQ_CST );
+    if (pNode && ((NULL == pPid) || pthread_equal( pNode->pid, *pPid )))
+    {
+        __atomic_store_n( &(pNode->bStop), true, __ATOMIC_RELEASE );
+        pu_thread_stop_wake( pNode );
+        bMatch = true;
+    }
+    __atomic_fetch_sub( &(pSlot->uiPosters), 1, __ATOMIC_RELEASE );
+    return (bMatch);
 }
-/* pu_thread_get_number_of_threads */
+/* pu_thread_slot_stop */
+
+/* The thread is exiting and no post is in progress: release what nobody will receive */
+static void pu_thread_mailbox_drain( pu_thread_context_t* pNode )
+{
+    pu_msg_t* pMsg;
+    size_t    uiDropped = 0;
 
+    while (NULL != (pMsg = (pu_msg_t*)pu_mpsc_pop( &(pNode->mbox.queue) )))
+    {
+        uiDropped++;
+        if (pMsg->fctRelease)
+        {
+            pMsg->fctRelease( pMsg );
+        }
+    }
+    if (0 != uiDropped)
+    {
+        LOG_TRACE( "PU_THREAD(exit):proc=%s, thrd=%s, %zu messages not received\n", szProcName, pNode->szName, uiDropped );
+    }
+}
+/* pu_thread_mailbox_drain */
+
+/* Scheduling and affinity part of the attributes, the stack is handled by the caller */
+static int pu_thread_attr_apply( pthread_attr_t* pAttr, const pu_thread_attr_t* pPuAttr )
+{
+    struct sched_param param;
+    cpu_set_t          cpuSet;
+    unsigned int       uiCpu;
+    int                iResult;
+
+    if (pPuAttr->bInheritSched)
+    {
+        iResult = pthread_attr_setinheritsched( pAttr, PTHREAD_INHERIT_SCHED );
+    }
+    else
+    {
+        memset( &param, 0, sizeof(param) );
+        param.sched_priority = pPuAttr->iPriority;
+        iResult = pthread_attr_setinheritsched( pAttr, PTHREAD_EXPLICIT_SCHED );
+        if (0 == iResult)
+        {
+            iResult = pthread_attr_setschedpolicy( pAttr, pPuAttr->iPolicy );
+        }
+        if (0 == iResult)
+        {
+            iResult = pthread_attr_setschedparam( pAttr, &param );
+        }
+    }
+    if ((0 == iResult) && (0 != pPuAttr->uiCpuMask))
+    {
+        CPU_ZERO( &cpuSet );
+        for (uiCpu = 0; uiCpu < 32; uiCpu++)
+        {
+            if (pPuAttr->uiCpuMask & (1u << uiCpu))
+            {
+                CPU_SET( uiCpu, &cpuSet );
+            }
+        }
+        iResult = pthread_attr_setaffinity_np( pAttr, sizeof(cpuSet), &cpuSet );
+    }
+    return (iResult);
+}
+/* pu_thread_attr_apply */
+
+/* Builds the pthread attributes. pStack is a cached stack, or NULL for a glibc allocated one.
+ * The attributes are destroyed again on failure.
+ */
+static int pu_thread_attr_build( pthread_attr_t* pAttr, const pu_thread_attr_t* pPuAttr, void* pStack, size_t uiStackSize )
+{
+    int iResult;
+
+    iResult = pthread_attr_init( pAttr );
+    ASSERT( 0 == iResult );
+    if (0 != iResult)
+    {
+        return (iResult);
+    }
+
+    /* A cached stack is already guarded and pre-faulted */
+    if (pStack)
+    {
+        iResult = pthread_attr_setstack( pAttr, pStack, uiStackSize );
+        ASSERT( 0 == iResult );
+    }
+    else
+    {
+        iResult = pthread_attr_setstacksize( pAttr, uiStackSize );
+        ASSERT( 0 == iResult );
+
+        /* GLIBC will by default set the guard size to one page whenever we set the stack size.
+         * uClibC does NOT do this, so we always force the guard size
+         */
+        if (0 == iResult)
+        {
+            iResult = pthread_attr_setguardsize( pAttr, uiPageSize );
+            ASSERT( 0 == iResult );
+        }
+    }
+    if (0 == iResult)
+    {
+        iResult = pu_thread_attr_apply( pAttr, pPuAttr );
+        ASSERT( 0 == iResult );
+    }
+    if (0 != iResult)
+    {
+        pthread_attr_destroy( pAttr );
+    }
+    return (iResult);
+}
+/* pu_thread_attr_build */
+
+/* Gets a context from the cache and fills it in, apart from the slot */
+static pu_thread_context_t* pu_thread_context_new(
+    pu_thread_fct_t         fctMain,
+    void*                   pMainArg,
+    const pu_thread_attr_t* pPuAttr,
+    const char*             szName )
+{
+    pu_thread_context_t* pNode = (pu_thread_context_t*)pu_cache_context_get();
+
+    ASSERT( NULL != pNode );
+    if (NULL != pNode)
+    {
+        memset( pNode, 0, sizeof(pu_thread_context_t) );
+        pNode->fctMain   = fctMain;
+        pNode->pMainArg  = pMainArg;
+        pNode->bMlock    = pPuAttr->bMlock;
+        pNode->bPrefault = pPuAttr->bPrefault;
+        pNode->bOwned    = pPuAttr->bOwned;
+        pu_mpsc_init( &(pNode->mbox.queue) );
+
+        /* simply copy the name pointer. This is constant and persistent,
+         * it does not need a separate allocation
+         */
+        pNode->szName = (char*)szName;
+    }
+    return (pNode);
+}
+/* pu_thread_context_new */
+
+/* Creates the pthread for a filled in context (slot reserved) and indexes the slot by its ID.
+ * pStack is the cached stack in pAttr, NULL for a glibc one; the slot remembers it for the join.
+ * The ID goes to the caller, the node belongs to the new thread from here on.
+ */
+static int pu_thread_spawn( pthread_attr_t* pAttr, pu_thread_context_t* pNode, void* pStack, size_t uiStackSize, pthread_t* pPid )
+{
+    uint32_t uiSlot = pNode->uiSlot;
+    bool     bOwned = pNode->bOwned;
+    char     szSysName[16];
+    int      iResult;
+
+    /* Everything we need from the node, it is off limits once the thread runs */
+    strncpy( szSysName, pNode->szName, 16 );
+    szSysName[15] = 0;
+    __atomic_store_n( &(aSlots[uiSlot].uiLife), 0, __ATOMIC_RELAXED );
+    aSlots[uiSlot].pCacheStack      = pStack;
+    aSlots[uiSlot].uiCacheStackSize = uiStackSize;
+    iResult = pthread_create(
+        pPid,
+        pAttr,
+        pu_thread_entry_handler,
+        (void*)pNode );
+    ASSERT( (0 == iResult) || (EPERM == iResult) );
+
+    /* Set the system thread name. This name is 15+null long, so will often cause the input name
+     * to be truncated. This means the debug name and the name in the system may be different.
+     */
+    if (0 == iResult)
+    {
+        pu_thread_slot_claim( uiSlot, *pPid, bOwned );
+        pthread_setname_np( *pPid, szSysName );
+    }
+    return (iResult);
+}
+/* pu_thread_spawn */
+
+/* Drops a reference to a start gate, the last one frees it */
+static void pu_thread_gate_put( pu_thread_gate_t* pGate )
+{
+    if (1 == __atomic_fetch_sub( &(pGate->uiRefs), 1, __ATOMIC_ACQ_REL ))
+    {
+        pthread_cond_destroy( &(pGate->cndGate) );
+        pthread_mutex_destroy( &(pGate->mtxGate) );
+        free( pGate );
+    }
+}
+/* pu_thread_gate_put */
+
+/* Waits until the creator opens the gate. The caller has cancellation disabled */
+static void pu_thread_gate_wait( pu_thread_gate_t* pGate )
+{
+    pthread_mutex_lock( &(pGate->mtxGate) );
+    while (!pGate->bOpen)
+    {
+        pthread_cond_wait( &(pGate->cndGate), &(pGate->mtxGate) );
+    }
+    pthread_mutex_unlock( &(pGate->mtxGate) );
+    pu_thread_gate_put( pGate );
+}
+/* pu_thread_gate_wait */
+
+/* Joins, with an absolute (CLOCK_REALTIME) deadline or forever (NULL). Frees the registry slot,
+ * recycles a cached stack
+ */
+static int pu_thread_join_until( pthread_t pid, void** ppRet, const struct timespec* pDeadline, uint64_t* puiExitNs )
+{
+    uint32_t uiSlot = 0;
+    bool     bSlot;
+    int      iResult;
+
+    /* Find the slot before the join, once joined the ID can be handed out again */
+    bSlot = pu_thread_slot_find( pid, &uiSlot );
+    if (pDeadline)
+    {
+        iResult = pthread_timedjoin_np( pid, ppRet, pDeadline );
+    }
+    else
+    {
+        iResult = pthread_join( pid, ppRet );
+    }
+    if ((0 == iResult) && bSlot)
+    {
+        pu_cache_stack_put( aSlots[uiSlot].pCacheStack, aSlots[uiSlot].uiCacheStackSize );
+        pu_thread_slot_reap( uiSlot, puiExitNs );
+    }
+    return (iResult);
+}
+/* pu_thread_join_until */
+
+/* Absolute CLOCK_REALTIME deadline, as pthread_timedjoin_np() wants */
+static void pu_thread_deadline( struct timespec* pDeadline, uint32_t uiTimeoutMs )
+{
+    clock_gettime( CLOCK_REALTIME, pDeadline );
+    pDeadline->tv_sec  += (time_t)(uiTimeoutMs / 1000);
+    pDeadline->tv_nsec += (long)(uiTimeoutMs % 1000) * 1000000L;
+    if (pDeadline->tv_nsec >= 1000000000L)
+    {
+        pDeadline->tv_nsec -= 1000000000L;
+        pDeadline->tv_sec++;
+    }
+}
+/* pu_thread_deadline */
+
+/* Registry snapshot for the join-all: every thread not joined yet (starting, running or
+ * exited), but not the caller, the owned and the detached ones. The arrays have
+ * PU_THREAD_MAX_THREADS entries, the registry cannot hold more
+ */
+static size_t pu_thread_collect( pu_thread_stop_t* aStop, uint32_t* auiSlots )
+{
+    pu_thread_slot_t* pSlot;
+    pu_thread_info_t  info;
+    size_t            uiHigh  = __atomic_load_n( &uiSlotHigh, __ATOMIC_ACQUIRE );
+    size_t            uiCount = 0;
+    size_t            i;
+
+    /* Joins (reap) take the index lock, so an indexed slot stays put here. A running thread may
+     * exit meanwhile, it is joined all the same
+     */
+    pthread_mutex_lock( &mtxIndex );
+    for (i = 0; i < uiHigh; i++)
+    {
+        pSlot = &(aSlots[i]);
+        if ((0 != pSlot->pidJoin) && !pthread_equal( pSlot->pidJoin, pthread_self() ) && !pSlot->bOwned &&
+            !(PU_THREAD_LIFE_DETACHED & __atomic_load_n( &(pSlot->uiLife), __ATOMIC_ACQUIRE )))
+        {
+            memset( &info, 0, sizeof(info) );
+            pu_thread_slot_read( pSlot, &info );
+            aStop[uiCount].szName = info.szName ? info.szName : "(starting)";
+            aStop[uiCount].pid    = pSlot->pidJoin;
+            aStop[uiCount].tid    = info.tid;
+            auiSlots[uiCount]     = (uint32_t)i;
+            uiCount++;
+        }
+    }
+    pthread_mutex_unlock( &mtxIndex );
+    return (uiCount);
+}
+/* pu_thread_collect */
+
+/* Locks and/or faults in the stack of the calling thread, so an RT loop never takes a page fault */
+static void pu_thread_stack_prepare( pu_thread_context_t* pNode )
+{
+    pthread_attr_t     attr;
+    void*              pStack;
+    size_t             uiSize;
+    volatile uint8_t*  pByte;
+    uint8_t            uiHere;
+
+    if (0 != pthread_getattr_np( pthread_self(), &attr ))
+    {
+        return;
+    }
+    pthread_attr_getstack( &attr, &pStack, &uiSize );
+    pthread_attr_destroy( &attr );
+
+    /* Write a byte per page from the bottom of the stack up to (just below) this frame */
+    if (pNode->bPrefault)
+    {
+        for (pByte = (volatile uint8_t*)pStack;
+             pByte < (&uiHere - uiPageSize);
+             pByte += uiPageSize)
+        {
+            *pByte = 0;
+        }
+    }
+    if (pNode->bMlock && (0 != mlock( pStack, uiSize )))
+    {
+        LOG_ERROR( "PU_THREAD(create):proc=%s, thrd=%s, cannot mlock stack (%d)\n", szProcName, pNode->szName, errno );
+    }
+}
+/* pu_thread_stack_prepare */
+
+static void* pu_thread_entry_handler( void* pArg )
+{
+    pu_thread_context_t* pNode = (pu_thread_context_t*)pArg;
+    void*                pReturn;
+    int                  iCancelState;
+
+    /* No cancellation until the exit handler is in place, it undoes everything below. A cancel
+     * that comes in meanwhile is acted upon at the first cancellation point in main
+     */
+    pthread_setcancelstate( PTHREAD_CANCEL_DISABLE, &iCancelState );
+
+    /* Get the system thread ID. The Posix ID is also taken here, the creator must not touch
+     * the node after pthread_create(), we may already have exited and freed it.
+     */
+    pNode->tid = (pid_t)syscall( SYS_gettid );
+    pNode->pid = pthread_self();
+    pNode->uiStartNs = pu_thread_now_ns_private();
+    pSelfThread = pNode;
+
+    /* Trace thread creation */
+    LOG_TRACE(
+        "PU_THREAD(create):proc=%s, thrd=%s, tid=%d\n",
+        szProcName,
+        pNode->szName,
+        (int)pNode->tid );
+
+    /* RT threads want their stack resident before they start */
+    if (pNode->bMlock || pNode->bPrefault)
+    {
+        pu_thread_stack_prepare( pNode );
+    }
+
+    /* Stack profiling, paints the rest of the stack if enabled */
+    pu_stack_paint_private();
+
+    /* Publish in the slot the creator reserved for us, no lock needed. The lookup indices are
+     * shared, they have a lock of their own
+     */
+    pu_thread_slot_write( &(aSlots[pNode->uiSlot]), pNode );
+    pthread_mutex_lock( &mtxIndex );
+    if ((0 != pu_hmap_insert( &mapTid, &(aSlots[pNode->uiSlot]) )) ||
+        (0 != pu_hmap_insert( &mapName, &(aSlots[pNode->uiSlot]) )))
+    {
+        /* Cannot happen, the indices are sized for a full registry */
+        LOG_ERROR( "PU_THREAD(create):proc=%s, thrd=%s not indexed\n", szProcName, pNode->szName );
+    }
+    pthread_mutex_unlock( &mtxIndex );
+
+    /* A stop request that came before we were in the slot was left there */
+    __atomic_thread_fence( __ATOMIC_SEQ_CST );
+    if (PU_THREAD_LIFE_STOP & __atomic_load_n( &(aSlots[pNode->uiSlot].uiLife), __ATOMIC_RELAXED ))
+    {
+        __atomic_store_n( &(pNode->bStop), true, __ATOMIC_RELEASE );
+    }
+    __atomic_fetch_add( &uiNumThreads, 1, __ATOMIC_RELAXED );
+
+    /* Batch created threads all start together */
+    if (pNode->pGate)
+    {
+        pu_thread_gate_wait( pNode->pGate );
+        pNode->pGate = NULL;
+    }
+
+    /* register the exist handler */
+    pthread_cleanup_push( pu_thread_exit_handler, pNode );
+    pthread_setcancelstate( iCancelState, NULL );
+
+    /* Thread real main entry */  
+    pReturn = pNode->fctMain( pNode->pMainArg );
+    pthread_cleanup_pop( 1 );
+    
+    /* pass back the actual thread return value */
+    return (pReturn);
+}
+/* pu_thread_entry_handler */
+
+static void pu_thread_exit_handler( void* pArg )
+{
+    pu_thread_context_t* pNode  = (pu_thread_context_t*)pArg;
+    uint32_t             uiSlot = pNode->uiSlot;
+    ASSERT( pNode );
+    ASSERT( uiNumThreads > 0 );
+
+    pSelfThread = NULL;
+
+    /* Record the stack high water mark (if painted) */
+    pu_stack_measure_private( pNode->szName );
+
+    /* Whatever the thread left in its arena goes with it */
+    pu_arena_thread_exit_private();
+
+    /* Out of the indices, then retire the slot (it is freed by the join, or below if detached) */
+    pthread_mutex_lock( &mtxIndex );
+    pu_hmap_remove_entry( &mapTid, &(aSlots[pNode->uiSlot]) );
+    pu_hmap_remove_entry( &mapName, &(aSlots[pNode->uiSlot]) );
+    pthread_mutex_unlock( &mtxIndex );
+    pu_thread_slot_retire( &(aSlots[pNode->uiSlot]) );
+    __atomic_fetch_sub( &uiNumThreads, 1, __ATOMIC_RELAXED );
+
+    /* Posts and stop requests do not take a lock. They count themselves in, then check the slot;
+     * we cleared the slot, so after the fence any of them still in progress is counted. Wait for
+     * those, then nobody can reach the context any more
+     */
+    __atomic_thread_fence( __ATOMIC_SEQ_CST );
+    while (0 != __atomic_load_n( &(aSlots[pNode->uiSlot].uiPosters), __ATOMIC_ACQUIRE ))
+    {
+        sched_yield();
+    }
+    pu_thread_mailbox_drain( pNode );
+    pu_cache_context_put( pNode );
+    pNode = NULL;
+
+    /* Detached: nobody is going to join us, the slot is ours to free. Otherwise a later
+     * pu_thread_detach() sees the exit and frees it
+     */
+    if (PU_THREAD_LIFE_DETACHED & __atomic_fetch_or( &(aSlots[uiSlot].uiLife), PU_THREAD_LIFE_EXITED, __ATOMIC_ACQ_REL ))
+    {
+        /* We may have detached ourselves before the creator got round to indexing us */
+        while (!(PU_THREAD_LIFE_INDEXED & __atomic_load_n( &(aSlots[uiSlot].uiLife), __ATOMIC_ACQUIRE )))
+        {
+            sched_yield();
+        }
+        pu_thread_slot_reap( uiSlot, NULL );
+    }
+}
+/* pu_thread_exit_handler */
+
+/****************************************************************************/
+/* PUBLIC FUNCTION DEFINITIONS                                              */
+/****************************************************************************/
+
+/**
+ * @brief Initialises the module
+ *
+ * @retval 0     Success
+ * @retval non-0 Error
+ *
+ * @pre     None
+ * @post    Module is initialised
+ *
+ * @par Description
+ * Initialises the module. Creates any resources needed.
+ * Wrapped in the init, no init/exit test needed
+ */
+int pu_thread_init_private( void )
+{
+    int      iResult = -1;
+    intptr_t iPageSize;
+    uint32_t i;
+    
+    /* Safe page size query - make sure it is at least 1K - this is merely for sanity */
+    iPageSize = sysconf( _SC_PAGESIZE );
+    ASSERT( iPageSize >= 1024 );
+    if (iPageSize >= 1024)
+    {
+        /* Store for posterity.. */
+        uiPageSize = (size_t)iPageSize;
+
+        /* Initialise the registry, every slot free. Lowest index on top of the stack. The
+         * registry lock only covers the free stack, the indices have a lock of their own
+         */
+        iResult = pu_mutex_create_type( &mtxSlots, PU_MUTEX_TYPE_FAST );
+        ASSERT( 0 == iResult );
+        if (0 == iResult)
+        {
+            iResult = pu_mutex_create_type( &mtxIndex, PU_MUTEX_TYPE_FAST );
+        }
+        if (0 == iResult)
+        {
+            iResult = pu_hmap_init( &mapPid, &opsPid, PU_THREAD_MAX_THREADS );
+        }
+        if (0 == iResult)
+        {
+            iResult = pu_hmap_init( &mapTid, &opsTid, PU_THREAD_MAX_THREADS );
+        }
+        if (0 == iResult)
+        {
+            iResult = pu_hmap_init( &mapName, &opsName, PU_THREAD_MAX_THREADS );
+        }
+        ASSERT( 0 == iResult );
+        memset( aSlots, 0, sizeof(aSlots) );
+        for (i = 0; i < PU_THREAD_MAX_THREADS; i++)
+        {
+            aFreeSlots[i] = (PU_THREAD_MAX_THREADS - 1) - i;
+        }
+        uiNumFree  = PU_THREAD_MAX_THREADS;
+        uiSlotHigh = 0;
+        bStopAll   = false;
+
+        /* flood with NULL up to 1 byte PAST the 16 byte count. The name will be up to 16 bytes. It will
+         * only be null terminated if it is less than 16 bytes. We enforce NULL termination
+         * regardless of length
+         */
+        memset( szProcName, 0, 17 );
+        if (0 != prctl( PR_GET_NAME, (unsigned long)szProcName, 0, 0, 0 ))
+        {
+            sprintf( szProcName, "????????");
+        }
+    }
+    return (iResult);
+}
+/* pu_thread_init_private */
+
+/**
+ * @brief CLOCK_MONOTONIC in nanoseconds
+ *
+ * @return Time in ns
+ */
+uint64_t pu_thread_now_ns_private( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (((uint64_t)ts.tv_sec * 1000000000ull) + (uint64_t)ts.tv_nsec);
+}
+/* pu_thread_now_ns_private */
+
+/**
+ * @brief Records (pObj != NULL) or clears what the calling thread is about to sleep on
+ *
+ * @param[in] pObj   : The futex object, NULL when the thread is awake again
+ * @param[in] szKind : Object kind (persistent string)
+ *
+ * @par Description
+ * Only the owning thread writes its slot while it runs, so the sequence count is enough. A
+ * thread that is not a pu_thread is not in the registry and records nothing.
+ */
+void pu_thread_blocked_private( const void* pObj, const char* szKind )
+{
+    pu_thread_context_t* pNode = pSelfThread;
+    pu_thread_slot_t*    pSlot;
+    uint32_t             uiSeq;
+
+    if (NULL != pNode)
+    {
+        pSlot = &(aSlots[pNode->uiSlot]);
+        uiSeq = __atomic_load_n( &(pSlot->uiSeq), __ATOMIC_RELAXED );
+        __atomic_store_n( &(pSlot->uiSeq), uiSeq + 1, __ATOMIC_RELAXED );
+        __atomic_thread_fence( __ATOMIC_RELEASE );
+        __atomic_store_n( &(pSlot->pBlockedOn), pObj, __ATOMIC_RELAXED );
+        __atomic_store_n( &(pSlot->szBlockedOn), szKind, __ATOMIC_RELAXED );
+        __atomic_store_n( &(pSlot->uiBlockedNs), (pObj ? pu_thread_now_ns_private() : 0), __ATOMIC_RELAXED );
+        __atomic_store_n( &(pSlot->uiSeq), uiSeq + 2, __ATOMIC_RELEASE );
+    }
+}
+/* pu_thread_blocked_private */
+
+/**
+ * @brief Sets what wakes the calling thread when it is asked to stop
+ *
+ * @param[in] fctHook : Called by the requester, NULL for none
+ * @param[in] pArg    : Hook argument
+ *
+ * @par Description
+ * For library code that sleeps on something other than the mailbox (e.g. a pool worker on its
+ * condition variable). The hook runs in the requesting thread, and holds up the exit of the
+ * thread while it runs, so it must be short and must not create, join or stop threads. It stays
+ * set until the thread exits, the object it points at must outlive the thread.
+ */
+void pu_thread_stop_hook_private( void (*fctHook)( void* ), void* pArg )
+{
+    pu_thread_context_t* pNode = pSelfThread;
+
+    if (NULL != pNode)
+    {
+        pNode->pStopHookArg = pArg;
+        __atomic_store_n( &(pNode->fctStopHook), fctHook, __ATOMIC_RELEASE );
+    }
+}
+/* pu_thread_stop_hook_private */
+
+/**
+ * @brief Size of a thread context, the cache hands out blocks of this size
+ *
+ * @return Size in bytes
+ */
+size_t pu_thread_context_size_private( void )
+{
+    return (sizeof(pu_thread_context_t));
+}
+/* pu_thread_context_size_private */
+
+/**
+ * @brief Closes (exits) the module
+ *
+ * @retval 0     Success
+ * @retval non-0 Error
+ *
+ * @pre     None
+ * @post    Module shuts down
+ *
+ * @par Description
+ * Exits the module, cleans up any resources.
+ * Wrapped in the sysutils exit, no init/exit test needed
+ */
+int pu_thread_exit_private( void )
+{
+    int iResult;
+
+    /* Threads still running (or not joined) would touch the registry on their way out */
+    if (uiNumFree < PU_THREAD_MAX_THREADS)
+    {
+        LOG_ERROR( "PU_THREAD(exit):proc=%s, %zu threads not joined\n", szProcName, PU_THREAD_MAX_THREADS - uiNumFree );
+        return (EBUSY);
+    }
+
+    /* Destroy the indices and the locks */
+    pu_hmap_destroy( &mapPid );
+    pu_hmap_destroy( &mapTid );
+    pu_hmap_destroy( &mapName );
+    pthread_mutex_destroy( &mtxIndex );
+    uiPageSize = 0;
+    iResult    = pthread_mutex_destroy( &mtxSlots );
+    ASSERT( 0 == iResult );
+    return (iResult);
+}
+/* pu_thread_exit_private */
+
+/**
+ * @brief   Number of registry slots in use, every thread counts (owned and detached too)
+ *
+ * @return  Threads created and not yet joined (or, if detached, not yet exited)
+ */
+size_t pu_thread_count_private( void )
+{
+    size_t uiUsed;
+
+    pthread_mutex_lock( &mtxSlots );
+    uiUsed = PU_THREAD_MAX_THREADS - uiNumFree;
+    pthread_mutex_unlock( &mtxSlots );
+    return (uiUsed);
+}
+/* pu_thread_count_private */
+
+/**
+ * @brief   Sets thread attributes to the defaults, i.e. what \ref pu_thread_create does
+ *
+ * @param[out] pAttr : Attributes to initialise
+ */
+void pu_thread_attr_init( pu_thread_attr_t* pAttr )
+{
+    ASSERT( pAttr );
+    if (pAttr)
+    {
+        memset( pAttr, 0, sizeof(pu_thread_attr_t) );
+        pAttr->iPolicy = SCHED_OTHER;
+    }
+}
+/* pu_thread_attr_init */
+
+/**
+ * @brief   Creates a pthread with explicit attributes (policy, priority, affinity, ...)
+ *
+ * @param[in] fctMain  : Thread main function (entry point)
+ * @param[in] pMainArg : Argument for main
+ * @param[in] pAttr    : Thread attributes
+ * @param[in] szName   : Thread name
+ * @retval  A non-zero pthread ID indicates success
+ * @retval  A zero pthread ID means failure
+ *
+ * @par Description
+ * The common creation path, \ref pu_thread_create is this call with default attributes.
+ */
+pthread_t pu_thread_create_attr(
+    pu_thread_fct_t         fctMain,
+    void*                   pMainArg,
+    const pu_thread_attr_t* pAttr,
+    const char*             szName )
+{
+    pthread_attr_t       attr;
+    int                  iResult = -1;
+    pu_thread_context_t* pNode = NULL;
+    pthread_t            iPid = (pthread_t)0;
+    pthread_t            iNewPid;
+    void*                pStack = NULL;
+    size_t               uiStackSize;
+
+    /* pre-condition */
+    ASSERT( uiPageSize > 0 );
+    ASSERT( fctMain );
+    ASSERT( szName );
+    ASSERT( pAttr );
+    ASSERT( pAttr && (pAttr->uiStackSize <= PU_THREAD_STUPID_STACKSIZE) );
+    if ((uiPageSize > 0) && fctMain && szName && pAttr && (pAttr->uiStackSize <= PU_THREAD_STUPID_STACKSIZE))
+    {
+        /* set stack size and guard size */
+        uiStackSize = pu_thread_stacksize_fix( pu_stack_tune_private( szName, pAttr->uiStackSize ) );
+        pStack      = pu_cache_stack_get( uiStackSize );
+        iResult     = pu_thread_attr_build( &attr, pAttr, pStack, uiStackSize );
+        if (0 == iResult)
+        {
+            pNode = pu_thread_context_new( fctMain, pMainArg, pAttr, szName );
+            if (NULL == pNode)
+            {
+                iResult = ENOMEM;
+            }
+
+            /* Reserve the registry slot up front, the creator gets to hear about a full registry */
+            else if (!pu_thread_slot_reserve( &(pNode->uiSlot) ))
+            {
+                LOG_ERROR( "PU_THREAD(create):proc=%s, registry full (%d)\n", szProcName, PU_THREAD_MAX_THREADS );
+                pu_cache_context_put( pNode );
+                iResult = EAGAIN;
+            }
+            else
+            {
+                iResult = pu_thread_spawn( &attr, pNode, pStack, uiStackSize, &iNewPid );
+                if (0 == iResult)
+                {
+                    iPid = iNewPid;
+                }
+                else
+                {
+                    pu_thread_slot_release( pNode->uiSlot );
+                    pu_cache_context_put( pNode );
+                }
+            }
+            pthread_attr_destroy( &attr );
+        }
+        if ((0 == iPid) && pStack)
+        {
+            pu_cache_stack_put( pStack, uiStackSize );
+        }
+    }
+    /* Not being allowed an RT policy is an expected (not a coding) error */
+    if (0 == iPid)
+    {
+        LOG_ERROR( "PU_THREAD(create):proc=%s, cannot create %s (%d)\n", szProcName, szName, iResult );
+        ASSERT( (0 != iPid) || (EPERM == iResult) );
+    }
+
+    /* Done */
+    return (iPid);
+}
+/* pu_thread_create_attr */
+
+/**
+ * @brief   Creates a batch of identical pthreads, optionally starting them together
+ *
+ * @param[in]  fctMain       : Thread main function (entry point)
+ * @param[in]  apMainArgs    : One argument per thread, NULL passes NULL to all of them
+ * @param[in]  uiCount       : Number of threads
+ * @param[in]  pAttr         : Thread attributes (shared)
+ * @param[in]  szName        : Thread name (shared)
+ * @param[in]  bStartBarrier : Hold every thread back until all of them are created
+ * @param[out] aPids         : uiCount Posix thread IDs, zero for the ones not created
+ * @return  Number of threads created, they are at the front of aPids
+ *
+ * @par Description
+ * The pthread attributes are built once (twice at most, if some stacks come from the cache and
+ * some do not) and all registry slots are reserved with a single lock acquisition. Creation
+ * stops at the first failure.
+ */
+size_t pu_thread_create_many(
+    pu_thread_fct_t         fctMain,
+    void* const*            apMainArgs,
+    size_t                  uiCount,
+    const pu_thread_attr_t* pAttr,
+    const char*             szName,
+    bool                    bStartBarrier,
+    pthread_t*              aPids )
+{
+    uint32_t             auiSlots[PU_THREAD_MAX_THREADS];
+    pthread_attr_t       attrGlibc;
+    pthread_attr_t       attrCached;
+    bool                 bGlibc   = false;
+    bool                 bCached  = false;
+    pu_thread_gate_t*    pGate    = NULL;
+    pu_thread_context_t* pNode;
+    void*                pStack;
+    size_t               uiStackSize;
+    size_t               uiCreated = 0;
+    int                  iResult   = EINVAL;
+
+    /* pre-condition */
+    ASSERT( uiPageSize > 0 );
+    ASSERT( fctMain );
+    ASSERT( szName );
+    ASSERT( pAttr );
+    ASSERT( aPids );
+    ASSERT( uiCount <= PU_THREAD_MAX_THREADS );
+    ASSERT( pAttr && (pAttr->uiStackSize <= PU_THREAD_STUPID_STACKSIZE) );
+    if ((0 == uiPageSize) || !fctMain || !szName || !pAttr || !aPids || (0 == uiCount) ||
+        (uiCount > PU_THREAD_MAX_THREADS) || (pAttr->uiStackSize > PU_THREAD_STUPID_STACKSIZE))
+    {
+        return (0);
+    }
+    memset( aPids, 0, uiCount * sizeof(pthread_t) );
+
+    /* All the slots in one critical section */
+    if (!pu_thread_slot_reserve_many( auiSlots, uiCount ))
+    {
+        LOG_ERROR( "PU_THREAD(create):proc=%s, registry full (%d)\n", szProcName, PU_THREAD_MAX_THREADS );
+        return (0);
+    }
+    if (bStartBarrier)
+    {
+        pGate = (pu_thread_gate_t*)malloc( sizeof(pu_thread_gate_t) );
+        ASSERT( pGate );
+        if (NULL == pGate)
+        {
+            pu_thread_slot_release_many( auiSlots, uiCount );
+            return (0);
+        }
+        pu_mutex_create_type( &(pGate->mtxGate), PU_MUTEX_TYPE_FAST );
+        pthread_cond_init( &(pGate->cndGate), NULL );
+        pGate->bOpen  = false;
+        pGate->uiRefs = 1;
+    }
+
+    uiStackSize = pu_thread_stacksize_fix( pu_stack_tune_private( szName, pAttr->uiStackSize ) );
+    for (uiCreated = 0; uiCreated < uiCount; uiCreated++)
+    {
+        /* Cached stacks share one attribute object (the stack is swapped in), glibc ones another */
+        pStack  = pu_cache_stack_get( uiStackSize );
+        iResult = 0;
+        if (pStack && bCached)
+        {
+            iResult = pthread_attr_setstack( &attrCached, pStack, uiStackSize );
+        }
+        else if (pStack)
+        {
+            iResult = pu_thread_attr_build( &attrCached, pAttr, pStack, uiStackSize );
+            bCached = (0 == iResult);
+        }
+        else if (!bGlibc)
+        {
+            iResult = pu_thread_attr_build( &attrGlibc, pAttr, NULL, uiStackSize );
+            bGlibc  = (0 == iResult);
+        }
+
+        pNode = NULL;
+        if (0 == iResult)
+        {
+            pNode   = pu_thread_context_new( fctMain, (apMainArgs ? apMainArgs[uiCreated] : NULL), pAttr, szName );
+            iResult = pNode ? 0 : ENOMEM;
+        }
+        if (0 == iResult)
+        {
+            pNode->uiSlot = auiSlots[uiCreated];
+            pNode->pGate  = pGate;
+            if (pGate)
+            {
+                __atomic_fetch_add( &(pGate->uiRefs), 1, __ATOMIC_RELAXED );
+            }
+            iResult = pu_thread_spawn( (pStack ? &attrCached : &attrGlibc), pNode, pStack, uiStackSize, &(aPids[uiCreated]) );
+            if (0 != iResult)
+            {
+                aPids[uiCreated] = (pthread_t)0;
+                if (pGate)
+                {
+                    __atomic_fetch_sub( &(pGate->uiRefs), 1, __ATOMIC_RELAXED );
+                }
+                pu_cache_context_put( pNode );
+            }
+        }
+        if (0 != iResult)
+        {
+            if (pStack)
+            {
+                pu_cache_stack_put( pStack, uiStackSize );
+            }
+            break;
+        }
+    }
+
+    /* Unused slots go back in one go, then everyone is let go at once */
+    if (uiCreated < uiCount)
+    {
+        LOG_ERROR( "PU_THREAD(create):proc=%s, created %zu of %zu %s (%d)\n", szProcName, uiCreated, uiCount, szName, iResult );
+        pu_thread_slot_release_many( &(auiSlots[uiCreated]), uiCount - uiCreated );
+    }
+    if (pGate)
+    {
+        pthread_mutex_lock( &(pGate->mtxGate) );
+        pGate->bOpen = true;
+        pthread_cond_broadcast( &(pGate->cndGate) );
+        pthread_mutex_unlock( &(pGate->mtxGate) );
+        pu_thread_gate_put( pGate );
+    }
+    if (bCached)
+    {
+        pthread_attr_destroy( &attrCached );
+    }
+    if (bGlibc)
+    {
+        pthread_attr_destroy( &attrGlibc );
+    }
+    return (uiCreated);
+}
+/* pu_thread_create_many */
+
+/**
+ * @brief   Creates a non-RT pthread with the Comet constraints applied
+ *
+ * @param[in] fctMain     : Thread main function (entry point)
+ * @param[in] pMainArg    : Argument for main
+ * @param[in] fctExit     : Thread exit handler function
+ * @param[in] pExitArg    : Exit handler argument
+ * @param[in] uiStackSize : Stack size
+ * @param[in] szName      : Thread name
+ * @retval  A non-zero pthread ID indicates success
+ * @retval  A zero pthread ID means failure
+ *
+ * @pre     The entry function (main) is non-NULL
+ * @pre     The name is non-NULL
+ * @post    The pthread is created.
+ *
+ * @par Description
+ * Creates a standard pthread (SCHED_OTHER) with the passed in parameters. The stack size will be
+ * rounded up to the nearest multiple of the page size, i.e. (n * 4k).
+ *
+ * @par Exit handling
+ * The are two main ways a thread can exit. It can terminate on its own either by simply coming to
+ * the end of the main loop or invoking pthread_exit(). In this case the thread is aware it is going to exit,
+ * and will naturally clean up after itself. The second scenario is when the thread is terminated
+ * by another thread, i.e. as a result of a call to pthread_cancel(pid). Is this case the exit handler
+ * will be invoked. This allows us to do clean up during an on-demand process shutdown.
+ *
+ * @par Note
+ * If there is no need for an exit handler, then simply set the \c fctExit parameter to NULL.
+ *
+ * @par Note
+ * The thread name (szName) \b MUST be persistent and null terminated.. In the code the \b pointer to the
+ * name will simply be copied, the string itself will not be copied (i.e. there will be no strcpy call).
+ * If you use the provided macros this will not be an issue, as the entry function is string-ised into a
+ * constant persistent string.
+ */
+pthread_t pu_thread_create(
+    pu_thread_fct_t fctMain,
+    void*           pMainArg,
+    size_t          uiStackSize,
+    const char*     szName )
+{
+    pu_thread_attr_t attr;
+
+    pu_thread_attr_init( &attr );
+    attr.uiStackSize = uiStackSize;
+    return (pu_thread_create_attr( fctMain, pMainArg, &attr, szName ));
+}
+/* pu_thread_create */
+
+/**
+ * @brief   Joins a pu_thread, recycles its stack if it came from the cache
+ *
+ * @param[in]  pid    : Posix thread ID, as returned by \ref pu_thread_create
+ * @param[out] ppRet  : Thread return value, may be NULL
+ * @retval  0 for success
+ * @retval  Non-zero (as pthread_join) for failure
+ *
+ * @par Description
+ * Drop in replacement for pthread_join(). A cached stack can only be reused once glibc is
+ * completely done with the thread, i.e. after the join, so this is where it goes back.
+ */
+int pu_thread_join(
+    pthread_t pid,
+    void**    ppRet )
+{
+    return (pu_thread_join_until( pid, ppRet, NULL, NULL ));
+}
+/* pu_thread_join */
+
+/**
+ * @brief   Detaches a pu_thread, its registry slot is freed when it exits
+ *
+ * @param[in] pid : Posix thread ID, as returned by \ref pu_thread_create
+ * @retval  0 for success
+ * @retval  EINVAL if the thread runs on a cached stack
+ * @retval  Non-zero (as pthread_detach) for failure
+ *
+ * @par Description
+ * Drop in replacement for pthread_detach(). The thread and the detacher race to the slot: the
+ * exit handler sets EXITED, we set DETACHED, whoever comes second frees it.
+ */
+int pu_thread_detach( pthread_t pid )
+{
+    uint32_t uiSlot = 0;
+    bool     bSlot;
+    int      iResult;
+
+    /* A thread detaching itself may be quicker than its creator is at indexing it */
+    if (pSelfThread && pthread_equal( pSelfThread->pid, pid ))
+    {
+        uiSlot = pSelfThread->uiSlot;
+        bSlot  = true;
+    }
+    else
+    {
+        bSlot = pu_thread_slot_find( pid, &uiSlot );
+    }
+    /* Nobody would give a cached stack back */
+    if (bSlot && aSlots[uiSlot].pCacheStack)
+    {
+        return (EINVAL);
+    }
+    iResult = pthread_detach( pid );
+
+    if ((0 == iResult) && bSlot &&
+        (PU_THREAD_LIFE_EXITED & __atomic_fetch_or( &(aSlots[uiSlot].uiLife), PU_THREAD_LIFE_DETACHED, __ATOMIC_ACQ_REL )))
+    {
+        pu_thread_slot_reap( uiSlot, NULL );
+    }
+    return (iResult);
+}
+/* pu_thread_detach */
+
+/**
+ * @brief   Checks the stop token of the calling thread
+ *
+ * @return  true if the thread has been asked to stop
+ */
+bool pu_thread_stop_requested( void )
+{
+    return (__atomic_load_n( &bStopAll, __ATOMIC_ACQUIRE ) ||
+            (pSelfThread && __atomic_load_n( &(pSelfThread->bStop), __ATOMIC_ACQUIRE )));
+}
+/* pu_thread_stop_requested */
+
+/**
+ * @brief   Sets the stop token of one thread
+ *
+ * @param[in] pid : Posix thread ID
+ * @retval  0 for success
+ * @retval  ENOENT if the thread is not registered
+ *
+ * @par Description
+ * The slot is found through the pid index. Then no lock: the requester counts itself in on the
+ * slot before it looks at the context, like a post, and an exiting thread waits for that count
+ * to drop before its context is freed.
+ */
+int pu_thread_request_stop( pthread_t pid )
+{
+    uint32_t uiSlot;
+    uint32_t uiLife;
+
+    /* Stopping ourselves: our own context cannot go away, no need for the search */
+    if (pSelfThread && pthread_equal( pSelfThread->pid, pid ))
+    {
+        __atomic_store_n( &(pSelfThread->bStop), true, __ATOMIC_RELEASE );
+        return (0);
+    }
+
+    if (!pu_thread_slot_find( pid, &uiSlot ))
+    {
+        return (ENOENT);
+    }
+
+    /* Leave the request in the slot as well, a thread that is not in it yet picks it up there */
+    uiLife = __atomic_fetch_or( &(aSlots[uiSlot].uiLife), PU_THREAD_LIFE_STOP, __ATOMIC_SEQ_CST );
+    if (PU_THREAD_LIFE_EXITED & uiLife)
+    {
+        return (ENOENT);
+    }
+    pu_thread_slot_stop( &(aSlots[uiSlot]), &pid );
+    return (0);
+}
+/* pu_thread_request_stop */
+
+/**
+ * @brief   Sets the stop token of every thread, including ones created later
+ *
+ * @par Description
+ * The token of every registered thread is set, the global flag catches the threads that are
+ * not in the registry yet (or are not pu_threads). \ref pu_thread_join_all clears the flag
+ * again when it is done, the tokens stay set.
+ * Threads waiting for a message (or in a pool) are woken, without a lock like
+ * \ref pu_thread_request_stop.
+ */
+void pu_thread_request_stop_all( void )
+{
+    size_t uiHigh;
+    size_t i;
+
+    __atomic_store_n( &bStopAll, true, __ATOMIC_SEQ_CST );
+    uiHigh = __atomic_load_n( &uiSlotHigh, __ATOMIC_ACQUIRE );
+    for (i = 0; i < uiHigh; i++)
+    {
+        pu_thread_slot_stop( &(aSlots[i]), NULL );
+    }
+}
+/* pu_thread_request_stop_all */
+
+/**
+ * @brief   Stops and joins every registered thread, with a deadline
+ *
+ * @param[in]     uiTimeoutMs : Time allowed for a cooperative stop
+ * @param[out]    aReport     : Per thread report, may be NULL
+ * @param[in,out] puiReport   : In: size of aReport, out: entries filled in. May be NULL
+ * @retval  0 all threads have stopped
+ * @retval  EBUSY some threads could not be stopped
+ *
+ * @par Description
+ * 1. Sets every stop token and joins the threads until the deadline
+ * 2. Cancels what is left (the exit handler cleans up) and gives them a short grace period.
+ *    A thread asleep on one of our futex objects is left alone, cancelling it there would
+ *    leave the object locked (or its waiter count wrong) for everybody else
+ * 3. Whatever is still running is reported as stuck, it is not detached
+ * .
+ * Owned threads (pool workers) are not touched beyond the stop token, their owner joins them.
+ * The stop-all flag is cleared on the way out, so that threads created afterwards run normally.
+ * Threads that are still running keep their own stop token.
+ */
+int pu_thread_join_all(
+    uint32_t          uiTimeoutMs,
+    pu_thread_stop_t* aReport,
+    size_t*           puiReport )
+{
+    uint32_t          auiSlots[PU_THREAD_MAX_THREADS];
+    pu_thread_stop_t* aStop;
+    pu_thread_info_t  info;
+    struct timespec   tsDeadline;
+    uint64_t          uiStartNs;
+    uint64_t          uiExitNs;
+    size_t            uiCount;
+    size_t            uiStuck = 0;
+    size_t            uiOut   = 0;
+    size_t            i;
+    int               iResult;
+
+    aStop = (pu_thread_stop_t*)calloc( PU_THREAD_MAX_THREADS, sizeof(pu_thread_stop_t) );
+    ASSERT( aStop );
+    if (NULL == aStop)
+    {
+        return (ENOMEM);
+    }
+    uiStartNs = pu_thread_now_ns_private();
+    pu_thread_request_stop_all();
+    uiCount = pu_thread_collect( aStop, auiSlots );
+
+    /* Cooperative. The stop time is when the thread exited, not when it got joined */
+    pu_thread_deadline( &tsDeadline, uiTimeoutMs );
+    for (i = 0; i < uiCount; i++)
+    {
+        aStop[i].enHow = PU_THREAD_STOP_STUCK;
+        uiExitNs       = uiStartNs;
+        if (0 == pu_thread_join_until( aStop[i].pid, NULL, &tsDeadline, &uiExitNs ))
+        {
+            aStop[i].enHow    = PU_THREAD_STOP_JOINED;
+            aStop[i].uiStopNs = (uiExitNs > uiStartNs) ? (uiExitNs - uiStartNs) : 0;
+        }
+    }
+
+    /* Stragglers */
+    for (i = 0; i < uiCount; i++)
+    {
+        if ((PU_THREAD_STOP_STUCK == aStop[i].enHow) &&
+            !(pu_thread_slot_read( &(aSlots[auiSlots[i]]), &info ) && (NULL != info.pBlockedOn)))
+        {
+            pthread_cancel( aStop[i].pid );
+        }
+    }
+    pu_thread_deadline( &tsDeadline, PU_THREAD_CANCEL_GRACE_MS );
+    for (i = 0; i < uiCount; i++)
+    {
+        if (PU_THREAD_STOP_STUCK == aStop[i].enHow)
+        {
+            uiExitNs          = pu_thread_now_ns_private();
+            iResult           = pu_thread_join_until( aStop[i].pid, NULL, &tsDeadline, &uiExitNs );
+            aStop[i].uiStopNs = uiExitNs - uiStartNs;
+            if (0 == iResult)
+            {
+                aStop[i].enHow = PU_THREAD_STOP_CANCELLED;
+            }
+            else
+            {
+                uiStuck++;
+                LOG_ERROR( "PU_THREAD(stop):proc=%s, thrd=%s, tid=%d will not stop\n", szProcName, aStop[i].szName, (int)aStop[i].tid );
+            }
+        }
+        LOG_TRACE(
+            "PU_THREAD(stop):proc=%s, thrd=%s, tid=%d, %s after %llu us\n",
+            szProcName,
+            aStop[i].szName,
+            (int)aStop[i].tid,
+            ((PU_THREAD_STOP_JOINED == aStop[i].enHow) ? "joined" :
+             ((PU_THREAD_STOP_CANCELLED == aStop[i].enHow) ? "cancelled" : "stuck")),
+            (unsigned long long)(aStop[i].uiStopNs / 1000) );
+        if (aReport && puiReport && (uiOut < *puiReport))
+        {
+            aReport[uiOut++] = aStop[i];
+        }
+    }
+    if (puiReport)
+    {
+        *puiReport = uiOut;
+    }
+
+    /* The stuck ones may not have been started when the stop-all went out, make it personal */
+    for (i = 0; i < uiCount; i++)
+    {
+        if (PU_THREAD_STOP_STUCK == aStop[i].enHow)
+        {
+            pu_thread_request_stop( aStop[i].pid );
+        }
+    }
+    __atomic_store_n( &bStopAll, false, __ATOMIC_RELEASE );
+    free( aStop );
+    return ((0 == uiStuck) ? 0 : EBUSY);
+}
+/* pu_thread_join_all */
+
+/**
+ * @brief Gets the number of threads in the list
+ *
+ * @return Number of threads in the list
+ *
+ * @pre       None
+ * @post      Number of threads is returned
+ * @invariant The list is unchanged
+ *
+ * @par Description
+ * Simple query for number of active threads. This works in both debug and non-debug builds
+ */
+size_t pu_thread_get_number_of_threads( void )
+{
+   return (__atomic_load_n( &uiNumThreads, __ATOMIC_RELAXED ));
+}
+/* pu_thread_get_number_of_threads */
+
+/**
+ * @brief Calls a function for every registered thread
+ *
+ * @param[in] fctIter : Called once per thread, return false to stop the iteration
+ * @param[in] pArg    : Passed through to fctIter
+ * @return Number of threads visited
+ *
+ * @par Description
+ * Lock-free. Each slot is copied under its sequence count, so every \ref pu_thread_info_t is
+ * self consistent, but the set as a whole is only a snapshot.
+ */
+size_t pu_thread_for_each(
+    pu_thread_iter_fct_t fctIter,
+    void*                pArg )
+{
+    pu_thread_info_t info;
+    size_t           uiHigh;
+    size_t           uiVisited = 0;
+    size_t           i;
+
+    ASSERT( fctIter );
+    if (NULL != fctIter)
+    {
+        uiHigh = __atomic_load_n( &uiSlotHigh, __ATOMIC_ACQUIRE );
+        for (i = 0; i < uiHigh; i++)
+        {
+            if (pu_thread_slot_read( &(aSlots[i]), &info ))
+            {
+                uiVisited++;
+                if (!fctIter( &info, pArg ))
+                {
+                    break;
+                }
+            }
+        }
+    }
+    return (uiVisited);
+}
+/* pu_thread_for_each */
+
+/**
+ * @brief Prints the registered threads that are asleep on a posutils futex object
+ *
+ * @param[in] pOut : Output stream, NULL for stdout
+ * @return Number of blocked threads printed
+ */
+size_t pu_thread_dump_blocked( FILE* pOut )
+{
+    pu_thread_info_t info;
+    uint64_t         uiNow  = pu_thread_now_ns_private();
+    size_t           uiHigh = __atomic_load_n( &uiSlotHigh, __ATOMIC_ACQUIRE );
+    size_t           uiCount = 0;
+    size_t           i;
+
+    pOut = pOut ? pOut : stdout;
+    fprintf( pOut, "%-16s %7s %-12s %-18s %10s\n", "NAME", "TID", "BLOCKED ON", "OBJECT", "FOR (ms)" );
+    for (i = 0; i < uiHigh; i++)
+    {
+        if (pu_thread_slot_read( &(aSlots[i]), &info ) && (NULL != info.pBlockedOn))
+        {
+            fprintf( pOut, "%-16s %7d %-12s %-18p %10.1f\n",
+                info.szName, (int)info.tid, info.szBlockedOn, info.pBlockedOn,
+                (uiNow > info.uiBlockedNs) ? (double)(uiNow - info.uiBlockedNs) / 1.0e6 : 0.0 );
+            uiCount++;
+        }
+    }
+    fflush( pOut );
+    return (uiCount);
+}
+/* pu_thread_dump_blocked */
+
+/**
+ * @brief Finds a running thread by name
+ *
+ * @param[in]  szName : Thread name
+ * @param[out] pRef   : Reference to the thread
+ * @retval 0 for success
+ * @retval ENOENT not found
+ * @retval EINVAL NULL parameter
+ */
+int pu_thread_lookup_name(
+    const char*      szName,
+    pu_thread_ref_t* pRef )
+{
+    const pu_thread_slot_t* pSlot;
+    int                     iResult = ENOENT;
+
+    ASSERT( szName && pRef );
+    if ((NULL == szName) || (NULL == pRef))
+    {
+        return (EINVAL);
+    }
+    pthread_mutex_lock( &mtxIndex );
+    pSlot = (const pu_thread_slot_t*)pu_hmap_find( &mapName, szName );
+    if (pSlot)
+    {
+        pRef->uiSlot = (uint32_t)(pSlot - aSlots);
+        pRef->uiGen  = pSlot->uiGen;
+        iResult      = 0;
+    }
+    pthread_mutex_unlock( &mtxIndex );
+    return (iResult);
+}
+/* pu_thread_lookup_name */
+
+/**
+ * @brief Finds a running thread by Linux thread ID
+ *
+ * @param[in]  tid  : Linux thread ID
+ * @param[out] pRef : Reference to the thread
+ * @retval 0 for success
+ * @retval ENOENT not found
+ * @retval EINVAL NULL parameter
+ */
+int pu_thread_lookup_tid(
+    pid_t            tid,
+    pu_thread_ref_t* pRef )
+{
+    const pu_thread_slot_t* pSlot;
+    int                     iResult = ENOENT;
+
+    ASSERT( pRef );
+    if (NULL == pRef)
+    {
+        return (EINVAL);
+    }
+    pthread_mutex_lock( &mtxIndex );
+    pSlot = (const pu_thread_slot_t*)pu_hmap_find( &mapTid, &tid );
+    if (pSlot)
+    {
+        pRef->uiSlot = (uint32_t)(pSlot - aSlots);
+        pRef->uiGen  = pSlot->uiGen;
+        iResult      = 0;
+    }
+    pthread_mutex_unlock( &mtxIndex );
+    return (iResult);
+}
+/* pu_thread_lookup_tid */
+
+/**
+ * @brief Posts a message to a thread's mailbox
+ *
+ * @param[in] ref  : The receiver
+ * @param[in] pMsg : Message
+ * @retval 0 for success, the receiver owns the message
+ * @retval ESRCH the receiver has exited, the caller keeps the message
+ * @retval EINVAL bad reference or NULL message
+ *
+ * @par Description
+ * No lock. The poster counts itself in on the slot before it looks at it, and an exiting thread
+ * clears the slot before it waits for that count to drop to zero. So if the slot still holds the
+ * same generation, the context (and its mailbox) stays put until we are done.
+ */
+int pu_thread_post(
+    pu_thread_ref_t ref,
+    pu_msg_t*       pMsg )
+{
+    pu_thread_context_t* pNode;
+    pu_thread_slot_t*    pSlot;
+    int                  iResult = ESRCH;
+
+    ASSERT( pMsg && (ref.uiSlot < PU_THREAD_MAX_THREADS) );
+    if ((NULL == pMsg) || (ref.uiSlot >= PU_THREAD_MAX_THREADS))
+    {
+        return (EINVAL);
+    }
+    pSlot = &(aSlots[ref.uiSlot]);
+    __atomic_fetch_add( &(pSlot->uiPosters), 1, __ATOMIC_SEQ_CST );
+    /* pNode first, then the generation: a new occupant's pNode comes with its new generation, so
+     * a stale ref cannot match it
+     */
+    pNode = __atomic_load_n( &(pSlot->pNode), __ATOMIC_SEQ_CST );
+    if (pNode && (__atomic_load_n( &(pSlot->uiGen), __ATOMIC_ACQUIRE ) == ref.uiGen))
+    {
+        pMsg->tidFrom = pSelfThread ? pSelfThread->tid : 0;
+        pu_mpsc_push( &(pNode->mbox.queue), &(pMsg->node) );
+        pu_thread_mailbox_wake( pNode );
+        iResult = 0;
+    }
+    __atomic_fetch_sub( &(pSlot->uiPosters), 1, __ATOMIC_RELEASE );
+    return (iResult);
+}
+/* pu_thread_post */
+
+/**
+ * @brief Takes the oldest message out of the calling thread's mailbox
+ *
+ * @param[in] uiTimeoutMs : 0 to poll, PU_FUTEX_FOREVER to wait without a timeout
+ * @return The message, NULL on timeout, stop request (mailbox empty) or if not a pu_thread
+ *
+ * @par Description
+ * Same handshake as the ring: announce the sleep, full fence, look again. A poster pushes,
+ * fences, then looks at uiSleeping, so one of the two sees the other. A post (or a stop
+ * request) between the look and the futex wait clears uiSleeping and the wait returns at once.
+ */
+pu_msg_t* pu_thread_receive( uint32_t uiTimeoutMs )
+{
+    pu_thread_context_t* pNode = pSelfThread;
+    pu_thread_mailbox_t* pMbox;
+    pu_msg_t*            pMsg;
+    struct timespec      deadline;
+
+    ASSERT( pNode );
+    if (NULL == pNode)
+    {
+        return (NULL);
+    }
+    pMbox = &(pNode->mbox);
+    pMsg  = (pu_msg_t*)pu_mpsc_pop( &(pMbox->queue) );
+    if ((NULL != pMsg) || (0 == uiTimeoutMs))
+    {
+        return (pMsg);
+    }
+
+    if (PU_FUTEX_FOREVER != uiTimeoutMs)
+    {
+        pu_futex_deadline_private( &deadline, uiTimeoutMs );
+    }
+    pu_thread_blocked_private( pMbox, "mailbox" );
+    for (;;)
+    {
+        __atomic_store_n( &(pMbox->uiSleeping), 1, __ATOMIC_RELAXED );
+        __atomic_thread_fence( __ATOMIC_SEQ_CST );
+        pMsg = (pu_msg_t*)pu_mpsc_pop( &(pMbox->queue) );
+        if ((NULL != pMsg) || pu_thread_stop_requested())
+        {
+            break;
+        }
+        if (ETIMEDOUT == pu_futex_wait_until_private( &(pMbox->uiSleeping), 1, (PU_FUTEX_FOREVER != uiTimeoutMs) ? &deadline : NULL ))
+        {
+            pMsg = (pu_msg_t*)pu_mpsc_pop( &(pMbox->queue) );
+            break;
+        }
+    }
+    __atomic_store_n( &(pMbox->uiSleeping), 0, __ATOMIC_RELAXED );
+    pu_thread_blocked_private( NULL, NULL );
+    return (pMsg);
+}
+/* pu_thread_receive */
+
+/**
+ * @brief Gets the calling thread's context
+ *
+ * @return The context, NULL if the caller is not a pu_thread (or is exiting)
+ */
+pu_thread_context_t* pu_thread_self( void )
+{
+    return (pSelfThread);
+}
+/* pu_thread_self */
+
+/**
+ * @brief Gets the name of a thread
+ *
+ * @param[in] pCtx : Context from \ref pu_thread_self
+ * @return The name, NULL for a NULL context
+ */
+const char* pu_thread_get_name( const pu_thread_context_t* pCtx )
+{
+    return (pCtx ? pCtx->szName : NULL);
+}
+/* pu_thread_get_name */
+
+/**
+ * @brief Gets the Linux thread ID of a thread
+ *
+ * @param[in] pCtx : Context from \ref pu_thread_self
+ * @return The tid, 0 for a NULL context
+ */
+pid_t pu_thread_get_tid( const pu_thread_context_t* pCtx )
+{
+    return (pCtx ? pCtx->tid : 0);
+}
+/* pu_thread_get_tid */
+
+/**
+ * @brief Gets a reference to a thread, for its mailbox
+ *
+ * @param[in]  pCtx : Context from \ref pu_thread_self
+ * @param[out] pRef : The reference
+ * @retval 0 for success
+ * @retval EINVAL NULL parameter
+ *
+ * @par Description
+ * The slot is the thread's own, and its generation was set before the thread started, so no
+ * lock is needed.
+ */
+int pu_thread_get_ref(
+    const pu_thread_context_t* pCtx,
+    pu_thread_ref_t*           pRef )
+{
+    if ((NULL == pCtx) || (NULL == pRef))
+    {
+        return (EINVAL);
+    }
+    pRef->uiSlot = pCtx->uiSlot;
+    pRef->uiGen  = __atomic_load_n( &(aSlots[pCtx->uiSlot].uiGen), __ATOMIC_RELAXED );
+    return (0);
+}
+/* pu_thread_get_ref */
+
+/**
+ * @brief Gets the user data of a thread
+ *
+ * @param[in] pCtx : Context from \ref pu_thread_self
+ * @return The user data, NULL if never set (or for a NULL context)
+ */
+void* pu_thread_get_user( const pu_thread_context_t* pCtx )
+{
+    return (pCtx ? pCtx->pUserData : NULL);
+}
+/* pu_thread_get_user */
+
+/**
+ * @brief Sets the user data of a thread
+ *
+ * @param[in] pCtx      : Context from \ref pu_thread_self
+ * @param[in] pUserData : Anything, the thread owns it
+ */
+void pu_thread_set_user(
+    pu_thread_context_t* pCtx,
+    void*                pUserData )
+{
+    ASSERT( pCtx );
+    if (pCtx)
+    {
+        pCtx->pUserData = pUserData;
+    }
+}
+/* pu_thread_set_user */